@@ -0,0 +1,728 @@
+#include "datarepository.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QMetaMethod>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QJsonDocument>
+#include <QFileInfo>
+#include <QUuid>
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+
+DataRepository::DataRepository(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_connectionName("datarepository-" + QUuid::createUuid().toString())
+    , m_initialized(false)
+    , m_maxQueueSize(DEFAULT_MAX_QUEUE_SIZE)
+{
+    if (m_databasePath.isEmpty()) {
+        const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dataDir);
+        m_databasePath = dataDir + "/industrial_data.db";
+    }
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(DEFAULT_FLUSH_INTERVAL_MS);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DataRepository::onFlushTimer);
+
+    m_vacuumTimer.setInterval(VACUUM_STEP_INTERVAL_MS);
+    connect(&m_vacuumTimer, &QTimer::timeout, this, &DataRepository::onVacuumStep);
+}
+
+DataRepository::~DataRepository()
+{
+    m_vacuumTimer.stop();
+    flush();
+
+    {
+        QMutexLocker locker(&m_dbMutex);
+        if (m_database.isOpen()) {
+            m_database.close();
+        }
+        m_database = QSqlDatabase();
+        m_initialized = false;
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool DataRepository::initialize()
+{
+    // Errors are reported once the lock is released, so a slot connected
+    // to databaseError() can call back into the repository
+    QString error;
+    {
+        QMutexLocker locker(&m_dbMutex);
+
+        if (m_initialized) {
+            return true;
+        }
+
+        m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+        m_database.setDatabaseName(m_databasePath);
+        if (!m_database.open()) {
+            error = "Failed to open database: " + m_database.lastError().text();
+        } else {
+            QSqlQuery pragma(m_database);
+
+            // Must be set before the first table is created to take effect
+            pragma.exec("PRAGMA auto_vacuum = INCREMENTAL");
+            pragma.exec("PRAGMA journal_mode = WAL");
+            pragma.exec("PRAGMA synchronous = NORMAL");
+
+            error = createTables();
+            if (error.isEmpty() && pragma.exec("PRAGMA auto_vacuum") && pragma.next()
+                && pragma.value(0).toInt() != 2) {
+                // File created without incremental auto-vacuum: one full VACUUM converts it
+                qWarning() << "DataRepository: Converting" << m_databasePath << "to incremental auto-vacuum";
+                if (!pragma.exec("VACUUM")) {
+                    qWarning() << "DataRepository: Conversion failed:" << pragma.lastError().text();
+                }
+            }
+            m_initialized = error.isEmpty();
+        }
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+        return false;
+    }
+    return true;
+}
+
+bool DataRepository::isConnected() const
+{
+    QMutexLocker locker(&m_dbMutex);
+    return m_initialized && m_database.isOpen();
+}
+
+QString DataRepository::createTables()
+{
+    const QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS data_points ("
+        "  id INTEGER PRIMARY KEY,"
+        "  source TEXT NOT NULL,"
+        "  tag TEXT NOT NULL,"
+        "  timestamp INTEGER NOT NULL,"
+        "  value,"
+        "  quality INTEGER NOT NULL)",
+        "CREATE INDEX IF NOT EXISTS idx_data_points_source_tag_time"
+        "  ON data_points (source, tag, timestamp)",
+        "CREATE INDEX IF NOT EXISTS idx_data_points_time ON data_points (timestamp)",
+        "CREATE TABLE IF NOT EXISTS controller_config ("
+        "  controller_ip TEXT PRIMARY KEY,"
+        "  config TEXT NOT NULL,"
+        "  updated INTEGER NOT NULL)",
+        "CREATE TABLE IF NOT EXISTS events ("
+        "  id INTEGER PRIMARY KEY,"
+        "  timestamp INTEGER NOT NULL,"
+        "  type TEXT NOT NULL,"
+        "  source TEXT,"
+        "  message TEXT)",
+        "CREATE INDEX IF NOT EXISTS idx_events_time ON events (timestamp)"
+    };
+
+    QSqlQuery query(m_database);
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            return "Failed to create tables: " + query.lastError().text();
+        }
+    }
+    return QString();
+}
+
+bool DataRepository::insertDataPoint(const QString &source, const DataPoint &point)
+{
+    return writeBatch({ SourcedPoint(source, point) });
+}
+
+bool DataRepository::insertDataPoints(const QString &source, const QList<DataPoint> &points)
+{
+    QList<SourcedPoint> batch;
+    batch.reserve(points.size());
+    for (const DataPoint &point : points) {
+        batch.append(SourcedPoint(source, point));
+    }
+    return writeBatch(batch);
+}
+
+bool DataRepository::writeBatch(const QList<SourcedPoint> &points)
+{
+    if (points.isEmpty()) {
+        return true;
+    }
+
+    QString error;
+    {
+        QMutexLocker locker(&m_dbMutex);
+        error = m_initialized ? insertBatch(points) : QString("Database not initialized");
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+        return false;
+    }
+
+    // Per-point notification is only worth its cost if somebody listens
+    if (isSignalConnected(QMetaMethod::fromSignal(&DataRepository::dataInserted))) {
+        for (const SourcedPoint &entry : points) {
+            emit dataInserted(entry.first, entry.second);
+        }
+    }
+
+    return true;
+}
+
+QString DataRepository::insertBatch(const QList<SourcedPoint> &points)
+{
+    auto insertStatement = [](int rows) {
+        QStringList placeholders;
+        placeholders.reserve(rows);
+        for (int i = 0; i < rows; ++i) {
+            placeholders.append("(?, ?, ?, ?, ?)");
+        }
+        return "INSERT INTO data_points (source, tag, timestamp, value, quality) VALUES "
+               + placeholders.join(", ");
+    };
+
+    if (!m_database.transaction()) {
+        return "Failed to begin transaction: " + m_database.lastError().text();
+    }
+
+    // Full-size statement is prepared once and reused; only the tail of
+    // the batch needs its own statement
+    QSqlQuery fullStatement(m_database);
+    bool fullPrepared = false;
+
+    for (int offset = 0; offset < points.size(); offset += ROWS_PER_STATEMENT) {
+        const int rows = qMin(ROWS_PER_STATEMENT, points.size() - offset);
+
+        QSqlQuery tailStatement(m_database);
+        QSqlQuery &query = rows == ROWS_PER_STATEMENT ? fullStatement : tailStatement;
+        bool prepared = true;
+        if (&query == &tailStatement) {
+            prepared = query.prepare(insertStatement(rows));
+        } else if (!fullPrepared) {
+            prepared = fullPrepared = query.prepare(insertStatement(rows));
+        }
+
+        if (prepared) {
+            for (int row = 0; row < rows; ++row) {
+                const SourcedPoint &entry = points.at(offset + row);
+                const int column = row * 5;
+                query.bindValue(column, entry.first);
+                query.bindValue(column + 1, entry.second.tag());
+                query.bindValue(column + 2, entry.second.timestamp().toMSecsSinceEpoch());
+                query.bindValue(column + 3, entry.second.value());
+                query.bindValue(column + 4, static_cast<int>(entry.second.quality()));
+            }
+        }
+
+        if (!prepared || !query.exec()) {
+            const QString error = query.lastError().text();
+            m_database.rollback();
+            return "Failed to insert data points: " + error;
+        }
+    }
+
+    if (!m_database.commit()) {
+        const QString error = m_database.lastError().text();
+        m_database.rollback();
+        return "Failed to commit data points: " + error;
+    }
+    return QString();
+}
+
+QList<DataPoint> DataRepository::getHistoricalData(const QString &source, const QString &tag,
+                                                   const QDateTime &startTime, const QDateTime &endTime) const
+{
+    QList<DataPoint> result;
+    const qint64 startMs = startTime.toMSecsSinceEpoch();
+    const qint64 endMs = endTime.toMSecsSinceEpoch();
+    QString error;
+
+    {
+        QMutexLocker locker(&m_dbMutex);
+        if (!m_initialized) {
+            return result;
+        }
+
+        QSqlQuery query(m_database);
+        query.setForwardOnly(true);
+        query.prepare("SELECT timestamp, value, quality FROM data_points "
+                      "WHERE source = ? AND tag = ? AND timestamp BETWEEN ? AND ? "
+                      "ORDER BY timestamp");
+        query.addBindValue(source);
+        query.addBindValue(tag);
+        query.addBindValue(startMs);
+        query.addBindValue(endMs);
+
+        if (!query.exec()) {
+            error = "Failed to query historical data: " + query.lastError().text();
+        }
+
+        while (query.next()) {
+            result.append(DataPoint(tag, query.value(1),
+                                    QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong()),
+                                    static_cast<DataPoint::Quality>(query.value(2).toInt())));
+        }
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+        return result;
+    }
+
+    // Samples still in the write-behind queue
+    bool appendedQueued = false;
+    for (const SourcedPoint &entry : m_writeQueue) {
+        const qint64 ts = entry.second.timestamp().toMSecsSinceEpoch();
+        if (entry.first == source && entry.second.tag() == tag && ts >= startMs && ts <= endMs) {
+            result.append(entry.second);
+            appendedQueued = true;
+        }
+    }
+    if (appendedQueued) {
+        std::stable_sort(result.begin(), result.end(), [](const DataPoint &a, const DataPoint &b) {
+            return a.timestamp() < b.timestamp();
+        });
+    }
+
+    return result;
+}
+
+QList<DataPoint> DataRepository::getLatestData(const QString &source, int count) const
+{
+    QList<DataPoint> result;
+    if (count <= 0) {
+        return result;
+    }
+
+    // Queued samples are the newest ones
+    for (int i = m_writeQueue.size() - 1; i >= 0 && result.size() < count; --i) {
+        if (m_writeQueue.at(i).first == source) {
+            result.append(m_writeQueue.at(i).second);
+        }
+    }
+
+    QString error;
+    {
+        QMutexLocker locker(&m_dbMutex);
+        if (!m_initialized || result.size() >= count) {
+            return result;
+        }
+
+        QSqlQuery query(m_database);
+        query.setForwardOnly(true);
+        query.prepare("SELECT tag, timestamp, value, quality FROM data_points "
+                      "WHERE source = ? ORDER BY timestamp DESC LIMIT ?");
+        query.addBindValue(source);
+        query.addBindValue(count - result.size());
+
+        if (!query.exec()) {
+            error = "Failed to query latest data: " + query.lastError().text();
+        }
+
+        while (query.next()) {
+            result.append(DataPoint(query.value(0).toString(), query.value(2),
+                                    QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+                                    static_cast<DataPoint::Quality>(query.value(3).toInt())));
+        }
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+    }
+    return result;
+}
+
+bool DataRepository::flush()
+{
+    m_flushTimer.stop();
+
+    if (m_writeQueue.isEmpty()) {
+        return true;
+    }
+
+    QList<SourcedPoint> batch;
+    batch.swap(m_writeQueue);
+
+    if (writeBatch(batch)) {
+        return true;
+    }
+
+    // Keep the samples for the next attempt, but never more than a few
+    // queues' worth while the database is unavailable
+    m_writeQueue = batch + m_writeQueue;
+    const int limit = m_maxQueueSize * 4;
+    if (m_writeQueue.size() > limit) {
+        const int dropped = m_writeQueue.size() - limit;
+        m_writeQueue.erase(m_writeQueue.begin(), m_writeQueue.begin() + dropped);
+        qWarning() << "DataRepository: Dropped" << dropped << "queued samples";
+    }
+    m_flushTimer.start();
+    return false;
+}
+
+int DataRepository::queuedCount() const
+{
+    return m_writeQueue.size();
+}
+
+int DataRepository::flushInterval() const
+{
+    return m_flushTimer.interval();
+}
+
+void DataRepository::setFlushInterval(int msecs)
+{
+    m_flushTimer.setInterval(qMax(0, msecs));
+}
+
+int DataRepository::maxQueueSize() const
+{
+    return m_maxQueueSize;
+}
+
+void DataRepository::setMaxQueueSize(int samples)
+{
+    m_maxQueueSize = qMax(1, samples);
+}
+
+bool DataRepository::saveControllerConfig(const QString &controllerIp, const QVariantMap &config)
+{
+    const QString json = QString::fromUtf8(QJsonDocument::fromVariant(config).toJson(QJsonDocument::Compact));
+
+    QVariantMap bindings;
+    bindings[":ip"] = controllerIp;
+    bindings[":config"] = json;
+    bindings[":updated"] = QDateTime::currentMSecsSinceEpoch();
+
+    return executeSql("INSERT OR REPLACE INTO controller_config (controller_ip, config, updated) "
+                      "VALUES (:ip, :config, :updated)", bindings);
+}
+
+QVariantMap DataRepository::loadControllerConfig(const QString &controllerIp) const
+{
+    QVariantMap bindings;
+    bindings[":ip"] = controllerIp;
+
+    const QList<QVariantMap> rows = executeQuery(
+        "SELECT config FROM controller_config WHERE controller_ip = :ip", bindings);
+    if (rows.isEmpty()) {
+        return QVariantMap();
+    }
+
+    return QJsonDocument::fromJson(rows.first().value("config").toString().toUtf8()).toVariant().toMap();
+}
+
+QStringList DataRepository::getConfiguredControllers() const
+{
+    QStringList controllers;
+    for (const QVariantMap &row : executeQuery("SELECT controller_ip FROM controller_config ORDER BY controller_ip")) {
+        controllers.append(row.value("controller_ip").toString());
+    }
+    return controllers;
+}
+
+bool DataRepository::logEvent(const QString &type, const QString &source,
+                              const QString &message, const QDateTime &timestamp)
+{
+    QVariantMap bindings;
+    bindings[":timestamp"] = timestamp.toMSecsSinceEpoch();
+    bindings[":type"] = type;
+    bindings[":source"] = source;
+    bindings[":message"] = message;
+
+    return executeSql("INSERT INTO events (timestamp, type, source, message) "
+                      "VALUES (:timestamp, :type, :source, :message)", bindings);
+}
+
+QList<QVariantMap> DataRepository::getEvents(const QDateTime &startTime, const QDateTime &endTime,
+                                             const QString &source) const
+{
+    QVariantMap bindings;
+    bindings[":start"] = startTime.toMSecsSinceEpoch();
+    bindings[":end"] = endTime.toMSecsSinceEpoch();
+
+    QString sql = "SELECT timestamp, type, source, message FROM events "
+                  "WHERE timestamp BETWEEN :start AND :end";
+    if (!source.isEmpty()) {
+        sql += " AND source = :source";
+        bindings[":source"] = source;
+    }
+    sql += " ORDER BY timestamp";
+
+    QList<QVariantMap> events = executeQuery(sql, bindings);
+    for (QVariantMap &event : events) {
+        event["timestamp"] = QDateTime::fromMSecsSinceEpoch(event.value("timestamp").toLongLong());
+    }
+    return events;
+}
+
+bool DataRepository::cleanupOldData(const QDateTime &cutoffTime)
+{
+    QVariantMap bindings;
+    bindings[":cutoff"] = cutoffTime.toMSecsSinceEpoch();
+
+    const bool removed = executeSql("DELETE FROM data_points WHERE timestamp < :cutoff", bindings)
+                         && executeSql("DELETE FROM events WHERE timestamp < :cutoff", bindings);
+
+    // Hand the freed pages back to the file system in the background
+    if (removed) {
+        vacuum();
+    }
+    return removed;
+}
+
+qint64 DataRepository::getDatabaseSize() const
+{
+    return QFileInfo(m_databasePath).size() + QFileInfo(m_databasePath + "-wal").size();
+}
+
+bool DataRepository::vacuum()
+{
+    if (!isConnected()) {
+        return false;
+    }
+
+    if (!m_vacuumTimer.isActive()) {
+        m_vacuumTimer.start();
+    }
+    return true;
+}
+
+bool DataRepository::isVacuuming() const
+{
+    return m_vacuumTimer.isActive();
+}
+
+void DataRepository::onVacuumStep()
+{
+    QString error;
+    bool finished = false;
+    {
+        QMutexLocker locker(&m_dbMutex);
+
+        QSqlQuery query(m_database);
+        if (!m_initialized || !query.exec("PRAGMA freelist_count") || !query.next()) {
+            m_vacuumTimer.stop();
+            return;
+        }
+
+        if (query.value(0).toLongLong() == 0) {
+            finished = true;
+        } else if (query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(VACUUM_PAGES_PER_STEP))) {
+            // Each step of the statement releases one page, so drain it
+            while (query.next()) {
+            }
+        } else {
+            error = "Incremental vacuum failed: " + query.lastError().text();
+        }
+    }
+
+    if (finished) {
+        m_vacuumTimer.stop();
+        emit vacuumFinished();
+    } else if (!error.isEmpty()) {
+        m_vacuumTimer.stop();
+        reportError(error);
+    }
+}
+
+void DataRepository::onDataReceived(const QString &source, const QString &tag, const QVariant &value)
+{
+    m_writeQueue.append(SourcedPoint(source, DataPoint(tag, value)));
+
+    if (m_writeQueue.size() >= m_maxQueueSize) {
+        flush();
+    } else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void DataRepository::onEventOccurred(const QString &type, const QString &source, const QString &message)
+{
+    logEvent(type, source, message);
+}
+
+void DataRepository::onFlushTimer()
+{
+    flush();
+}
+
+bool DataRepository::executeSql(const QString &query, const QVariantMap &bindings) const
+{
+    QString error;
+    {
+        QMutexLocker locker(&m_dbMutex);
+
+        if (!m_initialized) {
+            error = "Database not initialized";
+        } else {
+            QSqlQuery sqlQuery(m_database);
+            sqlQuery.prepare(query);
+            for (auto it = bindings.constBegin(); it != bindings.constEnd(); ++it) {
+                sqlQuery.bindValue(it.key(), it.value());
+            }
+
+            if (!sqlQuery.exec()) {
+                error = "SQL error: " + sqlQuery.lastError().text();
+            }
+        }
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+        return false;
+    }
+    return true;
+}
+
+QList<QVariantMap> DataRepository::executeQuery(const QString &query, const QVariantMap &bindings) const
+{
+    QList<QVariantMap> rows;
+    QString error;
+    {
+        QMutexLocker locker(&m_dbMutex);
+
+        if (!m_initialized) {
+            return rows;
+        }
+
+        QSqlQuery sqlQuery(m_database);
+        sqlQuery.setForwardOnly(true);
+        sqlQuery.prepare(query);
+        for (auto it = bindings.constBegin(); it != bindings.constEnd(); ++it) {
+            sqlQuery.bindValue(it.key(), it.value());
+        }
+
+        if (!sqlQuery.exec()) {
+            error = "SQL error: " + sqlQuery.lastError().text();
+        }
+
+        while (sqlQuery.next()) {
+            const QSqlRecord record = sqlQuery.record();
+            QVariantMap row;
+            for (int i = 0; i < record.count(); ++i) {
+                row.insert(record.fieldName(i), sqlQuery.value(i));
+            }
+            rows.append(row);
+        }
+    }
+
+    if (!error.isEmpty()) {
+        reportError(error);
+    }
+    return rows;
+}
+
+void DataRepository::reportError(const QString &error) const
+{
+    qWarning() << "DataRepository:" << error;
+    emit const_cast<DataRepository *>(this)->databaseError(error);
+}
+
+CircularDataBuffer::CircularDataBuffer(int maxSize, QObject *parent)
+    : QObject(parent)
+    , m_maxSize(qMax(1, maxSize))
+    , m_currentIndex(0)
+{
+    m_buffer.reserve(m_maxSize);
+}
+
+void CircularDataBuffer::addDataPoint(const DataPoint &point)
+{
+    bool becameFull = false;
+    {
+        QMutexLocker locker(&m_bufferMutex);
+        if (m_buffer.size() < m_maxSize) {
+            m_buffer.append(point);
+            becameFull = m_buffer.size() == m_maxSize;
+        } else {
+            m_buffer[m_currentIndex] = point;
+            m_currentIndex = (m_currentIndex + 1) % m_maxSize;
+        }
+    }
+
+    emit dataAdded(point);
+    if (becameFull) {
+        emit bufferFull();
+    }
+}
+
+QList<DataPoint> CircularDataBuffer::getData(int count) const
+{
+    QMutexLocker locker(&m_bufferMutex);
+
+    const int size = m_buffer.size();
+    const int n = (count < 0 || count > size) ? size : count;
+
+    // Oldest entry is at m_currentIndex once the buffer has wrapped
+    QList<DataPoint> result;
+    result.reserve(n);
+    for (int i = size - n; i < size; ++i) {
+        result.append(m_buffer.at((m_currentIndex + i) % size));
+    }
+    return result;
+}
+
+QList<DataPoint> CircularDataBuffer::getDataRange(const QDateTime &start, const QDateTime &end) const
+{
+    QMutexLocker locker(&m_bufferMutex);
+
+    const int size = m_buffer.size();
+    QList<DataPoint> result;
+    for (int i = 0; i < size; ++i) {
+        const DataPoint &point = m_buffer.at((m_currentIndex + i) % size);
+        if (point.timestamp() >= start && point.timestamp() <= end) {
+            result.append(point);
+        }
+    }
+    return result;
+}
+
+void CircularDataBuffer::clear()
+{
+    QMutexLocker locker(&m_bufferMutex);
+    m_buffer.clear();
+    m_currentIndex = 0;
+}
+
+int CircularDataBuffer::size() const
+{
+    QMutexLocker locker(&m_bufferMutex);
+    return m_buffer.size();
+}
+
+int CircularDataBuffer::maxSize() const
+{
+    QMutexLocker locker(&m_bufferMutex);
+    return m_maxSize;
+}
+
+void CircularDataBuffer::setMaxSize(int maxSize)
+{
+    QMutexLocker locker(&m_bufferMutex);
+
+    maxSize = qMax(1, maxSize);
+    if (maxSize == m_maxSize) {
+        return;
+    }
+
+    // Unroll into chronological order, keeping the newest points
+    const int size = m_buffer.size();
+    const int keep = qMin(size, maxSize);
+    QList<DataPoint> unrolled;
+    unrolled.reserve(maxSize);
+    for (int i = size - keep; i < size; ++i) {
+        unrolled.append(m_buffer.at((m_currentIndex + i) % size));
+    }
+
+    m_buffer = unrolled;
+    m_maxSize = maxSize;
+    m_currentIndex = 0;
+}
@@ -4,29 +4,39 @@
 #include <QSqlDatabase>
 #include <QDateTime>
 #include <QVariantMap>
-
-/**
- * @brief Data point for historical trending
- */
-struct DataPoint
-{
-    QString source;
-    QString tag;
-    QVariant value;
-    QDateTime timestamp;
-    int quality; // 0=Bad, 1=Uncertain, 2=Good
-};
+#include <QMutex>
+#include <QTimer>
+#include <QPair>
+#include "../models/datapoint.h"
 
 /**
  * @brief Repository pattern for industrial data persistence
  *
- * Handles historical data, configurations, and event logging
+ * Handles historical data, configurations, and event logging. Samples
+ * are stored per (source, tag) using the shared DataPoint model; the
+ * source is the controller the sample came from.
+ *
+ * Live samples delivered through onDataReceived() are queued and written
+ * in batches (write-behind), either every flushInterval() ms or as soon as
+ * maxQueueSize() samples are waiting. Space freed by cleanupOldData() is
+ * returned to the file system by an incremental vacuum that runs in small
+ * steps from the event loop, so the database is never locked for the
+ * length of a full VACUUM.
+ *
+ * Threading: All methods must be called from the thread the repository
+ * lives in; move it to a worker QThread to keep disk I/O off the GUI thread.
  */
 class DataRepository : public QObject
 {
     Q_OBJECT
 
 public:
+    static constexpr int DEFAULT_FLUSH_INTERVAL_MS = 1000;  // Write-behind period
+    static constexpr int DEFAULT_MAX_QUEUE_SIZE = 5000;     // Queued samples that force a flush
+    static constexpr int ROWS_PER_STATEMENT = 199;          // 5 parameters per row, below SQLite's 999 limit
+    static constexpr int VACUUM_PAGES_PER_STEP = 256;       // Pages released per incremental vacuum step
+    static constexpr int VACUUM_STEP_INTERVAL_MS = 100;     // Pause between vacuum steps
+
     explicit DataRepository(const QString &databasePath = QString(), QObject *parent = nullptr);
     ~DataRepository();
 
@@ -34,12 +44,20 @@ public:
     bool isConnected() const;
 
     // Historical data
-    bool insertDataPoint(const DataPoint &point);
-    bool insertDataPoints(const QList<DataPoint> &points);
+    bool insertDataPoint(const QString &source, const DataPoint &point);
+    bool insertDataPoints(const QString &source, const QList<DataPoint> &points);
     QList<DataPoint> getHistoricalData(const QString &source, const QString &tag,
                                        const QDateTime &startTime, const QDateTime &endTime) const;
     QList<DataPoint> getLatestData(const QString &source, int count = 100) const;
 
+    // Write-behind queue
+    bool flush();
+    int queuedCount() const;
+    int flushInterval() const;
+    void setFlushInterval(int msecs);
+    int maxQueueSize() const;
+    void setMaxQueueSize(int samples);
+
     // Configuration management
     bool saveControllerConfig(const QString &controllerIp, const QVariantMap &config);
     QVariantMap loadControllerConfig(const QString &controllerIp) const;
@@ -54,32 +72,51 @@ public:
     // Maintenance
     bool cleanupOldData(const QDateTime &cutoffTime);
     qint64 getDatabaseSize() const;
-    bool vacuum();
+    bool vacuum();              // Starts a background incremental vacuum; returns immediately
+    bool isVacuuming() const;
 
 public slots:
     void onDataReceived(const QString &source, const QString &tag, const QVariant &value);
     void onEventOccurred(const QString &type, const QString &source, const QString &message);
 
 signals:
-    void dataInserted(const DataPoint &point);
+    void dataInserted(const QString &source, const DataPoint &point);
     void databaseError(const QString &error);
+    void vacuumFinished();
+
+private slots:
+    void onFlushTimer();
+    void onVacuumStep();
 
 private:
-    bool createTables();
+    typedef QPair<QString, DataPoint> SourcedPoint;
+
+    QString createTables();                                 // Returns the error, empty on success
+    bool writeBatch(const QList<SourcedPoint> &points);
+    QString insertBatch(const QList<SourcedPoint> &points); // Caller holds m_dbMutex
     bool executeSql(const QString &query, const QVariantMap &bindings = QVariantMap()) const;
     QList<QVariantMap> executeQuery(const QString &query, const QVariantMap &bindings = QVariantMap()) const;
+    void reportError(const QString &error) const;           // Never called with m_dbMutex held
 
     QSqlDatabase m_database;
     QString m_databasePath;
+    QString m_connectionName;
     bool m_initialized;
 
+    QList<SourcedPoint> m_writeQueue;   // Samples waiting for the next flush
+    int m_maxQueueSize;
+    QTimer m_flushTimer;
+    QTimer m_vacuumTimer;
+
     mutable QMutex m_dbMutex;
 };
 
 /**
  * @brief High-performance circular buffer for real-time data
  *
- * Used for live trending while repository handles historical storage
+ * Used for live trending while repository handles historical storage.
+ * Storage is allocated once; adding a point overwrites the oldest one
+ * when the buffer is full.
  */
 class CircularDataBuffer : public QObject
 {
@@ -89,7 +126,7 @@ public:
     explicit CircularDataBuffer(int maxSize = 10000, QObject *parent = nullptr);
 
     void addDataPoint(const DataPoint &point);
-    QList<DataPoint> getData(int count = -1) const; // -1 = all data
+    QList<DataPoint> getData(int count = -1) const; // -1 = all data, oldest first
     QList<DataPoint> getDataRange(const QDateTime &start, const QDateTime &end) const;
 
     void clear();
@@ -104,6 +141,6 @@ signals:
 private:
     QList<DataPoint> m_buffer;
     int m_maxSize;
-    int m_currentIndex;
+    int m_currentIndex;         // Slot written next once the buffer is full
     mutable QMutex m_bufferMutex;
 };
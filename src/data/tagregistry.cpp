@@ -0,0 +1,96 @@
+#include "tagregistry.h"
+
+TagRegistry::TagRegistry()
+{
+    m_tags.append(TagInfo());
+}
+
+TagRegistry& TagRegistry::instance()
+{
+    static TagRegistry registry;
+    return registry;
+}
+
+quint32 TagRegistry::intern(const QString& name)
+{
+    if (name.isEmpty()) {
+        return 0;
+    }
+    
+    {
+        QReadLocker locker(&m_lock);
+        const quint32 id = m_ids.value(name, 0);
+        if (id != 0) {
+            return id;
+        }
+    }
+    
+    QWriteLocker locker(&m_lock);
+    return internLocked(name);
+}
+
+quint32 TagRegistry::define(const TagInfo& info)
+{
+    if (info.name.isEmpty()) {
+        return 0;
+    }
+    
+    QWriteLocker locker(&m_lock);
+    const quint32 id = internLocked(info.name);
+    m_tags[int(id)] = info;
+    m_tags[int(id)].id = id;
+    return id;
+}
+
+quint32 TagRegistry::internLocked(const QString& name)
+{
+    // May have been registered between releasing the read and taking the write lock
+    const quint32 existing = m_ids.value(name, 0);
+    if (existing != 0) {
+        return existing;
+    }
+    
+    TagInfo info;
+    info.id = quint32(m_tags.size());
+    info.name = name;
+    m_tags.append(info);
+    m_ids.insert(name, info.id);
+    return info.id;
+}
+
+quint32 TagRegistry::find(const QString& name) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(name, 0);
+}
+
+QString TagRegistry::name(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < quint32(m_tags.size()) ? m_tags.at(int(id)).name : QString();
+}
+
+TagInfo TagRegistry::info(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < quint32(m_tags.size()) ? m_tags.at(int(id)) : TagInfo();
+}
+
+QVector<TagInfo> TagRegistry::tagsOfController(const QString& controller) const
+{
+    QReadLocker locker(&m_lock);
+    
+    QVector<TagInfo> tags;
+    for (const TagInfo& tag : m_tags) {
+        if (tag.isValid() && tag.controller == controller) {
+            tags.append(tag);
+        }
+    }
+    return tags;
+}
+
+int TagRegistry::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_tags.size();
+}
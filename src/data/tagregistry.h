@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+#include "../models/taginfo.h"
+
+/**
+ * @brief Process-wide dictionary of tags: dense 32-bit IDs plus metadata
+ * 
+ * Every tag name is interned once, where it enters the system
+ * (configuration, a controller's response, a database row), and is passed
+ * around as its ID from then on: Sample::tagId, ModbusService's poll list
+ * and the view models all compare and index by ID. Names are looked up
+ * again only for display and storage.
+ * 
+ * IDs are assigned in order starting at 1 and never reused, so they can
+ * index plain arrays. ID 0 stands for "no tag". Tags are never removed;
+ * redefining a tag only replaces its metadata.
+ * 
+ * Pattern: Registry (singleton via instance(); separate instances for tests)
+ * Location: src/data/
+ * Threading: All methods are thread-safe.
+ * 
+ * Example:
+ * @code
+ * TagInfo eeg;
+ * eeg.name = "EEG";
+ * eeg.address = 25;
+ * eeg.unit = "µV";
+ * const quint32 id = TagRegistry::instance().define(eeg);
+ * ...
+ * if (sample.tagId == id) { ... }
+ * label->setText(TagRegistry::instance().name(sample.tagId));
+ * @endcode
+ */
+class TagRegistry {
+public:
+    TagRegistry();
+    
+    TagRegistry(const TagRegistry&) = delete;
+    TagRegistry& operator=(const TagRegistry&) = delete;
+    
+    /**
+     * @brief The registry shared by the whole application
+     */
+    static TagRegistry& instance();
+    
+    /**
+     * @brief Get the ID of a tag, registering it with default metadata if new
+     * @return The tag's ID, or 0 for an empty name
+     */
+    quint32 intern(const QString& name);
+    
+    /**
+     * @brief Register a tag or replace its metadata
+     * @param info Metadata; info.name identifies the tag, info.id is ignored
+     * @return The tag's ID, or 0 for an empty name
+     */
+    quint32 define(const TagInfo& info);
+    
+    /**
+     * @brief Get the ID of a tag without registering it
+     * @return The ID, or 0 for unknown names
+     */
+    quint32 find(const QString& name) const;
+    
+    /**
+     * @brief Get the name of a tag
+     * @return The name, or an empty string for unknown IDs
+     */
+    QString name(quint32 id) const;
+    
+    /**
+     * @brief Get the metadata of a tag
+     * @return The metadata, or an invalid TagInfo for unknown IDs
+     */
+    TagInfo info(quint32 id) const;
+    
+    /**
+     * @brief Get all tags read from a controller, in ID order
+     */
+    QVector<TagInfo> tagsOfController(const QString& controller) const;
+    
+    /**
+     * @brief Number of IDs handed out (including the reserved ID 0)
+     */
+    int size() const;
+
+private:
+    quint32 internLocked(const QString& name);
+    
+    mutable QReadWriteLock m_lock;
+    QHash<QString, quint32> m_ids;
+    QVector<TagInfo> m_tags;    // Indexed by ID; m_tags[0] is the invalid tag
+};
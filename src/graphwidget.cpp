@@ -1,12 +1,16 @@
 #include "graphwidget.h"
-#include <QGraphicsDropShadowEffect>
-#include <QDebug>
+#include <QPaintEvent>
 #include <cmath>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+namespace {
+// History envelope resolution; a bucket spans at most half a column
+const int ENVELOPE_BUCKETS_PER_COLUMN = 4;
+}
+
 GraphWidget::GraphWidget(const QString &title, GraphType graphType, QWidget *parent)
     : QWidget(parent), m_title(title), m_graphType(graphType)
 {
@@ -68,24 +72,73 @@ void GraphWidget::setupUI()
     m_layout->addWidget(m_titleLabel);
     m_layout->addStretch(); // Graph area takes remaining space
     
-    // Dark sci-fi background
-    setAutoFillBackground(true);
+    // Dark sci-fi background, painted by the background layer
     QPalette pal = palette();
     pal.setColor(QPalette::Window, QColor(8, 12, 20)); // Very dark navy
     setPalette(pal);
-    
-    // Add subtle glow effect to the entire widget
-    QGraphicsDropShadowEffect *glowEffect = new QGraphicsDropShadowEffect;
-    glowEffect->setColor(QColor(m_graphColor.red(), m_graphColor.green(), m_graphColor.blue(), 60));
-    glowEffect->setBlurRadius(15);
-    glowEffect->setOffset(0, 0);
-    setGraphicsEffect(glowEffect);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+QRect GraphWidget::graphRect() const
+{
+    // Leave space for the title and the axis labels
+    return rect().adjusted(10, 25, -10, -10);
+}
+
+int GraphWidget::capacity() const
+{
+    return width() > 0 && m_stepSize > 0 ? (width() - 20) / m_stepSize : m_maxDataPoints;
+}
+
+qreal GraphWidget::valueY(qreal value, const QRect &graphRect) const
+{
+    qreal valueRange = qMax(1.0, m_maxValue - m_minValue);
+    qreal normalizedValue = qBound(0.0, (value - m_minValue) / valueRange, 1.0);
+    return graphRect.bottom() - normalizedValue * graphRect.height();
+}
+
+QPointF GraphWidget::slotPoint(int slot, const QRect &graphRect) const
+{
+    return QPointF(graphRect.left() + slot * m_stepSize, valueY(m_dataPoints[slot], graphRect));
+}
+
+QRect GraphWidget::slotStrip(int firstSlot, int lastSlot) const
+{
+    // Slots plus the reach of antialiased pens and the marker
+    const QRect area = graphRect();
+    const int left = area.left() + qMax(firstSlot, 0) * m_stepSize - 2;
+    const int right = area.left() + lastSlot * m_stepSize + 2;
+    return QRect(QPoint(left, area.top() - 2), QPoint(right, area.bottom() + 2));
+}
+
+QRect GraphWidget::valueLabelRect() const
+{
+    const QRect area = graphRect();
+    return QRect(area.right() - 120, area.top() + 10, 110, 24);
 }
 
 void GraphWidget::addDataPoint(qreal value)
 {
-    qDebug() << "addDataPoint:" << value;
-    int bufferSize = width() > 0 && m_stepSize > 0 ? (width() - 20) / m_stepSize : m_maxDataPoints;
+    if (m_historyMode) {
+        // The whole trace rescales; the background stays
+        m_history.append(value);
+        if (m_envelopeColumns > 0) {
+            m_envelope.append(value);
+        }
+        if (m_layersValid) {
+            drawTraceLayer();
+            update(graphRect().adjusted(-2, -2, 2, 2).united(valueLabelRect()));
+        } else {
+            update();
+        }
+        return;
+    }
+    
+    const int bufferSize = capacity();
+    if (bufferSize <= 0) {
+        return;
+    }
+    const int previousHead = m_bufferHead;
     if (m_dataPoints.size() < bufferSize) {
         m_dataPoints.append(value);
         m_bufferHead = m_dataPoints.size() - 1;
@@ -93,32 +146,208 @@ void GraphWidget::addDataPoint(qreal value)
         m_bufferHead = (m_bufferHead + 1) % bufferSize;
         m_dataPoints[m_bufferHead] = value;
     }
-    update(); // Trigger repaint
+    
+    if (!m_layersValid) {
+        update(); // Layers are built on the next paint
+        return;
+    }
+    updateTrace(m_bufferHead);
+    
+    // Only the sweep strip, the previous marker and the value label change
+    QRegion dirty(slotStrip(m_bufferHead - 1, m_bufferHead + 1));
+    if (previousHead >= 0) {
+        dirty += slotStrip(previousHead, previousHead);
+    }
+    dirty += valueLabelRect();
+    update(dirty);
 }
 
 void GraphWidget::setColor(const QColor &color)
 {
     m_graphColor = color;
-    update();
+    invalidateLayers();
 }
 
 void GraphWidget::setRange(qreal min, qreal max)
 {
     m_minValue = min;
     m_maxValue = max;
+    invalidateLayers();
+}
+
+void GraphWidget::setStepSize(int step)
+{
+    m_stepSize = step;
+    fitBufferToWidth();
+    invalidateLayers();
+}
+
+void GraphWidget::setHistory(const QVector<double> &samples)
+{
+    m_history = samples;
+    m_historyMode = true;
+    m_envelopeColumns = 0;
+    invalidateLayers();
+}
+
+void GraphWidget::clearHistory()
+{
+    m_history.clear();
+    m_historyMode = false;
+    m_envelopeColumns = 0;
+    m_envelope.reset(0);
+    invalidateLayers();
+}
+
+void GraphWidget::setDecimation(TraceDecimator::Mode mode)
+{
+    m_decimation = mode;
+    if (m_historyMode) {
+        invalidateLayers();
+    }
+}
+
+void GraphWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    fitBufferToWidth();
+    invalidateLayers();
+}
+
+void GraphWidget::changeEvent(QEvent *event)
+{
+    QWidget::changeEvent(event);
+    if (event->type() == QEvent::PaletteChange || event->type() == QEvent::StyleChange) {
+        invalidateLayers(); // Theme change
+    }
+}
+
+void GraphWidget::fitBufferToWidth()
+{
+    const int bufferSize = capacity();
+    const int count = m_dataPoints.size();
+    const bool wrapped = count > 0 && m_bufferHead != count - 1;
+    if (bufferSize <= 0 || (count <= bufferSize && !wrapped)) {
+        return;
+    }
+    
+    // Keep the newest samples in time order and restart the sweep after them
+    QVector<qreal> samples;
+    samples.reserve(qMin(count, bufferSize));
+    for (int i = qMax(0, count - bufferSize); i < count; ++i) {
+        samples.append(m_dataPoints[(m_bufferHead + 1 + i) % count]);
+    }
+    m_dataPoints = samples;
+    m_bufferHead = m_dataPoints.size() - 1;
+}
+
+void GraphWidget::invalidateLayers()
+{
+    m_layersValid = false;
     update();
 }
 
+void GraphWidget::ensureLayers()
+{
+    const qreal ratio = devicePixelRatioF();
+    if (m_layersValid && m_backgroundLayer.devicePixelRatioF() == ratio) {
+        return;
+    }
+    
+    const QSize pixelSize = size() * ratio;
+    if (pixelSize.isEmpty()) {
+        return;
+    }
+    m_backgroundLayer = QPixmap(pixelSize);
+    m_backgroundLayer.setDevicePixelRatio(ratio);
+    QPainter background(&m_backgroundLayer);
+    background.setRenderHint(QPainter::Antialiasing);
+    drawBackground(background);
+    
+    m_traceLayer = QPixmap(pixelSize);
+    m_traceLayer.setDevicePixelRatio(ratio);
+    drawTraceLayer();
+    
+    m_layersValid = true;
+}
+
+void GraphWidget::drawTraceLayer()
+{
+    m_traceLayer.fill(Qt::transparent);
+    QPainter trace(&m_traceLayer);
+    trace.setRenderHint(QPainter::Antialiasing);
+    if (m_historyMode) {
+        drawHistory(trace);
+    } else {
+        drawTrace(trace, 0, m_dataPoints.size() - 1);
+    }
+}
+
+void GraphWidget::updateTrace(int slot)
+{
+    // The new sample replaces the segment ahead of it with the gap and
+    // connects to the one before; redraw what crosses that strip
+    QPainter painter(&m_traceLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+    const QRect strip = slotStrip(slot - 1, slot + 1);
+    painter.setClipRect(strip);
+    painter.setCompositionMode(QPainter::CompositionMode_Clear);
+    painter.fillRect(strip, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    drawTrace(painter, slot - 2, slot + 1);
+}
+
 void GraphWidget::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event)
+    ensureLayers();
     
     QPainter painter(this);
+    const QRect dirty = event->rect();
+    const qreal ratio = m_backgroundLayer.devicePixelRatioF();
+    const QRectF source(QPointF(dirty.topLeft()) * ratio, QSizeF(dirty.size()) * ratio);
+    painter.drawPixmap(dirty, m_backgroundLayer, source);
+    
+    QRect graphRect = this->graphRect();
+    const bool empty = m_historyMode ? m_history.isEmpty() : m_dataPoints.isEmpty();
+    if (graphRect.width() < 50 || graphRect.height() < 50 || empty) {
+        return;
+    }
+    painter.drawPixmap(dirty, m_traceLayer, source);
+    
+    // Draw vertical marker as a subtle dotted line (the history doesn't sweep)
     painter.setRenderHint(QPainter::Antialiasing);
+    if (!m_historyMode) {
+        int markerX = graphRect.left() + m_bufferHead * m_stepSize;
+        QPen scanPen(QColor(m_graphColor.red(), m_graphColor.green(), m_graphColor.blue(), 120), 1); // semi-transparent
+        scanPen.setStyle(Qt::DotLine);
+        painter.setPen(scanPen);
+        painter.drawLine(QPointF(markerX, graphRect.top()), QPointF(markerX, graphRect.bottom()));
+    }
+    
+    // Show current value label
+    if (dirty.intersects(valueLabelRect())) {
+        qreal lastValue = m_historyMode ? m_history.last() : m_dataPoints[m_bufferHead];
+        QString valueLabel = QString("Value: %1").arg(lastValue, 0, 'f', 1);
+        QFont valueFont = painter.font();
+        valueFont.setBold(true);
+        valueFont.setPointSize(12);
+        painter.setFont(valueFont);
+        painter.setPen(Qt::yellow);
+        painter.drawText(valueLabelRect(), Qt::AlignRight | Qt::AlignVCenter, valueLabel);
+    }
+}
+    
+void GraphWidget::drawBackground(QPainter &painter)
+{
+    painter.fillRect(rect(), palette().color(QPalette::Window));
     
-    // Calculate graph area (leave space for title)
-    QRect graphRect = rect().adjusted(10, 25, -10, -10);
+    // Subtle glow along the edges in the graph color
+    for (int i = 0; i < 6; ++i) {
+        painter.setPen(QPen(QColor(m_graphColor.red(), m_graphColor.green(), m_graphColor.blue(), 40 - i * 6), 1));
+        painter.drawRect(QRectF(rect()).adjusted(i + 0.5, i + 0.5, -i - 0.5, -i - 0.5));
+    }
     
+    QRect graphRect = this->graphRect();
     if (graphRect.width() < 50 || graphRect.height() < 50) {
         return; // Too small to draw
     }
@@ -132,34 +361,16 @@ void GraphWidget::paintEvent(QPaintEvent *event)
     painter.drawLine(graphRect.left(), graphRect.top(), graphRect.left(), graphRect.bottom());
     int numTicks = 5;
     QFont tickFont = painter.font();
-    tickFont.setPointSize(10);
+    tickFont.setPointSize(14);
     painter.setFont(tickFont);
     for (int i = 0; i <= numTicks; ++i) {
         qreal value = m_minValue + (m_maxValue - m_minValue) * (1.0 - i / (qreal)numTicks);
         int y = graphRect.top() + (graphRect.height() * i) / numTicks;
         painter.drawLine(graphRect.left() - 10, y, graphRect.left(), y);
         painter.setPen(Qt::white);
-        QFont tickFont = painter.font();
-        tickFont.setPointSize(14);
-        painter.setFont(tickFont);
         painter.drawText(5, y - 12, 50, 24, Qt::AlignLeft | Qt::AlignVCenter, QString::number((int)value));
         painter.setPen(axisPen);
     }
-
-    // Draw graph data
-    drawGraph(painter, graphRect);
-
-    // Show current value label
-    if (!m_dataPoints.isEmpty()) {
-        qreal lastValue = m_dataPoints.last();
-        QString valueLabel = QString("Value: %1").arg(lastValue, 0, 'f', 1);
-        QFont valueFont = painter.font();
-        valueFont.setBold(true);
-        valueFont.setPointSize(12);
-        painter.setFont(valueFont);
-        painter.setPen(Qt::yellow);
-        painter.drawText(graphRect.right() - 120, graphRect.top() + 10, 110, 24, Qt::AlignRight | Qt::AlignVCenter, valueLabel);
-    }
 }
 
 void GraphWidget::drawGrid(QPainter &painter, const QRect &graphRect)
@@ -221,79 +432,77 @@ void GraphWidget::drawGrid(QPainter &painter, const QRect &graphRect)
     painter.setPen(hexPen);
     
     int hexSize = 20;
+    QPolygonF hexagon;
+    for (int i = 0; i < 6; ++i) {
+        qreal angle = i * M_PI / 3.0;
+        hexagon << QPointF(hexSize/3 * cos(angle), hexSize/3 * sin(angle));
+    }
     for (int x = graphRect.left(); x < graphRect.right(); x += hexSize * 1.5) {
         for (int y = graphRect.top(); y < graphRect.bottom(); y += hexSize) {
             // Draw small hexagon
-            QPolygonF hexagon;
-            for (int i = 0; i < 6; ++i) {
-                qreal angle = i * M_PI / 3.0;
-                hexagon << QPointF(x + hexSize/3 * cos(angle), y + hexSize/3 * sin(angle));
-            }
-            painter.drawPolygon(hexagon);
+            painter.drawPolygon(hexagon.translated(x, y));
         }
     }
 }
 
 
-void GraphWidget::drawGraph(QPainter &painter, const QRect &graphRect)
+void GraphWidget::drawTrace(QPainter &painter, int firstSlot, int lastSlot)
 {
-    if (m_dataPoints.isEmpty())
+    // Segments starting at the given slots; none leaves the newest sample,
+    // which is where the sweep gap is
+    QRect graphRect = this->graphRect();
+    if (graphRect.width() < 50 || graphRect.height() < 50) {
         return;
-
-    int bufferSize = graphRect.width() / m_stepSize;
-    qreal valueRange = qMax(1.0, m_maxValue - m_minValue);
-
-    int N = m_dataPoints.size();
-    int startIdx = (N > bufferSize) ? (m_bufferHead + 1) % N : 0;
-
-    // Marker X position
-    int markerX = graphRect.left() + (m_bufferHead % bufferSize) * m_stepSize;
-
-    // Clear a narrow strip ahead of the marker
-    int eraseWidth = m_stepSize + 2;
-    int eraseX = markerX + 1;
-    if (eraseX + eraseWidth > graphRect.right())
-        eraseX -= graphRect.width(); // wrap
-    painter.save();
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.fillRect(QRect(eraseX, graphRect.top(), eraseWidth, graphRect.height()), palette().color(QPalette::Window));
-    painter.restore();
-
-    // Draw all segments except those crossing the cleared strip
-    QPen corePen(m_graphColor.lighter(120), 1);
-    painter.setPen(corePen);
-
-    QPointF prevPoint;
-    bool hasPrev = false;
-
-    for (int i = 0; i < qMin(bufferSize, N); ++i)
-    {
-        int bufIdx = (startIdx + i) % N;
-        qreal normalizedValue = (m_dataPoints[bufIdx] - m_minValue) / valueRange;
-        normalizedValue = qBound(0.0, normalizedValue, 1.0);
-        qreal y = graphRect.bottom() - normalizedValue * graphRect.height();
-        int x = graphRect.left() + i * m_stepSize;
-
-        QPointF currentPoint(x, y);
-
-        if (hasPrev)
-        {
-            // Skip line if it crosses cleared area
-            if (!((prevPoint.x() < eraseX + eraseWidth && prevPoint.x() > eraseX) ||
-                  (currentPoint.x() < eraseX + eraseWidth && currentPoint.x() > eraseX)))
-            {
-                painter.drawLine(prevPoint, currentPoint);
-            }
+    }
+    painter.setPen(QPen(m_graphColor.lighter(120), 1));
+    const int lastSegment = qMin(lastSlot, m_dataPoints.size() - 2);
+    for (int slot = qMax(firstSlot, 0); slot <= lastSegment; ++slot) {
+        if (slot != m_bufferHead) {
+            painter.drawLine(slotPoint(slot, graphRect), slotPoint(slot + 1, graphRect));
         }
-
-        prevPoint = currentPoint;
-        hasPrev = true;
     }
+}
 
-  // Draw vertical marker as a subtle dotted line
-QPen scanPen(m_graphColor.lighter(150), 1); // lighter color, thinner
-scanPen.setStyle(Qt::DotLine);              // dotted line
-scanPen.setColor(QColor(m_graphColor.red(), m_graphColor.green(), m_graphColor.blue(), 120)); // semi-transparent
-painter.setPen(scanPen);
-painter.drawLine(QPointF(markerX, graphRect.top()), QPointF(markerX, graphRect.bottom()));
+void GraphWidget::drawHistory(QPainter &painter)
+{
+    QRect graphRect = this->graphRect();
+    const int count = m_history.size();
+    if (graphRect.width() < 50 || graphRect.height() < 50 || count < 2) {
+        return;
+    }
+    
+    // At most about two vertices per device pixel column, whatever the
+    // count. The envelope is regrouped only when the width changes and
+    // takes new samples as they arrive.
+    const int columns = int(std::ceil(graphRect.width() * m_traceLayer.devicePixelRatioF()));
+    if (columns != m_envelopeColumns) {
+        m_envelope.reset(ENVELOPE_BUCKETS_PER_COLUMN * columns);
+        m_envelope.append(m_history.constData(), count);
+        m_envelopeColumns = columns;
+    }
+    const QVector<QPointF> points = TraceDecimator::decimate(m_envelope.values(), m_envelope.size(),
+                                                             columns, m_decimation);
+    const qreal xScale = qreal(graphRect.width()) / (count - 1);
+    
+    // One polyline per run of valid samples; NaN breaks the line
+    painter.setPen(QPen(m_graphColor.lighter(120), 1));
+    QPolygonF run;
+    run.reserve(points.size());
+    auto flushRun = [&painter, &run]() {
+        if (run.size() > 1) {
+            painter.drawPolyline(run);
+        } else if (run.size() == 1) {
+            painter.drawPoint(run.first());
+        }
+        run.clear();
+    };
+    for (const QPointF &point : points) {
+        if (std::isnan(point.y())) {
+            flushRun();
+            continue;
+        }
+        run.append(QPointF(graphRect.left() + m_envelope.sampleIndex(int(point.x())) * xScale,
+                           valueY(point.y(), graphRect)));
+    }
+    flushRun();
 }
@@ -3,12 +3,32 @@
 #include <QWidget>
 #include <QTimer>
 #include <QPainter>
+#include <QPixmap>
 #include <QVector>
 #include <QRandomGenerator>
 #include <QLabel>
 #include <QVBoxLayout>
 #include <cmath>
+#include "utils/tracedecimator.h"
 
+/**
+ * @brief Sweeping trend display
+ *
+ * Samples are written left to right into one slot per step and the sweep
+ * wraps at the right edge, overwriting the oldest samples behind a gap
+ * at the marker. Grid, hexagon overlay, brackets, axis and glow are
+ * rendered once into a background pixmap, and the trace into a second
+ * pixmap that each new sample only touches around its slot. Both are
+ * rebuilt on resize, range, color or palette changes. A new sample
+ * repaints just the strip around the marker and the value label.
+ *
+ * Given a history with setHistory(), the widget shows all of it instead,
+ * scaled to the graph width. The samples are summarised in a
+ * TraceEnvelope of a few buckets per pixel column, which each new sample
+ * updates in place, and that is decimated to the columns and drawn as
+ * polylines. Neither a repaint nor a new sample costs more for a longer
+ * history.
+ */
 class GraphWidget : public QWidget
 {
     Q_OBJECT
@@ -27,17 +47,41 @@ public:
     void addDataPoint(qreal value);
     void setColor(const QColor &color);
     void setRange(qreal min, qreal max);
+    void setStepSize(int step);
+
+    // History mode
+    void setHistory(const QVector<double> &samples);
+    void clearHistory();
+    void setDecimation(TraceDecimator::Mode mode);
+    bool hasHistory() const { return m_historyMode; }
+
+protected:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
 
 private:
     QString m_title;
     void setupUI();
+    QRect graphRect() const;
+    int capacity() const;
+    qreal valueY(qreal value, const QRect &graphRect) const;
+    QPointF slotPoint(int slot, const QRect &graphRect) const;
+    QRect slotStrip(int firstSlot, int lastSlot) const;
+    QRect valueLabelRect() const;
+    void fitBufferToWidth();
+    void invalidateLayers();
+    void ensureLayers();
+    void drawBackground(QPainter &painter);
     void drawGrid(QPainter &painter, const QRect &graphRect);
-    void drawGraph(QPainter &painter, const QRect &graphRect);
+    void drawTraceLayer();
+    void drawTrace(QPainter &painter, int firstSlot, int lastSlot);
+    void drawHistory(QPainter &painter);
+    void updateTrace(int slot);
     qreal generateNextValue();
-    QVector<qreal> m_dataPoints;
+    QVector<qreal> m_dataPoints;    // One sample per slot
     int m_maxDataPoints;
-    int m_bufferHead = -1;
+    int m_bufferHead = -1;          // Slot of the newest sample
     QColor m_graphColor;
     QColor m_gridColor;
     QVBoxLayout *m_layout;
@@ -46,8 +90,16 @@ private:
     qreal m_maxValue = 100;
     GraphType m_graphType;
     int m_stepSize = 24; // Increased step size (pixels)
-public:
-    void setStepSize(int step) { m_stepSize = step; update(); }
-    // ...existing code...
     
+    // History mode: every sample, and their envelope for the current width
+    QVector<double> m_history;
+    bool m_historyMode = false;
+    TraceEnvelope m_envelope;
+    int m_envelopeColumns = 0;      // 0 while the envelope needs rebuilding
+    TraceDecimator::Mode m_decimation = TraceDecimator::MinMax;
+    
+    // Pre-rendered layers at the device pixel ratio
+    QPixmap m_backgroundLayer;
+    QPixmap m_traceLayer;
+    bool m_layersValid = false;
 };
@@ -0,0 +1,256 @@
+#include "controllerpagemodel.h"
+#include <algorithm>
+
+ControllerPageModel::ControllerPageModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int ControllerPageModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+QVariant ControllerPageModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+    
+    const Row &row = m_rows.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return row.text;
+    case Qt::EditRole:
+    case ValueRole:
+        return row.value;
+    case RowKindRole:
+        return row.kind;
+    case FieldIdRole:
+        return row.fieldId;
+    case FieldTypeRole:
+        return row.fieldType;
+    case ValueTextRole:
+        return row.valueText;
+    case UnitRole:
+        return row.unit;
+    case OptionsRole:
+        return row.options;
+    case OptionValuesRole:
+        return row.optionValues;
+    case EditableRole:
+        return row.editable;
+    case GroupGapRole:
+        return row.groupGap;
+    default:
+        return QVariant();
+    }
+}
+
+bool ControllerPageModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row() >= m_rows.size()
+        || (role != Qt::EditRole && role != ValueRole)) {
+        return false;
+    }
+    
+    Row &row = m_rows[index.row()];
+    if (row.kind != FieldRow) {
+        return false;
+    }
+    setRowValue(row, value);
+    emit dataChanged(index, index, {Qt::EditRole, ValueRole, ValueTextRole});
+    return true;
+}
+
+Qt::ItemFlags ControllerPageModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return Qt::NoItemFlags;
+    }
+    
+    const Row &row = m_rows.at(index.row());
+    if (row.kind != FieldRow) {
+        return Qt::ItemIsEnabled;
+    }
+    Qt::ItemFlags itemFlags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    if (row.editable || row.fieldType == "drp") {
+        itemFlags |= Qt::ItemIsEditable;
+    }
+    return itemFlags;
+}
+
+QHash<int, QByteArray> ControllerPageModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles[RowKindRole] = "rowKind";
+    roles[FieldIdRole] = "fieldId";
+    roles[FieldTypeRole] = "fieldType";
+    roles[ValueRole] = "value";
+    roles[ValueTextRole] = "valueText";
+    roles[UnitRole] = "unit";
+    roles[OptionsRole] = "options";
+    roles[OptionValuesRole] = "optionValues";
+    roles[EditableRole] = "editable";
+    roles[GroupGapRole] = "groupGap";
+    return roles;
+}
+
+void ControllerPageModel::setPage(const ControllerXmlService::XmlPage &page)
+{
+    beginResetModel();
+    m_rows.clear();
+    m_rowByField.clear();
+    m_rows.reserve(page.fieldCount + page.forms.size());
+    
+    for (const auto &form : page.forms) {
+        if (form.type == "cnt" && !form.columns.isEmpty()) {
+            appendForm(form);
+        } else if (form.type == "sub" && !form.title.isEmpty()) {
+            Row header;
+            header.kind = SubHeaderRow;
+            header.text = form.title.toUpper();
+            m_rows.append(header);
+        }
+    }
+    endResetModel();
+}
+
+void ControllerPageModel::clear()
+{
+    beginResetModel();
+    m_rows.clear();
+    m_rowByField.clear();
+    endResetModel();
+}
+
+void ControllerPageModel::appendForm(const ControllerXmlService::XmlForm &form)
+{
+    // All fields of the form in one list, with a header whenever the
+    // column title changes
+    QString currentGroup;
+    for (const auto &column : form.columns) {
+        const QString groupName = column.title.isEmpty() ? "General" : column.title;
+        
+        for (const auto &field : column.fields) {
+            if (field.hidden || field.id.isEmpty()) {
+                continue;
+            }
+            
+            if (groupName != currentGroup) {
+                Row header;
+                header.kind = GroupHeaderRow;
+                header.text = groupName.toUpper();
+                header.groupGap = !currentGroup.isEmpty();
+                m_rows.append(header);
+                currentGroup = groupName;
+            }
+            
+            Row row;
+            row.text = field.label;
+            row.fieldId = field.id;
+            row.fieldType = field.type;
+            row.unit = field.unit;
+            row.editable = field.type != "drp" && field.type != "btn" && isInputField(field);
+            if (field.type == "drp") {
+                if (!field.optds.isEmpty()) {
+                    row.options = field.optds.split(',');
+                }
+                if (!field.optdv.isEmpty()) {
+                    row.optionValues = field.optdv.split(',');
+                }
+            }
+            setRowValue(row, field.value);
+            
+            m_rowByField.insert(field.id, m_rows.size());
+            m_rows.append(row);
+        }
+    }
+}
+
+void ControllerPageModel::updateValues(const QVector<ControllerXmlService::XmlValueChange> &changes)
+{
+    QVector<int> changedRows;
+    changedRows.reserve(changes.size());
+    for (const auto &change : changes) {
+        const int rowIndex = m_rowByField.value(change.id, -1);
+        if (rowIndex < 0) {
+            continue;
+        }
+        Row &row = m_rows[rowIndex];
+        const QString previousText = row.valueText;
+        setRowValue(row, change.value);
+        if (row.valueText != previousText) {
+            changedRows.append(rowIndex);
+        }
+    }
+    if (changedRows.isEmpty()) {
+        return;
+    }
+    
+    // One notification per run of adjacent rows; views repaint only the
+    // rows of a single-row run and never touch rows outside the viewport
+    std::sort(changedRows.begin(), changedRows.end());
+    const QVector<int> roles = {Qt::EditRole, ValueRole, ValueTextRole};
+    int first = changedRows.first();
+    int last = first;
+    for (int i = 1; i <= changedRows.size(); ++i) {
+        if (i < changedRows.size() && changedRows.at(i) <= last + 1) {
+            last = changedRows.at(i);
+            continue;
+        }
+        emit dataChanged(index(first), index(last), roles);
+        if (i < changedRows.size()) {
+            first = last = changedRows.at(i);
+        }
+    }
+}
+
+int ControllerPageModel::optionIndex(const QStringList &optionValues, int optionCount, const QVariant &value)
+{
+    int optionIndex = optionValues.indexOf(value.toString());
+    if (optionValues.isEmpty()) {
+        bool ok = false;
+        optionIndex = value.toInt(&ok);
+        if (!ok) {
+            optionIndex = -1;
+        }
+    }
+    return optionIndex >= 0 && optionIndex < optionCount ? optionIndex : -1;
+}
+
+void ControllerPageModel::setRowValue(Row &row, const QVariant &value)
+{
+    row.value = value;
+    if (row.fieldType == "btn") {
+        return; // Buttons carry no value
+    }
+    if (row.fieldType == "drp") {
+        // Like a combo box: the first option until a value selects another,
+        // and values that select nothing keep the current one
+        const int option = optionIndex(row.optionValues, row.options.size(), value);
+        if (option >= 0) {
+            row.valueText = row.options.at(option);
+        } else if (row.valueText.isEmpty()) {
+            row.valueText = row.options.value(0);
+        }
+        return;
+    }
+    if (!value.isValid()) {
+        row.valueText = row.editable ? "0" : "--"; // Input default / display placeholder
+    } else {
+        row.valueText = value.type() == QVariant::Double
+            ? QString::number(value.toDouble())
+            : value.toString();
+    }
+}
+
+bool ControllerPageModel::isInputField(const ControllerXmlService::XmlField &field)
+{
+    // Fields with a variable name take input, as do labels that read like one
+    return !field.var.isEmpty() ||
+           field.label.contains("Set", Qt::CaseInsensitive) ||
+           field.label.contains("Input", Qt::CaseInsensitive) ||
+           field.label.contains("Target", Qt::CaseInsensitive) ||
+           field.label.contains("Command", Qt::CaseInsensitive);
+}
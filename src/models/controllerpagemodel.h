@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include "../services/controllerxmlservice.h"
+
+/**
+ * @brief List model over a parsed controller XML page
+ * 
+ * Flattens the forms of an XmlPage into rows the way IndustrialDataPage
+ * lays them out: a header row per "sub" form, a group header row per
+ * column title of a "cnt" form, and a row per visible field. Rows are
+ * plain data; ControllerFieldDelegate paints them and creates editors only
+ * for the row being edited, so a page costs nothing per field beyond its
+ * row here.
+ * 
+ * Live refreshes go through updateValues(), which changes the value of
+ * the affected rows only and reports them with dataChanged() so views
+ * repaint just those rows.
+ * 
+ * Pattern: Model (Qt model/view)
+ * Location: src/models/
+ */
+class ControllerPageModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum RowKind
+    {
+        SubHeaderRow,       // Title of a "sub" form
+        GroupHeaderRow,     // Column title inside a "cnt" form
+        FieldRow            // One visible field
+    };
+    Q_ENUM(RowKind)
+    
+    enum Roles
+    {
+        RowKindRole = Qt::UserRole + 1,
+        FieldIdRole,
+        FieldTypeRole,      // "drp", "btn" or a value type
+        ValueRole,          // Field value as received (EditRole too)
+        ValueTextRole,      // Value as shown, option text for dropdowns
+        UnitRole,
+        OptionsRole,        // Dropdown option texts (optds)
+        OptionValuesRole,   // Dropdown option values (optdv), may be empty
+        EditableRole,       // Operator input field
+        GroupGapRole        // Group header that follows another group of the form
+    };
+    
+    explicit ControllerPageModel(QObject *parent = nullptr);
+    
+    // QAbstractListModel interface
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+    
+    /**
+     * @brief Replace all rows with the layout and values of a page
+     */
+    void setPage(const ControllerXmlService::XmlPage &page);
+    
+    /**
+     * @brief Remove all rows
+     */
+    void clear();
+    
+    /**
+     * @brief Apply refreshed field values; unknown and hidden fields are ignored
+     */
+    void updateValues(const QVector<ControllerXmlService::XmlValueChange> &changes);
+    
+    /**
+     * @brief Row of a field, -1 if the field is hidden or unknown
+     */
+    int rowForField(const QString &fieldId) const { return m_rowByField.value(fieldId, -1); }
+    
+    /**
+     * @brief Index of a dropdown option selected by a value, -1 if none
+     * 
+     * The value selects an option by its optdv entry, or by index when
+     * the field has no option values.
+     */
+    static int optionIndex(const QStringList &optionValues, int optionCount, const QVariant &value);
+
+private:
+    struct Row
+    {
+        RowKind kind = FieldRow;
+        QString text;               // Header title or field label
+        QString fieldId;
+        QString fieldType;
+        QString unit;
+        QVariant value;
+        QString valueText;
+        QStringList options;
+        QStringList optionValues;
+        bool editable = false;
+        bool groupGap = false;
+    };
+    
+    void appendForm(const ControllerXmlService::XmlForm &form);
+    void setRowValue(Row &row, const QVariant &value);
+    static bool isInputField(const ControllerXmlService::XmlField &field);
+    
+    QVector<Row> m_rows;
+    QHash<QString, int> m_rowByField;   // Field ID -> row
+};
@@ -9,6 +9,7 @@
  * 
  * Pure C++ data structure with no Qt dependencies (except Qt types for convenience).
  * Represents a single measurement or reading from an industrial controller.
+ * Sample (sample.h) is the compact, allocation-free form used on hot paths.
  * 
  * Pattern: Domain Model (RULE-102 - pure C++)
  * Location: src/models/ (RULE-300)
@@ -26,12 +27,12 @@ public:
     };
     
     /**
-     * @brief Default constructor
+     * @brief Default constructor (null timestamp; placeholders are not stamped)
      */
     DataPoint() 
-        : m_tag("")
+        : m_tag()
         , m_value(0.0)
-        , m_timestamp(QDateTime::currentDateTime())
+        , m_timestamp()
         , m_quality(Quality::Good)
     {}
     
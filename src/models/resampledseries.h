@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief How raw samples are turned into one value per resampling slot
+ * 
+ * Slot k covers [startMs + k * stepMs, startMs + (k + 1) * stepMs).
+ */
+enum class ResampleMode {
+    Previous,               // Last sample at or before the slot start (sample-and-hold)
+    Linear,                 // Linear interpolation at the slot start
+    TimeWeightedAverage,    // Average of the held signal over the slot, weighted by time
+    MinMax                  // Smallest and largest raw sample inside the slot
+};
+
+/**
+ * @brief Several tags resampled onto one shared time grid
+ * 
+ * Columnar layout: one timestamp array for all tags and one value array
+ * per tag, index-aligned with the timestamps. Slots without data hold NaN
+ * (check with std::isnan()).
+ * 
+ * Pattern: Domain Model (RULE-102 - pure C++)
+ * Location: src/models/ (RULE-300)
+ */
+struct ResampledSeries {
+    ResampleMode mode = ResampleMode::Previous;
+    qint64 startMs = 0;                 // Start of the first slot (milliseconds since epoch)
+    qint64 stepMs = 0;                  // Slot width in milliseconds
+    QVector<qint64> timestamps;         // Slot start times, shared by all tags
+    QStringList tags;                   // Tag of each value column
+    QVector<QVector<double>> values;    // [tag][slot]; the minimum in MinMax mode
+    QVector<QVector<double>> maxValues; // [tag][slot]; MinMax mode only, empty otherwise
+    
+    /**
+     * @brief Number of slots
+     */
+    int slotCount() const {
+        return timestamps.size();
+    }
+    
+    /**
+     * @brief Column index of a tag, or -1 if it was not requested
+     */
+    int indexOf(const QString& tag) const {
+        return tags.indexOf(tag);
+    }
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "datapoint.h"
+#include "../data/tagregistry.h"
+#include "../utils/stringinterner.h"
+#include <QMetaType>
+#include <chrono>
+#include <type_traits>
+
+/**
+ * @brief Compact, trivially copyable form of a DataPoint
+ * 
+ * A DataPoint owns a QString, a QVariant and a QDateTime, so creating,
+ * copying or queueing one allocates several times and it takes about
+ * 100 bytes. A Sample is 24 bytes with no heap memory: the tag is an ID
+ * from TagRegistry, the value a tagged union, the timestamp
+ * nanoseconds since epoch and the quality one byte. Containers of
+ * samples are flat arrays that can be memcpy'd, and a Sample passes
+ * through a queued signal without allocating.
+ * 
+ * Acquisition, buffering and display paths carry Samples; DataPoint stays
+ * the type of the repository interface. Convert at the boundary with
+ * fromDataPoint() / toDataPoint().
+ * 
+ * Text values are interned in StringInterner::texts(), which suits the
+ * handful of states a text tag takes. That interner is bounded: once it
+ * holds StringInterner::TEXT_CAPACITY strings, new texts read back as
+ * empty. Free-form text belongs in a DataPoint.
+ * 
+ * Pattern: Domain Model (RULE-102 - pure C++)
+ * Location: src/models/ (RULE-300)
+ */
+struct Sample {
+    /**
+     * @brief Which member of the value union is set
+     */
+    enum class Type : quint8 {
+        Double,
+        Int,
+        Bool,
+        Text            // textId into StringInterner::texts()
+    };
+    
+    static constexpr qint64 NSECS_PER_MSEC = 1000000;
+    
+    qint64 timestampNs = 0;     // Nanoseconds since epoch (UTC)
+    union {
+        double real = 0.0;
+        qint64 integer;
+        bool boolean;
+        quint32 textId;
+    };
+    quint32 tagId = 0;          // ID in TagRegistry::instance()
+    Type type = Type::Double;
+    quint8 quality = 0;         // DataPoint::Quality
+    
+    Sample() = default;
+    
+    static Sample ofDouble(quint32 tagId, qint64 timestampNs, double value,
+                           DataPoint::Quality quality = DataPoint::Quality::Good)
+    {
+        Sample sample(tagId, timestampNs, quality);
+        sample.real = value;
+        return sample;
+    }
+    
+    static Sample ofInt(quint32 tagId, qint64 timestampNs, qint64 value,
+                        DataPoint::Quality quality = DataPoint::Quality::Good)
+    {
+        Sample sample(tagId, timestampNs, quality);
+        sample.type = Type::Int;
+        sample.integer = value;
+        return sample;
+    }
+    
+    static Sample ofText(quint32 tagId, qint64 timestampNs, const QString& value,
+                         DataPoint::Quality quality = DataPoint::Quality::Good)
+    {
+        Sample sample(tagId, timestampNs, quality);
+        sample.type = Type::Text;
+        sample.textId = StringInterner::texts().intern(value);
+        return sample;
+    }
+    
+    /**
+     * @brief Current time in nanoseconds since epoch
+     */
+    static qint64 nowNs()
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+    }
+    
+    /**
+     * @brief Convert a DataPoint, interning its tag (and text value, see setValue())
+     */
+    static Sample fromDataPoint(const DataPoint& point, bool internText = true)
+    {
+        Sample sample(TagRegistry::instance().intern(point.tag()),
+                      point.timestamp().toMSecsSinceEpoch() * NSECS_PER_MSEC,
+                      point.quality());
+        sample.setValue(point.value(), internText);
+        return sample;
+    }
+    
+    /**
+     * @brief Convert back to a DataPoint (timestamp truncated to milliseconds)
+     */
+    DataPoint toDataPoint() const
+    {
+        return DataPoint(tag(), toVariant(), QDateTime::fromMSecsSinceEpoch(timestampMs()),
+                         static_cast<DataPoint::Quality>(quality));
+    }
+    
+    /**
+     * @brief Store a QVariant, choosing the union member from its type
+     * @param value Value to store
+     * @param internText False to only look up a text value, leaving text
+     *        that was never interned as textId 0 (for callers that keep
+     *        the original value themselves)
+     */
+    void setValue(const QVariant& value, bool internText = true)
+    {
+        switch (value.userType()) {
+            case QMetaType::Bool:
+                type = Type::Bool;
+                boolean = value.toBool();
+                break;
+            case QMetaType::Int:
+            case QMetaType::UInt:
+            case QMetaType::Long:
+            case QMetaType::ULong:
+            case QMetaType::LongLong:
+            case QMetaType::ULongLong:
+            case QMetaType::Short:
+            case QMetaType::UShort:
+            case QMetaType::Char:
+            case QMetaType::SChar:
+            case QMetaType::UChar:
+                type = Type::Int;
+                integer = value.toLongLong();
+                break;
+            case QMetaType::Double:
+            case QMetaType::Float:
+                type = Type::Double;
+                real = value.toDouble();
+                break;
+            default: {
+                // Strings, and anything else in its string form
+                const QString text = value.toString();
+                type = Type::Text;
+                textId = internText ? StringInterner::texts().intern(text) : StringInterner::texts().find(text);
+                break;
+            }
+        }
+    }
+    
+    QVariant toVariant() const
+    {
+        switch (type) {
+            case Type::Int: return QVariant(integer);
+            case Type::Bool: return QVariant(boolean);
+            case Type::Text: return QVariant(StringInterner::texts().value(textId));
+            case Type::Double: break;
+        }
+        return QVariant(real);
+    }
+    
+    /**
+     * @brief Numeric value (text values convert like QString::toDouble())
+     */
+    double toDouble() const
+    {
+        switch (type) {
+            case Type::Int: return double(integer);
+            case Type::Bool: return boolean ? 1.0 : 0.0;
+            case Type::Text: return StringInterner::texts().value(textId).toDouble();
+            case Type::Double: break;
+        }
+        return real;
+    }
+    
+    QString tag() const { return TagRegistry::instance().name(tagId); }
+    
+    DataPoint::Quality dataQuality() const { return static_cast<DataPoint::Quality>(quality); }
+    
+    /**
+     * @brief Timestamp in milliseconds since epoch (rounded down)
+     */
+    qint64 timestampMs() const
+    {
+        const qint64 ms = timestampNs / NSECS_PER_MSEC;
+        return (timestampNs % NSECS_PER_MSEC < 0) ? ms - 1 : ms;
+    }
+    
+private:
+    Sample(quint32 tag, qint64 ns, DataPoint::Quality pointQuality)
+        : timestampNs(ns), tagId(tag), quality(quint8(pointQuality))
+    {
+    }
+};
+
+static_assert(std::is_trivially_copyable<Sample>::value, "Sample must stay memcpy-able");
+static_assert(sizeof(Sample) == 24, "Sample layout changed");
+
+Q_DECLARE_TYPEINFO(Sample, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(Sample)
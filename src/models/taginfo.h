@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Configuration of one tag, as held by TagRegistry
+ * 
+ * Pattern: Domain Model (RULE-102 - pure C++)
+ * Location: src/models/ (RULE-300)
+ */
+struct TagInfo {
+    /**
+     * @brief Value type the tag is acquired as
+     */
+    enum class ValueType : quint8 {
+        Double,
+        Int,
+        Bool,
+        Text
+    };
+    
+    quint32 id = 0;                         // Dense registry ID (0 = unknown tag)
+    QString name;                           // Tag name, e.g. "EEG"
+    QString controller;                     // Controller the tag is read from (address or name)
+    int address = -1;                       // Register/field address on the controller (-1 = none)
+    ValueType type = ValueType::Double;
+    QString unit;                           // Engineering unit, e.g. "m3/h"
+    int scanClass = 0;                      // Polling group (0 = default rate)
+    double deadband = 0.0;                  // Minimum change to publish (0 = every value)
+    
+    bool isValid() const { return id != 0; }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * @brief Aggregated statistics for one time bucket of a tag's history
+ * 
+ * Returned by trend queries that read pre-computed rollup tiers instead of
+ * raw samples. A bucket with widthMs == 0 represents a single raw sample
+ * (count == 1, min == max == first == last).
+ * 
+ * Pattern: Domain Model (RULE-102 - pure C++)
+ * Location: src/models/ (RULE-300)
+ */
+struct TrendBucket {
+    qint64 startMs = 0;     // Bucket start (milliseconds since epoch)
+    qint64 widthMs = 0;     // Bucket width in milliseconds (0 = raw sample)
+    int count = 0;          // Number of samples aggregated
+    double min = 0.0;       // Smallest value in the bucket
+    double max = 0.0;       // Largest value in the bucket
+    double sum = 0.0;       // Sum of all values (for averaging)
+    qint64 firstMs = 0;     // Timestamp of the first sample
+    double first = 0.0;     // Value of the first sample
+    qint64 lastMs = 0;      // Timestamp of the last sample
+    double last = 0.0;      // Value of the last sample
+    
+    /**
+     * @brief Arithmetic mean of the bucket's samples
+     */
+    double average() const {
+        return count > 0 ? sum / count : 0.0;
+    }
+};
@@ -2,16 +2,11 @@
 
 #include <QWidget>
 #include <QVBoxLayout>
-#include <QHBoxLayout>
-#include <QGridLayout>
 #include <QLabel>
-#include <QFrame>
-#include <QScrollArea>
-#include <QGroupBox>
-#include <QLineEdit>
-#include <QComboBox>
-#include <QPushButton>
+#include <QListView>
 #include "../services/controllerxmlservice.h"
+#include "../models/controllerpagemodel.h"
+#include "../ui/controllerfielddelegate.h"
 #include "../ui/virtualkeyboard.h"
 
 /**
@@ -19,6 +14,10 @@
  * 
  * Creates a Qt widget interface equivalent to the original web interface
  * by transforming XML data using the same logic as the XSLT file.
+ * 
+ * Fields are shown through ControllerPageModel in a QListView painted by
+ * ControllerFieldDelegate, so building a page with hundreds of fields
+ * creates no widgets per field and only visible rows are painted.
  */
 class IndustrialDataPage : public QWidget
 {
@@ -34,30 +33,22 @@ public:
 private slots:
     void onXmlDataReceived(const ControllerXmlService::XmlPage &page);
     void onXmlDataUpdated(const ControllerXmlService::XmlPage &page);
+    void onXmlValuesChanged(const QVector<ControllerXmlService::XmlValueChange> &changes);
     void onNetworkError(const QString &error);
     void onParsingError(const QString &error);
 
 private:
     void setupUI();
-    void clearLayout();
     void createPageLayout(const ControllerXmlService::XmlPage &page);
-    void createFormWidget(const ControllerXmlService::XmlForm &form);
-    QWidget* createColumnWidget(const ControllerXmlService::XmlColumn &column);
-    QWidget* createFieldWidget(const ControllerXmlService::XmlField &field);
-    QWidget* createListFieldWidget(const ControllerXmlService::XmlField &field);
-    
-    void applyCleanStyling(QWidget *widget, const QString &widgetType);
-    void updateFieldValues(const ControllerXmlService::XmlPage &page);
 
     QVBoxLayout *m_mainLayout;
-    QScrollArea *m_scrollArea;
-    QWidget *m_contentWidget;
-    QVBoxLayout *m_contentLayout;
+    QListView *m_fieldView;
+    ControllerPageModel *m_pageModel;
+    ControllerFieldDelegate *m_fieldDelegate;
     QLabel *m_titleLabel;
     QLabel *m_statusLabel;
 
     ControllerXmlService *m_xmlService;
-    QMap<QString, QWidget*> m_fieldWidgets; // Maps field ID to widget for updates
     VirtualKeyboard *m_virtualKeyboard;     // Touch screen virtual keyboard
     
     bool m_isInitialized;
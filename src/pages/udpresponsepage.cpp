@@ -2,6 +2,7 @@
 #include "udpresponsepage.h"
 #include "../ui/modernmainwindow.h"
 #include "../navigation/navigationmanager.h"
+#include "../ui/themestyle.h"
 #include <QVBoxLayout>
 #include <QTextEdit>
 #include <QPushButton>
@@ -9,6 +10,7 @@
 #include <QIcon>
 #include <QDateTime>
 #include <QTextCursor>
+#include <QTextDocument>
 
 UdpResponsePage::UdpResponsePage(QWidget *parent)
     : QWidget(parent), m_layout(new QVBoxLayout), m_textEdit(new QTextEdit(this))
@@ -26,34 +28,19 @@ UdpResponsePage::UdpResponsePage(QWidget *parent)
         QPushButton *homeBtn = new QPushButton("🏠 Back to Overview");
         homeBtn->setMinimumSize(160, 44); // Touch-friendly size
         homeBtn->setMaximumSize(160, 44);
-        homeBtn->setStyleSheet(
-            "QPushButton {"
-            "  background: #007AFF;"
-            "  color: white;"
-            "  border: none;"
-            "  border-radius: 8px;"
-            "  padding: 8px 16px;"
-            "  font-weight: bold;"
-            "  font-size: 14px;"
-            "}"
-            "QPushButton:hover {"
-            "  background: #0051D0;"
-            "}"
-            "QPushButton:pressed {"
-            "  background: #003d99;"
-            "}"
-        );
+        ThemeStyle::setVariant(homeBtn, ThemeStyle::PrimaryButton);
         homeBtn->setToolTip("Navigate back to the main overview page");
         topLayout->addWidget(homeBtn, 0, Qt::AlignLeft);
         
         QLabel *titleLabel = new QLabel("🌐 Network Discovery Monitor");
-        titleLabel->setStyleSheet("font-size: 22px; font-weight: bold; color: #007AFF; background: transparent;");
+        ThemeStyle::setVariant(titleLabel, ThemeStyle::Title);
         topLayout->addWidget(titleLabel, 1, Qt::AlignLeft);
         topLayout->addStretch();
         
         // Add test button for simulating UDP responses in development/testing
         QPushButton *testBtn = new QPushButton("📡 Test Response");
-        testBtn->setStyleSheet("QPushButton { background: #007AFF; color: white; border: none; border-radius: 8px; padding: 8px 16px; font-weight: bold; } QPushButton:pressed { background: #0051D0; }");
+        testBtn->setMinimumHeight(44);
+        ThemeStyle::setVariant(testBtn, ThemeStyle::PrimaryButton);
         testBtn->setToolTip("Click to simulate a UDP response for testing");
         connect(testBtn, &QPushButton::clicked, this, [this]() {
             static int testCounter = 1;
@@ -79,12 +66,14 @@ UdpResponsePage::UdpResponsePage(QWidget *parent)
             "• <b>Format:</b> Each response shows source IP and full protocol data<br><br>"
             "<i>In WSL/Docker environments, use the Test button to simulate network responses.</i>"
         );
-        infoLabel->setStyleSheet("QLabel { background: #f0f0f0; border: 1px solid #ddd; border-radius: 8px; padding: 16px; margin: 8px 0; }");
+        infoLabel->setMargin(16);
+        ThemeStyle::setVariant(infoLabel, ThemeStyle::Panel);
         infoLabel->setWordWrap(true);
         mainLayout->addWidget(infoLabel);
         
         // Configure text edit for better display
-        m_textEdit->setStyleSheet("QTextEdit { background: #ffffff; border: 2px solid #007AFF; border-radius: 8px; padding: 12px; font-family: 'Courier New', monospace; font-size: 12px; }");
+        m_textEdit->document()->setDocumentMargin(12);
+        ThemeStyle::setVariant(m_textEdit, ThemeStyle::Console);
         m_textEdit->setPlaceholderText("UDP responses will appear here...\nClick 'Test Response' to simulate controller responses in development environments.");
         
         mainLayout->addWidget(m_textEdit);
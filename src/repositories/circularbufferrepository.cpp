@@ -1,17 +1,20 @@
 #include "circularbufferrepository.h"
 #include <QDebug>
+#include <QMetaMethod>
 #include <algorithm>
 
 CircularBufferRepository::CircularBufferRepository(int maxSize, QObject* parent)
     : QObject(parent)
     , m_buffer()
+    , m_values()
     , m_maxSize(maxSize)
     , m_writeIndex(0)
     , m_currentCount(0)
     , m_mutex()
 {
-    // Pre-allocate buffer to avoid dynamic reallocation
-    m_buffer.reserve(maxSize);
+    // Allocate every slot up front so saving never reallocates
+    m_buffer.resize(maxSize);
+    m_values.resize(maxSize);
     qDebug() << "CircularBufferRepository: Created with max size" << maxSize;
 }
 
@@ -19,45 +22,87 @@ CircularBufferRepository::~CircularBufferRepository() {
     qDebug() << "CircularBufferRepository: Destroyed with" << m_currentCount << "entries";
 }
 
-Result<void> CircularBufferRepository::save(const DataPoint& entity) {
-    QMutexLocker locker(&m_mutex);
-    
-    if (!entity.isValid()) {
-        return Result<void>::failure("Cannot save invalid DataPoint");
-    }
-    
+bool CircularBufferRepository::storeLocked(const Sample& sample, const std::optional<QVariant>& value,
+                                           DataPoint* overwritten) {
     // Check if we're overwriting old data
     bool willOverwrite = (m_currentCount == m_maxSize);
-    DataPoint overwrittenPoint;
     
-    if (willOverwrite) {
-        overwrittenPoint = m_buffer[m_writeIndex];
-    }
-    
-    // Insert or overwrite
-    if (m_currentCount < m_maxSize) {
-        m_buffer.append(entity);
+    if (!willOverwrite) {
         m_currentCount++;
-    } else {
-        m_buffer[m_writeIndex] = entity;
+    } else if (overwritten) {
+        *overwritten = pointAt(m_writeIndex);
     }
+    m_buffer[m_writeIndex] = sample;
+    m_values[m_writeIndex] = value;
     
     // Advance write index (circular)
     m_writeIndex = (m_writeIndex + 1) % m_maxSize;
+    return willOverwrite;
+}
+
+Result<void> CircularBufferRepository::save(const DataPoint& entity) {
+    if (!entity.isValid()) {
+        return Result<void>::failure("Cannot save invalid DataPoint");
+    }
+    
+    // The value is kept as given, so the sample (read by recentSamples()
+    // and samplesByTag()) only looks text up instead of interning it
+    const Sample sample = Sample::fromDataPoint(entity, false);
+    
+    const bool notifyOverwrite = isSignalConnected(QMetaMethod::fromSignal(&CircularBufferRepository::dataOverwritten));
+    DataPoint overwrittenPoint;
+    
+    QMutexLocker locker(&m_mutex);
+    bool willOverwrite = storeLocked(sample, entity.value(), notifyOverwrite ? &overwrittenPoint : nullptr);
     
     // Emit signals outside mutex lock
     locker.unlock();
     
     emit dataSaved(entity);
     
-    if (willOverwrite) {
+    if (willOverwrite && notifyOverwrite) {
+        emit dataOverwritten(overwrittenPoint);
+    }
+    
+    return Result<void>::success();
+}
+
+Result<void> CircularBufferRepository::saveSample(const Sample& sample) {
+    if (sample.tagId == 0 || sample.dataQuality() != DataPoint::Quality::Good) {
+        return Result<void>::failure("Cannot save invalid Sample");
+    }
+    
+    // Converting for the DataPoint signals allocates, so only when someone listens
+    const bool notifyOverwrite = isSignalConnected(QMetaMethod::fromSignal(&CircularBufferRepository::dataOverwritten));
+    DataPoint overwrittenPoint;
+    
+    QMutexLocker locker(&m_mutex);
+    bool willOverwrite = storeLocked(sample, std::nullopt, notifyOverwrite ? &overwrittenPoint : nullptr);
+    locker.unlock();
+    
+    if (isSignalConnected(QMetaMethod::fromSignal(&CircularBufferRepository::dataSaved))) {
+        emit dataSaved(sample.toDataPoint());
+    }
+    if (willOverwrite && notifyOverwrite) {
         emit dataOverwritten(overwrittenPoint);
     }
     
     return Result<void>::success();
 }
 
+DataPoint CircularBufferRepository::pointAt(int index) const {
+    const Sample& sample = m_buffer[index];
+    const std::optional<QVariant>& value = m_values[index];
+    if (!value) {
+        return sample.toDataPoint();
+    }
+    return DataPoint(sample.tag(), *value, QDateTime::fromMSecsSinceEpoch(sample.timestampMs()),
+                     sample.dataQuality());
+}
+
 Result<DataPoint> CircularBufferRepository::findById(const QString& id) {
+    const quint32 tagId = TagRegistry::instance().find(id);
+    
     QMutexLocker locker(&m_mutex);
     
     if (m_currentCount == 0) {
@@ -65,10 +110,9 @@ Result<DataPoint> CircularBufferRepository::findById(const QString& id) {
     }
     
     // Search backwards from newest to oldest to find most recent match
-    for (int i = m_currentCount - 1; i >= 0; --i) {
-        int index = (m_writeIndex - 1 - i + m_maxSize) % m_maxSize;
-        if (m_buffer[index].tag() == id) {
-            return Result<DataPoint>::success(m_buffer[index]);
+    for (int i = m_currentCount - 1; tagId != 0 && i >= 0; --i) {
+        if (m_buffer[indexOf(i)].tagId == tagId) {
+            return Result<DataPoint>::success(pointAt(indexOf(i)));
         }
     }
     
@@ -78,52 +122,44 @@ Result<DataPoint> CircularBufferRepository::findById(const QString& id) {
 Result<QList<DataPoint>> CircularBufferRepository::findAll() {
     QMutexLocker locker(&m_mutex);
     
-    if (m_currentCount == 0) {
-        return Result<QList<DataPoint>>::success(QList<DataPoint>());
-    }
-    
     QList<DataPoint> result;
     result.reserve(m_currentCount);
     
     // Return in chronological order (oldest to newest)
-    if (m_currentCount < m_maxSize) {
-        // Buffer not full yet - simple case
-        result = m_buffer;
-    } else {
-        // Buffer is full - need to unwrap circular order
-        for (int i = 0; i < m_currentCount; ++i) {
-            int index = (m_writeIndex + i) % m_maxSize;
-            result.append(m_buffer[index]);
-        }
+    for (int i = 0; i < m_currentCount; ++i) {
+        result.append(pointAt(indexOf(i)));
     }
     
     return Result<QList<DataPoint>>::success(result);
 }
 
 Result<void> CircularBufferRepository::deleteById(const QString& id) {
+    const quint32 tagId = TagRegistry::instance().find(id);
+    
     QMutexLocker locker(&m_mutex);
     
-    int removedCount = 0;
-    
-    // Remove all matching entries
-    for (int i = m_currentCount - 1; i >= 0; --i) {
-        int index = (m_writeIndex - 1 - i + m_maxSize) % m_maxSize;
-        if (m_buffer[index].tag() == id) {
-            m_buffer.removeAt(index);
-            removedCount++;
-            m_currentCount--;
-            
-            // Adjust write index if we removed before it
-            if (index < m_writeIndex) {
-                m_writeIndex--;
-            }
+    // Compact the remaining entries to the front, oldest first
+    QVector<Sample> kept(m_maxSize);
+    QVector<std::optional<QVariant>> keptValues(m_maxSize);
+    int keptCount = 0;
+    for (int i = 0; i < m_currentCount; ++i) {
+        const int index = indexOf(i);
+        if (tagId == 0 || m_buffer[index].tagId != tagId) {
+            keptValues[keptCount] = m_values[index];
+            kept[keptCount++] = m_buffer[index];
         }
     }
     
+    int removedCount = m_currentCount - keptCount;
     if (removedCount == 0) {
         return Result<void>::failure(QString("No DataPoint found with tag: %1").arg(id));
     }
     
+    m_buffer.swap(kept);
+    m_values.swap(keptValues);
+    m_currentCount = keptCount;
+    m_writeIndex = keptCount % m_maxSize;
+    
     qDebug() << "CircularBufferRepository: Deleted" << removedCount 
              << "entries with tag" << id;
     
@@ -138,8 +174,8 @@ int CircularBufferRepository::count() const {
 Result<void> CircularBufferRepository::clear() {
     QMutexLocker locker(&m_mutex);
     
-    m_buffer.clear();
-    m_buffer.reserve(m_maxSize);
+    // Slots are simply reused; only the kept values are released
+    m_values.fill(std::nullopt);
     m_writeIndex = 0;
     m_currentCount = 0;
     
@@ -154,42 +190,50 @@ Result<void> CircularBufferRepository::clear() {
 Result<QList<DataPoint>> CircularBufferRepository::findRecent(int n) {
     QMutexLocker locker(&m_mutex);
     
-    if (m_currentCount == 0) {
-        return Result<QList<DataPoint>>::success(QList<DataPoint>());
-    }
-    
-    int actualCount = qMin(n, m_currentCount);
+    int actualCount = qBound(0, n, m_currentCount);
     QList<DataPoint> result;
     result.reserve(actualCount);
     
     // Get most recent N points (newest first)
     for (int i = 0; i < actualCount; ++i) {
-        int index = (m_writeIndex - 1 - i + m_maxSize) % m_maxSize;
-        result.append(m_buffer[index]);
+        result.append(pointAt(indexOf(m_currentCount - 1 - i)));
     }
     
     return Result<QList<DataPoint>>::success(result);
 }
 
+QVector<Sample> CircularBufferRepository::recentSamples(int n) const {
+    QMutexLocker locker(&m_mutex);
+    
+    int actualCount = qBound(0, n, m_currentCount);
+    QVector<Sample> result;
+    result.reserve(actualCount);
+    
+    // Get most recent N samples (newest first)
+    for (int i = 0; i < actualCount; ++i) {
+        result.append(m_buffer[indexOf(m_currentCount - 1 - i)]);
+    }
+    
+    return result;
+}
+
 Result<QList<DataPoint>> CircularBufferRepository::findByTimeRange(
     const QDateTime& startTime,
     const QDateTime& endTime)
 {
-    QMutexLocker locker(&m_mutex);
+    const qint64 startNs = startTime.toMSecsSinceEpoch() * Sample::NSECS_PER_MSEC;
+    const qint64 endNs = endTime.toMSecsSinceEpoch() * Sample::NSECS_PER_MSEC;
     
-    if (m_currentCount == 0) {
-        return Result<QList<DataPoint>>::success(QList<DataPoint>());
-    }
+    QMutexLocker locker(&m_mutex);
     
     QList<DataPoint> result;
     
     // Search all entries
     for (int i = 0; i < m_currentCount; ++i) {
-        int index = (m_writeIndex + i) % m_maxSize;
-        const DataPoint& point = m_buffer[index];
+        const Sample& sample = m_buffer[indexOf(i)];
         
-        if (point.timestamp() >= startTime && point.timestamp() <= endTime) {
-            result.append(point);
+        if (sample.timestampNs >= startNs && sample.timestampNs <= endNs) {
+            result.append(pointAt(indexOf(i)));
         }
     }
     
@@ -201,45 +245,62 @@ Result<QList<DataPoint>> CircularBufferRepository::findByTagAndTimeRange(
     const QDateTime& startTime,
     const QDateTime& endTime)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    if (m_currentCount == 0) {
+    const quint32 tagId = TagRegistry::instance().find(tag);
+    if (tagId == 0) {
         return Result<QList<DataPoint>>::success(QList<DataPoint>());
     }
     
+    const qint64 startNs = startTime.toMSecsSinceEpoch() * Sample::NSECS_PER_MSEC;
+    const qint64 endNs = endTime.toMSecsSinceEpoch() * Sample::NSECS_PER_MSEC;
+    
+    QMutexLocker locker(&m_mutex);
+    
     QList<DataPoint> result;
     
     // Search all entries
     for (int i = 0; i < m_currentCount; ++i) {
-        int index = (m_writeIndex + i) % m_maxSize;
-        const DataPoint& point = m_buffer[index];
+        const Sample& sample = m_buffer[indexOf(i)];
         
-        if (point.tag() == tag &&
-            point.timestamp() >= startTime &&
-            point.timestamp() <= endTime) {
-            result.append(point);
+        if (sample.tagId == tagId &&
+            sample.timestampNs >= startNs &&
+            sample.timestampNs <= endNs) {
+            result.append(pointAt(indexOf(i)));
         }
     }
     
     return Result<QList<DataPoint>>::success(result);
 }
 
-Result<QList<DataPoint>> CircularBufferRepository::findByQuality(DataPoint::Quality quality) {
+QVector<Sample> CircularBufferRepository::samplesByTag(quint32 tagId, qint64 startNs, qint64 endNs) const {
     QMutexLocker locker(&m_mutex);
     
-    if (m_currentCount == 0) {
-        return Result<QList<DataPoint>>::success(QList<DataPoint>());
+    QVector<Sample> result;
+    
+    // Search all entries
+    for (int i = 0; i < m_currentCount; ++i) {
+        const Sample& sample = m_buffer[indexOf(i)];
+        
+        if (sample.tagId == tagId &&
+            sample.timestampNs >= startNs &&
+            sample.timestampNs <= endNs) {
+            result.append(sample);
+        }
     }
     
+    return result;
+}
+
+Result<QList<DataPoint>> CircularBufferRepository::findByQuality(DataPoint::Quality quality) {
+    QMutexLocker locker(&m_mutex);
+    
     QList<DataPoint> result;
     
     // Search all entries
     for (int i = 0; i < m_currentCount; ++i) {
-        int index = (m_writeIndex + i) % m_maxSize;
-        const DataPoint& point = m_buffer[index];
+        const Sample& sample = m_buffer[indexOf(i)];
         
-        if (point.quality() == quality) {
-            result.append(point);
+        if (sample.dataQuality() == quality) {
+            result.append(pointAt(indexOf(i)));
         }
     }
     
@@ -264,12 +325,7 @@ Result<QDateTime> CircularBufferRepository::oldestTimestamp() const {
         return Result<QDateTime>::failure("Buffer is empty");
     }
     
-    int oldestIndex = (m_writeIndex) % m_maxSize;
-    if (m_currentCount < m_maxSize) {
-        oldestIndex = 0;
-    }
-    
-    return Result<QDateTime>::success(m_buffer[oldestIndex].timestamp());
+    return Result<QDateTime>::success(QDateTime::fromMSecsSinceEpoch(m_buffer[indexOf(0)].timestampMs()));
 }
 
 Result<QDateTime> CircularBufferRepository::newestTimestamp() const {
@@ -279,6 +335,5 @@ Result<QDateTime> CircularBufferRepository::newestTimestamp() const {
         return Result<QDateTime>::failure("Buffer is empty");
     }
     
-    int newestIndex = (m_writeIndex - 1 + m_maxSize) % m_maxSize;
-    return Result<QDateTime>::success(m_buffer[newestIndex].timestamp());
+    return Result<QDateTime>::success(QDateTime::fromMSecsSinceEpoch(m_buffer[indexOf(m_currentCount - 1)].timestampMs()));
 }
@@ -3,8 +3,11 @@
 #include <QList>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QVector>
+#include <optional>
 #include "../interfaces/irepository.h"
 #include "../models/datapoint.h"
+#include "../models/sample.h"
 
 /**
  * @brief Circular buffer repository for efficient real-time data storage
@@ -16,7 +19,10 @@
  * Features:
  * - Thread-safe operations using QMutex
  * - O(1) insertion complexity
- * - Fixed memory footprint (no dynamic allocation after construction)
+ * - Fixed memory footprint: samples are kept as 24-byte Sample records in
+ *   an array allocated once, so saveSample() never allocates. Values saved
+ *   as DataPoints are also kept as the original QVariant, so they read
+ *   back with their type unchanged and text never enters the interner
  * - Automatic aging-out of old data
  * - Quality-based filtering
  * - Time-range queries
@@ -44,6 +50,10 @@
  *     QDateTime::currentDateTime().addSecs(-5),
  *     QDateTime::currentDateTime()
  * );
+ * 
+ * // Allocation-free path for acquisition and plotting
+ * repo->saveSample(Sample::ofDouble(eegId, Sample::nowNs(), 42.5));
+ * QVector<Sample> trace = repo->samplesByTag(eegId, startNs, endNs);
  * @endcode
  * 
  * Thread Safety: All public methods are thread-safe.
@@ -121,6 +131,41 @@ public:
     
     // Additional methods specific to circular buffer
     
+    /**
+     * @brief Save a compact sample without converting it to a DataPoint
+     * @param sample Sample with a non-zero tag ID and Good quality
+     * @return Result<void> Success or error
+     * 
+     * dataSaved()/dataOverwritten() are only converted and emitted when
+     * connected.
+     * 
+     * Complexity: O(1), no allocation
+     * Thread-safe: Yes
+     */
+    Result<void> saveSample(const Sample& sample);
+    
+    /**
+     * @brief Get the most recent N samples
+     * @param n Number of recent samples to retrieve
+     * @return Most recent samples (newest first)
+     * 
+     * Complexity: O(min(n, bufferSize))
+     * Thread-safe: Yes
+     */
+    QVector<Sample> recentSamples(int n) const;
+    
+    /**
+     * @brief Get the samples of one tag within a time range
+     * @param tagId Tag ID (TagRegistry)
+     * @param startNs Start of time range (inclusive, ns since epoch)
+     * @param endNs End of time range (inclusive, ns since epoch)
+     * @return Matching samples (oldest first)
+     * 
+     * Complexity: O(n)
+     * Thread-safe: Yes
+     */
+    QVector<Sample> samplesByTag(quint32 tagId, qint64 startNs, qint64 endNs) const;
+    
     /**
      * @brief Get the most recent N data points
      * @param n Number of recent points to retrieve
@@ -215,7 +260,26 @@ signals:
     void bufferCleared();
 
 private:
-    QList<DataPoint> m_buffer;       ///< Circular buffer storage
+    /**
+     * @brief Store a sample (m_mutex held)
+     * @param value Original value of a DataPoint, none for saveSample()
+     * @param overwritten Receives the point that was replaced, if any (may be null)
+     * @return True if an old sample was overwritten
+     */
+    bool storeLocked(const Sample& sample, const std::optional<QVariant>& value, DataPoint* overwritten);
+    
+    /**
+     * @brief DataPoint of a buffer slot, with its original value if it has one (m_mutex held)
+     */
+    DataPoint pointAt(int index) const;
+    
+    /**
+     * @brief Buffer index of the i-th oldest sample (m_mutex held)
+     */
+    int indexOf(int i) const { return (m_writeIndex - m_currentCount + i + m_maxSize) % m_maxSize; }
+    
+    QVector<Sample> m_buffer;        ///< Circular buffer storage (m_maxSize slots)
+    QVector<std::optional<QVariant>> m_values; ///< Value of each slot written by save()
     int m_maxSize;                   ///< Maximum buffer capacity
     int m_writeIndex;                ///< Current write position
     int m_currentCount;              ///< Current number of valid entries
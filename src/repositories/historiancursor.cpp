@@ -0,0 +1,269 @@
+#include "historiancursor.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QUuid>
+#include <QDebug>
+
+namespace {
+
+// Alias under which the cursor attaches the partition it is reading
+const char* const PARTITION_ALIAS = "cursor_partition";
+
+} // namespace
+
+HistorianCursor::HistorianCursor(const QString& databasePath,
+                                 const QList<QPair<qint64, QString>>& partitionFiles,
+                                 const QHash<qint64, QString>& tagNames,
+                                 const Query& query,
+                                 int pageSize)
+    : m_databasePath(databasePath)
+    , m_partitionFiles(partitionFiles)
+    , m_tagNames(tagNames)
+    , m_query(query)
+    , m_pageSize(qMax(1, pageSize))
+    , m_connectionName("historian-cursor-" + QUuid::createUuid().toString())
+    , m_partitionIndex(-1)
+    , m_exhausted(partitionFiles.isEmpty())
+    , m_rowsFetched(0)
+    , m_cancelled(false)
+{
+}
+
+HistorianCursor::~HistorianCursor()
+{
+    close();
+}
+
+template<typename Page, typename ReadRow>
+Result<Page> HistorianCursor::fetchPage(ReadRow readRow)
+{
+    if (isCancelled()) {
+        close();
+        return Result<Page>::failure("Cursor cancelled");
+    }
+    
+    Page page;
+    if (m_exhausted) {
+        return Result<Page>::success(page);
+    }
+    
+    if (!m_database.isOpen() && !openConnection()) {
+        close();
+        return Result<Page>::failure("Failed to open historian cursor: " + m_database.lastError().text());
+    }
+    
+    page.reserve(m_pageSize);
+    
+    while (page.size() < m_pageSize && !m_exhausted) {
+        if (isCancelled()) {
+            close();
+            return Result<Page>::failure("Cursor cancelled");
+        }
+        
+        if (!m_statement && !startNextPartition()) {
+            const QString error = m_database.lastError().text();
+            close();
+            return Result<Page>::failure("Historian cursor failed: " + error);
+        }
+        
+        if (!m_statement) {
+            break;  // Exhausted while looking for the next partition
+        }
+        
+        if (m_statement->next()) {
+            page.append(readRow(*m_statement));
+        } else if (m_statement->lastError().isValid()) {
+            const QString error = m_statement->lastError().text();
+            close();
+            return Result<Page>::failure(error);
+        } else {
+            finishPartition();
+        }
+    }
+    
+    m_rowsFetched += page.size();
+    
+    // Release the connection as soon as the last row has been handed out
+    if (m_exhausted) {
+        close();
+    }
+    
+    return Result<Page>::success(page);
+}
+
+Result<QList<DataPoint>> HistorianCursor::fetchNext()
+{
+    return fetchPage<QList<DataPoint>>([this](const QSqlQuery& row) {
+        return readSample(row, tagName(row.value(0).toLongLong()));
+    });
+}
+
+Result<QVector<Sample>> HistorianCursor::fetchNextSamples()
+{
+    return fetchPage<QVector<Sample>>([this](const QSqlQuery& row) {
+        return readCompactSample(row, registryTag(row.value(0).toLongLong()));
+    });
+}
+
+bool HistorianCursor::atEnd() const
+{
+    return m_exhausted || isCancelled();
+}
+
+void HistorianCursor::cancel()
+{
+    m_cancelled.store(true);
+}
+
+bool HistorianCursor::isCancelled() const
+{
+    return m_cancelled.load();
+}
+
+DataPoint HistorianCursor::readSample(const QSqlQuery& query, const QString& tagName)
+{
+    QVariant value;
+    if (!query.isNull(3)) {
+        value = query.value(3).toLongLong();
+    } else if (!query.isNull(2)) {
+        value = query.value(2).toDouble();
+    } else {
+        value = query.value(4).toString();
+    }
+    
+    return DataPoint(
+        tagName,
+        value,
+        QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+        static_cast<DataPoint::Quality>(query.value(5).toInt())
+    );
+}
+
+Sample HistorianCursor::readCompactSample(const QSqlQuery& query, quint32 tagId)
+{
+    const qint64 timestampNs = query.value(1).toLongLong() * Sample::NSECS_PER_MSEC;
+    const auto quality = static_cast<DataPoint::Quality>(query.value(5).toInt());
+    
+    if (!query.isNull(3)) {
+        return Sample::ofInt(tagId, timestampNs, query.value(3).toLongLong(), quality);
+    }
+    if (!query.isNull(2)) {
+        return Sample::ofDouble(tagId, timestampNs, query.value(2).toDouble(), quality);
+    }
+    
+    return Sample::ofText(tagId, timestampNs, query.value(4).toString(), quality);
+}
+
+bool HistorianCursor::openConnection()
+{
+    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_database.setDatabaseName(m_databasePath);
+    return m_database.open();
+}
+
+bool HistorianCursor::startNextPartition()
+{
+    while (++m_partitionIndex < m_partitionFiles.size()) {
+        const QString& file = m_partitionFiles.at(m_partitionIndex).second;
+        
+        // Retention may have removed the file since the cursor was planned;
+        // ATTACH would silently create an empty one
+        if (!QFile::exists(file)) {
+            continue;
+        }
+        
+        QSqlQuery attach(m_database);
+        attach.prepare(QString("ATTACH DATABASE :file AS %1").arg(PARTITION_ALIAS));
+        attach.bindValue(":file", file);
+        if (!attach.exec()) {
+            qWarning() << "HistorianCursor: Failed to attach" << file << ":" << attach.lastError().text();
+            return false;
+        }
+        
+        // The IN (SELECT id FROM tags) term lets SQLite seek the (tag_id, ts)
+        // primary key once per tag instead of scanning the whole partition
+        QString whereClause = "ts >= :start AND ts <= :end";
+        whereClause.prepend(m_query.tagId >= 0 ? "tag_id = :tag_id AND "
+                                               : "tag_id IN (SELECT id FROM main.tags) AND ");
+        
+        m_statement.reset(new QSqlQuery(m_database));
+        m_statement->setForwardOnly(true);
+        m_statement->prepare(QString(R"(
+            SELECT tag_id, ts, value_real, value_int, value_text, quality
+            FROM %1.samples
+            WHERE %2
+            ORDER BY ts %3
+        )").arg(PARTITION_ALIAS, whereClause, m_query.oldestFirst ? "ASC" : "DESC"));
+        if (m_query.tagId >= 0) {
+            m_statement->bindValue(":tag_id", m_query.tagId);
+        }
+        m_statement->bindValue(":start", m_query.startMs);
+        m_statement->bindValue(":end", m_query.endMs);
+        
+        if (!m_statement->exec()) {
+            qWarning() << "HistorianCursor: Query failed on" << file << ":" << m_statement->lastError().text();
+            finishPartition();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    m_exhausted = true;
+    return true;
+}
+
+void HistorianCursor::finishPartition()
+{
+    if (!m_statement) {
+        return;
+    }
+    
+    m_statement.reset();
+    
+    QSqlQuery detach(m_database);
+    if (!detach.exec(QString("DETACH DATABASE %1").arg(PARTITION_ALIAS))) {
+        qWarning() << "HistorianCursor: Failed to detach partition:" << detach.lastError().text();
+    }
+}
+
+void HistorianCursor::close()
+{
+    finishPartition();
+    m_exhausted = true;
+    
+    if (m_database.isValid()) {
+        m_database.close();
+        m_database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
+}
+
+QString HistorianCursor::tagName(qint64 id)
+{
+    auto it = m_tagNames.constFind(id);
+    if (it != m_tagNames.constEnd()) {
+        return it.value();
+    }
+    
+    // Tag registered after the cursor was opened - refresh the snapshot once
+    QSqlQuery query(m_database);
+    query.prepare("SELECT name FROM main.tags WHERE id = :id");
+    query.bindValue(":id", id);
+    const QString name = query.exec() && query.next() ? query.value(0).toString() : QString();
+    m_tagNames.insert(id, name);
+    return name;
+}
+
+quint32 HistorianCursor::registryTag(qint64 id)
+{
+    auto it = m_registryTags.constFind(id);
+    if (it != m_registryTags.constEnd()) {
+        return it.value();
+    }
+    
+    const quint32 registryId = TagRegistry::instance().intern(tagName(id));
+    m_registryTags.insert(id, registryId);
+    return registryId;
+}
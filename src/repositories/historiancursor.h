@@ -0,0 +1,208 @@
+#pragma once
+
+#include "../models/datapoint.h"
+#include "../models/sample.h"
+#include "../utils/result.h"
+#include <QSqlDatabase>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+class QSqlQuery;
+
+/**
+ * @brief Forward-only, paged cursor over historian samples
+ * 
+ * Streams the result of a historian range query in fixed-size pages so
+ * memory use stays constant regardless of how many samples match. Created
+ * by SqliteRepository::openCursor(); all list-returning range queries of
+ * the repository are built on top of it.
+ * 
+ * Pattern: Iterator over Repository (RULE-202)
+ * Location: src/repositories/ (RULE-304)
+ * 
+ * Features:
+ * - Fixed-size pages (fetchNext()), or pages of compact Samples
+ *   (fetchNextSamples()) for plotting and bulk processing
+ * - Partitions visited and samples ordered newest first, or oldest first
+ *   (Query::oldestFirst)
+ * - Own SQLite connection, opened lazily in the thread that first fetches,
+ *   so the cursor can be handed to and drained on a background thread
+ * - Thread-safe cancellation (cancel() may be called from any thread)
+ * 
+ * Threading: A cursor must be fetched from and destroyed in one thread at
+ * a time (Qt SQL connections are thread-affine). Only cancel() and
+ * isCancelled() may be called concurrently.
+ * 
+ * Example:
+ * @code
+ * auto cursor = repo.openCursor("Temperature", start, end, 1000);
+ * QThread* exportThread = QThread::create([cursor = std::move(cursor)]() {
+ *     while (!cursor->atEnd()) {
+ *         auto page = cursor->fetchNext();
+ *         if (page.isFailure()) break;
+ *         writeRows(page.value());
+ *     }
+ * });
+ * exportThread->start();
+ * @endcode
+ */
+class HistorianCursor {
+public:
+    /**
+     * @brief Default number of samples per page
+     */
+    static constexpr int DEFAULT_PAGE_SIZE = 1000;
+    
+    /**
+     * @brief Query executed by the cursor
+     */
+    struct Query {
+        qint64 tagId = -1;                                      // -1 = all tags
+        qint64 startMs = std::numeric_limits<qint64>::min();    // Inclusive
+        qint64 endMs = std::numeric_limits<qint64>::max();      // Inclusive
+        bool oldestFirst = false;                               // Ascending timestamps
+    };
+    
+    /**
+     * @brief Create a cursor (normally via SqliteRepository::openCursor())
+     * @param databasePath Main historian database (holds the tag dictionary)
+     * @param partitionFiles Partition files to visit, in the order of query.oldestFirst
+     * @param tagNames Snapshot of the tag dictionary (ID -> name)
+     * @param query Tag and time range to stream
+     * @param pageSize Number of samples returned per fetchNext()
+     */
+    HistorianCursor(const QString& databasePath,
+                    const QList<QPair<qint64, QString>>& partitionFiles,
+                    const QHash<qint64, QString>& tagNames,
+                    const Query& query,
+                    int pageSize = DEFAULT_PAGE_SIZE);
+    
+    ~HistorianCursor();
+    
+    HistorianCursor(const HistorianCursor&) = delete;
+    HistorianCursor& operator=(const HistorianCursor&) = delete;
+    
+    /**
+     * @brief Fetch the next page of samples
+     * @return Up to pageSize() samples (in query order); an empty list once
+     *         the cursor is exhausted; failure on error or cancellation
+     */
+    Result<QList<DataPoint>> fetchNext();
+    
+    /**
+     * @brief Fetch the next page as compact samples
+     * 
+     * Same rows as fetchNext(), but without a QString, QVariant and
+     * QDateTime per row. Both may be mixed on one cursor. Text values are
+     * interned (see Sample); fetch free-form text with fetchNext().
+     * @return Up to pageSize() samples; empty once exhausted; failure on
+     *         error or cancellation
+     */
+    Result<QVector<Sample>> fetchNextSamples();
+    
+    /**
+     * @brief Check if all samples have been returned (or the cursor was cancelled)
+     */
+    bool atEnd() const;
+    
+    /**
+     * @brief Request cancellation; the next fetchNext() fails and releases resources
+     * 
+     * Thread-safe.
+     */
+    void cancel();
+    
+    /**
+     * @brief Check if cancel() was called
+     * 
+     * Thread-safe.
+     */
+    bool isCancelled() const;
+    
+    /**
+     * @brief Number of samples per page
+     */
+    int pageSize() const { return m_pageSize; }
+    
+    /**
+     * @brief Total number of samples returned so far
+     */
+    qint64 rowsFetched() const { return m_rowsFetched; }
+    
+    /**
+     * @brief Decode the current row of a samples query into a DataPoint
+     * 
+     * Expects columns: tag_id, ts, value_real, value_int, value_text, quality
+     * @param query Positioned query
+     * @param tagName Name of the row's tag
+     */
+    static DataPoint readSample(const QSqlQuery& query, const QString& tagName);
+    
+    /**
+     * @brief Decode the current row of a samples query into a Sample
+     * 
+     * Same columns as readSample().
+     * @param query Positioned query
+     * @param tagId Registry ID of the row's tag (TagRegistry)
+     */
+    static Sample readCompactSample(const QSqlQuery& query, quint32 tagId);
+
+private:
+    /**
+     * @brief Read the next page, decoding each row with readRow
+     */
+    template<typename Page, typename ReadRow>
+    Result<Page> fetchPage(ReadRow readRow);
+    
+    /**
+     * @brief Open the cursor's connection in the calling thread
+     */
+    bool openConnection();
+    
+    /**
+     * @brief Attach the next partition and start its query
+     * @return False on error; sets m_exhausted when no partition is left
+     */
+    bool startNextPartition();
+    
+    /**
+     * @brief Finish the running query and detach its partition
+     */
+    void finishPartition();
+    
+    /**
+     * @brief Release the statement, partition and connection
+     */
+    void close();
+    
+    /**
+     * @brief Look up a tag name, refreshing the snapshot for unknown IDs
+     */
+    QString tagName(qint64 id);
+    
+    /**
+     * @brief TagRegistry ID of a historian tag ID
+     */
+    quint32 registryTag(qint64 id);
+    
+    QString m_databasePath;                         // Main historian database file
+    QList<QPair<qint64, QString>> m_partitionFiles; // (day, absolute file path), in query order
+    QHash<qint64, QString> m_tagNames;              // Tag dictionary snapshot
+    QHash<qint64, quint32> m_registryTags;          // Historian tag ID -> TagRegistry ID
+    Query m_query;                                  // Tag and time range
+    int m_pageSize;                                 // Samples per page
+    
+    QString m_connectionName;                       // Unique Qt SQL connection name
+    QSqlDatabase m_database;                        // Cursor's own connection (lazy)
+    std::unique_ptr<QSqlQuery> m_statement;         // Running query on the current partition
+    int m_partitionIndex;                           // Index into m_partitionFiles
+    bool m_exhausted;                               // No more rows
+    qint64 m_rowsFetched;                           // Rows returned so far
+    std::atomic<bool> m_cancelled;                  // Set by cancel()
+};
@@ -0,0 +1,375 @@
+#include "historianspool.h"
+#include "../utils/checksum.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const quint32 SPOOL_MAGIC = 0x4C505351;     // "QSPL"
+const quint32 SPOOL_VERSION = 1;
+const qint64 HEAD_SLOT_OFFSET = 16;
+const qint64 HEAD_SLOT_SIZE = 24;
+const qint64 DATA_START = 64;
+const qint64 RECORD_HEADER_SIZE = 16;
+const quint32 WRAP_MARKER = 0xFFFFFFFF;
+const qint64 MIN_CAPACITY = 4096;
+
+QByteArray encodeSample(const DataPoint& sample)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << sample.tag()
+           << sample.timestamp().toMSecsSinceEpoch()
+           << static_cast<qint32>(sample.quality())
+           << sample.value();
+    return payload;
+}
+
+DataPoint decodeSample(const uchar* data, qint64 size)
+{
+    QByteArray payload = QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(size));
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_12);
+    
+    QString tag;
+    qint64 timestampMs = 0;
+    qint32 quality = 0;
+    QVariant value;
+    stream >> tag >> timestampMs >> quality >> value;
+    
+    return DataPoint(tag, value, QDateTime::fromMSecsSinceEpoch(timestampMs),
+                     static_cast<DataPoint::Quality>(quality));
+}
+
+} // namespace
+
+HistorianSpool::HistorianSpool(const QString& filePath, qint64 capacityBytes)
+    : m_file(filePath)
+    , m_map(nullptr)
+    , m_capacity(0)
+    , m_head(DATA_START)
+    , m_headSequence(1)
+    , m_headSlot(0)
+    , m_tail(DATA_START)
+    , m_nextSequence(1)
+    , m_depth(0)
+{
+    if (!open(qMax(capacityBytes, MIN_CAPACITY))) {
+        qWarning() << "HistorianSpool: Failed to open" << filePath << ":" << m_file.errorString();
+        if (m_map) {
+            m_file.unmap(m_map);
+            m_map = nullptr;
+        }
+        m_file.close();
+        m_capacity = 0;
+    }
+}
+
+HistorianSpool::~HistorianSpool()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+    m_file.close();
+}
+
+bool HistorianSpool::open(qint64 capacityBytes)
+{
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    
+    // Reuse an existing journal if its header is intact, otherwise start over
+    bool valid = false;
+    if (m_file.size() >= DATA_START) {
+        QByteArray header = m_file.read(DATA_START);
+        const uchar* bytes = reinterpret_cast<const uchar*>(header.constData());
+        qint64 capacity = qFromLittleEndian<qint64>(bytes + 8);
+        valid = qFromLittleEndian<quint32>(bytes) == SPOOL_MAGIC
+             && qFromLittleEndian<quint32>(bytes + 4) == SPOOL_VERSION
+             && capacity == m_file.size()
+             && capacity >= MIN_CAPACITY;
+    }
+    
+    if (!valid) {
+        if (m_file.size() > 0) {
+            qWarning() << "HistorianSpool: Discarding unreadable journal" << m_file.fileName();
+        }
+        if (!initialize(capacityBytes)) {
+            return false;
+        }
+    }
+    
+    m_capacity = m_file.size();
+    m_map = m_file.map(0, m_capacity);
+    if (!m_map) {
+        return false;
+    }
+    
+    if (!valid) {
+        // Slot B (sequence 0) is immediately superseded by slot A (sequence 1)
+        m_headSlot = 0;
+        writeHead(DATA_START, 0);
+        writeHead(DATA_START, 1);
+    }
+    
+    recover();
+    return true;
+}
+
+bool HistorianSpool::initialize(qint64 capacityBytes)
+{
+    // Allocate every block up front so appends never hit a full disk
+    if (!m_file.resize(0) || !m_file.seek(0)) {
+        return false;
+    }
+    
+    const QByteArray zeros(1024 * 1024, '\0');
+    qint64 written = 0;
+    while (written < capacityBytes) {
+        qint64 chunk = qMin<qint64>(zeros.size(), capacityBytes - written);
+        if (m_file.write(zeros.constData(), chunk) != chunk) {
+            return false;
+        }
+        written += chunk;
+    }
+    
+    uchar header[16];
+    qToLittleEndian<quint32>(SPOOL_MAGIC, header);
+    qToLittleEndian<quint32>(SPOOL_VERSION, header + 4);
+    qToLittleEndian<qint64>(capacityBytes, header + 8);
+    if (!m_file.seek(0) || m_file.write(reinterpret_cast<const char*>(header), sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+    return m_file.flush();
+}
+
+void HistorianSpool::recover()
+{
+    // Pick the newest head slot with a valid checksum
+    bool found = false;
+    for (int slot = 0; slot < 2; ++slot) {
+        const uchar* p = m_map + HEAD_SLOT_OFFSET + slot * HEAD_SLOT_SIZE;
+        qint64 offset = qFromLittleEndian<qint64>(p);
+        quint64 sequence = qFromLittleEndian<quint64>(p + 8);
+        if (qFromLittleEndian<quint32>(p + 16) != crc32(p, 16)
+            || offset < DATA_START || offset > m_capacity) {
+            continue;
+        }
+        if (!found || sequence > m_headSequence) {
+            m_head = offset;
+            m_headSequence = sequence;
+            m_headSlot = slot;
+            found = true;
+        }
+    }
+    if (!found) {
+        qWarning() << "HistorianSpool: No valid head in" << m_file.fileName() << "- starting empty";
+        m_head = DATA_START;
+        m_headSequence = 1;
+        writeHead(m_head, m_headSequence);
+    }
+    
+    // Follow consecutive, intact records; the first gap is the tail
+    m_depth = 0;
+    m_tail = m_head;
+    m_nextSequence = m_headSequence;
+    qint64 scanned = 0;
+    while (scanned < m_capacity) {
+        qint64 offset = normalize(m_tail);
+        qint64 size = recordAt(offset, m_nextSequence);
+        if (size == 0) {
+            break;
+        }
+        scanned += size + (offset == m_tail ? 0 : m_capacity - m_tail);
+        m_tail = offset + size;
+        ++m_nextSequence;
+        ++m_depth;
+    }
+    
+    if (m_depth > 0) {
+        qDebug() << "HistorianSpool: Recovered" << m_depth << "spooled samples from" << m_file.fileName();
+    }
+}
+
+qint64 HistorianSpool::normalize(qint64 offset) const
+{
+    if (m_capacity - offset < RECORD_HEADER_SIZE
+        || qFromLittleEndian<quint32>(m_map + offset) == WRAP_MARKER) {
+        return DATA_START;
+    }
+    return offset;
+}
+
+qint64 HistorianSpool::recordAt(qint64 offset, quint64 sequence) const
+{
+    const uchar* p = m_map + offset;
+    qint64 length = qFromLittleEndian<quint32>(p);
+    if (length == 0 || length > m_capacity - offset - RECORD_HEADER_SIZE
+        || qFromLittleEndian<quint64>(p + 8) != sequence
+        || qFromLittleEndian<quint32>(p + 4) != crc32(p + 8, 8 + length)) {
+        return 0;
+    }
+    return RECORD_HEADER_SIZE + length;
+}
+
+Result<void> HistorianSpool::append(const QList<DataPoint>& samples)
+{
+    if (!m_map) {
+        return Result<void>::failure("Spool is not available");
+    }
+    if (samples.isEmpty()) {
+        return Result<void>::success();
+    }
+    
+    // Place every record before writing any, so a batch is all or nothing
+    QList<QByteArray> payloads;
+    QList<qint64> offsets;
+    payloads.reserve(samples.size());
+    offsets.reserve(samples.size());
+    
+    qint64 tail = m_tail;
+    bool wrapped = m_depth > 0 && m_tail <= m_head;
+    bool batchWraps = false;
+    for (const auto& sample : samples) {
+        QByteArray payload = encodeSample(sample);
+        qint64 size = RECORD_HEADER_SIZE + payload.size();
+        
+        if (!wrapped && tail + size > m_capacity) {
+            tail = DATA_START;
+            wrapped = true;
+            batchWraps = true;
+        }
+        if (wrapped && tail + size > m_head) {
+            return Result<void>::failure(QString("Spool full (%1 of %2 bytes used)")
+                                         .arg(usedBytes()).arg(m_capacity));
+        }
+        
+        offsets.append(tail);
+        payloads.append(payload);
+        tail += size;
+    }
+    
+    // Write records; the sequence numbers link them to the existing ones
+    qint64 previousEnd = m_tail;
+    for (int i = 0; i < payloads.size(); ++i) {
+        qint64 offset = offsets.at(i);
+        const QByteArray& payload = payloads.at(i);
+        if (offset != previousEnd && m_capacity - previousEnd >= 4) {
+            qToLittleEndian<quint32>(WRAP_MARKER, m_map + previousEnd);
+        }
+        
+        uchar* p = m_map + offset;
+        qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), p);
+        qToLittleEndian<quint64>(m_nextSequence, p + 8);
+        std::memcpy(p + RECORD_HEADER_SIZE, payload.constData(), static_cast<size_t>(payload.size()));
+        qToLittleEndian<quint32>(crc32(p + 8, 8 + payload.size()), p + 4);
+        
+        previousEnd = offset + RECORD_HEADER_SIZE + payload.size();
+        ++m_nextSequence;
+    }
+    
+    // Records are only reachable once the whole batch is on disk
+    if (batchWraps) {
+        sync(m_tail, m_capacity - m_tail);
+        sync(DATA_START, previousEnd - DATA_START);
+    } else {
+        sync(m_tail, previousEnd - m_tail);
+    }
+    m_tail = previousEnd;
+    m_depth += samples.size();
+    return Result<void>::success();
+}
+
+QList<DataPoint> HistorianSpool::peek(int maxSamples) const
+{
+    QList<DataPoint> samples;
+    if (!m_map) {
+        return samples;
+    }
+    
+    int count = qMin(maxSamples, m_depth);
+    samples.reserve(count);
+    qint64 offset = m_head;
+    for (int i = 0; i < count; ++i) {
+        offset = normalize(offset);
+        const uchar* p = m_map + offset;
+        qint64 length = qFromLittleEndian<quint32>(p);
+        samples.append(decodeSample(p + RECORD_HEADER_SIZE, length));
+        offset += RECORD_HEADER_SIZE + length;
+    }
+    return samples;
+}
+
+void HistorianSpool::consume(int samples)
+{
+    if (!m_map || samples <= 0) {
+        return;
+    }
+    
+    int count = qMin(samples, m_depth);
+    qint64 offset = m_head;
+    for (int i = 0; i < count; ++i) {
+        offset = normalize(offset);
+        offset += RECORD_HEADER_SIZE + qFromLittleEndian<quint32>(m_map + offset);
+    }
+    
+    m_depth -= count;
+    if (m_depth == 0) {
+        // Restart at the front so the next batch gets the whole file
+        offset = DATA_START;
+        m_tail = DATA_START;
+    }
+    writeHead(offset, m_headSequence + static_cast<quint64>(count));
+}
+
+qint64 HistorianSpool::usedBytes() const
+{
+    if (m_depth == 0) {
+        return 0;
+    }
+    if (m_tail > m_head) {
+        return m_tail - m_head;
+    }
+    return (m_capacity - m_head) + (m_tail - DATA_START);
+}
+
+void HistorianSpool::writeHead(qint64 offset, quint64 sequence)
+{
+    // Alternate slots so a torn write leaves the previous head intact
+    int slot = 1 - m_headSlot;
+    uchar* p = m_map + HEAD_SLOT_OFFSET + slot * HEAD_SLOT_SIZE;
+    qToLittleEndian<qint64>(offset, p);
+    qToLittleEndian<quint64>(sequence, p + 8);
+    qToLittleEndian<quint32>(crc32(p, 16), p + 16);
+    sync(0, DATA_START);
+    
+    m_head = offset;
+    m_headSequence = sequence;
+    m_headSlot = slot;
+}
+
+void HistorianSpool::sync(qint64 offset, qint64 size)
+{
+    // Flush whole pages; the mapping itself starts on a page boundary
+    const qint64 page = 4096;
+    qint64 start = offset - offset % page;
+    qint64 length = qMin(m_capacity, offset + size) - start;
+#ifdef Q_OS_WIN
+    FlushViewOfFile(m_map + start, static_cast<SIZE_T>(length));
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(m_file.handle())));
+#else
+    msync(m_map + start, static_cast<size_t>(length), MS_SYNC);
+#endif
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../models/datapoint.h"
+#include "../utils/result.h"
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/**
+ * @brief Spool health as exposed by SqliteRepository::spoolMetrics()
+ */
+struct SpoolMetrics {
+    int depth = 0;                  // Samples waiting in the spool
+    qint64 usedBytes = 0;           // Journal bytes holding those samples
+    qint64 capacityBytes = 0;       // Journal size (0 = spool unavailable)
+    qint64 spooledTotal = 0;        // Samples diverted to the spool since startup
+    qint64 drainedTotal = 0;        // Samples replayed into the historian since startup
+    qint64 droppedTotal = 0;        // Samples lost because the spool was full
+    double drainRate = 0.0;         // Samples per second during the last drain
+    QString lastError;              // Why the historian was last unavailable
+};
+
+/**
+ * @brief Durable store-and-forward journal for samples the historian could not take
+ * 
+ * A fixed-size, preallocated, memory-mapped ring of append-only records.
+ * Samples are appended while the database is unavailable (locked, disk
+ * full, migration running) and replayed in order once it is writable;
+ * consume() then advances the durable head. Because historian writes are
+ * upserts on (tag, timestamp), replaying a record twice - e.g.
+ * after a crash between the database commit and consume() - is harmless.
+ * 
+ * Pattern: Journal (write-ahead, replay on recovery)
+ * Location: src/repositories/ (RULE-304)
+ * 
+ * File layout (little endian):
+ * @code
+ * 0   magic "QSPL" (u32) | version (u32) | capacity (u64)
+ * 16  head slot A: offset (u64) | sequence (u64) | crc32 (u32) | reserved (u32)
+ * 40  head slot B: same layout; the valid slot with the higher sequence wins
+ * 64  records: length (u32) | crc32 of sequence + payload (u32) | sequence (u64) | payload
+ * @endcode
+ * 
+ * Records never straddle the end of the file: a length of 0xFFFFFFFF (or
+ * less than a record header left) means "continue at offset 64". The tail
+ * is not stored; it is found on open by following records from the head
+ * while their sequence numbers are consecutive and their CRCs match, so a
+ * torn append or leftovers from an earlier lap end the scan. The two head
+ * slots are written alternately, so a torn head update falls back to the
+ * previous head (its records are replayed again, which is idempotent).
+ * 
+ * The file is fully allocated when created, so appends cannot fail for
+ * lack of disk space. Every append() and consume() is flushed to disk
+ * before it returns.
+ * 
+ * Threading: Not thread-safe; SqliteRepository serializes access.
+ */
+class HistorianSpool {
+public:
+    static constexpr qint64 DEFAULT_CAPACITY_BYTES = 16 * 1024 * 1024;
+    
+    /**
+     * @brief Open or create a spool file
+     * @param filePath Journal file
+     * @param capacityBytes Size of a new journal (an existing one keeps its size)
+     */
+    explicit HistorianSpool(const QString& filePath, qint64 capacityBytes = DEFAULT_CAPACITY_BYTES);
+    ~HistorianSpool();
+    
+    HistorianSpool(const HistorianSpool&) = delete;
+    HistorianSpool& operator=(const HistorianSpool&) = delete;
+    
+    /**
+     * @brief Check if the journal is mapped and usable
+     */
+    bool isOpen() const { return m_map != nullptr; }
+    
+    /**
+     * @brief Append samples after the existing ones (all or nothing)
+     * @return Failure if the spool is not open or has no room for all of them
+     */
+    Result<void> append(const QList<DataPoint>& samples);
+    
+    /**
+     * @brief Oldest samples in the spool, without removing them
+     * @param maxSamples Maximum number of samples to return
+     */
+    QList<DataPoint> peek(int maxSamples) const;
+    
+    /**
+     * @brief Durably remove the oldest samples (after they were written elsewhere)
+     */
+    void consume(int samples);
+    
+    /**
+     * @brief Number of samples in the spool
+     */
+    int depth() const { return m_depth; }
+    
+    /**
+     * @brief Journal bytes in use (including wrap-around padding)
+     */
+    qint64 usedBytes() const;
+    
+    /**
+     * @brief Total journal size
+     */
+    qint64 capacityBytes() const { return m_capacity; }
+
+private:
+    bool open(qint64 capacityBytes);
+    bool initialize(qint64 capacityBytes);
+    
+    /**
+     * @brief Follow records from the head to find the tail and depth
+     */
+    void recover();
+    
+    /**
+     * @brief Offset of the record at or after a position, following wrap markers
+     */
+    qint64 normalize(qint64 offset) const;
+    
+    /**
+     * @brief Validate the record at an offset
+     * @return Total record size, or 0 if there is no valid record with this sequence
+     */
+    qint64 recordAt(qint64 offset, quint64 sequence) const;
+    
+    void writeHead(qint64 offset, quint64 sequence);
+    void sync(qint64 offset, qint64 size);
+    
+    QFile m_file;
+    uchar* m_map;               // Whole file, read/write, shared
+    qint64 m_capacity;          // File size
+    
+    qint64 m_head;              // Offset of the oldest record
+    quint64 m_headSequence;     // Sequence number of the oldest record
+    int m_headSlot;             // Header slot (0/1) holding the current head
+    qint64 m_tail;              // Offset after the newest record
+    quint64 m_nextSequence;     // Sequence number of the next appended record
+    int m_depth;                // Records between head and tail
+};
@@ -1,322 +1,1990 @@
 #include "sqliterepository.h"
+#include "../utils/resampler.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
 #include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QThread>
 #include <QUuid>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QVector>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+// Column list shared by every samples query (see HistorianCursor::readSample())
+const char* const SAMPLE_COLUMNS = "tag_id, ts, value_real, value_int, value_text, quality";
+
+const qint64 MSECS_PER_DAY = 86400000;
+
+// How long a connection waits for another connection's write lock
+const int BUSY_TIMEOUT_MS = 5000;
+
+// Samples replayed per transaction when draining the spool
+const int SPOOL_DRAIN_BATCH = 1000;
+
+// Rollup tiers as an inline table for the trigger and backfill statements
+QString rollupTiersSql()
+{
+    QStringList selects;
+    for (qint64 width : SqliteRepository::ROLLUP_TIERS_MS) {
+        selects.append(QString("SELECT %1 AS width").arg(width));
+    }
+    return "(" + selects.join(" UNION ALL ") + ")";
+}
+
+// Rollup rows (all tiers) of the numeric samples matching a filter on the
+// samples ("s") and tiers ("t") tables
+QString rollupRowsSql(const QString& samplesTable, const QString& filter)
+{
+    return QString(R"(
+        SELECT DISTINCT width, tag_id, bucket,
+               COUNT(*) OVER w, MIN(x) OVER w, MAX(x) OVER w, SUM(x) OVER w,
+               MIN(ts) OVER w, FIRST_VALUE(x) OVER w, MAX(ts) OVER w, LAST_VALUE(x) OVER w
+        FROM (
+            SELECT t.width AS width, s.tag_id AS tag_id, s.ts AS ts,
+                   COALESCE(s.value_real, s.value_int) AS x,
+                   s.ts - (s.ts % t.width + t.width) % t.width AS bucket
+            FROM %1 AS s, %2 AS t
+            WHERE (s.value_real IS NOT NULL OR s.value_int IS NOT NULL) AND %3
+        )
+        WINDOW w AS (PARTITION BY width, tag_id, bucket ORDER BY ts
+                     ROWS BETWEEN UNBOUNDED PRECEDING AND UNBOUNDED FOLLOWING)
+    )").arg(samplesTable, rollupTiersSql(), filter);
+}
+
+// Whether an attached partition has its rollups table (a bulk load drops it)
+bool hasRollupsTable(QSqlDatabase& database, const QString& schema)
+{
+    QSqlQuery query(database);
+    query.exec(QString("SELECT 1 FROM \"%1\".sqlite_master WHERE type = 'table' AND name = 'rollups'").arg(schema));
+    return query.next();
+}
+
+// Conflict clause of every samples insert: a sample stored again with the
+// same values is left alone, a changed one is updated in place (so the
+// rollup update trigger sees it instead of a second insert)
+const char* const UPSERT_SAMPLE = R"(
+    ON CONFLICT (tag_id, ts) DO UPDATE SET
+        value_real = excluded.value_real, value_int = excluded.value_int,
+        value_text = excluded.value_text, quality = excluded.quality
+    WHERE value_real IS NOT excluded.value_real OR value_int IS NOT excluded.value_int
+       OR value_text IS NOT excluded.value_text OR quality IS NOT excluded.quality
+)";
+
+bool isIntegralType(int type)
+{
+    switch (type) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::Char:
+        case QMetaType::SChar:
+        case QMetaType::UChar:
+        case QMetaType::Long:
+        case QMetaType::ULong:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
 
 SqliteRepository::SqliteRepository(const QString& databasePath)
     : m_databasePath(databasePath)
-    , m_mutex()
+    , m_writerContext(new QObject)
+    , m_writeMutex()
     , m_connectionName(QUuid::createUuid().toString())
 {
-    initialize();
+    // The writer connection is opened, used and closed on this thread only
+    m_writerThread.setObjectName("SqliteRepository writer");
+    m_writerContext->moveToThread(&m_writerThread);
+    QObject::connect(&m_writerThread, &QThread::finished, m_writerContext, &QObject::deleteLater);
+    m_writerThread.start();
+    
+    onWriterThread([this]() { return initialize(); });
+    
+    // Replay whatever a previous run could not write; a new journal is
+    // only created once a write has to be spooled
+    if (QFile::exists(spoolPath())) {
+        m_spool.reset(new HistorianSpool(spoolPath()));
+        if (m_spool->depth() > 0) {
+            drainSpool();
+        }
+    }
 }
 
 SqliteRepository::~SqliteRepository()
 {
-    if (m_database.isOpen()) {
-        m_database.close();
+    // Reader connections of threads that are still running are closed here
+    QStringList connectionNames;
+    for (auto& entry : m_readers) {
+        QObject::disconnect(entry.second->threadFinished);
+        connectionNames.append(entry.second->database.connectionName());
+        entry.second->database.close();
+        for (const QString& fileName : qAsConst(entry.second->attachedFiles)) {
+            releasePartitionFile(fileName);
+        }
+    }
+    m_readers.clear();
+    
+    for (const QString& name : qAsConst(connectionNames)) {
+        QSqlDatabase::removeDatabase(name);
     }
-    QSqlDatabase::removeDatabase(m_connectionName);
+    
+    onWriterThread([this]() {
+        if (m_writer.database.isOpen()) {
+            m_writer.database.close();
+        }
+        for (const QString& fileName : qAsConst(m_writer.attachedFiles)) {
+            releasePartitionFile(fileName);
+        }
+        m_writer.database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+        return true;
+    });
+    
+    m_writerThread.quit();
+    m_writerThread.wait();
 }
 
 bool SqliteRepository::initialize()
 {
-    QMutexLocker locker(&m_mutex);
+    QMutexLocker locker(&m_writeMutex);
     
     // Create database connection with unique name
-    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
-    m_database.setDatabaseName(m_databasePath);
+    m_writer.database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_writer.database.setDatabaseName(m_databasePath);
     
-    if (!m_database.open()) {
-        qWarning() << "Failed to open database:" << m_database.lastError().text();
+    if (!m_writer.database.open()) {
+        qWarning() << "Failed to open database:" << m_writer.database.lastError().text();
         return false;
     }
     
-    return createTables();
+    // WAL lets readers and cursors work on their own connections while
+    // samples are saved
+    QSqlQuery pragma(m_writer.database);
+    if (!pragma.exec("PRAGMA main.journal_mode = WAL")) {
+        qWarning() << "Failed to enable WAL journal:" << pragma.lastError().text();
+    }
+    configureConnection(m_writer.database);
+    
+    if (!createTables() || !loadTags()) {
+        return false;
+    }
+    
+    loadLatestValues();
+    return true;
+}
+
+void SqliteRepository::configureConnection(QSqlDatabase& database)
+{
+    QSqlQuery query(database);
+    if (!query.exec(QString("PRAGMA busy_timeout = %1").arg(BUSY_TIMEOUT_MS))) {
+        qWarning() << "Failed to set busy timeout:" << query.lastError().text();
+    }
+}
+
+SqliteRepository::Connection& SqliteRepository::reader() const
+{
+    const Qt::HANDLE threadId = QThread::currentThreadId();
+    
+    QMutexLocker locker(&m_poolMutex);
+    
+    auto it = m_readers.find(threadId);
+    if (it == m_readers.end()) {
+        std::unique_ptr<Connection> connection(new Connection);
+        const QString name = QString("%1-reader-%2").arg(m_connectionName).arg(quintptr(threadId));
+        connection->database = QSqlDatabase::addDatabase("QSQLITE", name);
+        connection->database.setDatabaseName(m_databasePath);
+        
+        if (connection->database.open()) {
+            configureConnection(connection->database);
+        } else {
+            qWarning() << "Failed to open reader connection" << name << ":" << connection->database.lastError().text();
+        }
+        
+        // Qt SQL connections must be closed in their own thread; QThread
+        // emits finished() from the finishing thread itself
+        if (QThread* thread = QThread::currentThread()) {
+            connection->threadFinished = QObject::connect(thread, &QThread::finished, [this, threadId]() {
+                releaseReader(threadId);
+            });
+        }
+        
+        it = m_readers.emplace(threadId, std::move(connection)).first;
+    }
+    
+    Connection& connection = *it->second;
+    locker.unlock();
+    
+    detachStalePartitions(connection);
+    return connection;
+}
+
+void SqliteRepository::releaseReader(Qt::HANDLE threadId) const
+{
+    std::unique_ptr<Connection> connection;
+    {
+        QMutexLocker locker(&m_poolMutex);
+        auto it = m_readers.find(threadId);
+        if (it == m_readers.end()) {
+            return;
+        }
+        connection = std::move(it->second);
+        m_readers.erase(it);
+    }
+    QObject::disconnect(connection->threadFinished);
+    
+    const QString name = connection->database.connectionName();
+    connection->database.close();
+    for (const QString& fileName : qAsConst(connection->attachedFiles)) {
+        releasePartitionFile(fileName);
+    }
+    connection.reset();
+    QSqlDatabase::removeDatabase(name);
+}
+
+void SqliteRepository::detachStalePartitions(Connection& connection) const
+{
+    if (connection.attachedPartitions.isEmpty()) {
+        return;
+    }
+    
+    // Partitions removed by retention or clear() since this connection
+    // attached them, including days that have a new file by now
+    QList<qint64> staleDays;
+    {
+        QReadLocker locker(&m_stateLock);
+        for (qint64 day : qAsConst(connection.attachedPartitions)) {
+            if (m_partitions.value(day) != connection.attachedFiles.value(day)) {
+                staleDays.append(day);
+            }
+        }
+    }
+    
+    for (qint64 day : qAsConst(staleDays)) {
+        detachPartition(connection, day);
+    }
 }
 
 bool SqliteRepository::createTables()
 {
-    QSqlQuery query(m_database);
+    QSqlQuery query(m_writer.database);
+    
+    if (!query.exec("PRAGMA user_version") || !query.next()) {
+        qWarning() << "Failed to read schema version:" << query.lastError().text();
+        return false;
+    }
+    const int version = query.value(0).toInt();
+    query.finish();
+    
+    if (version > SCHEMA_VERSION) {
+        qWarning() << "Database schema version" << version << "is newer than supported version" << SCHEMA_VERSION;
+        return false;
+    }
+    
+    QString createTagsSQL = R"(
+        CREATE TABLE IF NOT EXISTS tags (
+            id INTEGER PRIMARY KEY,
+            name TEXT NOT NULL UNIQUE
+        )
+    )";
     
-    QString createTableSQL = R"(
-        CREATE TABLE IF NOT EXISTS datapoints (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            tag TEXT NOT NULL,
-            value TEXT NOT NULL,
-            timestamp INTEGER NOT NULL,
-            quality INTEGER NOT NULL
+    QString createPartitionsSQL = R"(
+        CREATE TABLE IF NOT EXISTS partitions (
+            day INTEGER PRIMARY KEY,
+            file TEXT NOT NULL
         )
     )";
     
-    if (!query.exec(createTableSQL)) {
-        qWarning() << "Failed to create datapoints table:" << query.lastError().text();
+    if (!query.exec(createTagsSQL) || !query.exec(createPartitionsSQL)) {
+        qWarning() << "Failed to create historian tables:" << query.lastError().text();
+        return false;
+    }
+    
+    if (!loadPartitions()) {
         return false;
     }
     
-    // Create indices for performance
-    query.exec("CREATE INDEX IF NOT EXISTS idx_tag ON datapoints(tag)");
-    query.exec("CREATE INDEX IF NOT EXISTS idx_timestamp ON datapoints(timestamp)");
-    query.exec("CREATE INDEX IF NOT EXISTS idx_tag_timestamp ON datapoints(tag, timestamp)");
+    if (version == SCHEMA_VERSION) {
+        return true;
+    }
+    
+    // Version 0 is either a fresh file or a legacy (v1) database without user_version
+    query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name IN ('datapoints', 'samples')");
+    QStringList existingTables;
+    while (query.next()) {
+        existingTables.append(query.value(0).toString());
+    }
+    query.finish();
+    
+    if (existingTables.contains("datapoints") && !migrateFromV1()) {
+        return false;
+    }
+    
+    if ((existingTables.contains("datapoints") || existingTables.contains("samples")) && !migrateToPartitions()) {
+        return false;
+    }
+    
+    if (!query.exec(QString("PRAGMA user_version = %1").arg(SCHEMA_VERSION))) {
+        qWarning() << "Failed to store schema version:" << query.lastError().text();
+        return false;
+    }
     
     return true;
 }
 
-Result<void> SqliteRepository::save(const DataPoint& entity)
+QString SqliteRepository::samplesTableSql(const QString& schema)
+{
+    return QString(R"(
+        CREATE TABLE IF NOT EXISTS "%1".samples (
+            tag_id INTEGER NOT NULL,
+            ts INTEGER NOT NULL,
+            value_real REAL,
+            value_int INTEGER,
+            value_text TEXT,
+            quality INTEGER NOT NULL,
+            PRIMARY KEY (tag_id, ts)
+        ) WITHOUT ROWID
+    )").arg(schema);
+}
+
+bool SqliteRepository::ensurePartitionSchema(QSqlDatabase& database, const QString& schema, bool maintainRollups)
+{
+    QSqlQuery query(database);
+    
+    // journal_mode is stored in the file, so this is a no-op after the first attach
+    if (!query.exec(QString("PRAGMA \"%1\".journal_mode = WAL").arg(schema))) {
+        qWarning() << "Failed to enable WAL journal on" << schema << ":" << query.lastError().text();
+    }
+    query.finish();
+    
+    // Bulk load: a missing rollups table makes the next regular attach backfill it
+    if (!maintainRollups) {
+        if (!query.exec(samplesTableSql(schema))
+            || !query.exec(QString("DROP TRIGGER IF EXISTS \"%1\".samples_rollup").arg(schema))
+            || !query.exec(QString("DROP TRIGGER IF EXISTS \"%1\".samples_rollup_update").arg(schema))
+            || !query.exec(QString("DROP TABLE IF EXISTS \"%1\".rollups").arg(schema))) {
+            qWarning() << "Failed to prepare partition" << schema << "for bulk load:" << query.lastError().text();
+            return false;
+        }
+        return true;
+    }
+    
+    // A changed sample (the upsert's update path) has its buckets recomputed
+    // from the samples, since min/max/first/last cannot be adjusted in place.
+    // The key cannot change, so OLD.ts is also the new sample's time.
+    QString createUpdateTriggerSQL = QString(R"(
+        CREATE TRIGGER IF NOT EXISTS "%1".samples_rollup_update AFTER UPDATE ON samples
+        BEGIN
+            DELETE FROM rollups
+            WHERE tag_id = OLD.tag_id AND bucket = OLD.ts - (OLD.ts % tier + tier) % tier;
+            INSERT INTO rollups (tier, tag_id, bucket, count, min, max, sum, first_ts, first, last_ts, last)
+            %2;
+        END
+    )").arg(schema, rollupRowsSql("samples",
+                                  "s.tag_id = OLD.tag_id"
+                                  " AND s.ts >= OLD.ts - (OLD.ts % t.width + t.width) % t.width"
+                                  " AND s.ts < OLD.ts - (OLD.ts % t.width + t.width) % t.width + t.width"));
+    
+    if (hasRollupsTable(database, schema)) {
+        // Partitions rolled up before changed samples were handled get the trigger now
+        if (!query.exec(createUpdateTriggerSQL)) {
+            qWarning() << "Failed to prepare partition" << schema << ":" << query.lastError().text();
+            return false;
+        }
+        return true;
+    }
+    
+    QString createRollupsSQL = QString(R"(
+        CREATE TABLE IF NOT EXISTS "%1".rollups (
+            tier INTEGER NOT NULL,
+            tag_id INTEGER NOT NULL,
+            bucket INTEGER NOT NULL,
+            count INTEGER NOT NULL,
+            min REAL NOT NULL,
+            max REAL NOT NULL,
+            sum REAL NOT NULL,
+            first_ts INTEGER NOT NULL,
+            first REAL NOT NULL,
+            last_ts INTEGER NOT NULL,
+            last REAL NOT NULL,
+            PRIMARY KEY (tier, tag_id, bucket)
+        ) WITHOUT ROWID
+    )").arg(schema);
+    
+    // Every SET expression sees the old row, so first/last compare against
+    // the previous first_ts/last_ts before those are updated
+    QString createTriggerSQL = QString(R"(
+        CREATE TRIGGER IF NOT EXISTS "%1".samples_rollup AFTER INSERT ON samples
+        WHEN NEW.value_real IS NOT NULL OR NEW.value_int IS NOT NULL
+        BEGIN
+            INSERT INTO rollups (tier, tag_id, bucket, count, min, max, sum, first_ts, first, last_ts, last)
+            SELECT t.width, NEW.tag_id, NEW.ts - (NEW.ts % t.width + t.width) % t.width,
+                   1, v.x, v.x, v.x, NEW.ts, v.x, NEW.ts, v.x
+            FROM %2 AS t, (SELECT COALESCE(NEW.value_real, NEW.value_int) AS x) AS v
+            WHERE 1
+            ON CONFLICT (tier, tag_id, bucket) DO UPDATE SET
+                count = count + 1,
+                min = MIN(min, excluded.min),
+                max = MAX(max, excluded.max),
+                sum = sum + excluded.sum,
+                first = CASE WHEN excluded.first_ts < first_ts THEN excluded.first ELSE first END,
+                first_ts = MIN(first_ts, excluded.first_ts),
+                last = CASE WHEN excluded.last_ts >= last_ts THEN excluded.last ELSE last END,
+                last_ts = MAX(last_ts, excluded.last_ts);
+        END
+    )").arg(schema, rollupTiersSql());
+    
+    // Backfill partitions written before rollups existed
+    QString backfillSQL = QString(R"(
+        INSERT OR REPLACE INTO "%1".rollups (tier, tag_id, bucket, count, min, max, sum, first_ts, first, last_ts, last)
+        %2
+    )").arg(schema, rollupRowsSql(QString("\"%1\".samples").arg(schema), "1"));
+    
+    if (!query.exec(samplesTableSql(schema)) || !query.exec(createRollupsSQL) || !query.exec(backfillSQL)
+        || !query.exec(createTriggerSQL) || !query.exec(createUpdateTriggerSQL)) {
+        qWarning() << "Failed to prepare partition" << schema << ":" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+bool SqliteRepository::rebuildRollups(QSqlDatabase& database, const QString& schema, qint64 tagId,
+                                      qint64 fromMs, qint64 toMs)
 {
-    QMutexLocker locker(&m_mutex);
+    // Left to the one-pass rebuild after a bulk load
+    if (!hasRollupsTable(database, schema)) {
+        return true;
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare(R"(
-        INSERT INTO datapoints (tag, value, timestamp, quality)
-        VALUES (:tag, :value, :timestamp, :quality)
-    )");
+    // Every bucket overlapping [fromMs, toMs], in each tier
+    const QString tagFilter = tagId >= 0 ? QString(" AND tag_id = %1").arg(tagId) : QString();
     
-    query.bindValue(":tag", entity.tag());
-    query.bindValue(":value", entity.value().toString());
-    query.bindValue(":timestamp", entity.timestamp().toSecsSinceEpoch());
-    query.bindValue(":quality", qualityToInt(entity.quality()));
+    QSqlQuery query(database);
+    query.prepare(QString(R"(
+        DELETE FROM "%1".rollups
+        WHERE bucket >= :from - (:from % tier + tier) % tier AND bucket <= :to - (:to % tier + tier) % tier %2
+    )").arg(schema, tagFilter));
+    query.bindValue(":from", fromMs);
+    query.bindValue(":to", toMs);
+    if (!query.exec()) {
+        qWarning() << "Failed to remove rollups of" << schema << ":" << query.lastError().text();
+        return false;
+    }
     
+    const QString filter = QString("s.ts >= :from - (:from % t.width + t.width) % t.width"
+                                   " AND s.ts < :to - (:to % t.width + t.width) % t.width + t.width%1")
+                               .arg(tagId >= 0 ? QString(" AND s.tag_id = %1").arg(tagId) : QString());
+    query.prepare(QString(R"(
+        INSERT INTO "%1".rollups (tier, tag_id, bucket, count, min, max, sum, first_ts, first, last_ts, last)
+        %2
+    )").arg(schema, rollupRowsSql(QString("\"%1\".samples").arg(schema), filter)));
+    query.bindValue(":from", fromMs);
+    query.bindValue(":to", toMs);
     if (!query.exec()) {
-        return Result<void>::failure(query.lastError().text());
+        qWarning() << "Failed to rebuild rollups of" << schema << ":" << query.lastError().text();
+        return false;
     }
     
-    return Result<void>::success();
+    return true;
 }
 
-Result<DataPoint> SqliteRepository::findById(const QString& id)
+bool SqliteRepository::migrateFromV1()
 {
-    QMutexLocker locker(&m_mutex);
+    qDebug() << "SqliteRepository: Migrating" << m_databasePath << "from schema v1 to v" << SCHEMA_VERSION;
     
-    QSqlQuery query(m_database);
-    query.prepare("SELECT tag, value, timestamp, quality FROM datapoints WHERE id = :id");
-    query.bindValue(":id", id.toInt());
+    if (!m_writer.database.transaction()) {
+        qWarning() << "Failed to begin migration:" << m_writer.database.lastError().text();
+        return false;
+    }
     
-    if (!query.exec()) {
-        return Result<DataPoint>::failure(query.lastError().text());
+    QSqlQuery query(m_writer.database);
+    bool ok = query.exec(samplesTableSql("main"))
+        && query.exec("INSERT OR IGNORE INTO tags (name) SELECT DISTINCT tag FROM datapoints");
+    
+    QHash<QString, qint64> tagIds;
+    if (ok) {
+        ok = query.exec("SELECT id, name FROM tags");
+        while (ok && query.next()) {
+            tagIds.insert(query.value(1).toString(), query.value(0).toLongLong());
+        }
     }
     
-    if (!query.next()) {
-        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    QSqlQuery source(m_writer.database);
+    source.setForwardOnly(true);
+    ok = ok && source.exec("SELECT tag, value, timestamp, quality FROM datapoints ORDER BY tag, timestamp, id");
+    
+    QSqlQuery insert(m_writer.database);
+    ok = ok && insert.prepare(QString("INSERT OR REPLACE INTO main.samples (%1) VALUES (?, ?, ?, ?, ?, ?)")
+                                  .arg(SAMPLE_COLUMNS));
+    
+    // v1 timestamps have second precision; spread rows that share a tag and
+    // second over consecutive milliseconds so the new primary key keeps them
+    QString previousTag;
+    qint64 previousSecs = 0;
+    int sameSecondCount = 0;
+    int migratedRows = 0;
+    
+    while (ok && source.next()) {
+        const QString tag = source.value(0).toString();
+        const QString text = source.value(1).toString();
+        const qint64 secs = source.value(2).toLongLong();
+        
+        if (tag == previousTag && secs == previousSecs) {
+            sameSecondCount = qMin(sameSecondCount + 1, 999);
+        } else {
+            sameSecondCount = 0;
+            previousTag = tag;
+            previousSecs = secs;
+        }
+        
+        // v1 stored QVariant::toString(); recover the numeric type where possible
+        bool isInt = false;
+        bool isReal = false;
+        const qlonglong intValue = text.toLongLong(&isInt);
+        const double realValue = isInt ? 0.0 : text.toDouble(&isReal);
+        
+        insert.addBindValue(tagIds.value(tag));
+        insert.addBindValue(secs * 1000 + sameSecondCount);
+        insert.addBindValue(isReal ? QVariant(realValue) : QVariant(QVariant::Double));
+        insert.addBindValue(isInt ? QVariant(intValue) : QVariant(QVariant::LongLong));
+        insert.addBindValue(isInt || isReal ? QVariant(QVariant::String) : QVariant(text));
+        insert.addBindValue(source.value(3).toInt());
+        
+        ok = insert.exec();
+        ++migratedRows;
+    }
+    
+    if (ok) {
+        source.finish();
+        ok = query.exec("DROP TABLE datapoints");
     }
     
-    QString tag = query.value(0).toString();
-    QVariant value = query.value(1);
-    QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-    DataPoint::Quality quality = intToQuality(query.value(3).toInt());
+    if (!ok || !m_writer.database.commit()) {
+        qWarning() << "Schema migration failed:" << insert.lastError().text() << query.lastError().text()
+                   << m_writer.database.lastError().text();
+        m_writer.database.rollback();
+        return false;
+    }
     
-    return Result<DataPoint>::success(DataPoint(tag, value, timestamp, quality));
+    qDebug() << "SqliteRepository: Migrated" << migratedRows << "rows," << tagIds.size() << "tags";
+    return true;
 }
 
-Result<QList<DataPoint>> SqliteRepository::findAll()
+bool SqliteRepository::migrateToPartitions()
 {
-    QMutexLocker locker(&m_mutex);
+    qDebug() << "SqliteRepository: Moving samples of" << m_databasePath << "into daily partitions";
+    
+    QSqlQuery query(m_writer.database);
+    query.setForwardOnly(true);
+    if (!query.exec(QString("SELECT DISTINCT ts / %1 - (ts < 0 AND ts % %1 != 0) FROM main.samples")
+                        .arg(MSECS_PER_DAY))) {
+        qWarning() << "Failed to enumerate days:" << query.lastError().text();
+        return false;
+    }
+    
+    QList<qint64> days;
+    while (query.next()) {
+        days.append(query.value(0).toLongLong());
+    }
+    query.finish();
+    
+    // ATTACH is not allowed inside a transaction, so each day is copied on
+    // its own; the upsert makes a repeated (interrupted) run harmless
+    for (qint64 day : days) {
+        const QString schema = attachPartition(m_writer, day, true);
+        if (schema.isEmpty()) {
+            return false;
+        }
+        
+        QSqlQuery copy(m_writer.database);
+        copy.prepare(QString(R"(
+            INSERT INTO "%1".samples (%2)
+            SELECT %2 FROM main.samples
+            WHERE tag_id IN (SELECT id FROM main.tags) AND ts >= :start AND ts < :end
+            %3
+        )").arg(schema, SAMPLE_COLUMNS, UPSERT_SAMPLE));
+        copy.bindValue(":start", day * MSECS_PER_DAY);
+        copy.bindValue(":end", (day + 1) * MSECS_PER_DAY);
+        
+        if (!copy.exec()) {
+            qWarning() << "Failed to migrate partition" << schema << ":" << copy.lastError().text();
+            return false;
+        }
+    }
+    
+    if (!query.exec("DROP TABLE main.samples")) {
+        qWarning() << "Failed to drop migrated samples table:" << query.lastError().text();
+        return false;
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare("SELECT tag, value, timestamp, quality FROM datapoints ORDER BY timestamp DESC");
+    // Reclaim the space of the migrated tables and their indices
+    if (!query.exec("VACUUM main")) {
+        qWarning() << "VACUUM after migration failed:" << query.lastError().text();
+    }
     
+    qDebug() << "SqliteRepository: Migrated samples into" << days.size() << "partitions";
+    return true;
+}
+
+bool SqliteRepository::loadPartitions()
+{
+    QSqlQuery query(m_writer.database);
+    if (!query.exec("SELECT day, file FROM partitions")) {
+        qWarning() << "Failed to load partition manifest:" << query.lastError().text();
+        return false;
+    }
+    
+    QWriteLocker locker(&m_stateLock);
+    m_partitions.clear();
+    while (query.next()) {
+        m_partitions.insert(query.value(0).toLongLong(), query.value(1).toString());
+    }
+    
+    // Files of removed partitions that could not be deleted at the time
+    const QSet<QString> listed(m_partitions.cbegin(), m_partitions.cend());
+    const QStringList files = QDir(partitionDirectory()).entryList(QStringList() << "*.db" << "*.db-*",
+                                                                   QDir::Files);
+    QSet<QString> orphans;
+    for (const QString& file : files) {
+        const QString fileName = file.left(file.lastIndexOf(".db") + 3);
+        if (!listed.contains(fileName) && !m_attachCounts.contains(fileName)) {
+            orphans.insert(fileName);
+        }
+    }
+    for (const QString& fileName : qAsConst(orphans)) {
+        removePartitionFiles(fileName);
+    }
+    
+    return true;
+}
+
+QString SqliteRepository::newPartitionFile(qint64 day) const
+{
+    // A removed partition of the same day may still be on disk until every
+    // connection has detached it
+    const QString date = QDateTime::fromMSecsSinceEpoch(day * MSECS_PER_DAY, Qt::UTC).toString("yyyy-MM-dd");
+    const QDir directory(partitionDirectory());
+    QString fileName = date + ".db";
+    for (int generation = 1; directory.exists(fileName); ++generation) {
+        fileName = QString("%1.%2.db").arg(date).arg(generation);
+    }
+    return fileName;
+}
+
+void SqliteRepository::releasePartitionFile(const QString& fileName) const
+{
+    {
+        QWriteLocker locker(&m_stateLock);
+        auto it = m_attachCounts.find(fileName);
+        if (it == m_attachCounts.end() || --it.value() > 0) {
+            return;
+        }
+        m_attachCounts.erase(it);
+        if (!m_retiredPartitions.remove(fileName)) {
+            return;
+        }
+    }
+    removePartitionFiles(fileName);
+}
+
+void SqliteRepository::retirePartitionFile(const QString& fileName) const
+{
+    {
+        QWriteLocker locker(&m_stateLock);
+        if (m_attachCounts.value(fileName) > 0) {
+            m_retiredPartitions.insert(fileName);
+            return;
+        }
+    }
+    removePartitionFiles(fileName);
+}
+
+void SqliteRepository::removePartitionFiles(const QString& fileName) const
+{
+    const QDir directory(partitionDirectory());
+    for (const char* suffix : {"", "-journal", "-wal", "-shm"}) {
+        const QString path = directory.filePath(fileName + suffix);
+        if (QFile::exists(path) && !QFile::remove(path)) {
+            qWarning() << "Failed to remove partition file" << path << "(removed at the next start)";
+        }
+    }
+}
+
+QString SqliteRepository::partitionDirectory() const
+{
+    const QFileInfo info(m_databasePath);
+    return info.absoluteDir().filePath(info.fileName() + ".partitions");
+}
+
+QString SqliteRepository::spoolPath() const
+{
+    return m_databasePath + ".spool";
+}
+
+qint64 SqliteRepository::dayOf(qint64 msecsSinceEpoch)
+{
+    // Floor division so timestamps before 1970 land in the correct day
+    qint64 day = msecsSinceEpoch / MSECS_PER_DAY;
+    if (msecsSinceEpoch < 0 && msecsSinceEpoch % MSECS_PER_DAY != 0) {
+        --day;
+    }
+    return day;
+}
+
+QString SqliteRepository::partitionSchema(qint64 day)
+{
+    return "p" + QDateTime::fromMSecsSinceEpoch(day * MSECS_PER_DAY, Qt::UTC).toString("yyyyMMdd");
+}
+
+QString SqliteRepository::attachPartition(Connection& connection, qint64 day, bool create) const
+{
+    const QString schema = partitionSchema(day);
+    
+    const int attachedIndex = connection.attachedPartitions.indexOf(day);
+    if (attachedIndex >= 0) {
+        connection.attachedPartitions.move(attachedIndex, connection.attachedPartitions.size() - 1);
+        return schema;
+    }
+    
+    // The reference is taken with the lookup, so the file cannot be
+    // deleted between the two
+    QString fileName;
+    {
+        QWriteLocker locker(&m_stateLock);
+        fileName = m_partitions.value(day);
+        if (!fileName.isEmpty()) {
+            ++m_attachCounts[fileName];
+        }
+    }
+    
+    const bool exists = !fileName.isEmpty();
+    if (!exists && !create) {
+        return QString();
+    }
+    
+    while (connection.attachedPartitions.size() >= MAX_ATTACHED_PARTITIONS) {
+        detachPartition(connection, connection.attachedPartitions.first());
+    }
+    
+    if (!QDir().mkpath(partitionDirectory())) {
+        qWarning() << "Failed to create partition directory" << partitionDirectory();
+        if (exists) {
+            releasePartitionFile(fileName);
+        }
+        return QString();
+    }
+    
+    if (!exists) {
+        // Only the writer creates partitions
+        fileName = newPartitionFile(day);
+        QWriteLocker locker(&m_stateLock);
+        ++m_attachCounts[fileName];
+    }
+    
+    QSqlQuery query(connection.database);
+    query.prepare(QString("ATTACH DATABASE :file AS \"%1\"").arg(schema));
+    query.bindValue(":file", QDir(partitionDirectory()).filePath(fileName));
     if (!query.exec()) {
-        return Result<QList<DataPoint>>::failure(query.lastError().text());
+        qWarning() << "Failed to attach partition" << fileName << ":" << query.lastError().text();
+        releasePartitionFile(fileName);
+        return QString();
+    }
+    connection.attachedPartitions.append(day);
+    connection.attachedFiles.insert(day, fileName);
+    
+    if (&connection == &m_writer) {
+        if (!ensurePartitionSchema(connection.database, schema, !m_bulkLoad)) {
+            detachPartition(connection, day);
+            return QString();
+        }
+    } else if (!m_bulkLoad) {
+        // Only the writer changes the schema: have it backfill the rollups
+        // of a partition that predates them or was left by a bulk load
+        if (!hasRollupsTable(connection.database, schema)) {
+            onWriterThread([this, day]() {
+                QMutexLocker locker(&m_writeMutex);
+                return !attachPartition(m_writer, day, false).isEmpty();
+            });
+        }
+    }
+    
+    if (!exists) {
+        QSqlQuery manifest(connection.database);
+        manifest.prepare("INSERT OR REPLACE INTO main.partitions (day, file) VALUES (:day, :file)");
+        manifest.bindValue(":day", day);
+        manifest.bindValue(":file", fileName);
+        
+        if (!manifest.exec()) {
+            qWarning() << "Failed to register partition" << fileName << ":" << manifest.lastError().text();
+            detachPartition(connection, day);
+            return QString();
+        }
+        
+        QWriteLocker locker(&m_stateLock);
+        m_partitions.insert(day, fileName);
+    }
+    
+    return schema;
+}
+
+void SqliteRepository::detachPartition(Connection& connection, qint64 day) const
+{
+    if (!connection.attachedPartitions.removeOne(day)) {
+        return;
+    }
+    
+    // A file that failed to detach keeps its reference and is not deleted
+    const QString fileName = connection.attachedFiles.take(day);
+    QSqlQuery query(connection.database);
+    if (!query.exec(QString("DETACH DATABASE \"%1\"").arg(partitionSchema(day)))) {
+        qWarning() << "Failed to detach partition" << partitionSchema(day) << ":" << query.lastError().text();
+        return;
+    }
+    releasePartitionFile(fileName);
+}
+
+QList<qint64> SqliteRepository::partitionsInRange(qint64 startMs, qint64 endMs) const
+{
+    QList<qint64> days;
+    if (startMs > endMs) {
+        return days;
     }
     
+    const qint64 firstDay = dayOf(startMs);
+    const qint64 lastDay = dayOf(endMs);
+    
+    QReadLocker locker(&m_stateLock);
+    auto it = m_partitions.upperBound(lastDay);
+    while (it != m_partitions.constBegin()) {
+        --it;
+        if (it.key() < firstDay) {
+            break;
+        }
+        days.append(it.key());
+    }
+    
+    return days;
+}
+
+Result<QList<DataPoint>> SqliteRepository::queryPartitions(Connection& connection,
+                                                           const QList<qint64>& days,
+                                                           const QString& whereClause,
+                                                           const QVariantMap& bindings,
+                                                           int limit) const
+{
     QList<DataPoint> dataPoints;
-    while (query.next()) {
-        QString tag = query.value(0).toString();
-        QVariant value = query.value(1);
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-        DataPoint::Quality quality = intToQuality(query.value(3).toInt());
+    const QHash<qint64, QString> tagNames = tagNamesSnapshot();
+    
+    for (qint64 day : days) {
+        const QString schema = attachPartition(connection, day, false);
+        if (schema.isEmpty()) {
+            // Removed by retention since the day list was taken
+            continue;
+        }
         
-        dataPoints.append(DataPoint(tag, value, timestamp, quality));
+        QString sql = QString("SELECT %1 FROM \"%2\".samples WHERE %3 ORDER BY ts DESC")
+                          .arg(SAMPLE_COLUMNS, schema, whereClause);
+        if (limit >= 0) {
+            sql += QString(" LIMIT %1").arg(limit - dataPoints.size());
+        }
+        
+        QSqlQuery query(connection.database);
+        query.setForwardOnly(true);
+        query.prepare(sql);
+        for (auto it = bindings.constBegin(); it != bindings.constEnd(); ++it) {
+            query.bindValue(it.key(), it.value());
+        }
+        
+        if (!query.exec()) {
+            return Result<QList<DataPoint>>::failure(query.lastError().text());
+        }
+        
+        while (query.next()) {
+            dataPoints.append(HistorianCursor::readSample(query, tagNames.value(query.value(0).toLongLong())));
+        }
+        
+        if (limit >= 0 && dataPoints.size() >= limit) {
+            break;
+        }
     }
     
     return Result<QList<DataPoint>>::success(dataPoints);
 }
 
-Result<void> SqliteRepository::deleteById(const QString& id)
+bool SqliteRepository::parseId(const QString& id, qint64& tagIdOut, qint64& tsOut) const
 {
-    QMutexLocker locker(&m_mutex);
+    const int separator = id.lastIndexOf(QLatin1Char('@'));
+    if (separator <= 0) {
+        return false;
+    }
+    
+    bool validTimestamp = false;
+    tsOut = id.mid(separator + 1).toLongLong(&validTimestamp);
+    if (!validTimestamp) {
+        return false;
+    }
+    
+    tagIdOut = lookupTagId(id.left(separator));
+    return tagIdOut >= 0;
+}
+
+bool SqliteRepository::loadTags()
+{
+    QSqlQuery query(m_writer.database);
+    if (!query.exec("SELECT id, name FROM tags")) {
+        qWarning() << "Failed to load tag dictionary:" << query.lastError().text();
+        return false;
+    }
+    
+    QWriteLocker locker(&m_stateLock);
+    m_tagIds.clear();
+    m_tagNames.clear();
+    while (query.next()) {
+        const qint64 id = query.value(0).toLongLong();
+        const QString name = query.value(1).toString();
+        m_tagIds.insert(name, id);
+        m_tagNames.insert(id, name);
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare("DELETE FROM datapoints WHERE id = :id");
-    query.bindValue(":id", id.toInt());
+    return true;
+}
+
+qint64 SqliteRepository::lookupTagId(const QString& tag) const
+{
+    QReadLocker locker(&m_stateLock);
+    return m_tagIds.value(tag, -1);
+}
+
+qint64 SqliteRepository::registerTag(const QString& tag)
+{
+    const qint64 existing = lookupTagId(tag);
+    if (existing >= 0) {
+        return existing;
+    }
     
+    QSqlQuery query(m_writer.database);
+    query.prepare("INSERT INTO tags (name) VALUES (:name)");
+    query.bindValue(":name", tag);
     if (!query.exec()) {
-        return Result<void>::failure(query.lastError().text());
+        qWarning() << "Failed to register tag" << tag << ":" << query.lastError().text();
+        return -1;
     }
     
-    return Result<void>::success();
+    const qint64 id = query.lastInsertId().toLongLong();
+    
+    QWriteLocker locker(&m_stateLock);
+    m_tagIds.insert(tag, id);
+    m_tagNames.insert(id, tag);
+    return id;
 }
 
-int SqliteRepository::count() const
+void SqliteRepository::loadLatestValues()
 {
-    QMutexLocker locker(&m_mutex);
+    const QHash<qint64, QString> tagNames = tagNamesSnapshot();
+    QHash<qint64, DataPoint> latest;
+    bool complete = true;
+    
+    // Newest partition first: a tag's latest sample is in the first partition
+    // that has any sample of it, so older partitions are only visited for
+    // tags that have not been written to recently
+    for (qint64 day : partitionsInRange(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max())) {
+        if (latest.size() >= tagNames.size()) {
+            break;
+        }
+        
+        const QString schema = attachPartition(m_writer, day, false);
+        if (schema.isEmpty()) {
+            continue;
+        }
+        
+        // SQLite returns the other columns from the row holding MAX(ts)
+        QSqlQuery query(m_writer.database);
+        query.setForwardOnly(true);
+        if (!query.exec(QString("SELECT tag_id, MAX(ts), value_real, value_int, value_text, quality "
+                                "FROM \"%1\".samples GROUP BY tag_id").arg(schema))) {
+            qWarning() << "Failed to load latest values from" << schema << ":" << query.lastError().text();
+            complete = false;
+            break;
+        }
+        
+        while (query.next()) {
+            const qint64 id = query.value(0).toLongLong();
+            if (!latest.contains(id)) {
+                latest.insert(id, HistorianCursor::readSample(query, tagNames.value(id)));
+            }
+        }
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare("SELECT COUNT(*) FROM datapoints");
+    QWriteLocker locker(&m_latestLock);
+    m_latest = latest;
+    m_latestUnknown.clear();
+    if (!complete) {
+        // Fall back to per-tag lookups for everything not loaded
+        for (auto it = tagNames.constBegin(); it != tagNames.constEnd(); ++it) {
+            if (!m_latest.contains(it.key())) {
+                m_latestUnknown.insert(it.key());
+            }
+        }
+    }
+}
+
+void SqliteRepository::updateLatest(qint64 tagId, const DataPoint& point)
+{
+    QWriteLocker locker(&m_latestLock);
     
-    if (!query.exec() || !query.next()) {
-        return 0;
+    if (m_latestUnknown.contains(tagId)) {
+        return;
     }
     
-    return query.value(0).toInt();
+    auto it = m_latest.find(tagId);
+    if (it == m_latest.end()) {
+        m_latest.insert(tagId, point);
+    } else if (point.timestamp() >= it->timestamp()) {
+        *it = point;
+    }
 }
 
-Result<void> SqliteRepository::clear()
+QHash<qint64, QString> SqliteRepository::tagNamesSnapshot() const
+{
+    QReadLocker locker(&m_stateLock);
+    return m_tagNames;
+}
+
+QString SqliteRepository::makeId(const QString& tag, const QDateTime& timestamp)
+{
+    return tag + QLatin1Char('@') + QString::number(timestamp.toMSecsSinceEpoch());
+}
+
+void SqliteRepository::bindValue(QSqlQuery& query, const QVariant& value)
 {
-    QMutexLocker locker(&m_mutex);
+    const int type = value.userType();
     
-    QSqlQuery query(m_database);
-    if (!query.exec("DELETE FROM datapoints")) {
-        return Result<void>::failure(query.lastError().text());
+    if (isIntegralType(type)) {
+        query.bindValue(":value_real", QVariant(QVariant::Double));
+        query.bindValue(":value_int", value.toLongLong());
+        query.bindValue(":value_text", QVariant(QVariant::String));
+        return;
+    }
+    
+    bool isReal = false;
+    const double realValue = value.toDouble(&isReal);
+    query.bindValue(":value_real", isReal ? QVariant(realValue) : QVariant(QVariant::Double));
+    query.bindValue(":value_int", QVariant(QVariant::LongLong));
+    query.bindValue(":value_text", isReal ? QVariant(QVariant::String) : QVariant(value.toString()));
+}
+
+Result<void> SqliteRepository::save(const DataPoint& entity)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+        return store({entity});
+    });
+}
+
+Result<void> SqliteRepository::saveAll(const QList<DataPoint>& entities)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+        return store(entities);
+    });
+}
+
+Result<void> SqliteRepository::store(const QList<DataPoint>& entities)
+{
+    if (m_spool && m_spool->depth() > 0) {
+        if (!m_spoolRetry.isValid() || m_spoolRetry.hasExpired(SPOOL_RETRY_MS)) {
+            drainSpoolLocked(-1);
+        }
+        
+        // Queue behind the spooled samples so replay keeps arrival order
+        if (m_spool->depth() > 0) {
+            return spool(entities, m_spoolStats.lastError);
+        }
+    }
+    
+    QList<DataPoint> uncommitted;
+    Result<void> result = writeSamples(entities, uncommitted);
+    if (result.isFailure() && openSpool()) {
+        qWarning() << "SqliteRepository: Write failed, spooling" << uncommitted.size()
+                   << "samples:" << result.error();
+        m_spoolStats.lastError = result.error();
+        m_spoolRetry.start();
+        return spool(uncommitted, result.error());
+    }
+    return result;
+}
+
+Result<void> SqliteRepository::writeSamples(const QList<DataPoint>& entities, QList<DataPoint>& uncommitted)
+{
+    // ATTACH is not allowed inside a transaction, so rows are grouped by
+    // partition and each partition is written in its own transaction
+    QMap<qint64, QList<int>> rowsByDay;
+    QVector<qint64> tagIds(entities.size());
+    for (int i = 0; i < entities.size(); ++i) {
+        tagIds[i] = registerTag(entities.at(i).tag());
+        if (tagIds[i] < 0) {
+            uncommitted = entities;
+            return Result<void>::failure("Failed to register tag: " + entities.at(i).tag());
+        }
+        rowsByDay[dayOf(entities.at(i).timestamp().toMSecsSinceEpoch())].append(i);
+    }
+    
+    // Rows of the failing partition and of all later ones are reported back
+    auto collectUncommitted = [&](QMap<qint64, QList<int>>::const_iterator from) {
+        for (auto it = from; it != rowsByDay.constEnd(); ++it) {
+            for (int row : it.value()) {
+                uncommitted.append(entities.at(row));
+            }
+        }
+    };
+    
+    for (auto it = rowsByDay.constBegin(); it != rowsByDay.constEnd(); ++it) {
+        const QString schema = attachPartition(m_writer, it.key(), true);
+        if (schema.isEmpty()) {
+            collectUncommitted(it);
+            return Result<void>::failure("Failed to open partition " + partitionSchema(it.key()));
+        }
+        
+        if (!m_writer.database.transaction()) {
+            collectUncommitted(it);
+            return Result<void>::failure(m_writer.database.lastError().text());
+        }
+        
+        // Rewriting an identical sample (e.g. a replayed spool batch) is
+        // skipped and a changed one updated, so each sample is rolled up once
+        QSqlQuery query(m_writer.database);
+        bool ok = query.prepare(QString(R"(
+            INSERT INTO "%1".samples (tag_id, ts, value_real, value_int, value_text, quality)
+            VALUES (:tag_id, :ts, :value_real, :value_int, :value_text, :quality)
+            %2
+        )").arg(schema, UPSERT_SAMPLE));
+        
+        for (int row : it.value()) {
+            if (!ok) {
+                break;
+            }
+            const DataPoint& entity = entities.at(row);
+            query.bindValue(":tag_id", tagIds.at(row));
+            query.bindValue(":ts", entity.timestamp().toMSecsSinceEpoch());
+            bindValue(query, entity.value());
+            query.bindValue(":quality", qualityToInt(entity.quality()));
+            ok = query.exec();
+        }
+        
+        if (!ok || !m_writer.database.commit()) {
+            const QString error = query.lastError().isValid() ? query.lastError().text()
+                                                              : m_writer.database.lastError().text();
+            m_writer.database.rollback();
+            collectUncommitted(it);
+            return Result<void>::failure(error);
+        }
+        
+        for (int row : it.value()) {
+            updateLatest(tagIds.at(row), entities.at(row));
+        }
     }
     
     return Result<void>::success();
 }
 
-Result<QList<DataPoint>> SqliteRepository::findByTag(const QString& tag)
+Result<void> SqliteRepository::spool(const QList<DataPoint>& entities, const QString& reason)
 {
-    QMutexLocker locker(&m_mutex);
+    Result<void> appended = m_spool->append(entities);
+    if (appended.isFailure()) {
+        m_spoolStats.droppedTotal += entities.size();
+        return Result<void>::failure(reason + " (" + appended.error() + ")");
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare("SELECT tag, value, timestamp, quality FROM datapoints WHERE tag = :tag ORDER BY timestamp DESC");
-    query.bindValue(":tag", tag);
+    m_spoolStats.spooledTotal += entities.size();
+    return Result<void>::success();
+}
+
+bool SqliteRepository::openSpool()
+{
+    if (!m_spool) {
+        m_spool.reset(new HistorianSpool(spoolPath()));
+    }
+    if (!m_spool->isOpen()) {
+        // Try again on the next failed write
+        m_spool.reset();
+        return false;
+    }
+    return true;
+}
+
+Result<int> SqliteRepository::drainSpool(int maxSamples)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+        return drainSpoolLocked(maxSamples);
+    });
+}
+
+Result<int> SqliteRepository::drainSpoolLocked(int maxSamples)
+{
+    if (!m_spool) {
+        return Result<int>::success(0);
+    }
     
-    if (!query.exec()) {
-        return Result<QList<DataPoint>>::failure(query.lastError().text());
+    QElapsedTimer elapsed;
+    elapsed.start();
+    int drained = 0;
+    Result<int> result = Result<int>::success(0);
+    
+    while (m_spool->depth() > 0 && (maxSamples < 0 || drained < maxSamples)) {
+        int batchSize = SPOOL_DRAIN_BATCH;
+        if (maxSamples >= 0) {
+            batchSize = qMin(batchSize, maxSamples - drained);
+        }
+        
+        // A batch that fails part way stays spooled as a whole; its
+        // committed rows are simply replaced when it is replayed
+        const QList<DataPoint> batch = m_spool->peek(batchSize);
+        QList<DataPoint> uncommitted;
+        Result<void> written = writeSamples(batch, uncommitted);
+        if (written.isFailure()) {
+            m_spoolStats.lastError = written.error();
+            m_spoolRetry.start();
+            result = Result<int>::failure(written.error());
+            break;
+        }
+        
+        m_spool->consume(batch.size());
+        drained += batch.size();
     }
     
-    QList<DataPoint> dataPoints;
-    while (query.next()) {
-        QString resultTag = query.value(0).toString();
-        QVariant value = query.value(1);
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-        DataPoint::Quality quality = intToQuality(query.value(3).toInt());
+    if (drained > 0) {
+        m_spoolStats.drainedTotal += drained;
+        m_spoolStats.drainRate = drained * 1000.0 / qMax<qint64>(1, elapsed.elapsed());
+        if (m_spool->depth() == 0) {
+            qDebug() << "SqliteRepository: Spool drained," << m_spoolStats.drainedTotal << "samples replayed so far";
+            m_spoolRetry.invalidate();
+        }
+    }
+    
+    return result.isFailure() ? result : Result<int>::success(drained);
+}
+
+SpoolMetrics SqliteRepository::spoolMetrics() const
+{
+    QMutexLocker locker(&m_writeMutex);
+    
+    SpoolMetrics metrics = m_spoolStats;
+    if (m_spool) {
+        metrics.depth = m_spool->depth();
+        metrics.usedBytes = m_spool->usedBytes();
+        metrics.capacityBytes = m_spool->capacityBytes();
+    }
+    return metrics;
+}
+
+void SqliteRepository::beginBulkLoad()
+{
+    onWriterThread([this]() {
+        QMutexLocker locker(&m_writeMutex);
+    
+        // Partitions attached from now on drop their rollup trigger
+        while (!m_writer.attachedPartitions.isEmpty()) {
+            detachPartition(m_writer, m_writer.attachedPartitions.first());
+        }
+        m_bulkLoad = true;
+        return true;
+    });
+}
+
+Result<void> SqliteRepository::endBulkLoad()
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+    
+        while (!m_writer.attachedPartitions.isEmpty()) {
+            detachPartition(m_writer, m_writer.attachedPartitions.first());
+        }
+        m_bulkLoad = false;
+    
+        // Attaching backfills the rollups of every partition that lacks them;
+        // partitions that kept theirs only cost a catalog lookup
+        QList<qint64> days;
+        {
+            QReadLocker stateLocker(&m_stateLock);
+            days = m_partitions.keys();
+        }
+        for (qint64 day : qAsConst(days)) {
+            if (attachPartition(m_writer, day, false).isEmpty()) {
+                return Result<void>::failure("Failed to rebuild rollups of " + partitionSchema(day));
+            }
+        }
+    
+        return Result<void>::success();
+    });
+}
+
+Result<void> SqliteRepository::importSamples(const QList<DataPoint>& entities)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+    
+        QList<DataPoint> uncommitted;
+        return writeSamples(entities, uncommitted);
+    });
+}
+
+Result<DataPoint> SqliteRepository::findById(const QString& id)
+{
+    qint64 tag = -1;
+    qint64 ts = 0;
+    if (!parseId(id, tag, ts)) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    QVariantMap bindings;
+    bindings.insert(":tag_id", tag);
+    bindings.insert(":ts", ts);
+    
+    auto result = queryPartitions(reader(), partitionsInRange(ts, ts), "tag_id = :tag_id AND ts = :ts", bindings, 1);
+    if (result.isFailure()) {
+        return Result<DataPoint>::failure(result.error());
+    }
+    
+    if (result.value().isEmpty()) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    return Result<DataPoint>::success(result.value().first());
+}
+
+Result<QList<DataPoint>> SqliteRepository::findAll()
+{
+    return drainCursor(*openCursor(QString()));
+}
+
+Result<void> SqliteRepository::deleteById(const QString& id)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+    
+        qint64 tag = -1;
+        qint64 ts = 0;
+        const QString schema = parseId(id, tag, ts) ? attachPartition(m_writer, dayOf(ts), false) : QString();
+    
+        if (schema.isEmpty()) {
+            // Nothing stored under this ID - deleting is a no-op, as before
+            return Result<void>::success();
+        }
+        
+        QSqlQuery query(m_writer.database);
+        query.prepare(QString("DELETE FROM \"%1\".samples WHERE tag_id = :tag_id AND ts = :ts").arg(schema));
+        query.bindValue(":tag_id", tag);
+        query.bindValue(":ts", ts);
+        
+        if (!query.exec()) {
+            return Result<void>::failure(query.lastError().text());
+        }
+        if (query.numRowsAffected() > 0 && !rebuildRollups(m_writer.database, schema, tag, ts, ts)) {
+            return Result<void>::failure("Failed to update rollups of " + schema);
+        }
+        
+        // The tag's previous sample becomes the latest; find it on next lookup
+        QWriteLocker latestLocker(&m_latestLock);
+        auto latest = m_latest.find(tag);
+        if (latest != m_latest.end() && latest->timestamp().toMSecsSinceEpoch() == ts) {
+            m_latest.erase(latest);
+            m_latestUnknown.insert(tag);
+        }
+        
+        return Result<void>::success();
+    });
+}
+
+int SqliteRepository::count() const
+{
+    Connection& connection = reader();
+    
+    int total = 0;
+    for (qint64 day : partitionsInRange(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max())) {
+        const QString schema = attachPartition(connection, day, false);
         
-        dataPoints.append(DataPoint(resultTag, value, timestamp, quality));
+        QSqlQuery query(connection.database);
+        if (schema.isEmpty() || !query.exec(QString("SELECT COUNT(*) FROM \"%1\".samples").arg(schema))
+            || !query.next()) {
+            continue;
+        }
+        total += query.value(0).toInt();
     }
     
-    return Result<QList<DataPoint>>::success(dataPoints);
+    return total;
 }
 
-Result<QList<DataPoint>> SqliteRepository::findByTimeRange(const QDateTime& startTime, const QDateTime& endTime)
+Result<void> SqliteRepository::clear()
 {
-    QMutexLocker locker(&m_mutex);
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
     
-    QSqlQuery query(m_database);
-    query.prepare(R"(
-        SELECT tag, value, timestamp, quality 
-        FROM datapoints 
-        WHERE timestamp >= :start AND timestamp <= :end 
-        ORDER BY timestamp DESC
-    )");
-    query.bindValue(":start", startTime.toSecsSinceEpoch());
-    query.bindValue(":end", endTime.toSecsSinceEpoch());
+        while (!m_writer.attachedPartitions.isEmpty()) {
+            detachPartition(m_writer, m_writer.attachedPartitions.first());
+        }
     
-    if (!query.exec()) {
-        return Result<QList<DataPoint>>::failure(query.lastError().text());
+        QSqlQuery query(m_writer.database);
+        if (!query.exec("DELETE FROM partitions")) {
+            return Result<void>::failure(query.lastError().text());
+        }
+    
+        // Readers detach the removed partitions on their next query; each
+        // file is deleted once the last connection has let go of it
+        QMap<qint64, QString> removed;
+        {
+            QWriteLocker stateLocker(&m_stateLock);
+            removed.swap(m_partitions);
+        }
+    
+        {
+            QWriteLocker latestLocker(&m_latestLock);
+            m_latest.clear();
+            m_latestUnknown.clear();
+        }
+    
+        // Spooled samples would otherwise reappear on the next write
+        if (m_spool) {
+            m_spool->consume(m_spool->depth());
+        }
+    
+        for (const QString& fileName : qAsConst(removed)) {
+            retirePartitionFile(fileName);
+        }
+    
+        return Result<void>::success();
+    });
+}
+
+std::unique_ptr<HistorianCursor> SqliteRepository::openCursor(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime,
+    int pageSize,
+    bool oldestFirst)
+{
+    HistorianCursor::Query query;
+    query.oldestFirst = oldestFirst;
+    if (startTime.isValid()) {
+        query.startMs = startTime.toMSecsSinceEpoch();
+    }
+    if (endTime.isValid()) {
+        query.endMs = endTime.toMSecsSinceEpoch();
     }
     
-    QList<DataPoint> dataPoints;
-    while (query.next()) {
-        QString tag = query.value(0).toString();
-        QVariant value = query.value(1);
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-        DataPoint::Quality quality = intToQuality(query.value(3).toInt());
+    QList<QPair<qint64, QString>> partitionFiles;
+    if (!tag.isEmpty()) {
+        query.tagId = lookupTagId(tag);
+    }
+    
+    // An unknown tag yields a cursor without partitions, i.e. an empty result
+    if (tag.isEmpty() || query.tagId >= 0) {
+        const QList<qint64> days = partitionsInRange(query.startMs, query.endMs);
+        const QDir directory(partitionDirectory());
         
-        dataPoints.append(DataPoint(tag, value, timestamp, quality));
+        QReadLocker locker(&m_stateLock);
+        for (qint64 day : days) {
+            const auto file = qMakePair(day, directory.filePath(m_partitions.value(day)));
+            if (oldestFirst) {
+                partitionFiles.prepend(file);
+            } else {
+                partitionFiles.append(file);
+            }
+        }
+    }
+    
+    return std::unique_ptr<HistorianCursor>(
+        new HistorianCursor(m_databasePath, partitionFiles, tagNamesSnapshot(), query, pageSize));
+}
+
+Result<QList<DataPoint>> SqliteRepository::drainCursor(HistorianCursor& cursor)
+{
+    QList<DataPoint> dataPoints;
+    
+    while (!cursor.atEnd()) {
+        auto page = cursor.fetchNext();
+        if (page.isFailure()) {
+            return page;
+        }
+        dataPoints.append(page.value());
     }
     
     return Result<QList<DataPoint>>::success(dataPoints);
 }
 
+Result<QList<DataPoint>> SqliteRepository::findByTag(const QString& tag)
+{
+    if (tag.isEmpty()) {
+        return Result<QList<DataPoint>>::success(QList<DataPoint>());
+    }
+    
+    return drainCursor(*openCursor(tag));
+}
+
+Result<QList<DataPoint>> SqliteRepository::findByTimeRange(const QDateTime& startTime, const QDateTime& endTime)
+{
+    return drainCursor(*openCursor(QString(), startTime, endTime));
+}
+
 Result<QList<DataPoint>> SqliteRepository::findByTagAndTimeRange(
     const QString& tag,
     const QDateTime& startTime,
     const QDateTime& endTime)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    QSqlQuery query(m_database);
-    query.prepare(R"(
-        SELECT tag, value, timestamp, quality 
-        FROM datapoints 
-        WHERE tag = :tag AND timestamp >= :start AND timestamp <= :end 
-        ORDER BY timestamp DESC
-    )");
-    query.bindValue(":tag", tag);
-    query.bindValue(":start", startTime.toSecsSinceEpoch());
-    query.bindValue(":end", endTime.toSecsSinceEpoch());
+    if (tag.isEmpty()) {
+        return Result<QList<DataPoint>>::success(QList<DataPoint>());
+    }
     
-    if (!query.exec()) {
-        return Result<QList<DataPoint>>::failure(query.lastError().text());
+    return drainCursor(*openCursor(tag, startTime, endTime));
+}
+
+Result<QVector<Sample>> SqliteRepository::findSamples(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime)
+{
+    QVector<Sample> samples;
+    if (tag.isEmpty()) {
+        return Result<QVector<Sample>>::success(samples);
     }
     
-    QList<DataPoint> dataPoints;
-    while (query.next()) {
-        QString resultTag = query.value(0).toString();
-        QVariant value = query.value(1);
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-        DataPoint::Quality quality = intToQuality(query.value(3).toInt());
-        
-        dataPoints.append(DataPoint(resultTag, value, timestamp, quality));
+    auto cursor = openCursor(tag, startTime, endTime, HistorianCursor::DEFAULT_PAGE_SIZE, true);
+    while (!cursor->atEnd()) {
+        auto page = cursor->fetchNextSamples();
+        if (page.isFailure()) {
+            return Result<QVector<Sample>>::failure(page.error());
+        }
+        samples.append(page.value());
     }
     
-    return Result<QList<DataPoint>>::success(dataPoints);
+    return Result<QVector<Sample>>::success(samples);
 }
 
 Result<DataPoint> SqliteRepository::findLatestByTag(const QString& tag)
 {
-    QMutexLocker locker(&m_mutex);
+    const qint64 id = lookupTagId(tag);
+    if (id < 0) {
+        return Result<DataPoint>::failure("No data points found for tag: " + tag);
+    }
     
-    QSqlQuery query(m_database);
-    query.prepare(R"(
-        SELECT tag, value, timestamp, quality 
-        FROM datapoints 
-        WHERE tag = :tag 
-        ORDER BY timestamp DESC 
-        LIMIT 1
-    )");
-    query.bindValue(":tag", tag);
+    {
+        QReadLocker locker(&m_latestLock);
+        if (!m_latestUnknown.contains(id)) {
+            auto it = m_latest.constFind(id);
+            if (it == m_latest.constEnd()) {
+                return Result<DataPoint>::failure("No data points found for tag: " + tag);
+            }
+            return Result<DataPoint>::success(*it);
+        }
+    }
     
-    if (!query.exec()) {
-        return Result<DataPoint>::failure(query.lastError().text());
+    // The cached sample was deleted: reload it on the writer thread with
+    // writes held off, so no newer sample can be saved between the query
+    // and the update
+    return onWriterThread([&]() {
+        QMutexLocker writeLocker(&m_writeMutex);
+    
+        QVariantMap bindings;
+        bindings.insert(":tag_id", id);
+    
+        // Partitions are visited newest first, so the first hit is the latest sample
+        auto result = queryPartitions(
+            m_writer,
+            partitionsInRange(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max()),
+            "tag_id = :tag_id", bindings, 1);
+    
+        if (result.isFailure()) {
+            return Result<DataPoint>::failure(result.error());
+        }
+    
+        QWriteLocker locker(&m_latestLock);
+        m_latestUnknown.remove(id);
+    
+        if (result.value().isEmpty()) {
+            m_latest.remove(id);
+            return Result<DataPoint>::failure("No data points found for tag: " + tag);
+        }
+    
+        m_latest.insert(id, result.value().first());
+        return Result<DataPoint>::success(result.value().first());
+    });
+}
+
+qint64 SqliteRepository::rollupTierFor(qint64 rangeMs, int pixelWidth)
+{
+    qint64 tier = 0;
+    for (qint64 width : ROLLUP_TIERS_MS) {
+        if (pixelWidth > 0 && rangeMs / width >= pixelWidth) {
+            tier = width;
+        }
     }
+    return tier;
+}
+
+Result<QList<TrendBucket>> SqliteRepository::findTrend(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime,
+    int pixelWidth)
+{
+    QList<TrendBucket> buckets;
     
-    if (!query.next()) {
-        return Result<DataPoint>::failure("No data points found for tag: " + tag);
+    const qint64 id = lookupTagId(tag);
+    if (id < 0) {
+        return Result<QList<TrendBucket>>::success(buckets);
     }
     
-    QString resultTag = query.value(0).toString();
-    QVariant value = query.value(1);
-    QDateTime timestamp = QDateTime::fromSecsSinceEpoch(query.value(2).toLongLong());
-    DataPoint::Quality quality = intToQuality(query.value(3).toInt());
+    const qint64 startMs = startTime.toMSecsSinceEpoch();
+    const qint64 endMs = endTime.toMSecsSinceEpoch();
+    const qint64 tier = rollupTierFor(endMs - startMs, pixelWidth);
+    
+    // partitionsInRange() is newest first; trends are read oldest first
+    QList<qint64> days = partitionsInRange(startMs, endMs);
+    std::reverse(days.begin(), days.end());
     
-    return Result<DataPoint>::success(DataPoint(resultTag, value, timestamp, quality));
+    Connection& connection = reader();
+    for (qint64 day : days) {
+        const QString schema = attachPartition(connection, day, false);
+        if (schema.isEmpty()) {
+            // Removed by retention since the day list was taken
+            continue;
+        }
+        
+        QSqlQuery query(connection.database);
+        query.setForwardOnly(true);
+        
+        if (tier > 0) {
+            QString bucketsSQL = QString(R"(
+                SELECT bucket, count, min, max, sum, first_ts, first, last_ts, last
+                FROM "%1".rollups
+                WHERE tier = :tier AND tag_id = :tag_id AND bucket >= :start AND bucket <= :end
+                ORDER BY bucket
+            )").arg(schema);
+            if (!hasRollupsTable(connection.database, schema)) {
+                // Bulk load in progress: aggregate the raw samples the same way
+                bucketsSQL = QString(R"(
+                    WITH buckets (tier, tag_id, bucket, count, min, max, sum, first_ts, first, last_ts, last) AS (%1)
+                    SELECT bucket, count, min, max, sum, first_ts, first, last_ts, last
+                    FROM buckets
+                    ORDER BY bucket
+                )").arg(rollupRowsSql(QString("\"%1\".samples").arg(schema),
+                                      "t.width = :tier AND s.tag_id = :tag_id AND s.ts >= :start"
+                                      " AND s.ts < :end - (:end % t.width + t.width) % t.width + t.width"));
+            }
+            query.prepare(bucketsSQL);
+            query.bindValue(":tier", tier);
+            query.bindValue(":start", startMs - (startMs % tier + tier) % tier);
+        } else {
+            query.prepare(QString(R"(
+                SELECT ts, COALESCE(value_real, value_int)
+                FROM "%1".samples
+                WHERE tag_id = :tag_id AND ts >= :start AND ts <= :end
+                  AND (value_real IS NOT NULL OR value_int IS NOT NULL)
+                ORDER BY ts
+            )").arg(schema));
+            query.bindValue(":start", startMs);
+        }
+        query.bindValue(":tag_id", id);
+        query.bindValue(":end", endMs);
+        
+        if (!query.exec()) {
+            return Result<QList<TrendBucket>>::failure(query.lastError().text());
+        }
+        
+        while (query.next()) {
+            TrendBucket bucket;
+            bucket.widthMs = tier;
+            bucket.startMs = query.value(0).toLongLong();
+            
+            if (tier > 0) {
+                bucket.count = query.value(1).toInt();
+                bucket.min = query.value(2).toDouble();
+                bucket.max = query.value(3).toDouble();
+                bucket.sum = query.value(4).toDouble();
+                bucket.firstMs = query.value(5).toLongLong();
+                bucket.first = query.value(6).toDouble();
+                bucket.lastMs = query.value(7).toLongLong();
+                bucket.last = query.value(8).toDouble();
+            } else {
+                const double value = query.value(1).toDouble();
+                bucket.count = 1;
+                bucket.min = bucket.max = bucket.sum = bucket.first = bucket.last = value;
+                bucket.firstMs = bucket.lastMs = bucket.startMs;
+            }
+            
+            buckets.append(bucket);
+        }
+    }
+    
+    return Result<QList<TrendBucket>>::success(buckets);
 }
 
-Result<void> SqliteRepository::deleteOlderThan(int retentionDays)
+Result<ResampledSeries> SqliteRepository::resample(
+    const QStringList& tags,
+    const QDateTime& startTime,
+    const QDateTime& endTime,
+    qint64 stepMs,
+    ResampleMode mode)
 {
-    QMutexLocker locker(&m_mutex);
+    if (stepMs <= 0 || !startTime.isValid() || !endTime.isValid() || endTime < startTime) {
+        return Result<ResampledSeries>::failure("Invalid resampling range or step");
+    }
     
-    QDateTime cutoffDate = QDateTime::currentDateTime().addDays(-retentionDays);
+    const qint64 startMs = startTime.toMSecsSinceEpoch();
+    const qint64 slots = (endTime.toMSecsSinceEpoch() - startMs) / stepMs + 1;
+    if (slots > MAX_RESAMPLE_SLOTS) {
+        return Result<ResampledSeries>::failure(
+            QString("Resampling grid too large: %1 slots (maximum %2)").arg(slots).arg(MAX_RESAMPLE_SLOTS));
+    }
+    const qint64 windowEndMs = startMs + slots * stepMs;
     
-    QSqlQuery query(m_database);
-    query.prepare("DELETE FROM datapoints WHERE timestamp < :cutoff");
-    query.bindValue(":cutoff", cutoffDate.toSecsSinceEpoch());
+    ResampledSeries series;
+    series.mode = mode;
+    series.startMs = startMs;
+    series.stepMs = stepMs;
+    series.tags = tags;
+    series.timestamps.reserve(int(slots));
+    for (qint64 slot = 0; slot < slots; ++slot) {
+        series.timestamps.append(startMs + slot * stepMs);
+    }
     
-    if (!query.exec()) {
-        return Result<void>::failure(query.lastError().text());
+    // One resampler per distinct known tag
+    QList<qint64> tagIds;
+    QHash<qint64, int> resamplerOf;
+    std::vector<Resampler> resamplers;
+    for (const QString& tag : tags) {
+        const qint64 id = lookupTagId(tag);
+        if (id >= 0 && !resamplerOf.contains(id)) {
+            resamplerOf.insert(id, int(resamplers.size()));
+            resamplers.emplace_back(mode, startMs, stepMs, int(slots));
+            tagIds.append(id);
+        }
     }
     
-    return Result<void>::success();
+    if (!tagIds.isEmpty()) {
+        Connection& connection = reader();
+        
+        if (mode != ResampleMode::MinMax) {
+            auto seeds = boundarySamples(connection, tagIds, startMs, true);
+            if (seeds.isFailure()) {
+                return Result<ResampledSeries>::failure(seeds.error());
+            }
+            const QHash<qint64, QPair<qint64, double>> seedSamples = seeds.value();
+            for (auto it = seedSamples.constBegin(); it != seedSamples.constEnd(); ++it) {
+                resamplers[resamplerOf.value(it.key())].add(it.value().first, it.value().second);
+            }
+        }
+        
+        QStringList idList;
+        for (qint64 id : qAsConst(tagIds)) {
+            idList.append(QString::number(id));
+        }
+        
+        // Oldest partition first and (tag_id, ts) order inside each, so every
+        // resampler sees its tag's samples in ascending order
+        const QList<qint64> days = partitionsInRange(startMs, windowEndMs - 1);
+        for (auto day = days.crbegin(); day != days.crend(); ++day) {
+            const QString schema = attachPartition(connection, *day, false);
+            if (schema.isEmpty()) {
+                continue;
+            }
+            
+            QSqlQuery query(connection.database);
+            query.setForwardOnly(true);
+            query.prepare(QString("SELECT tag_id, ts, COALESCE(value_real, value_int) FROM \"%1\".samples "
+                                  "WHERE tag_id IN (%2) AND ts >= :start AND ts < :end "
+                                  "AND value_text IS NULL AND quality <> :bad ORDER BY tag_id, ts")
+                              .arg(schema, idList.join(',')));
+            query.bindValue(":start", startMs);
+            query.bindValue(":end", windowEndMs);
+            query.bindValue(":bad", qualityToInt(DataPoint::Quality::Bad));
+            
+            if (!query.exec()) {
+                return Result<ResampledSeries>::failure(query.lastError().text());
+            }
+            
+            qint64 currentId = -1;
+            Resampler* resampler = nullptr;
+            while (query.next()) {
+                const qint64 id = query.value(0).toLongLong();
+                if (id != currentId) {
+                    currentId = id;
+                    resampler = &resamplers[resamplerOf.value(id)];
+                }
+                resampler->add(query.value(1).toLongLong(), query.value(2).toDouble());
+            }
+        }
+        
+        if (mode == ResampleMode::Linear) {
+            auto next = boundarySamples(connection, tagIds, windowEndMs, false);
+            if (next.isFailure()) {
+                return Result<ResampledSeries>::failure(next.error());
+            }
+            const QHash<qint64, QPair<qint64, double>> nextSamples = next.value();
+            for (auto it = nextSamples.constBegin(); it != nextSamples.constEnd(); ++it) {
+                resamplers[resamplerOf.value(it.key())].add(it.value().first, it.value().second);
+            }
+        }
+        
+        for (Resampler& resampler : resamplers) {
+            resampler.finish();
+        }
+    }
+    
+    const QVector<double> empty(int(slots), std::numeric_limits<double>::quiet_NaN());
+    for (const QString& tag : tags) {
+        const int index = resamplerOf.value(lookupTagId(tag), -1);
+        series.values.append(index >= 0 ? resamplers[index].values() : empty);
+        if (mode == ResampleMode::MinMax) {
+            series.maxValues.append(index >= 0 ? resamplers[index].maxValues() : empty);
+        }
+    }
+    
+    return Result<ResampledSeries>::success(series);
+}
+
+Result<QHash<qint64, QPair<qint64, double>>> SqliteRepository::boundarySamples(Connection& connection,
+                                                                               const QList<qint64>& tagIds,
+                                                                               qint64 timeMs,
+                                                                               bool before) const
+{
+    QHash<qint64, QPair<qint64, double>> found;
+    QList<qint64> remaining = tagIds;
+    
+    // Partitions are returned newest first; walk forward in time for "after"
+    QList<qint64> days = before ? partitionsInRange(std::numeric_limits<qint64>::min(), timeMs - 1)
+                                : partitionsInRange(timeMs, std::numeric_limits<qint64>::max());
+    if (!before) {
+        std::reverse(days.begin(), days.end());
+    }
+    
+    for (qint64 day : qAsConst(days)) {
+        if (remaining.isEmpty()) {
+            break;
+        }
+        
+        const QString schema = attachPartition(connection, day, false);
+        if (schema.isEmpty()) {
+            continue;
+        }
+        
+        QStringList idList;
+        for (qint64 id : qAsConst(remaining)) {
+            idList.append(QString::number(id));
+        }
+        
+        // SQLite returns the other columns from the row holding MAX/MIN(ts)
+        QSqlQuery query(connection.database);
+        query.setForwardOnly(true);
+        query.prepare(QString("SELECT tag_id, %1(ts), COALESCE(value_real, value_int) FROM \"%2\".samples "
+                              "WHERE tag_id IN (%3) AND ts %4 :time "
+                              "AND value_text IS NULL AND quality <> :bad GROUP BY tag_id")
+                          .arg(before ? "MAX" : "MIN", schema, idList.join(','), before ? "<" : ">="));
+        query.bindValue(":time", timeMs);
+        query.bindValue(":bad", qualityToInt(DataPoint::Quality::Bad));
+        
+        if (!query.exec()) {
+            return Result<QHash<qint64, QPair<qint64, double>>>::failure(query.lastError().text());
+        }
+        
+        while (query.next()) {
+            const qint64 id = query.value(0).toLongLong();
+            found.insert(id, qMakePair(query.value(1).toLongLong(), query.value(2).toDouble()));
+            remaining.removeOne(id);
+        }
+    }
+    
+    return Result<QHash<qint64, QPair<qint64, double>>>::success(found);
+}
+
+Result<void> SqliteRepository::deleteOlderThan(int retentionDays)
+{
+    return onWriterThread([&]() {
+        QMutexLocker locker(&m_writeMutex);
+    
+        QDateTime cutoffDate = QDateTime::currentDateTime().addDays(-retentionDays);
+        const qint64 cutoffMs = cutoffDate.toMSecsSinceEpoch();
+        const qint64 cutoffDay = dayOf(cutoffMs);
+    
+        // Whole partitions before the cutoff day are dropped by deleting their files
+        QList<qint64> expiredDays = partitionsInRange(std::numeric_limits<qint64>::min(),
+                                                      (cutoffDay - 1) * MSECS_PER_DAY);
+    
+        for (qint64 day : expiredDays) {
+            detachPartition(m_writer, day);
+        
+            QSqlQuery manifest(m_writer.database);
+            manifest.prepare("DELETE FROM partitions WHERE day = :day");
+            manifest.bindValue(":day", day);
+            if (!manifest.exec()) {
+                return Result<void>::failure(manifest.lastError().text());
+            }
+            
+            // Readers detach the partition on their next query; the file
+            // is deleted once the last connection has let go of it
+            QString fileName;
+            {
+                QWriteLocker stateLocker(&m_stateLock);
+                fileName = m_partitions.take(day);
+            }
+            
+            retirePartitionFile(fileName);
+        }
+        
+        // Only the partition containing the cutoff is trimmed row by row
+        const QString schema = attachPartition(m_writer, cutoffDay, false);
+        if (!schema.isEmpty()) {
+            QSqlQuery query(m_writer.database);
+            query.prepare(QString("DELETE FROM \"%1\".samples"
+                                  " WHERE tag_id IN (SELECT id FROM main.tags) AND ts < :cutoff").arg(schema));
+            query.bindValue(":cutoff", cutoffMs);
+            
+            if (!query.exec()) {
+                return Result<void>::failure(query.lastError().text());
+            }
+            
+            // Buckets before the cutoff go away, the ones containing it are recomputed
+            if (query.numRowsAffected() > 0
+                && !rebuildRollups(m_writer.database, schema, -1, cutoffDay * MSECS_PER_DAY, cutoffMs)) {
+                return Result<void>::failure("Failed to update rollups of " + schema);
+            }
+        }
+        
+        // A tag whose newest sample is older than the cutoff has no samples left
+        QWriteLocker latestLocker(&m_latestLock);
+        for (auto it = m_latest.begin(); it != m_latest.end();) {
+            if (it->timestamp().toMSecsSinceEpoch() < cutoffMs) {
+                it = m_latest.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        return Result<void>::success();
+    });
 }
 
 bool SqliteRepository::isConnected() const
 {
-    return m_database.isOpen();
+    return onWriterThread([this]() { return m_writer.database.isOpen(); });
 }
 
 int SqliteRepository::qualityToInt(DataPoint::Quality quality) const
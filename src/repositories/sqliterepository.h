@@ -2,9 +2,29 @@
 
 #include "../interfaces/irepository.h"
 #include "../models/datapoint.h"
+#include "../models/sample.h"
+#include "../models/trendbucket.h"
+#include "../models/resampledseries.h"
+#include "historiancursor.h"
+#include "historianspool.h"
 #include <QSqlDatabase>
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QThread>
 #include <QString>
+#include <QHash>
+#include <QSet>
+#include <QMap>
+#include <QPair>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+class QSqlQuery;
 
 /**
  * @brief SQLite-backed repository for DataPoint persistence
@@ -17,22 +37,124 @@
  * 
  * Features:
  * - Persistent storage (survives application restarts)
- * - Thread-safe operations (QMutex)
+ * - Thread-safe operations; reads run concurrently with each other and with writes
  * - Query by time range
  * - Query by tag
- * - Automatic table creation
- * - Connection pooling
- * 
- * Database Schema:
- * CREATE TABLE datapoints (
- *   id INTEGER PRIMARY KEY AUTOINCREMENT,
- *   tag TEXT NOT NULL,
- *   value TEXT NOT NULL,
- *   timestamp INTEGER NOT NULL,
- *   quality INTEGER NOT NULL,
- *   INDEX idx_tag (tag),
- *   INDEX idx_timestamp (timestamp)
+ * - Automatic table creation and schema migration
+ * - Tag dictionary (tag names stored once, samples reference integer IDs)
+ * - Typed numeric values and millisecond timestamps
+ * - Daily time partitions with O(1) retention
+ * - Incremental min/max/avg/first/last/count rollups for trend queries
+ * - Paged, cancellable cursors for large range queries (openCursor())
+ * - Store-and-forward spool for samples the database cannot take right now
+ * 
+ * Database Layout (version 3, tracked in PRAGMA user_version):
+ * 
+ * The main database file holds the tag dictionary and the partition manifest:
+ * CREATE TABLE tags (
+ *   id INTEGER PRIMARY KEY,
+ *   name TEXT NOT NULL UNIQUE
  * );
+ * CREATE TABLE partitions (
+ *   day INTEGER PRIMARY KEY,       -- UTC days since epoch
+ *   file TEXT NOT NULL             -- file name inside the partition directory
+ * );
+ * 
+ * Samples live in one SQLite file per UTC day ("<db>.partitions/yyyy-MM-dd.db"),
+ * each holding:
+ * CREATE TABLE samples (
+ *   tag_id INTEGER NOT NULL,
+ *   ts INTEGER NOT NULL,           -- milliseconds since epoch (UTC)
+ *   value_real REAL,               -- floating point values
+ *   value_int INTEGER,             -- integral and boolean values
+ *   value_text TEXT,               -- non-numeric values (rare)
+ *   quality INTEGER NOT NULL,
+ *   PRIMARY KEY (tag_id, ts)
+ * ) WITHOUT ROWID;
+ * 
+ * CREATE TABLE rollups (
+ *   tier INTEGER NOT NULL,         -- bucket width in milliseconds
+ *   tag_id INTEGER NOT NULL,
+ *   bucket INTEGER NOT NULL,       -- bucket start (ms since epoch)
+ *   count INTEGER NOT NULL,
+ *   min REAL NOT NULL, max REAL NOT NULL, sum REAL NOT NULL,
+ *   first_ts INTEGER NOT NULL, first REAL NOT NULL,
+ *   last_ts INTEGER NOT NULL, last REAL NOT NULL,
+ *   PRIMARY KEY (tier, tag_id, bucket)
+ * ) WITHOUT ROWID;
+ * 
+ * The clustered (tag_id, ts) key keeps every tag's history contiguous on
+ * disk, so per-tag range scans are sequential and no secondary index is
+ * needed. Exactly one of the value columns is non-NULL per row.
+ * 
+ * Rollups are maintained by an AFTER INSERT trigger on samples, one row
+ * per tier (ROLLUP_TIERS_MS) and bucket, for numeric values only. Every
+ * tier divides a day, so buckets never straddle partitions and expire
+ * together with the raw data. Partitions created before rollups existed
+ * are backfilled the first time they are attached. Writes are upserts that
+ * leave identical rows alone; a sample stored again with different values
+ * is updated in place, and an AFTER UPDATE trigger recomputes its buckets
+ * from the samples. deleteById() and the cutoff trim of deleteOlderThan()
+ * recompute the buckets they touched (rebuildRollups), so trends never
+ * report deleted or double-counted data.
+ * 
+ * Partition files are ATTACHed lazily when a write or query first touches
+ * them and detached again in least-recently-used order (at most
+ * MAX_ATTACHED_PARTITIONS at a time), so startup cost does not grow with
+ * the amount of history. Queries only visit partitions overlapping the
+ * requested range. Retention removes whole partition files; only the
+ * partition containing the cutoff is trimmed row by row. A removed
+ * partition's file is deleted once no connection has it attached any
+ * more, and a partition created for the same day meanwhile gets a file of
+ * its own, so a reader never keeps serving a removed file. Files left over
+ * by a failed delete are removed at the next startup.
+ * 
+ * Connections: Qt SQL connections may only be used by the thread that
+ * created them. Writes (save, deletes, retention, imports) and every DDL
+ * statement therefore run on a single writer connection owned by the
+ * repository's own writer thread; a call from any other thread is handed
+ * to it and waits for the result. Every thread that reads gets its own
+ * reader connection, opened lazily on first use and named
+ * "<writer name>-reader-<thread ID>". Readers never change the schema: a
+ * partition that still lacks its rollups is prepared by the writer thread
+ * first (except during a bulk load, see beginBulkLoad()). A reader
+ * connection is closed when its QThread finishes (or with the
+ * repository). All files run in WAL journal mode, so readers and cursors
+ * never block save() and vice versa. The tag dictionary and partition
+ * manifest are shared in memory behind a read/write lock; each connection
+ * keeps its own set of attached partitions.
+ * 
+ * Latest values: findLatestByTag() is answered from an in-memory table
+ * holding the newest sample of every tag. It is rebuilt at startup with one
+ * grouped query per partition (newest partition first, usually only one is
+ * needed) and updated by save()/saveAll() after their transaction commits;
+ * an older sample never replaces a newer one. Deleting a tag's cached
+ * sample marks the tag as unknown, and the next lookup reloads it from
+ * disk while writes are held off, so the table is never behind the
+ * database for writes made through this repository.
+ * 
+ * Store and forward: when a write fails (database locked by another
+ * process, disk full, I/O error), the rows that were not committed are
+ * appended to a memory-mapped journal next to the database
+ * ("<db>.spool", see HistorianSpool) and save()/saveAll() still succeed.
+ * The journal is created by the first write that needs it. While the
+ * spool holds samples, new samples are spooled behind them so they reach
+ * the database in arrival order. Each write first tries to drain the
+ * spool (at most once per SPOOL_RETRY_MS after a failure), and the
+ * constructor drains what a previous run left behind. Replay uses the
+ * same upsert as save(), which skips rows identical to the stored one, so
+ * a sample replayed twice is stored (and rolled up) once. Spooled samples
+ * are not visible to queries until they have been drained. Only a full
+ * (or uncreatable) spool makes a write fail; spoolMetrics() reports
+ * depth, drain rate and losses.
+ * 
+ * Version 1 databases (single `datapoints` table with TEXT tag/value and
+ * second-precision timestamps) and version 2 databases (single `samples`
+ * table in the main file) are migrated in place on first open.
+ * 
+ * Entity IDs: samples no longer have a surrogate row ID. findById() and
+ * deleteById() take the composite key "<tag>@<msecsSinceEpoch>" produced
+ * by makeId().
  * 
  * Example Usage:
  * @code
@@ -49,6 +171,33 @@
  */
 class SqliteRepository : public IRepository<DataPoint> {
 public:
+    /**
+     * @brief Current on-disk schema version (PRAGMA user_version)
+     */
+    static constexpr int SCHEMA_VERSION = 3;
+    
+    /**
+     * @brief Maximum number of partition files attached at the same time
+     * 
+     * SQLite's default SQLITE_MAX_ATTACHED is 10; two slots are left free.
+     */
+    static constexpr int MAX_ATTACHED_PARTITIONS = 8;
+    
+    /**
+     * @brief Rollup tier bucket widths in milliseconds (10 s, 1 min, 1 h)
+     */
+    static constexpr qint64 ROLLUP_TIERS_MS[] = {10000, 60000, 3600000};
+    
+    /**
+     * @brief Largest grid accepted by resample() (slots per tag)
+     */
+    static constexpr int MAX_RESAMPLE_SLOTS = 1000000;
+    
+    /**
+     * @brief Minimum delay between drain attempts after a failed drain
+     */
+    static constexpr int SPOOL_RETRY_MS = 1000;
+    
     /**
      * @brief Construct a SQLite repository
      * @param databasePath Path to SQLite database file (default: "datapoints.db")
@@ -65,6 +214,76 @@ public:
     int count() const override;
     Result<void> clear() override;
     
+    /**
+     * @brief Save many data points with one transaction per partition
+     * 
+     * Much faster than repeated save() calls: the insert statement is
+     * prepared once per partition and each partition is committed once.
+     * 
+     * Rows that cannot be committed are spooled (see class documentation).
+     * @param entities Data points to save (any order)
+     * @return Result indicating success or failure; fails only if rows could
+     *         neither be committed nor spooled (the partitions committed
+     *         before the error keep their rows)
+     */
+    Result<void> saveAll(const QList<DataPoint>& entities);
+    
+    /**
+     * @brief Replay spooled samples into the database, oldest first
+     * 
+     * Called implicitly by save()/saveAll(); exposed for callers that want
+     * to flush the spool as soon as the database is known to be back
+     * (e.g. after maintenance). Ignores the retry delay.
+     * @param maxSamples Stop after this many samples (-1 = drain everything)
+     * @return Number of samples drained; failure if the database rejected
+     *         the next batch (it stays in the spool)
+     */
+    Result<int> drainSpool(int maxSamples = -1);
+    
+    /**
+     * @brief Spool depth, size, throughput and loss counters
+     */
+    SpoolMetrics spoolMetrics() const;
+    
+    /**
+     * @brief Enter bulk-load mode for a large backfill
+     * 
+     * Until endBulkLoad(), partitions written through this repository do
+     * not maintain rollups per row: their rollup trigger and table are
+     * dropped when the writer attaches them, and endBulkLoad() rebuilds
+     * them in one pass per partition. Meanwhile findTrend() aggregates the
+     * raw samples of a partition without rollups, and deletes leave its
+     * buckets to the rebuild. If the process stops before endBulkLoad(),
+     * the rollups are rebuilt the next time the partition is attached.
+     */
+    void beginBulkLoad();
+    
+    /**
+     * @brief Leave bulk-load mode and rebuild the rollups of every partition lacking them
+     */
+    Result<void> endBulkLoad();
+    
+    /**
+     * @brief Write a large batch with one transaction per partition
+     * 
+     * Like saveAll() but never spools: a failure is reported to the caller
+     * (e.g. a bulk importer that retries from its last checkpoint).
+     */
+    Result<void> importSamples(const QList<DataPoint>& entities);
+    
+    /**
+     * @brief Path of the main database file
+     */
+    QString databasePath() const { return m_databasePath; }
+    
+    /**
+     * @brief Build the entity ID used by findById()/deleteById()
+     * @param tag The tag identifier
+     * @param timestamp Sample timestamp (millisecond precision)
+     * @return Composite key "<tag>@<msecsSinceEpoch>"
+     */
+    static QString makeId(const QString& tag, const QDateTime& timestamp);
+    
     /**
      * @brief Find data points by tag
      * @param tag The tag identifier
@@ -93,13 +312,119 @@ public:
         const QDateTime& endTime
     );
     
+    /**
+     * @brief Load a tag's samples in compact form, oldest first
+     * 
+     * For plots and calculations over long ranges: rows are decoded
+     * straight into Samples (HistorianCursor::fetchNextSamples()), without
+     * building a DataPoint per row.
+     * @param tag The tag identifier
+     * @param startTime Start of time range (inclusive, invalid = unbounded)
+     * @param endTime End of time range (inclusive, invalid = unbounded)
+     * @return Result containing the samples (empty for unknown tags)
+     */
+    Result<QVector<Sample>> findSamples(
+        const QString& tag,
+        const QDateTime& startTime = QDateTime(),
+        const QDateTime& endTime = QDateTime()
+    );
+    
+    /**
+     * @brief Open a paged cursor over a tag and time range
+     * 
+     * The cursor reads on its own connection and holds no lock on the
+     * repository, so it may be drained on a worker thread while samples
+     * keep being saved. findAll(), findByTag(), findByTimeRange() and
+     * findByTagAndTimeRange() are convenience wrappers that drain a cursor
+     * into a list; use the cursor directly for exports and other queries
+     * that may match millions of samples.
+     * 
+     * @param tag The tag identifier (empty = all tags)
+     * @param startTime Start of time range (inclusive, invalid = unbounded)
+     * @param endTime End of time range (inclusive, invalid = unbounded)
+     * @param pageSize Number of samples per HistorianCursor::fetchNext()
+     * @param oldestFirst Yield samples in ascending instead of descending time order
+     * @return Cursor yielding samples newest first unless oldestFirst
+     *         (empty for unknown tags)
+     */
+    std::unique_ptr<HistorianCursor> openCursor(
+        const QString& tag,
+        const QDateTime& startTime = QDateTime(),
+        const QDateTime& endTime = QDateTime(),
+        int pageSize = HistorianCursor::DEFAULT_PAGE_SIZE,
+        bool oldestFirst = false
+    );
+    
     /**
      * @brief Get the latest data point for a tag
+     * 
+     * Served from the in-memory latest-value table without touching SQLite
+     * (except for the first lookup after the cached sample was deleted).
      * @param tag The tag identifier
      * @return Result containing the most recent data point
      */
     Result<DataPoint> findLatestByTag(const QString& tag);
     
+    /**
+     * @brief Load a trend for display, bounded by screen width
+     * 
+     * Picks the coarsest rollup tier that still yields at least one bucket
+     * per output pixel (see rollupTierFor()). If even the finest tier is
+     * too coarse, raw samples are returned as single-sample buckets. The
+     * number of rows read is therefore bounded by pixelWidth rather than
+     * by the amount of data in the range.
+     * 
+     * @param tag The tag identifier
+     * @param startTime Start of time range (inclusive)
+     * @param endTime End of time range (inclusive)
+     * @param pixelWidth Width of the plot area in pixels
+     * @return Result containing buckets ordered oldest first
+     */
+    Result<QList<TrendBucket>> findTrend(
+        const QString& tag,
+        const QDateTime& startTime,
+        const QDateTime& endTime,
+        int pixelWidth
+    );
+    
+    /**
+     * @brief Resample several tags onto a regular time grid
+     * 
+     * The grid has one slot per stepMs from startTime up to and including
+     * endTime. Each tag is evaluated in a single pass over its samples in
+     * ascending order (see Resampler): partitions are read oldest first,
+     * one query per partition for all tags, in primary key order. Hold and
+     * interpolation modes also read the nearest sample before the range
+     * (and Linear the nearest one after it), so the first and last slots
+     * are filled even if no sample falls inside them.
+     * 
+     * Only numeric samples are used; Bad quality samples are skipped.
+     * Unknown tags and slots without data are NaN.
+     * 
+     * @param tags Tags to resample (one value column each)
+     * @param startTime Start of the first slot
+     * @param endTime Start of the last slot is at or before this time
+     * @param stepMs Slot width in milliseconds (> 0)
+     * @param mode How samples are combined per slot
+     * @return Result containing the aligned columns, or failure for an
+     *         invalid range or more than MAX_RESAMPLE_SLOTS slots
+     */
+    Result<ResampledSeries> resample(
+        const QStringList& tags,
+        const QDateTime& startTime,
+        const QDateTime& endTime,
+        qint64 stepMs,
+        ResampleMode mode
+    );
+    
+    /**
+     * @brief Choose the rollup tier for a trend query
+     * @param rangeMs Length of the requested time range in milliseconds
+     * @param pixelWidth Width of the plot area in pixels
+     * @return Coarsest tier width giving >= 1 bucket per pixel, or 0 for raw samples
+     */
+    static qint64 rollupTierFor(qint64 rangeMs, int pixelWidth);
+    
     /**
      * @brief Delete old data points beyond retention period
      * @param retentionDays Number of days to retain (older data is deleted)
@@ -114,8 +439,30 @@ public:
     bool isConnected() const;
 
 private:
+    /**
+     * @brief Run a function on the writer thread and return its result
+     * 
+     * Runs it directly when already there, otherwise queues it to the
+     * writer thread and blocks until it has run. The caller must not hold
+     * m_writeMutex. The function must return a value.
+     */
+    template<typename Function>
+    auto onWriterThread(Function function) const -> decltype(function())
+    {
+        if (QThread::currentThread() == &m_writerThread) {
+            return function();
+        }
+        
+        std::optional<decltype(function())> result;
+        QMetaObject::invokeMethod(m_writerContext, [&]() { result.emplace(function()); },
+                                  Qt::BlockingQueuedConnection);
+        return std::move(*result);
+    }
+    
     /**
      * @brief Initialize database connection and create tables
+     * 
+     * Runs on the writer thread, which owns the writer connection.
      * @return True if successful, false on error
      */
     bool initialize();
@@ -126,6 +473,289 @@ private:
      */
     bool createTables();
     
+    /**
+     * @brief Migrate a version 1 `datapoints` table to the version 2 layout
+     * 
+     * Runs in a single transaction. Rows sharing a tag and a second are
+     * spread over distinct milliseconds so no sample is lost to the new
+     * primary key.
+     * @return True if successful, false on error (database left at v1)
+     */
+    bool migrateFromV1();
+    
+    /**
+     * @brief Move a version 2 `samples` table into daily partition files
+     * 
+     * Each day is copied with an upsert, so an interrupted
+     * migration is simply repeated on the next start. The main file is
+     * vacuumed afterwards to reclaim space.
+     * @return True if successful, false on error
+     */
+    bool migrateToPartitions();
+    
+    /**
+     * @brief CREATE TABLE statement for the samples table in a schema
+     * @param schema Database schema name ("main" or a partition alias)
+     */
+    static QString samplesTableSql(const QString& schema);
+    
+    /**
+     * @brief A SQLite connection and the partitions attached to it
+     */
+    struct Connection {
+        QSqlDatabase database;
+        QList<qint64> attachedPartitions;   // Least recently used first
+        QHash<qint64, QString> attachedFiles;   // Day -> file it was attached from
+        QMetaObject::Connection threadFinished; // Releases a reader with its thread
+    };
+    
+    /**
+     * @brief Settings applied to every connection (busy timeout)
+     */
+    static void configureConnection(QSqlDatabase& database);
+    
+    /**
+     * @brief Reader connection of the calling thread, opened on first use
+     */
+    Connection& reader() const;
+    
+    /**
+     * @brief Close and remove the reader connection of a finished thread
+     */
+    void releaseReader(Qt::HANDLE threadId) const;
+    
+    /**
+     * @brief Detach partitions whose file is no longer the one in the manifest
+     */
+    void detachStalePartitions(Connection& connection) const;
+    
+    /**
+     * @brief Create the samples/rollups tables and rollup trigger of a partition
+     * 
+     * Backfills the rollups of partitions that predate them (or were bulk loaded).
+     * @param database Connection the partition is attached to
+     * @param schema Attached partition alias
+     * @param maintainRollups False during a bulk load: drop the rollup trigger
+     *        and table instead, so they are rebuilt in one pass afterwards
+     */
+    static bool ensurePartitionSchema(QSqlDatabase& database, const QString& schema, bool maintainRollups = true);
+    
+    /**
+     * @brief Recompute the rollup buckets overlapping a time range from the samples
+     * 
+     * Used after deleting samples, which the rollup triggers do not follow.
+     * @param database Connection the partition is attached to
+     * @param schema Attached partition alias
+     * @param tagId Tag whose buckets are recomputed, -1 for all tags
+     * @param fromMs Start of the range (inclusive, Unix ms)
+     * @param toMs End of the range (inclusive, Unix ms)
+     */
+    static bool rebuildRollups(QSqlDatabase& database, const QString& schema, qint64 tagId,
+                               qint64 fromMs, qint64 toMs);
+    
+    /**
+     * @brief Load the partition manifest (no files are attached)
+     * 
+     * Deletes partition files the manifest does not list, left over by a
+     * delete that failed.
+     */
+    bool loadPartitions();
+    
+    /**
+     * @brief File name for a new partition, not used by any file yet
+     */
+    QString newPartitionFile(qint64 day) const;
+    
+    /**
+     * @brief Drop a connection's reference to a partition file
+     * 
+     * Deletes the file if it was retired and this was the last reference.
+     */
+    void releasePartitionFile(const QString& fileName) const;
+    
+    /**
+     * @brief Delete a file removed from the manifest, or defer that until
+     *        every connection has detached it
+     */
+    void retirePartitionFile(const QString& fileName) const;
+    
+    /**
+     * @brief Delete a partition file and its journals, warning on failure
+     */
+    void removePartitionFiles(const QString& fileName) const;
+    
+    /**
+     * @brief Directory holding the partition files of this database
+     */
+    QString partitionDirectory() const;
+    
+    /**
+     * @brief Store-and-forward journal next to the database file
+     */
+    QString spoolPath() const;
+    
+    /**
+     * @brief UTC day number (days since epoch) of a millisecond timestamp
+     */
+    static qint64 dayOf(qint64 msecsSinceEpoch);
+    
+    /**
+     * @brief Schema alias under which a partition is attached
+     */
+    static QString partitionSchema(qint64 day);
+    
+    /**
+     * @brief Make sure a partition is attached to a connection
+     * 
+     * Only the writer connection creates tables, triggers and rollups; a
+     * reader finding a partition without rollups has the writer thread
+     * prepare it (except during a bulk load) and then only reads.
+     * @param connection Connection to attach to
+     * @param day UTC day number
+     * @param create Create the partition file and manifest entry if missing
+     *        (writer connection only)
+     * @return Schema alias of the attached partition, or empty on error or
+     *         if the partition does not exist and create is false
+     */
+    QString attachPartition(Connection& connection, qint64 day, bool create) const;
+    
+    /**
+     * @brief Detach a partition from a connection if it is attached
+     */
+    void detachPartition(Connection& connection, qint64 day) const;
+    
+    /**
+     * @brief Partitions overlapping a time range, newest first
+     */
+    QList<qint64> partitionsInRange(qint64 startMs, qint64 endMs) const;
+    
+    /**
+     * @brief Run a small samples query over several partitions and concatenate
+     * 
+     * Used for point lookups on the repository's own connection; range
+     * queries go through openCursor(). The query runs once per partition
+     * (newest first) with the given WHERE clause and ORDER BY ts DESC, so
+     * the combined list is ordered newest first as well.
+     * @param connection Connection to query on
+     * @param days Partitions to visit, newest first
+     * @param whereClause SQL condition on the samples table
+     * @param bindings Named bind values used by whereClause
+     * @param limit Stop after this many rows (-1 = unlimited)
+     */
+    Result<QList<DataPoint>> queryPartitions(Connection& connection,
+                                             const QList<qint64>& days,
+                                             const QString& whereClause,
+                                             const QVariantMap& bindings,
+                                             int limit = -1) const;
+    
+    /**
+     * @brief Nearest numeric, non-Bad sample of each tag on one side of a time
+     * 
+     * Runs one grouped query per partition, walking away from timeMs until
+     * every tag is found or the partitions are exhausted.
+     * @param connection Connection to query on
+     * @param tagIds Tags to look up
+     * @param timeMs Reference time
+     * @param before True: last sample with ts < timeMs;
+     *        false: first sample with ts >= timeMs
+     * @return Tag ID -> (timestamp, value) for the tags that have one
+     */
+    Result<QHash<qint64, QPair<qint64, double>>> boundarySamples(Connection& connection,
+                                                                 const QList<qint64>& tagIds,
+                                                                 qint64 timeMs,
+                                                                 bool before) const;
+    
+    /**
+     * @brief Split a "<tag>@<msecs>" entity ID
+     * @return True if the ID is well formed and the tag is known
+     */
+    bool parseId(const QString& id, qint64& tagIdOut, qint64& tsOut) const;
+    
+    /**
+     * @brief Load the tag dictionary into the in-memory lookup tables
+     */
+    bool loadTags();
+    
+    /**
+     * @brief Resolve a tag name to its dictionary ID
+     * @return Tag ID, or -1 if unknown
+     */
+    qint64 lookupTagId(const QString& tag) const;
+    
+    /**
+     * @brief Resolve a tag name, inserting it into the dictionary if unknown
+     * 
+     * Uses the writer connection; the caller must hold m_writeMutex.
+     * @return Tag ID, or -1 on error
+     */
+    qint64 registerTag(const QString& tag);
+    
+    /**
+     * @brief Copy of the ID -> name dictionary (implicitly shared)
+     */
+    QHash<qint64, QString> tagNamesSnapshot() const;
+    
+    /**
+     * @brief Rebuild the latest-value table from the partitions
+     * 
+     * Runs on the writer connection; the caller must hold m_writeMutex.
+     * Tags whose latest sample cannot be read are marked unknown.
+     */
+    void loadLatestValues();
+    
+    /**
+     * @brief Record a committed sample in the latest-value table
+     * 
+     * Keeps the newer of the cached and the given sample. Tags marked
+     * unknown are left alone until their next lookup reloads them.
+     */
+    void updateLatest(qint64 tagId, const DataPoint& point);
+    
+    /**
+     * @brief Commit samples, or spool them if the database cannot take them
+     * 
+     * Body of save()/saveAll(); the caller must hold m_writeMutex.
+     */
+    Result<void> store(const QList<DataPoint>& entities);
+    
+    /**
+     * @brief Write samples with one transaction per partition
+     * 
+     * The caller must hold m_writeMutex.
+     * @param entities Samples to write
+     * @param uncommitted Receives the samples that were not committed on failure
+     */
+    Result<void> writeSamples(const QList<DataPoint>& entities, QList<DataPoint>& uncommitted);
+    
+    /**
+     * @brief Append samples to the spool, counting them as spooled or dropped
+     * @param reason Why the database did not take them (reported if the spool is full)
+     */
+    Result<void> spool(const QList<DataPoint>& entities, const QString& reason);
+    
+    /**
+     * @brief Open the spool, creating the journal file on first use
+     * 
+     * The caller must hold m_writeMutex.
+     * @return false if the journal cannot be created or mapped
+     */
+    bool openSpool();
+    
+    /**
+     * @brief drainSpool() body; the caller must hold m_writeMutex
+     */
+    Result<int> drainSpoolLocked(int maxSamples);
+    
+    /**
+     * @brief Drain a cursor into a single list
+     */
+    static Result<QList<DataPoint>> drainCursor(HistorianCursor& cursor);
+    
+    /**
+     * @brief Bind a QVariant to the typed value columns of a prepared query
+     */
+    static void bindValue(QSqlQuery& query, const QVariant& value);
+    
     /**
      * @brief Convert DataPoint to database-ready quality integer
      */
@@ -137,7 +767,28 @@ private:
     DataPoint::Quality intToQuality(int quality) const;
     
     QString m_databasePath;         // Path to SQLite database file
-    QSqlDatabase m_database;        // SQLite database connection
-    mutable QMutex m_mutex;         // Thread safety
-    QString m_connectionName;       // Unique connection name for Qt SQL
+    QThread m_writerThread;         // Owns the writer connection
+    QObject* m_writerContext;       // Lives in m_writerThread; target of onWriterThread()
+    mutable Connection m_writer;    // Writer connection (writer thread only)
+    mutable QMutex m_writeMutex;    // Serializes use of the writer connection and the spool
+    QString m_connectionName;       // Unique connection name for Qt SQL (writer)
+    
+    mutable QMutex m_poolMutex;     // Guards m_readers
+    mutable std::unordered_map<Qt::HANDLE, std::unique_ptr<Connection>> m_readers;  // Reader per thread
+    
+    mutable QReadWriteLock m_stateLock;                 // Guards the dictionary and partitions below
+    QHash<QString, qint64> m_tagIds;                    // Tag dictionary: name -> ID
+    QHash<qint64, QString> m_tagNames;                  // Tag dictionary: ID -> name
+    mutable QMap<qint64, QString> m_partitions;         // Partition manifest: day -> file name
+    mutable QHash<QString, int> m_attachCounts;         // Partition file -> connections attaching it
+    mutable QSet<QString> m_retiredPartitions;          // Out of the manifest, deleted when unattached
+    
+    mutable QReadWriteLock m_latestLock;                // Guards the latest-value table below
+    QHash<qint64, DataPoint> m_latest;                  // Tag ID -> newest sample
+    QSet<qint64> m_latestUnknown;                       // Tags whose newest sample must be reloaded
+    
+    std::unique_ptr<HistorianSpool> m_spool;            // Store-and-forward journal, null until needed
+    SpoolMetrics m_spoolStats;                          // Counters; depth and size are read from m_spool
+    QElapsedTimer m_spoolRetry;                         // Started when a drain fails
+    std::atomic<bool> m_bulkLoad{false};                // Between beginBulkLoad() and endBulkLoad()
 };
@@ -0,0 +1,486 @@
+#include "tieredrepository.h"
+#include <QMutexLocker>
+#include <QSet>
+#include <QPair>
+#include <QDebug>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace {
+
+// Watermark of a range RAM holds completely
+const qint64 NOTHING_ON_DISK_ONLY = std::numeric_limits<qint64>::min();
+
+bool newerFirst(const DataPoint& a, const DataPoint& b)
+{
+    return a.timestamp() > b.timestamp();
+}
+
+bool parseId(const QString& id, QString& tagOut, qint64& tsOut)
+{
+    const int separator = id.lastIndexOf(QLatin1Char('@'));
+    bool validTimestamp = false;
+    tsOut = separator > 0 ? id.mid(separator + 1).toLongLong(&validTimestamp) : 0;
+    tagOut = id.left(separator);
+    return validTimestamp;
+}
+
+} // namespace
+
+TieredFlushWorker::TieredFlushWorker(SqliteRepository* coldTier, QObject* parent)
+    : QObject(parent)
+    , m_coldTier(coldTier)
+{
+}
+
+void TieredFlushWorker::writeSegment(quint64 segmentId, const QList<DataPoint>& segment)
+{
+    auto result = m_coldTier->saveAll(segment);
+    emit segmentWritten(segmentId, result.isSuccess() ? QString() : result.error());
+}
+
+TieredRepository::TieredRepository(const QString& databasePath, int hotCapacity, QObject* parent)
+    : QObject(parent)
+    , m_hotTier(new CircularBufferRepository(hotCapacity, this))
+    , m_coldTier(new SqliteRepository(databasePath))
+    , m_worker(new TieredFlushWorker(m_coldTier.get()))
+    , m_nextSegmentId(1)
+    , m_segmentSize(DEFAULT_SEGMENT_SIZE)
+    , m_maxSegmentAgeMs(DEFAULT_MAX_SEGMENT_AGE_MS)
+    , m_ringSinceMs(NOTHING_ON_DISK_ONLY)
+    , m_diskOnlyUntilMs(NOTHING_ON_DISK_ONLY)
+{
+    // Whatever the database already holds is not in RAM
+    auto newest = m_coldTier->openCursor(QString(), QDateTime(), QDateTime(), 1, false)->fetchNext();
+    if (newest.isSuccess() && !newest.value().isEmpty()) {
+        m_diskOnlyUntilMs = newest.value().first().timestamp().toMSecsSinceEpoch() + 1;
+    }
+    
+    m_worker->moveToThread(&m_flushThread);
+    connect(&m_flushThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    
+    // Direct: the bookkeeping happens in the flush thread under m_mutex, so
+    // flush() sees it as soon as the worker's queue is drained
+    connect(m_worker, &TieredFlushWorker::segmentWritten,
+            this, &TieredRepository::onSegmentWritten, Qt::DirectConnection);
+    
+    m_flushThread.setObjectName("HistorianFlush");
+    m_flushThread.start(QThread::LowPriority);
+    
+    connect(&m_ageTimer, &QTimer::timeout, this, &TieredRepository::onAgeTimer);
+    m_ageTimer.start(qMax(50, m_maxSegmentAgeMs / 4));
+}
+
+TieredRepository::~TieredRepository()
+{
+    m_ageTimer.stop();
+    
+    auto result = flush();
+    if (result.isFailure()) {
+        qWarning() << "TieredRepository: Failed to write pending samples on shutdown:" << result.error();
+    }
+    
+    m_flushThread.quit();
+    m_flushThread.wait();
+}
+
+Result<void> TieredRepository::save(const DataPoint& entity)
+{
+    QMutexLocker saveLocker(&m_saveMutex);
+    trackTag(entity.tag());
+    
+    // Only Good samples enter the ring; all samples go to disk
+    const bool toRing = entity.isValid();
+    const qint64 ts = entity.timestamp().toMSecsSinceEpoch();
+    
+    {
+        QMutexLocker locker(&m_mutex);
+    
+        // Move the watermarks before the sample is missing from RAM, so a
+        // concurrent query reads it from disk rather than not at all
+        if (!toRing) {
+            if (!entity.tag().isEmpty()) {
+                m_tagDiskOnlyUntilMs[entity.tag()] = qMax(m_tagDiskOnlyUntilMs.value(entity.tag()), ts + 1);
+            }
+            m_diskOnlyUntilMs = qMax(m_diskOnlyUntilMs, ts + 1);
+        } else if (m_hotTier->isFull()) {
+            auto evicted = m_hotTier->oldestTimestamp();
+            if (evicted.isSuccess()) {
+                m_ringSinceMs = qMax(m_ringSinceMs, evicted.value().toMSecsSinceEpoch() + 1);
+            }
+        }
+        
+        if (m_pending.isEmpty()) {
+            m_pendingAge.start();
+        }
+        m_pending.append(entity);
+        
+        if (m_pending.size() >= m_segmentSize) {
+            dispatchPendingLocked();
+        }
+    }
+    
+    if (toRing) {
+        m_hotTier->save(entity);
+    }
+    
+    return Result<void>::success();
+}
+
+Result<DataPoint> TieredRepository::findById(const QString& id)
+{
+    QString tag;
+    qint64 ts = 0;
+    if (!parseId(id, tag, ts)) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    const QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(ts);
+    auto matches = query(tag, timestamp, timestamp);
+    if (matches.isFailure()) {
+        return Result<DataPoint>::failure(matches.error());
+    }
+    
+    if (matches.value().isEmpty()) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    return Result<DataPoint>::success(matches.value().first());
+}
+
+Result<QList<DataPoint>> TieredRepository::findAll()
+{
+    return query(QString(), QDateTime(), QDateTime());
+}
+
+Result<void> TieredRepository::deleteById(const QString& id)
+{
+    // Write everything first so a queued segment cannot bring the sample back
+    auto flushed = flush();
+    if (flushed.isFailure()) {
+        return flushed;
+    }
+    
+    return m_coldTier->deleteById(id);
+}
+
+int TieredRepository::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    int unflushed = m_pending.size();
+    for (const QList<DataPoint>& segment : m_inFlight) {
+        unflushed += segment.size();
+    }
+    locker.unlock();
+    
+    return m_coldTier->count() + unflushed;
+}
+
+Result<void> TieredRepository::clear()
+{
+    // Let queued segments finish so they do not land after the clear
+    QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    
+    QMutexLocker saveLocker(&m_saveMutex);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pending.clear();
+    }
+    
+    m_hotTier->clear();
+    auto result = m_coldTier->clear();
+    
+    if (result.isSuccess()) {
+        QMutexLocker locker(&m_mutex);
+        m_ringSinceMs = NOTHING_ON_DISK_ONLY;
+        m_diskOnlyUntilMs = NOTHING_ON_DISK_ONLY;
+        m_tagDiskOnlyUntilMs.clear();
+    }
+    return result;
+}
+
+Result<QList<DataPoint>> TieredRepository::findByTag(const QString& tag)
+{
+    if (tag.isEmpty()) {
+        return Result<QList<DataPoint>>::success(QList<DataPoint>());
+    }
+    
+    return query(tag, QDateTime(), QDateTime());
+}
+
+Result<QList<DataPoint>> TieredRepository::findByTimeRange(const QDateTime& startTime, const QDateTime& endTime)
+{
+    return query(QString(), startTime, endTime);
+}
+
+Result<QList<DataPoint>> TieredRepository::findByTagAndTimeRange(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime)
+{
+    if (tag.isEmpty()) {
+        return Result<QList<DataPoint>>::success(QList<DataPoint>());
+    }
+    
+    return query(tag, startTime, endTime);
+}
+
+Result<DataPoint> TieredRepository::findLatestByTag(const QString& tag)
+{
+    // The ring returns the most recently saved Good sample of the tag
+    auto hot = m_hotTier->findById(tag);
+    
+    DataPoint latest;
+    bool found = hot.isSuccess();
+    if (found) {
+        latest = hot.value();
+    }
+    
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const DataPoint& point : unflushedLocked()) {
+            if (point.tag() == tag && (!found || point.timestamp() >= latest.timestamp())) {
+                latest = point;
+                found = true;
+            }
+        }
+    }
+    
+    // A newer non-Good sample may already be on disk only (the ring skips
+    // those); the cold tier answers from its in-memory latest-value table
+    auto cold = m_coldTier->findLatestByTag(tag);
+    if (cold.isSuccess() && (!found || cold.value().timestamp() > latest.timestamp())) {
+        return cold;
+    }
+    
+    if (found) {
+        return Result<DataPoint>::success(latest);
+    }
+    
+    return cold;
+}
+
+Result<void> TieredRepository::flush()
+{
+    // Drain segments already queued to the flush thread
+    if (QThread::currentThread() != &m_flushThread) {
+        QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    }
+    
+    QList<DataPoint> segment;
+    {
+        QMutexLocker locker(&m_mutex);
+        segment.swap(m_pending);
+    }
+    
+    if (segment.isEmpty()) {
+        return Result<void>::success();
+    }
+    
+    auto result = m_coldTier->saveAll(segment);
+    if (result.isFailure()) {
+        QMutexLocker locker(&m_mutex);
+        m_pending = segment + m_pending;
+        return result;
+    }
+    
+    emit segmentFlushed(segment.size());
+    return result;
+}
+
+int TieredRepository::pendingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return unflushedLocked().size();
+}
+
+void TieredRepository::setSegmentSize(int samples)
+{
+    QMutexLocker locker(&m_mutex);
+    m_segmentSize = qMax(1, samples);
+}
+
+int TieredRepository::segmentSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_segmentSize;
+}
+
+void TieredRepository::setMaxSegmentAge(int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxSegmentAgeMs = qMax(0, msecs);
+    m_ageTimer.setInterval(qMax(50, m_maxSegmentAgeMs / 4));
+}
+
+int TieredRepository::maxSegmentAge() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxSegmentAgeMs;
+}
+
+void TieredRepository::onAgeTimer()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    if (!m_pending.isEmpty() && m_pendingAge.elapsed() >= m_maxSegmentAgeMs) {
+        dispatchPendingLocked();
+    }
+}
+
+void TieredRepository::onSegmentWritten(quint64 segmentId, const QString& error)
+{
+    // Runs in the flush thread
+    QMutexLocker locker(&m_mutex);
+    
+    const QList<DataPoint> segment = m_inFlight.take(segmentId);
+    
+    if (!error.isEmpty()) {
+        // Keep the samples and retry them with the next segment
+        if (m_pending.isEmpty()) {
+            m_pendingAge.start();
+        }
+        m_pending = segment + m_pending;
+        locker.unlock();
+        
+        qWarning() << "TieredRepository: Failed to write segment of" << segment.size() << "samples:" << error;
+        emit flushFailed(error);
+        return;
+    }
+    
+    locker.unlock();
+    emit segmentFlushed(segment.size());
+}
+
+void TieredRepository::dispatchPendingLocked()
+{
+    const quint64 segmentId = m_nextSegmentId++;
+    const QList<DataPoint> segment = m_pending;
+    m_inFlight.insert(segmentId, segment);
+    m_pending.clear();
+    
+    TieredFlushWorker* worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, segmentId, segment]() {
+        worker->writeSegment(segmentId, segment);
+    }, Qt::QueuedConnection);
+}
+
+QList<DataPoint> TieredRepository::unflushedLocked() const
+{
+    QList<DataPoint> unflushed = m_pending;
+    for (const QList<DataPoint>& segment : m_inFlight) {
+        unflushed.append(segment);
+    }
+    return unflushed;
+}
+
+void TieredRepository::trackTag(const QString& tag)
+{
+    if (tag.isEmpty()) {
+        return;
+    }
+    
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_tagDiskOnlyUntilMs.contains(tag)) {
+            return;
+        }
+    }
+    
+    // Answered from the cold tier's latest-value table
+    auto latest = m_coldTier->findLatestByTag(tag);
+    const qint64 until = latest.isSuccess() ? latest.value().timestamp().toMSecsSinceEpoch() + 1
+                                            : NOTHING_ON_DISK_ONLY;
+    
+    QMutexLocker locker(&m_mutex);
+    if (!m_tagDiskOnlyUntilMs.contains(tag)) {
+        m_tagDiskOnlyUntilMs.insert(tag, until);
+    }
+}
+
+qint64 TieredRepository::completeSinceLocked(const QString& tag) const
+{
+    const qint64 diskOnlyUntil = tag.isEmpty() ? m_diskOnlyUntilMs
+                                               : m_tagDiskOnlyUntilMs.value(tag, NOTHING_ON_DISK_ONLY);
+    return qMax(m_ringSinceMs, diskOnlyUntil);
+}
+
+Result<QList<DataPoint>> TieredRepository::query(const QString& tag, const QDateTime& startTime,
+                                                 const QDateTime& endTime)
+{
+    const qint64 startMs = startTime.isValid() ? startTime.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+    const qint64 endMs = endTime.isValid() ? endTime.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    
+    trackTag(tag);
+    
+    // Not clamped to the ring's oldest timestamp: that is its oldest saved
+    // sample, and out-of-order saves leave older ones behind it
+    QList<DataPoint> hot;
+    const QDateTime hotStart = startTime.isValid() ? startTime : QDateTime::fromMSecsSinceEpoch(0);
+    const QDateTime hotEnd = endTime.isValid() ? endTime : QDateTime::currentDateTime().addYears(100);
+    auto ring = tag.isEmpty() ? m_hotTier->findByTimeRange(hotStart, hotEnd)
+                              : m_hotTier->findByTagAndTimeRange(tag, hotStart, hotEnd);
+    if (ring.isSuccess()) {
+        hot.append(ring.value());
+    }
+    
+    // RAM holds every sample from completeSinceMs on; only the part of the
+    // range before it has to be read from disk. Read after the ring: save()
+    // moves the watermark before evicting, so a sample missing from the
+    // ring copy above is covered by it
+    qint64 completeSinceMs = NOTHING_ON_DISK_ONLY;
+    {
+        QMutexLocker locker(&m_mutex);
+        completeSinceMs = completeSinceLocked(tag);
+        for (const DataPoint& point : unflushedLocked()) {
+            const qint64 ts = point.timestamp().toMSecsSinceEpoch();
+            if ((tag.isEmpty() || point.tag() == tag) && ts >= startMs && ts <= endMs) {
+                hot.append(point);
+            }
+        }
+    }
+    
+    // A sample can be both unflushed and in the ring, or both in RAM and
+    // on disk; report each (tag, timestamp) once, preferring the RAM copy
+    QSet<QPair<QString, qint64>> seen;
+    QList<DataPoint> hotUnique;
+    for (const DataPoint& point : qAsConst(hot)) {
+        const qint64 ts = point.timestamp().toMSecsSinceEpoch();
+        if (!seen.contains(qMakePair(point.tag(), ts))) {
+            seen.insert(qMakePair(point.tag(), ts));
+            hotUnique.append(point);
+        }
+    }
+    std::stable_sort(hotUnique.begin(), hotUnique.end(), newerFirst);
+    
+    if (startMs >= completeSinceMs) {
+        return Result<QList<DataPoint>>::success(hotUnique);
+    }
+    
+    const qint64 coldEndMs = qMin(endMs, completeSinceMs - 1);
+    const QDateTime coldEnd = coldEndMs == std::numeric_limits<qint64>::max()
+        ? endTime : QDateTime::fromMSecsSinceEpoch(coldEndMs);
+    auto cold = tag.isEmpty() ? m_coldTier->findByTimeRange(startTime, coldEnd)
+                              : m_coldTier->findByTagAndTimeRange(tag, startTime, coldEnd);
+    if (cold.isFailure()) {
+        return cold;
+    }
+    
+    QList<DataPoint> coldUnique;
+    coldUnique.reserve(cold.value().size());
+    for (const DataPoint& point : cold.value()) {
+        if (!seen.contains(qMakePair(point.tag(), point.timestamp().toMSecsSinceEpoch()))) {
+            coldUnique.append(point);
+        }
+    }
+    
+    // Both sides are ordered newest first
+    QList<DataPoint> merged;
+    merged.reserve(hotUnique.size() + coldUnique.size());
+    std::merge(hotUnique.cbegin(), hotUnique.cend(), coldUnique.cbegin(), coldUnique.cend(),
+               std::back_inserter(merged), newerFirst);
+    
+    return Result<QList<DataPoint>>::success(merged);
+}
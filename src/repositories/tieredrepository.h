@@ -0,0 +1,271 @@
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QTimer>
+#include <memory>
+#include "../interfaces/irepository.h"
+#include "../models/datapoint.h"
+#include "circularbufferrepository.h"
+#include "sqliterepository.h"
+
+/**
+ * @brief Background writer moving segments from RAM to the disk tier
+ * 
+ * Lives in TieredRepository's flush thread. SqliteRepository::saveAll()
+ * hands the rows to the cold tier's own writer thread and waits, so the
+ * SQLite connection is never used from the flush thread.
+ */
+class TieredFlushWorker : public QObject {
+    Q_OBJECT
+    
+public:
+    explicit TieredFlushWorker(SqliteRepository* coldTier, QObject* parent = nullptr);
+    
+    /**
+     * @brief Write one segment (runs in the flush thread)
+     * @param segmentId Identifier echoed in segmentWritten()
+     * @param segment Data points to write
+     */
+    void writeSegment(quint64 segmentId, const QList<DataPoint>& segment);
+
+signals:
+    /**
+     * @brief Emitted after a segment was written
+     * @param segmentId Identifier passed to writeSegment()
+     * @param error Empty on success
+     */
+    void segmentWritten(quint64 segmentId, const QString& error);
+
+private:
+    SqliteRepository* m_coldTier;   ///< Not owned
+};
+
+/**
+ * @brief Two-tier historian: recent data in RAM, history on disk
+ * 
+ * Combines a CircularBufferRepository (hot tier) and a SqliteRepository
+ * (cold tier) behind one repository, so callers do not need to know where
+ * a sample lives.
+ * 
+ * Pattern: Repository (RULE-202), Facade over two repositories
+ * Location: src/repositories/ (RULE-301)
+ * 
+ * Behaviour:
+ * - save() writes to the hot ring and appends to the pending segment
+ * - A segment is handed to a background QThread and written to SQLite
+ *   with SqliteRepository::saveAll() when it reaches segmentSize() samples
+ *   or its oldest sample has waited maxSegmentAge() milliseconds
+ * - Range queries are answered from RAM (ring plus samples not yet
+ *   written) from a per-tag watermark on; SQLite is only read for the
+ *   part of the range before it, and samples present in both tiers are
+ *   reported once. A recent range is therefore served at memory speed.
+ * - On destruction, pending segments are written synchronously
+ * 
+ * The watermark of a tag is the point from which every one of its samples
+ * is known to be in RAM. It moves past anything that ends up on disk only:
+ * samples stored before this object saw the tag, non-Good samples (the
+ * ring rejects them; they are served from the pending segment until
+ * written) and samples overwritten in the ring. The ring overwrites in
+ * save order, so after out-of-order saves the watermark can jump ahead of
+ * the oldest sample left in it.
+ * 
+ * Example:
+ * @code
+ * auto* historian = new TieredRepository("historian.db", 20000, this);
+ * historian->save(DataPoint("Temperature", 42.5));
+ * 
+ * // Merged from RAM and disk, newest first
+ * auto trend = historian->findByTagAndTimeRange(
+ *     "Temperature", QDateTime::currentDateTime().addSecs(-3600), QDateTime::currentDateTime());
+ * @endcode
+ * 
+ * Thread Safety: All public methods are thread-safe. The object itself
+ * must live in a thread with an event loop (for the age timer and the
+ * flush notifications).
+ */
+class TieredRepository : public QObject, public IRepository<DataPoint> {
+    Q_OBJECT
+    
+public:
+    /**
+     * @brief Default number of samples per flushed segment
+     */
+    static constexpr int DEFAULT_SEGMENT_SIZE = 500;
+    
+    /**
+     * @brief Default maximum time a sample waits in RAM before being flushed
+     */
+    static constexpr int DEFAULT_MAX_SEGMENT_AGE_MS = 5000;
+    
+    /**
+     * @brief Create a tiered repository
+     * @param databasePath SQLite database file of the cold tier
+     * @param hotCapacity Number of samples kept in the RAM ring
+     * @param parent QObject parent
+     */
+    explicit TieredRepository(const QString& databasePath, int hotCapacity = 10000, QObject* parent = nullptr);
+    ~TieredRepository() override;
+    
+    // IRepository<DataPoint> interface implementation
+    
+    /**
+     * @brief Save a data point to the hot tier and queue it for the disk
+     */
+    Result<void> save(const DataPoint& entity) override;
+    
+    /**
+     * @brief Find a sample by "<tag>@<msecsSinceEpoch>" (see SqliteRepository::makeId())
+     */
+    Result<DataPoint> findById(const QString& id) override;
+    
+    /**
+     * @brief All samples of both tiers, newest first
+     */
+    Result<QList<DataPoint>> findAll() override;
+    
+    /**
+     * @brief Delete a sample from the disk tier and the pending segment
+     * 
+     * A copy may still be served from the ring until it is overwritten.
+     */
+    Result<void> deleteById(const QString& id) override;
+    
+    /**
+     * @brief Samples on disk plus samples not yet written
+     */
+    int count() const override;
+    
+    /**
+     * @brief Clear both tiers
+     */
+    Result<void> clear() override;
+    
+    /**
+     * @brief Find data points by tag (both tiers, newest first)
+     */
+    Result<QList<DataPoint>> findByTag(const QString& tag);
+    
+    /**
+     * @brief Find data points within a time range (both tiers, newest first)
+     */
+    Result<QList<DataPoint>> findByTimeRange(const QDateTime& startTime, const QDateTime& endTime);
+    
+    /**
+     * @brief Find data points by tag within a time range (both tiers, newest first)
+     */
+    Result<QList<DataPoint>> findByTagAndTimeRange(
+        const QString& tag,
+        const QDateTime& startTime,
+        const QDateTime& endTime
+    );
+    
+    /**
+     * @brief Latest sample of a tag, the newer of RAM and the disk tier's latest-value table
+     */
+    Result<DataPoint> findLatestByTag(const QString& tag);
+    
+    /**
+     * @brief Write all pending samples to disk and wait until they are stored
+     */
+    Result<void> flush();
+    
+    /**
+     * @brief Number of samples not yet written to disk
+     */
+    int pendingCount() const;
+    
+    /**
+     * @brief Set the number of samples per flushed segment
+     */
+    void setSegmentSize(int samples);
+    int segmentSize() const;
+    
+    /**
+     * @brief Set the maximum time a sample waits in RAM before being flushed
+     */
+    void setMaxSegmentAge(int msecs);
+    int maxSegmentAge() const;
+    
+    /**
+     * @brief The RAM tier (read access for diagnostics)
+     */
+    CircularBufferRepository* hotTier() const { return m_hotTier; }
+    
+    /**
+     * @brief The disk tier (e.g. for findTrend() or openCursor())
+     */
+    SqliteRepository* coldTier() const { return m_coldTier.get(); }
+
+signals:
+    /**
+     * @brief Emitted after a segment was written to disk
+     * @param count Number of samples written
+     */
+    void segmentFlushed(int count);
+    
+    /**
+     * @brief Emitted when writing a segment failed (it is retried)
+     * @param error Error message
+     */
+    void flushFailed(const QString& error);
+
+private slots:
+    void onAgeTimer();
+    void onSegmentWritten(quint64 segmentId, const QString& error);
+
+private:
+    /**
+     * @brief Hand the pending segment to the flush thread (m_mutex held)
+     */
+    void dispatchPendingLocked();
+    
+    /**
+     * @brief Merge the tiers for one query
+     * @param tag Tag filter (empty = all tags)
+     * @param startTime Range start, inclusive (invalid = unbounded)
+     * @param endTime Range end, inclusive (invalid = unbounded)
+     */
+    Result<QList<DataPoint>> query(const QString& tag, const QDateTime& startTime, const QDateTime& endTime);
+    
+    /**
+     * @brief Samples saved but not yet confirmed on disk (m_mutex held)
+     */
+    QList<DataPoint> unflushedLocked() const;
+    
+    /**
+     * @brief Set up the watermark of a tag seen for the first time
+     * 
+     * Its samples already on disk are not in RAM.
+     */
+    void trackTag(const QString& tag);
+    
+    /**
+     * @brief Start of the range RAM holds completely (m_mutex held)
+     * @param tag Tag (empty = all tags); trackTag() must have seen it
+     */
+    qint64 completeSinceLocked(const QString& tag) const;
+    
+    CircularBufferRepository* m_hotTier;            ///< RAM ring (child QObject)
+    std::unique_ptr<SqliteRepository> m_coldTier;   ///< Disk tier
+    
+    QThread m_flushThread;                          ///< Runs m_worker
+    TieredFlushWorker* m_worker;                    ///< Deleted when m_flushThread finishes
+    QTimer m_ageTimer;                              ///< Flushes aged segments
+    QMutex m_saveMutex;                             ///< Serializes save(), so the ring overwrites what it checked
+    
+    mutable QMutex m_mutex;                         ///< Guards the members below
+    QList<DataPoint> m_pending;                     ///< Segment being filled
+    QElapsedTimer m_pendingAge;                     ///< Started with the first pending sample
+    QHash<quint64, QList<DataPoint>> m_inFlight;    ///< Segments being written
+    quint64 m_nextSegmentId;
+    int m_segmentSize;
+    int m_maxSegmentAgeMs;
+    qint64 m_ringSinceMs;                           ///< Past every sample overwritten in the ring
+    qint64 m_diskOnlyUntilMs;                       ///< Past every disk-only sample of any tag
+    QHash<QString, qint64> m_tagDiskOnlyUntilMs;    ///< Tag -> past its newest disk-only sample
+};
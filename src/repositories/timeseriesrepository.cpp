@@ -0,0 +1,890 @@
+#include "timeseriesrepository.h"
+#include "../utils/checksum.h"
+#include <QMutexLocker>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 SEGMENT_MAGIC = 0x53535451;     // "QTSS"
+const quint32 SEGMENT_VERSION = 1;
+const quint32 CHUNK_MAGIC = 0x4B4E4843;       // "CHNK"
+const quint32 CHUNK_END_MAGIC = 0x444E4543;   // "CEND"
+
+const qint64 SEGMENT_HEADER_SIZE = 8;
+const qint64 CHUNK_HEADER_SIZE = 32;
+const qint64 CHUNK_TRAILER_SIZE = 8;
+
+const quint8 CHUNK_FLAG_INTEGRAL = 0x01;
+
+const qint64 JOURNAL_RECORD_HEADER_SIZE = 20;
+const qint64 JOURNAL_RECORD_TRAILER_SIZE = 4;
+
+const quint8 JOURNAL_FLAG_INTEGRAL = 0x01;
+const quint8 JOURNAL_FLAG_SEALED = 0x02;     // The tag's open chunk was sealed
+
+bool isIntegralType(int type)
+{
+    switch (type) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::Char:
+        case QMetaType::SChar:
+        case QMetaType::UChar:
+        case QMetaType::Long:
+        case QMetaType::ULong:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool newerFirst(const DataPoint& a, const DataPoint& b)
+{
+    return a.timestamp() > b.timestamp();
+}
+
+bool olderFirst(const Sample& a, const Sample& b)
+{
+    return a.timestampNs < b.timestampNs;
+}
+
+/**
+ * @brief Decode a Gorilla stream, calling visit(ts, value, quality) for the samples within [startMs, endMs]
+ */
+template<typename Visitor>
+bool decodeChunk(const uchar* data, qint64 size, int count, qint64 startMs, qint64 endMs, Visitor visit)
+{
+    QVector<qint64> timestamps(count);
+    QVector<double> values(count);
+    QVector<quint8> qualities(count);
+    
+    GorillaDecoder decoder(data, size, count);
+    if (decoder.decode(timestamps.data(), values.data(), qualities.data(), count) != count) {
+        return false;
+    }
+    
+    for (int i = 0; i < count; ++i) {
+        if (timestamps[i] >= startMs && timestamps[i] <= endMs) {
+            visit(timestamps[i], values[i], qualities[i]);
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Encode one journal record and write it with a single write()
+ * 
+ * A crash therefore tears at most the last record, which recoverJournal()
+ * detects by its checksum.
+ */
+bool writeJournalRecord(QIODevice& device, const QString& tag, qint64 ts, double value, quint8 quality,
+                        quint8 flags)
+{
+    const QByteArray tagUtf8 = tag.toUtf8().left(std::numeric_limits<quint16>::max());
+    const qint64 bodySize = JOURNAL_RECORD_HEADER_SIZE + tagUtf8.size();
+    
+    QByteArray record(int(bodySize + JOURNAL_RECORD_TRAILER_SIZE), Qt::Uninitialized);
+    uchar* data = reinterpret_cast<uchar*>(record.data());
+    quint64 valueBits;
+    memcpy(&valueBits, &value, sizeof(valueBits));
+    qToLittleEndian<quint16>(quint16(tagUtf8.size()), data);
+    data[2] = flags;
+    data[3] = quality;
+    qToLittleEndian<qint64>(ts, data + 4);
+    qToLittleEndian<quint64>(valueBits, data + 12);
+    memcpy(data + JOURNAL_RECORD_HEADER_SIZE, tagUtf8.constData(), size_t(tagUtf8.size()));
+    qToLittleEndian<quint32>(crc32(data, bodySize), data + bodySize);
+    
+    return device.write(record) == record.size();
+}
+
+/**
+ * @brief A sample read back from the journal
+ */
+struct JournalEntry {
+    qint64 ts;
+    double value;
+    quint8 quality;
+    bool integral;
+};
+
+} // namespace
+
+TimeSeriesRepository::TimeSeriesRepository(const QString& directory)
+    : m_directory(directory)
+    , m_mutex()
+    , m_activeSegment(0)
+{
+    QMutexLocker locker(&m_mutex);
+    initialize();
+}
+
+TimeSeriesRepository::~TimeSeriesRepository()
+{
+    flush();
+    
+    QMutexLocker locker(&m_mutex);
+    m_writer.close();
+    m_journal.close();
+    for (auto& entry : m_segments) {
+        if (entry.second.map) {
+            entry.second.file->unmap(entry.second.map);
+        }
+    }
+}
+
+bool TimeSeriesRepository::initialize()
+{
+    if (!QDir().mkpath(m_directory)) {
+        qWarning() << "TimeSeriesRepository: Failed to create directory" << m_directory;
+        return false;
+    }
+    
+    const QStringList files = QDir(m_directory).entryList({"segment-*.tss"}, QDir::Files, QDir::Name);
+    for (int i = 0; i < files.size(); ++i) {
+        bool validNumber = false;
+        const int number = files.at(i).mid(8, 8).toInt(&validNumber);
+        if (!validNumber) {
+            continue;
+        }
+        
+        Segment& segment = m_segments[number];
+        segment.path = segmentPath(number);
+        segment.file.reset(new QFile(segment.path));
+        segment.size = recoverSegment(number, segment, i == files.size() - 1);
+    }
+    
+    if (m_segments.empty()) {
+        if (!startSegment(1)) {
+            return false;
+        }
+    } else if (m_segments.rbegin()->second.size < SEGMENT_HEADER_SIZE) {
+        // A last segment without a valid header is rewritten in place
+        if (!startSegment(m_segments.rbegin()->first)) {
+            return false;
+        }
+    } else if (m_segments.rbegin()->second.size >= MAX_SEGMENT_BYTES) {
+        if (!startSegment(m_segments.rbegin()->first + 1)) {
+            return false;
+        }
+    } else {
+        m_activeSegment = m_segments.rbegin()->first;
+        m_writer.setFileName(segmentPath(m_activeSegment));
+        if (!m_writer.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "TimeSeriesRepository: Failed to open" << m_writer.fileName() << ":" << m_writer.errorString();
+            return false;
+        }
+    }
+    
+    return recoverJournal();
+}
+
+bool TimeSeriesRepository::recoverJournal()
+{
+    QFile journal(journalPath());
+    QByteArray data;
+    if (journal.exists()) {
+        if (!journal.open(QIODevice::ReadOnly)) {
+            qWarning() << "TimeSeriesRepository: Failed to open" << journal.fileName() << ":" << journal.errorString();
+            return false;
+        }
+        data = journal.readAll();
+        journal.close();
+    }
+    
+    // Samples journaled since each tag's chunk was last sealed, in save order
+    QHash<QString, QVector<JournalEntry>> pending;
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    qint64 position = 0;
+    while (position + JOURNAL_RECORD_HEADER_SIZE + JOURNAL_RECORD_TRAILER_SIZE <= data.size()) {
+        const uchar* record = bytes + position;
+        const quint16 tagLength = qFromLittleEndian<quint16>(record);
+        const qint64 bodySize = JOURNAL_RECORD_HEADER_SIZE + tagLength;
+        if (position + bodySize + JOURNAL_RECORD_TRAILER_SIZE > data.size()
+            || qFromLittleEndian<quint32>(record + bodySize) != crc32(record, bodySize)) {
+            // Torn by a crash in the middle of an append
+            qWarning() << "TimeSeriesRepository: Ignoring torn journal record at offset" << position;
+            break;
+        }
+        
+        const QString tag = QString::fromUtf8(reinterpret_cast<const char*>(record + JOURNAL_RECORD_HEADER_SIZE),
+                                              tagLength);
+        const quint8 flags = record[2];
+        if (flags & JOURNAL_FLAG_SEALED) {
+            pending.remove(tag);
+        } else {
+            quint64 valueBits = qFromLittleEndian<quint64>(record + 12);
+            double value;
+            memcpy(&value, &valueBits, sizeof(value));
+            pending[tag].append({qFromLittleEndian<qint64>(record + 4), value, record[3],
+                                 bool(flags & JOURNAL_FLAG_INTEGRAL)});
+        }
+        position += bodySize + JOURNAL_RECORD_TRAILER_SIZE;
+    }
+    
+    for (auto entries = pending.constBegin(); entries != pending.constEnd(); ++entries) {
+        const QString& tag = entries.key();
+        OpenChunk chunk;
+        chunk.minTs = std::numeric_limits<qint64>::max();
+        chunk.maxTs = std::numeric_limits<qint64>::min();
+        for (const JournalEntry& entry : entries.value()) {
+            chunk.encoder.append(entry.ts, entry.value, entry.quality);
+            chunk.minTs = qMin(chunk.minTs, entry.ts);
+            chunk.maxTs = qMax(chunk.maxTs, entry.ts);
+            chunk.integral = chunk.integral && entry.integral;
+        }
+        
+        // A crash between sealing a chunk and journaling that leaves the
+        // chunk's samples behind; they are already on disk
+        const QVector<ChunkRef> sealed = m_chunks.value(tag);
+        if (!sealed.isEmpty() && sealed.last().count == quint32(chunk.encoder.count())
+            && sealed.last().minTs == chunk.minTs && sealed.last().maxTs == chunk.maxTs) {
+            continue;
+        }
+        m_openChunks.insert(tag, chunk);
+    }
+    
+    if (!m_openChunks.isEmpty()) {
+        qWarning() << "TimeSeriesRepository: Recovered" << m_openChunks.size() << "open chunks from the journal";
+    }
+    
+    // Start from a journal holding exactly the recovered samples
+    return compactJournal();
+}
+
+bool TimeSeriesRepository::appendJournal(const QString& tag, qint64 ts, double value, quint8 quality,
+                                         bool integral, bool sealed)
+{
+    const quint8 flags = quint8((integral ? JOURNAL_FLAG_INTEGRAL : 0) | (sealed ? JOURNAL_FLAG_SEALED : 0));
+    if (!m_journal.isOpen() || !writeJournalRecord(m_journal, tag, ts, value, quality, flags) || !m_journal.flush()) {
+        qWarning() << "TimeSeriesRepository: Failed to journal" << tag << ":" << m_journal.errorString();
+        return false;
+    }
+    
+    return true;
+}
+
+bool TimeSeriesRepository::compactJournal()
+{
+    m_journal.close();
+    
+    // Written aside and renamed over the old journal, so a crash leaves one of the two
+    QSaveFile journal(journalPath());
+    if (!journal.open(QIODevice::WriteOnly)) {
+        qWarning() << "TimeSeriesRepository: Failed to create" << journal.fileName() << ":" << journal.errorString();
+        return false;
+    }
+    
+    bool written = true;
+    for (auto it = m_openChunks.constBegin(); it != m_openChunks.constEnd() && written; ++it) {
+        const QString& tag = it.key();
+        const OpenChunk& chunk = it.value();
+        const quint8 flags = chunk.integral ? JOURNAL_FLAG_INTEGRAL : 0;
+        const QByteArray payload = chunk.encoder.data();
+        decodeChunk(reinterpret_cast<const uchar*>(payload.constData()), payload.size(), chunk.encoder.count(),
+                    std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max(),
+                    [&](qint64 ts, double value, quint8 quality) {
+                        written = written && writeJournalRecord(journal, tag, ts, value, quality, flags);
+                    });
+    }
+    
+    if (!written || !journal.commit()) {
+        qWarning() << "TimeSeriesRepository: Failed to rewrite" << journal.fileName() << ":" << journal.errorString();
+        return false;
+    }
+    
+    m_journal.setFileName(journalPath());
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "TimeSeriesRepository: Failed to open" << m_journal.fileName() << ":" << m_journal.errorString();
+        return false;
+    }
+    
+    return true;
+}
+
+qint64 TimeSeriesRepository::recoverSegment(int number, Segment& segment, bool isLast)
+{
+    QFile& file = *segment.file;
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "TimeSeriesRepository: Failed to open" << segment.path << ":" << file.errorString();
+        return 0;
+    }
+    
+    const qint64 fileSize = file.size();
+    uchar* data = fileSize >= SEGMENT_HEADER_SIZE ? file.map(0, fileSize) : nullptr;
+    if (!data || qFromLittleEndian<quint32>(data) != SEGMENT_MAGIC) {
+        // A crash right after creating the file leaves it (partially) empty
+        qWarning() << "TimeSeriesRepository: Ignoring segment without valid header" << segment.path;
+        if (data) {
+            file.unmap(data);
+        }
+        return 0;
+    }
+    
+    qint64 position = SEGMENT_HEADER_SIZE;
+    while (position + CHUNK_HEADER_SIZE + CHUNK_TRAILER_SIZE <= fileSize) {
+        const uchar* header = data + position;
+        const quint16 tagLength = qFromLittleEndian<quint16>(header + 4);
+        const quint32 payloadLength = qFromLittleEndian<quint32>(header + 28);
+        const qint64 bodySize = CHUNK_HEADER_SIZE + tagLength + payloadLength;
+        
+        if (qFromLittleEndian<quint32>(header) != CHUNK_MAGIC
+            || position + bodySize + CHUNK_TRAILER_SIZE > fileSize
+            || qFromLittleEndian<quint32>(header + bodySize + 4) != CHUNK_END_MAGIC
+            || qFromLittleEndian<quint32>(header + bodySize) != crc32(header, bodySize)) {
+            break;
+        }
+        
+        ChunkRef chunk;
+        chunk.segment = number;
+        chunk.payloadOffset = position + CHUNK_HEADER_SIZE + tagLength;
+        chunk.payloadLength = payloadLength;
+        chunk.integral = header[6] & CHUNK_FLAG_INTEGRAL;
+        chunk.minTs = qFromLittleEndian<qint64>(header + 8);
+        chunk.maxTs = qFromLittleEndian<qint64>(header + 16);
+        chunk.count = qFromLittleEndian<quint32>(header + 24);
+        
+        const QString tag = QString::fromUtf8(reinterpret_cast<const char*>(header + CHUNK_HEADER_SIZE), tagLength);
+        m_chunks[tag].append(chunk);
+        segment.maxTs = qMax(segment.maxTs, chunk.maxTs);
+        
+        position += bodySize + CHUNK_TRAILER_SIZE;
+    }
+    
+    if (position == fileSize) {
+        segment.map = data;
+        segment.mappedSize = fileSize;
+        return position;
+    }
+    
+    file.unmap(data);
+    
+    if (!isLast) {
+        qWarning() << "TimeSeriesRepository: Corrupt chunk in" << segment.path << "at offset" << position
+                   << "- remaining" << (fileSize - position) << "bytes ignored";
+        return position;
+    }
+    
+    // Only the last segment is ever appended to, so anything after the last
+    // valid chunk is a write torn by a crash
+    qWarning() << "TimeSeriesRepository: Truncating torn write in" << segment.path << "at offset" << position;
+    file.close();
+    if (!file.resize(position)) {
+        qWarning() << "TimeSeriesRepository: Failed to truncate" << segment.path << ":" << file.errorString();
+    }
+    file.open(QIODevice::ReadOnly);
+    
+    return position;
+}
+
+bool TimeSeriesRepository::startSegment(int number)
+{
+    m_writer.close();
+    m_writer.setFileName(segmentPath(number));
+    if (!m_writer.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "TimeSeriesRepository: Failed to create" << m_writer.fileName() << ":" << m_writer.errorString();
+        return false;
+    }
+    
+    uchar header[SEGMENT_HEADER_SIZE];
+    qToLittleEndian<quint32>(SEGMENT_MAGIC, header);
+    qToLittleEndian<quint32>(SEGMENT_VERSION, header + 4);
+    if (m_writer.write(reinterpret_cast<const char*>(header), SEGMENT_HEADER_SIZE) != SEGMENT_HEADER_SIZE
+        || !m_writer.flush()) {
+        qWarning() << "TimeSeriesRepository: Failed to write segment header:" << m_writer.errorString();
+        m_writer.close();
+        return false;
+    }
+    
+    Segment& segment = m_segments[number];
+    if (segment.map) {
+        segment.file->unmap(segment.map);
+        segment.map = nullptr;
+        segment.mappedSize = 0;
+    }
+    segment.path = m_writer.fileName();
+    segment.file.reset(new QFile(segment.path));
+    segment.size = SEGMENT_HEADER_SIZE;
+    segment.maxTs = std::numeric_limits<qint64>::min();
+    
+    m_activeSegment = number;
+    return true;
+}
+
+bool TimeSeriesRepository::sealChunk(const QString& tag, const OpenChunk& chunk)
+{
+    if (!m_writer.isOpen()) {
+        return false;
+    }
+    
+    const QByteArray tagUtf8 = tag.toUtf8().left(std::numeric_limits<quint16>::max());
+    const QByteArray payload = chunk.encoder.data();
+    const qint64 bodySize = CHUNK_HEADER_SIZE + tagUtf8.size() + payload.size();
+    
+    if (m_segments[m_activeSegment].size + bodySize + CHUNK_TRAILER_SIZE > MAX_SEGMENT_BYTES
+        && m_segments[m_activeSegment].size > SEGMENT_HEADER_SIZE
+        && !startSegment(m_activeSegment + 1)) {
+        return false;
+    }
+    Segment& segment = m_segments[m_activeSegment];
+    
+    QByteArray record(int(bodySize + CHUNK_TRAILER_SIZE), Qt::Uninitialized);
+    uchar* header = reinterpret_cast<uchar*>(record.data());
+    qToLittleEndian<quint32>(CHUNK_MAGIC, header);
+    qToLittleEndian<quint16>(quint16(tagUtf8.size()), header + 4);
+    header[6] = chunk.integral ? CHUNK_FLAG_INTEGRAL : 0;
+    header[7] = 0;
+    qToLittleEndian<qint64>(chunk.minTs, header + 8);
+    qToLittleEndian<qint64>(chunk.maxTs, header + 16);
+    qToLittleEndian<quint32>(quint32(chunk.encoder.count()), header + 24);
+    qToLittleEndian<quint32>(quint32(payload.size()), header + 28);
+    memcpy(header + CHUNK_HEADER_SIZE, tagUtf8.constData(), size_t(tagUtf8.size()));
+    memcpy(header + CHUNK_HEADER_SIZE + tagUtf8.size(), payload.constData(), size_t(payload.size()));
+    qToLittleEndian<quint32>(crc32(header, bodySize), header + bodySize);
+    qToLittleEndian<quint32>(CHUNK_END_MAGIC, header + bodySize + 4);
+    
+    // A single write per chunk: a crash leaves at most one torn record at the
+    // end of the segment, which recoverSegment() detects by its checksum
+    if (m_writer.write(record) != record.size() || !m_writer.flush()) {
+        qWarning() << "TimeSeriesRepository: Failed to write chunk for" << tag << ":" << m_writer.errorString();
+        m_writer.resize(segment.size);
+        return false;
+    }
+    
+    ChunkRef ref;
+    ref.segment = m_activeSegment;
+    ref.payloadOffset = segment.size + CHUNK_HEADER_SIZE + tagUtf8.size();
+    ref.payloadLength = quint32(payload.size());
+    ref.count = quint32(chunk.encoder.count());
+    ref.minTs = chunk.minTs;
+    ref.maxTs = chunk.maxTs;
+    ref.integral = chunk.integral;
+    m_chunks[tag].append(ref);
+    
+    segment.size += record.size();
+    segment.maxTs = qMax(segment.maxTs, chunk.maxTs);
+    
+    // The journaled samples of this chunk are on disk now. Losing the marker
+    // to a crash is caught by recoverJournal() comparing with the chunk.
+    appendJournal(tag, 0, 0.0, 0, false, true);
+    
+    return true;
+}
+
+const uchar* TimeSeriesRepository::mapRange(int segmentNumber, qint64 offset, qint64 length)
+{
+    auto it = m_segments.find(segmentNumber);
+    if (it == m_segments.end()) {
+        return nullptr;
+    }
+    Segment& segment = it->second;
+    
+    if (!segment.map || offset + length > segment.mappedSize) {
+        // The active segment grew since it was mapped
+        if (segment.map) {
+            segment.file->unmap(segment.map);
+            segment.map = nullptr;
+            segment.mappedSize = 0;
+        }
+        
+        if (!segment.file->isOpen() && !segment.file->open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
+        
+        const qint64 fileSize = segment.file->size();
+        segment.map = segment.file->map(0, fileSize);
+        if (!segment.map) {
+            qWarning() << "TimeSeriesRepository: Failed to map" << segment.path << ":" << segment.file->errorString();
+            return nullptr;
+        }
+        segment.mappedSize = fileSize;
+    }
+    
+    return offset + length <= segment.mappedSize ? segment.map + offset : nullptr;
+}
+
+template<typename Visitor>
+bool TimeSeriesRepository::visitSamples(const QString& tag, qint64 startMs, qint64 endMs, Visitor visit)
+{
+    for (const ChunkRef& chunk : m_chunks.value(tag)) {
+        if (chunk.maxTs < startMs || chunk.minTs > endMs) {
+            continue;
+        }
+        
+        const bool integral = chunk.integral;
+        const uchar* data = mapRange(chunk.segment, chunk.payloadOffset, chunk.payloadLength);
+        if (!data || !decodeChunk(data, chunk.payloadLength, int(chunk.count), startMs, endMs,
+                                  [&](qint64 ts, double value, quint8 quality) { visit(ts, value, quality, integral); })) {
+            return false;
+        }
+    }
+    
+    auto openChunk = m_openChunks.constFind(tag);
+    if (openChunk != m_openChunks.constEnd() && openChunk->encoder.count() > 0
+        && openChunk->maxTs >= startMs && openChunk->minTs <= endMs) {
+        const bool integral = openChunk->integral;
+        const QByteArray payload = openChunk->encoder.data();
+        decodeChunk(reinterpret_cast<const uchar*>(payload.constData()), payload.size(), openChunk->encoder.count(),
+                    startMs, endMs,
+                    [&](qint64 ts, double value, quint8 quality) { visit(ts, value, quality, integral); });
+    }
+    
+    return true;
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::querySamples(const QString& tag, qint64 startMs, qint64 endMs,
+                                                            bool latestOnly)
+{
+    QList<DataPoint> dataPoints;
+    
+    // The chunk holding the newest sample is the one with the greatest maxTs
+    if (latestOnly) {
+        qint64 latestTs = std::numeric_limits<qint64>::min();
+        for (const ChunkRef& chunk : m_chunks.value(tag)) {
+            latestTs = qMax(latestTs, chunk.maxTs);
+        }
+        auto openChunk = m_openChunks.constFind(tag);
+        if (openChunk != m_openChunks.constEnd() && openChunk->encoder.count() > 0) {
+            latestTs = qMax(latestTs, openChunk->maxTs);
+        }
+        startMs = endMs = latestTs;
+    }
+    
+    const bool read = visitSamples(tag, startMs, endMs, [&](qint64 ts, double value, quint8 quality, bool integral) {
+        dataPoints.append(DataPoint(
+            tag,
+            integral ? QVariant(qlonglong(value)) : QVariant(value),
+            QDateTime::fromMSecsSinceEpoch(ts),
+            static_cast<DataPoint::Quality>(quality)
+        ));
+    });
+    if (!read) {
+        return Result<QList<DataPoint>>::failure("Failed to read chunk of " + tag);
+    }
+    
+    std::stable_sort(dataPoints.begin(), dataPoints.end(), newerFirst);
+    return Result<QList<DataPoint>>::success(dataPoints);
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::queryAllTags(qint64 startMs, qint64 endMs)
+{
+    QStringList tags = m_chunks.keys();
+    for (auto it = m_openChunks.constBegin(); it != m_openChunks.constEnd(); ++it) {
+        if (!m_chunks.contains(it.key())) {
+            tags.append(it.key());
+        }
+    }
+    
+    QList<DataPoint> dataPoints;
+    for (const QString& tag : qAsConst(tags)) {
+        auto result = querySamples(tag, startMs, endMs, false);
+        if (result.isFailure()) {
+            return result;
+        }
+        dataPoints.append(result.value());
+    }
+    
+    std::stable_sort(dataPoints.begin(), dataPoints.end(), newerFirst);
+    return Result<QList<DataPoint>>::success(dataPoints);
+}
+
+QString TimeSeriesRepository::segmentPath(int number) const
+{
+    return QDir(m_directory).filePath(QString("segment-%1.tss").arg(number, 8, 10, QLatin1Char('0')));
+}
+
+QString TimeSeriesRepository::journalPath() const
+{
+    return QDir(m_directory).filePath("open-chunks.journal");
+}
+
+Result<void> TimeSeriesRepository::save(const DataPoint& entity)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    const int type = entity.value().userType();
+    const bool integral = isIntegralType(type);
+    if (!integral && type != QMetaType::Double && type != QMetaType::Float) {
+        return Result<void>::failure("TimeSeriesRepository stores numeric values only: " + entity.tag());
+    }
+    
+    const qint64 ts = entity.timestamp().toMSecsSinceEpoch();
+    const double value = entity.value().toDouble();
+    
+    // Journaled first: once save() succeeds the sample survives a crash
+    if (!appendJournal(entity.tag(), ts, value, quint8(entity.quality()), integral, false)) {
+        return Result<void>::failure("Failed to journal sample of " + entity.tag() + ": " + m_journal.errorString());
+    }
+    
+    OpenChunk& chunk = m_openChunks[entity.tag()];
+    if (chunk.encoder.count() == 0) {
+        chunk.minTs = chunk.maxTs = ts;
+    }
+    chunk.encoder.append(ts, value, quint8(entity.quality()));
+    chunk.minTs = qMin(chunk.minTs, ts);
+    chunk.maxTs = qMax(chunk.maxTs, ts);
+    chunk.integral = chunk.integral && integral;
+    
+    if (chunk.encoder.count() >= SAMPLES_PER_CHUNK) {
+        if (!sealChunk(entity.tag(), chunk)) {
+            // Keep the chunk open; it is retried on the next save or flush
+            return Result<void>::failure("Failed to write chunk for " + entity.tag() + ": " + m_writer.errorString());
+        }
+        m_openChunks.remove(entity.tag());
+        
+        if (m_journal.size() > JOURNAL_COMPACT_BYTES && !compactJournal()) {
+            return Result<void>::failure("Failed to compact journal: " + m_journal.errorString());
+        }
+    }
+    
+    return Result<void>::success();
+}
+
+Result<DataPoint> TimeSeriesRepository::findById(const QString& id)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    const int separator = id.lastIndexOf(QLatin1Char('@'));
+    bool validTimestamp = false;
+    const qint64 ts = separator > 0 ? id.mid(separator + 1).toLongLong(&validTimestamp) : 0;
+    if (!validTimestamp) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    auto result = querySamples(id.left(separator), ts, ts, false);
+    if (result.isFailure()) {
+        return Result<DataPoint>::failure(result.error());
+    }
+    
+    if (result.value().isEmpty()) {
+        return Result<DataPoint>::failure("DataPoint not found with id: " + id);
+    }
+    
+    // Duplicates are possible in an append-only store; the last write wins
+    return Result<DataPoint>::success(result.value().last());
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::findAll()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return queryAllTags(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max());
+}
+
+Result<void> TimeSeriesRepository::deleteById(const QString& id)
+{
+    Q_UNUSED(id);
+    return Result<void>::failure("TimeSeriesRepository is append-only; use deleteOlderThan()");
+}
+
+int TimeSeriesRepository::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    qint64 total = 0;
+    for (const QVector<ChunkRef>& chunks : m_chunks) {
+        for (const ChunkRef& chunk : chunks) {
+            total += chunk.count;
+        }
+    }
+    for (const OpenChunk& chunk : m_openChunks) {
+        total += chunk.encoder.count();
+    }
+    
+    return int(qMin<qint64>(total, std::numeric_limits<int>::max()));
+}
+
+Result<void> TimeSeriesRepository::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    m_writer.close();
+    for (auto& entry : m_segments) {
+        Segment& segment = entry.second;
+        if (segment.map) {
+            segment.file->unmap(segment.map);
+        }
+        segment.file->close();
+        if (!QFile::remove(segment.path)) {
+            qWarning() << "TimeSeriesRepository: Failed to remove" << segment.path;
+        }
+    }
+    
+    m_segments.clear();
+    m_chunks.clear();
+    m_openChunks.clear();
+    
+    if (!compactJournal()) {
+        return Result<void>::failure("Failed to empty journal: " + m_journal.errorString());
+    }
+    
+    if (!startSegment(1)) {
+        return Result<void>::failure("Failed to create segment: " + m_writer.errorString());
+    }
+    
+    return Result<void>::success();
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::findByTag(const QString& tag)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return querySamples(tag, std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max(), false);
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::findByTimeRange(const QDateTime& startTime, const QDateTime& endTime)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return queryAllTags(startTime.toMSecsSinceEpoch(), endTime.toMSecsSinceEpoch());
+}
+
+Result<QList<DataPoint>> TimeSeriesRepository::findByTagAndTimeRange(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    return querySamples(tag, startTime.toMSecsSinceEpoch(), endTime.toMSecsSinceEpoch(), false);
+}
+
+Result<QVector<Sample>> TimeSeriesRepository::findSamples(
+    const QString& tag,
+    const QDateTime& startTime,
+    const QDateTime& endTime)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    QVector<Sample> samples;
+    if (!m_chunks.contains(tag) && !m_openChunks.contains(tag)) {
+        return Result<QVector<Sample>>::success(samples);
+    }
+    
+    const quint32 tagId = TagRegistry::instance().intern(tag);
+    const qint64 startMs = startTime.isValid() ? startTime.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+    const qint64 endMs = endTime.isValid() ? endTime.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    
+    int total = 0;
+    for (const ChunkRef& chunk : m_chunks.value(tag)) {
+        total += int(chunk.count);
+    }
+    samples.reserve(total + SAMPLES_PER_CHUNK);
+    
+    const bool read = visitSamples(tag, startMs, endMs, [&](qint64 ts, double value, quint8 quality, bool integral) {
+        const qint64 timestampNs = ts * Sample::NSECS_PER_MSEC;
+        const auto sampleQuality = static_cast<DataPoint::Quality>(quality);
+        samples.append(integral ? Sample::ofInt(tagId, timestampNs, qint64(value), sampleQuality)
+                                : Sample::ofDouble(tagId, timestampNs, value, sampleQuality));
+    });
+    if (!read) {
+        return Result<QVector<Sample>>::failure("Failed to read chunk of " + tag);
+    }
+    
+    // Chunks are in write order; only out-of-order saves need sorting
+    if (!std::is_sorted(samples.cbegin(), samples.cend(), olderFirst)) {
+        std::stable_sort(samples.begin(), samples.end(), olderFirst);
+    }
+    
+    return Result<QVector<Sample>>::success(samples);
+}
+
+Result<DataPoint> TimeSeriesRepository::findLatestByTag(const QString& tag)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    auto result = querySamples(tag, std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max(), true);
+    if (result.isFailure()) {
+        return Result<DataPoint>::failure(result.error());
+    }
+    
+    if (result.value().isEmpty()) {
+        return Result<DataPoint>::failure("No data points found for tag: " + tag);
+    }
+    
+    return Result<DataPoint>::success(result.value().last());
+}
+
+Result<void> TimeSeriesRepository::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    for (auto it = m_openChunks.begin(); it != m_openChunks.end();) {
+        if (it->encoder.count() > 0 && !sealChunk(it.key(), it.value())) {
+            return Result<void>::failure("Failed to write chunk for " + it.key() + ": " + m_writer.errorString());
+        }
+        it = m_openChunks.erase(it);
+    }
+    
+    // Every journaled sample is in a sealed chunk now
+    if (!compactJournal()) {
+        return Result<void>::failure("Failed to empty journal: " + m_journal.errorString());
+    }
+    
+    return Result<void>::success();
+}
+
+Result<void> TimeSeriesRepository::deleteOlderThan(int retentionDays)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    const qint64 cutoffMs = QDateTime::currentDateTime().addDays(-retentionDays).toMSecsSinceEpoch();
+    
+    for (auto it = m_segments.begin(); it != m_segments.end();) {
+        const int number = it->first;
+        Segment& segment = it->second;
+        if (number == m_activeSegment || segment.maxTs >= cutoffMs) {
+            ++it;
+            continue;
+        }
+        
+        for (auto chunks = m_chunks.begin(); chunks != m_chunks.end();) {
+            QVector<ChunkRef>& refs = chunks.value();
+            refs.erase(std::remove_if(refs.begin(), refs.end(),
+                                      [number](const ChunkRef& chunk) { return chunk.segment == number; }),
+                       refs.end());
+            chunks = refs.isEmpty() ? m_chunks.erase(chunks) : std::next(chunks);
+        }
+        
+        if (segment.map) {
+            segment.file->unmap(segment.map);
+        }
+        segment.file->close();
+        if (!QFile::remove(segment.path)) {
+            return Result<void>::failure("Failed to remove " + segment.path);
+        }
+        
+        it = m_segments.erase(it);
+    }
+    
+    return Result<void>::success();
+}
+
+qint64 TimeSeriesRepository::storageSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    
+    qint64 total = 0;
+    for (const auto& entry : m_segments) {
+        total += entry.second.size;
+    }
+    return total;
+}
+
+bool TimeSeriesRepository::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_writer.isOpen();
+}
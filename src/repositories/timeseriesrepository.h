@@ -0,0 +1,305 @@
+#pragma once
+
+#include "../interfaces/irepository.h"
+#include "../models/datapoint.h"
+#include "../models/sample.h"
+#include "../utils/gorillacodec.h"
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <limits>
+#include <map>
+#include <memory>
+
+/**
+ * @brief Append-only, compressed time-series storage engine for DataPoints
+ * 
+ * Native alternative to SqliteRepository for dense numeric process data.
+ * Samples are buffered per tag and compressed with GorillaEncoder
+ * (delta-of-delta timestamps, XOR-encoded values); every SAMPLES_PER_CHUNK
+ * samples the tag's chunk is sealed and appended to the active segment
+ * file. Segments are memory-mapped for reading and chunks are decoded
+ * straight from the mapping.
+ * 
+ * Samples of open chunks are also appended to a small journal
+ * ("<directory>/open-chunks.journal") before save() returns. On open the
+ * journal is replayed into the open chunks, skipping tags whose chunk was
+ * sealed after the last journal record, so a crash of the process loses
+ * no acknowledged sample. The journal is rewritten with only the open
+ * samples once it exceeds JOURNAL_COMPACT_BYTES, and emptied by flush().
+ * 
+ * Pattern: Repository Pattern (RULE-202)
+ * Location: src/repositories/ (RULE-304)
+ * 
+ * Features:
+ * - About 1 byte per sample for regularly polled, slowly changing values
+ * - Append-only segment files, rolled over at MAX_SEGMENT_BYTES
+ * - Memory-mapped, zero-copy reads
+ * - CRC-32 checked chunk trailers; torn or corrupt chunks are detected on
+ *   open and a torn tail of the last segment is truncated away
+ * - CRC-32 checked journal records for samples not yet sealed into a chunk
+ * - Compact read path (findSamples()) decoding chunks into Samples
+ * - Retention by deleting whole segment files
+ * - Thread-safe operations (QMutex)
+ * 
+ * Segment file layout ("<directory>/segment-NNNNNNNN.tss", little endian):
+ * @code
+ * segment header:  magic "QTSS" | u32 version
+ * chunk:           u32 magic "CHNK" | u16 tag length | u8 flags | u8 reserved
+ *                  | i64 min ts | i64 max ts | u32 sample count | u32 payload length
+ *                  | tag (UTF-8) | payload (Gorilla stream)
+ *                  | u32 CRC-32 of everything above | u32 magic "CEND"
+ * journal record:  u16 tag length | u8 flags (integral, sealed) | u8 quality
+ *                  | i64 ts | f64 value | tag (UTF-8) | u32 CRC-32 of everything above
+ * @endcode
+ * 
+ * Limitations:
+ * - Only numeric values are stored (integral and boolean values come back
+ *   as qlonglong when a whole chunk is integral, otherwise as double);
+ *   save() fails for other types
+ * - deleteById() is not supported (append-only); use deleteOlderThan()
+ * - Chunks and journal records are flushed to the operating system, not
+ *   synced, so a power loss can still drop what it has not written back
+ * 
+ * Entity IDs are "<tag>@<msecsSinceEpoch>", as in SqliteRepository.
+ * 
+ * Example Usage:
+ * @code
+ * TimeSeriesRepository repo("history");
+ * repo.save(DataPoint("Temperature", 42.5));
+ * 
+ * auto result = repo.findByTagAndTimeRange("Temperature", start, end);
+ * @endcode
+ */
+class TimeSeriesRepository : public IRepository<DataPoint> {
+public:
+    /**
+     * @brief Samples per chunk before it is sealed and written
+     */
+    static constexpr int SAMPLES_PER_CHUNK = 1024;
+    
+    /**
+     * @brief Segment size after which a new segment file is started
+     */
+    static constexpr qint64 MAX_SEGMENT_BYTES = 64 * 1024 * 1024;
+    
+    /**
+     * @brief Journal size after which it is rewritten with only the open samples
+     */
+    static constexpr qint64 JOURNAL_COMPACT_BYTES = 1024 * 1024;
+    
+    /**
+     * @brief Construct a time-series repository
+     * @param directory Directory holding the segment files (created if missing)
+     */
+    explicit TimeSeriesRepository(const QString& directory = "timeseries");
+    
+    ~TimeSeriesRepository() override;
+    
+    // IRepository interface implementation
+    Result<void> save(const DataPoint& entity) override;
+    Result<DataPoint> findById(const QString& id) override;
+    Result<QList<DataPoint>> findAll() override;
+    Result<void> deleteById(const QString& id) override;
+    int count() const override;
+    Result<void> clear() override;
+    
+    /**
+     * @brief Find data points by tag
+     * @param tag The tag identifier
+     * @return Result containing matching data points, newest first
+     */
+    Result<QList<DataPoint>> findByTag(const QString& tag);
+    
+    /**
+     * @brief Find data points within a time range
+     * @param startTime Start of time range (inclusive)
+     * @param endTime End of time range (inclusive)
+     * @return Result containing matching data points, newest first
+     */
+    Result<QList<DataPoint>> findByTimeRange(const QDateTime& startTime, const QDateTime& endTime);
+    
+    /**
+     * @brief Find data points by tag within a time range
+     * @param tag The tag identifier
+     * @param startTime Start of time range (inclusive)
+     * @param endTime End of time range (inclusive)
+     * @return Result containing matching data points, newest first
+     */
+    Result<QList<DataPoint>> findByTagAndTimeRange(
+        const QString& tag,
+        const QDateTime& startTime,
+        const QDateTime& endTime
+    );
+    
+    /**
+     * @brief Load a tag's samples in compact form, oldest first
+     * 
+     * For plots and calculations over long ranges: chunks are decoded
+     * straight into Samples, without building a DataPoint per sample.
+     * Values come back as Sample::Type::Int when their chunk is integral,
+     * otherwise as Sample::Type::Double.
+     * @param tag The tag identifier
+     * @param startTime Start of time range (inclusive, invalid = unbounded)
+     * @param endTime End of time range (inclusive, invalid = unbounded)
+     * @return Result containing the samples (empty for unknown tags)
+     */
+    Result<QVector<Sample>> findSamples(
+        const QString& tag,
+        const QDateTime& startTime = QDateTime(),
+        const QDateTime& endTime = QDateTime()
+    );
+    
+    /**
+     * @brief Get the latest data point for a tag
+     * @param tag The tag identifier
+     * @return Result containing the most recent data point
+     */
+    Result<DataPoint> findLatestByTag(const QString& tag);
+    
+    /**
+     * @brief Seal all open chunks, write them to disk and empty the journal
+     * @return Result indicating success or failure
+     */
+    Result<void> flush();
+    
+    /**
+     * @brief Delete segment files whose samples are all beyond the retention period
+     * 
+     * Works at segment granularity: a segment is kept while it holds any
+     * sample younger than the cutoff. The active segment is never deleted.
+     * @param retentionDays Number of days to retain
+     * @return Result indicating success or failure
+     */
+    Result<void> deleteOlderThan(int retentionDays);
+    
+    /**
+     * @brief Total size of all segment files in bytes
+     */
+    qint64 storageSize() const;
+    
+    /**
+     * @brief Check if the storage directory is usable
+     * @return True if the active segment is open for writing
+     */
+    bool isOpen() const;
+
+private:
+    /**
+     * @brief Location of a sealed chunk inside a segment
+     */
+    struct ChunkRef {
+        int segment = 0;            // Segment number
+        qint64 payloadOffset = 0;   // File offset of the Gorilla stream
+        quint32 payloadLength = 0;
+        quint32 count = 0;
+        qint64 minTs = 0;
+        qint64 maxTs = 0;
+        bool integral = false;      // All values were integral
+    };
+    
+    /**
+     * @brief Chunk still being filled in memory
+     */
+    struct OpenChunk {
+        GorillaEncoder encoder;
+        qint64 minTs = 0;
+        qint64 maxTs = 0;
+        bool integral = true;
+    };
+    
+    /**
+     * @brief Segment file and its read mapping
+     */
+    struct Segment {
+        QString path;
+        std::unique_ptr<QFile> file;    // Opened read-only for mapping
+        uchar* map = nullptr;
+        qint64 mappedSize = 0;
+        qint64 size = 0;                // Bytes of valid chunks
+        qint64 maxTs = std::numeric_limits<qint64>::min();
+    };
+    
+    /**
+     * @brief Index all segments and open the active one for appending
+     */
+    bool initialize();
+    
+    /**
+     * @brief Scan a segment, index its valid chunks and return the valid size
+     * @param isLast Truncate a torn tail (only the last segment is ever written)
+     */
+    qint64 recoverSegment(int number, Segment& segment, bool isLast);
+    
+    /**
+     * @brief Start a new, empty segment file and make it the active one
+     */
+    bool startSegment(int number);
+    
+    /**
+     * @brief Encode and append an open chunk to the active segment
+     */
+    bool sealChunk(const QString& tag, const OpenChunk& chunk);
+    
+    /**
+     * @brief Append a sample (or, with sealed set, a seal marker) to the journal
+     */
+    bool appendJournal(const QString& tag, qint64 ts, double value, quint8 quality, bool integral, bool sealed);
+    
+    /**
+     * @brief Replay the journal into the open chunks and reopen it for appending
+     */
+    bool recoverJournal();
+    
+    /**
+     * @brief Rewrite the journal with only the samples of the open chunks
+     */
+    bool compactJournal();
+    
+    /**
+     * @brief Pointer to a byte range of a segment, remapping a grown file
+     */
+    const uchar* mapRange(int segmentNumber, qint64 offset, qint64 length);
+    
+    /**
+     * @brief Decode the samples of one tag within [startMs, endMs]
+     * @param latestOnly Only return the newest sample
+     */
+    Result<QList<DataPoint>> querySamples(const QString& tag, qint64 startMs, qint64 endMs, bool latestOnly);
+    
+    /**
+     * @brief Decode every chunk of a tag overlapping [startMs, endMs]
+     * 
+     * Calls visit(ts, value, quality, integral) for each sample in range,
+     * sealed chunks first, in chunk write order.
+     * @return False if a sealed chunk could not be read
+     */
+    template<typename Visitor>
+    bool visitSamples(const QString& tag, qint64 startMs, qint64 endMs, Visitor visit);
+    
+    /**
+     * @brief Decode the samples of all tags within [startMs, endMs], newest first
+     */
+    Result<QList<DataPoint>> queryAllTags(qint64 startMs, qint64 endMs);
+    
+    /**
+     * @brief Path of a segment file
+     */
+    QString segmentPath(int number) const;
+    
+    /**
+     * @brief Path of the open-chunk journal
+     */
+    QString journalPath() const;
+    
+    QString m_directory;                            // Segment directory
+    mutable QMutex m_mutex;                         // Thread safety
+    std::map<int, Segment> m_segments;              // Segment number -> segment
+    QHash<QString, QVector<ChunkRef>> m_chunks;     // Sealed chunks per tag, in write order
+    QHash<QString, OpenChunk> m_openChunks;         // Chunks being filled per tag
+    QFile m_writer;                                 // Active segment, opened for appending
+    QFile m_journal;                                // Open-chunk journal, opened for appending
+    int m_activeSegment;                            // Number of the active segment
+};
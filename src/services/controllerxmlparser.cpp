@@ -0,0 +1,673 @@
+#include "controllerxmlparser.h"
+#include "../utils/checksum.h"
+#include <QDebug>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+#include <cstring>
+
+namespace {
+
+// On-disk layout cache file: magic, format version, then the layout
+const quint32 LAYOUT_FILE_MAGIC = 0x43584C59; // "CXLY"
+const quint16 LAYOUT_FILE_VERSION = 2;     // 2: keyed by the markup only
+
+inline bool isXmlSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Whether data continues with text at pos
+inline bool hasAt(const QByteArray &data, int pos, const char *text)
+{
+    const int length = int(std::strlen(text));
+    return data.size() - pos >= length && std::memcmp(data.constData() + pos, text, length) == 0;
+}
+
+// Offset of the '>' closing the tag that starts at pos, skipping quoted
+// attribute values; -1 if the tag is not closed
+int tagEnd(const char *data, int size, int pos)
+{
+    char quote = 0;
+    for (int i = pos + 1; i < size; ++i) {
+        const char c = data[i];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+ControllerXmlParser::ControllerXmlParser()
+    : m_hasPage(false)
+    , m_layoutCache(MAX_CACHED_LAYOUTS)
+    , m_layoutKey(0)
+{
+}
+
+void ControllerXmlParser::setLayoutCacheDirectory(const QString &directory)
+{
+    m_layoutCacheDir = directory;
+}
+
+void ControllerXmlParser::clearLayoutCache()
+{
+    m_layoutCache.clear();
+    m_layoutKey = 0; // Next document takes the slow path again
+}
+
+void ControllerXmlParser::reset()
+{
+    m_page = XmlPage();
+    m_hasPage = false;
+    m_layoutKey = 0;
+    m_slots.clear();
+    m_rawValues.clear();
+}
+
+Result<ControllerXmlParser::XmlPageDiff> ControllerXmlParser::update(const QByteArray &xmlData)
+{
+    const bool scanned = scanValues(xmlData, m_scan);
+    
+    // Fast path: same layout as the current page, only values to patch
+    if (scanned && m_hasPage && m_layoutKey != 0 && m_scan.layoutKey == m_layoutKey
+        && m_scan.values.size() == m_slots.size()) {
+        m_statistics.valueRefreshes++;
+        XmlPageDiff diff;
+        diff.layoutChanged = false;
+        patchValues(xmlData, diff.changes);
+        return Result<XmlPageDiff>::success(diff);
+    }
+    
+    XmlPage page;
+    CachedLayout layout;
+    if (scanned && findLayout(m_scan.layoutKey, layout)
+        && layout.fieldSlots.size() == m_scan.values.size()) {
+        m_statistics.cachedLayouts++;
+        page = layout.page;
+        m_slots = layout.fieldSlots;
+        fillValues(xmlData, page);
+        m_layoutKey = m_scan.layoutKey;
+    } else {
+        try {
+            page = parseXmlData(xmlData);
+        } catch (const std::exception &e) {
+            return Result<XmlPageDiff>::failure(QString::fromStdString(e.what()));
+        }
+        m_statistics.fullParses++;
+        
+        // Documents the scanner can't map (entities in values, nested
+        // elements, ...) simply keep taking this path
+        m_layoutKey = 0;
+        if (scanned && mapSlots(xmlData, m_scan, page, layout.fieldSlots)) {
+            layout.page = page;
+            storeLayout(m_scan.layoutKey, layout);
+            m_slots = layout.fieldSlots;
+            m_layoutKey = m_scan.layoutKey;
+        }
+    }
+    
+    // Remember the raw value texts for the next fast refresh
+    if (m_layoutKey != 0) {
+        m_rawValues.resize(m_scan.values.size());
+        for (int i = 0; i < m_scan.values.size(); ++i) {
+            const ScannedValue &value = m_scan.values.at(i);
+            m_rawValues[i] = xmlData.mid(value.textStart, value.textLength);
+        }
+    }
+    
+    XmlPageDiff diff;
+    if (m_hasPage) {
+        diff = diffPages(m_page, page);
+    }
+    m_page = std::move(page);
+    m_hasPage = true;
+    return Result<XmlPageDiff>::success(diff);
+}
+
+ControllerXmlParser::XmlPage ControllerXmlParser::parseXmlData(const QByteArray &xmlData)
+{
+    QXmlStreamReader reader(xmlData);
+    XmlPage page;
+    
+    while (!reader.atEnd() && !reader.hasError()) {
+        QXmlStreamReader::TokenType token = reader.readNext();
+        
+        if (token == QXmlStreamReader::StartElement) {
+            if (reader.name() == "unit_page") {
+                parseUnitPage(reader, page);
+            }
+        }
+    }
+    
+    if (reader.hasError()) {
+        throw std::runtime_error(reader.errorString().toStdString());
+    }
+    
+    page.layoutHash = computeLayoutHash(page);
+    
+    qDebug() << "ControllerXmlParser: Parsed page with" << page.forms.size() << "forms";
+    return page;
+}
+
+void ControllerXmlParser::parseUnitPage(QXmlStreamReader &reader, XmlPage &page)
+{
+    // Read attributes
+    QXmlStreamAttributes attrs = reader.attributes();
+    page.version = attrs.value("version").toString();
+    
+    while (!reader.atEnd() && !reader.hasError()) {
+        QXmlStreamReader::TokenType token = reader.readNext();
+        
+        if (token == QXmlStreamReader::StartElement) {
+            if (reader.name() == "hdr") {
+                QXmlStreamAttributes hdrAttrs = reader.attributes();
+                page.title = hdrAttrs.value("title").toString();
+            } else if (reader.name() == "frm") {
+                XmlForm form;
+                parseForm(reader, form);
+                if (!form.columns.isEmpty()) {
+                    for (const auto &column : form.columns) {
+                        page.fieldCount += column.fields.size();
+                    }
+                    page.forms.append(form);
+                }
+            }
+        } else if (token == QXmlStreamReader::EndElement) {
+            if (reader.name() == "unit_page") {
+                break;
+            }
+        }
+    }
+}
+
+void ControllerXmlParser::parseForm(QXmlStreamReader &reader, XmlForm &form)
+{
+    QXmlStreamAttributes attrs = reader.attributes();
+    form.type = attrs.value("type").toString();
+    form.title = attrs.value("title").toString();
+    
+    while (!reader.atEnd() && !reader.hasError()) {
+        QXmlStreamReader::TokenType token = reader.readNext();
+        
+        if (token == QXmlStreamReader::StartElement) {
+            if (reader.name() == "col") {
+                XmlColumn column;
+                parseColumn(reader, column);
+                form.columns.append(column);
+            }
+        } else if (token == QXmlStreamReader::EndElement) {
+            if (reader.name() == "frm") {
+                break;
+            }
+        }
+    }
+}
+
+void ControllerXmlParser::parseColumn(QXmlStreamReader &reader, XmlColumn &column)
+{
+    QXmlStreamAttributes attrs = reader.attributes();
+    column.width = attrs.value("width").toString();
+    column.title = attrs.value("title").toString();
+    
+    while (!reader.atEnd() && !reader.hasError()) {
+        QXmlStreamReader::TokenType token = reader.readNext();
+        
+        if (token == QXmlStreamReader::StartElement) {
+            if (reader.name() == "val") {
+                XmlField field;
+                parseField(reader, field);
+                if (!field.id.isEmpty()) {
+                    column.fields.append(field);
+                }
+            }
+        } else if (token == QXmlStreamReader::EndElement) {
+            if (reader.name() == "col") {
+                break;
+            }
+        }
+    }
+}
+
+void ControllerXmlParser::parseField(QXmlStreamReader &reader, XmlField &field)
+{
+    QXmlStreamAttributes attrs = reader.attributes();
+    
+    field.id = attrs.value("id").toString();
+    field.label = attrs.value("label").toString();
+    field.var = attrs.value("var").toString();
+    field.type = attrs.value("type").toString();
+    field.unit = attrs.value("unit").toString();
+    field.calc = attrs.value("calc").toString();
+    field.hidden = (attrs.value("hidden").toString() == "true");
+    field.optds = attrs.value("optds").toString();
+    field.optdv = attrs.value("optdv").toString();
+    
+    // The live value is the element text; reading it also moves to the end of val
+    field.value = decodeValue(reader.readElementText(QXmlStreamReader::SkipChildElements), field.calc);
+}
+
+QVariant ControllerXmlParser::decodeValue(const QString &text, const QString &calc)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty()) {
+        return QVariant();
+    }
+    
+    bool isNumber = false;
+    const double number = trimmed.toDouble(&isNumber);
+    if (isNumber && !calc.isEmpty()) {
+        return applyCalculation(calc, number);
+    }
+    return trimmed;
+}
+
+uint ControllerXmlParser::computeLayoutHash(const XmlPage &page)
+{
+    // Everything that shapes the widget tree; values are deliberately left out
+    uint hash = qHash(page.title, qHash(page.version));
+    for (const auto &form : page.forms) {
+        hash = qHash(form.type, hash);
+        hash = qHash(form.title, hash);
+        for (const auto &column : form.columns) {
+            hash = qHash(column.title, hash);
+            hash = qHash(column.width, hash);
+            for (const auto &field : column.fields) {
+                hash = qHash(field.id, hash);
+                hash = qHash(field.label, hash);
+                hash = qHash(field.var, hash);
+                hash = qHash(field.type, hash);
+                hash = qHash(field.unit, hash);
+                hash = qHash(field.calc, hash);
+                hash = qHash(field.hidden, hash);
+                hash = qHash(field.optds, hash);
+                hash = qHash(field.optdv, hash);
+            }
+        }
+    }
+    return hash;
+}
+
+ControllerXmlParser::XmlPageDiff ControllerXmlParser::diffPages(const XmlPage &previous, const XmlPage &current)
+{
+    XmlPageDiff diff;
+    if (previous.layoutHash != current.layoutHash
+        || previous.fieldCount != current.fieldCount
+        || previous.forms.size() != current.forms.size()) {
+        return diff;
+    }
+    
+    // Same hash: walk both pages in lockstep, still checking the shape and
+    // field IDs so a hash collision can never patch the wrong widget
+    for (int f = 0; f < current.forms.size(); ++f) {
+        const XmlForm &oldForm = previous.forms.at(f);
+        const XmlForm &newForm = current.forms.at(f);
+        if (oldForm.columns.size() != newForm.columns.size()) {
+            return XmlPageDiff();
+        }
+        
+        for (int c = 0; c < newForm.columns.size(); ++c) {
+            const QList<XmlField> &oldFields = oldForm.columns.at(c).fields;
+            const QList<XmlField> &newFields = newForm.columns.at(c).fields;
+            if (oldFields.size() != newFields.size()) {
+                return XmlPageDiff();
+            }
+            
+            for (int i = 0; i < newFields.size(); ++i) {
+                const XmlField &oldField = oldFields.at(i);
+                const XmlField &newField = newFields.at(i);
+                if (oldField.id != newField.id) {
+                    return XmlPageDiff();
+                }
+                if (oldField.value != newField.value) {
+                    diff.changes.append({newField.id, newField.value});
+                }
+            }
+        }
+    }
+    
+    diff.layoutChanged = false;
+    return diff;
+}
+
+QVariant ControllerXmlParser::applyCalculation(const QString &calc, const QVariant &value)
+{
+    if (calc.isEmpty()) {
+        return value;
+    }
+    
+    // Each distinct calc is compiled once, e.g. "val/10" or "val==0?val:(val+1)/100"
+    auto program = m_calcPrograms.constFind(calc);
+    if (program == m_calcPrograms.constEnd()) {
+        Result<CalcExpression> compiled = CalcExpression::compile(calc);
+        if (compiled.isFailure()) {
+            // Shown raw, as before this expression could be evaluated
+            qWarning() << "ControllerXmlParser: Ignoring calc" << calc << "-" << compiled.error();
+        }
+        program = m_calcPrograms.insert(calc, compiled.valueOr(CalcExpression()));
+    }
+    return program->evaluate(value.toDouble());
+}
+
+bool ControllerXmlParser::scanValues(const QByteArray &xmlData, ValueScan &scan)
+{
+    // Finds every <val> element and the byte range of its text without
+    // building any strings. The markup - every tag with its attributes,
+    // but no text content - is checksummed into the layout key, since text
+    // outside <val> never reaches the page. Anything the fast path could
+    // get wrong (entities or child elements in values, DOCTYPE) fails the
+    // scan.
+    scan.values.clear();
+    const char *data = xmlData.constData();
+    const int size = xmlData.size();
+    
+    quint32 crc = 0;
+    qint64 markupLength = 0;
+    int pos = 0;
+    
+    while ((pos = xmlData.indexOf('<', pos)) >= 0) {
+        if (hasAt(xmlData, pos, "<!--")) {
+            const int end = xmlData.indexOf("-->", pos + 4);
+            if (end < 0) {
+                return false;
+            }
+            pos = end + 3;
+            continue;
+        }
+        if (hasAt(xmlData, pos, "<![CDATA[")) {
+            const int end = xmlData.indexOf("]]>", pos + 9);
+            if (end < 0) {
+                return false;
+            }
+            pos = end + 3;
+            continue;
+        }
+        if (pos + 1 < size && data[pos + 1] == '!') {
+            return false;
+        }
+        
+        const int end = tagEnd(data, size, pos);
+        if (end < 0) {
+            return false;
+        }
+        crc = crc32(reinterpret_cast<const uchar*>(data + pos), end + 1 - pos, crc);
+        markupLength += end + 1 - pos;
+        
+        const bool isVal = hasAt(xmlData, pos, "<val")
+                           && (isXmlSpace(data[pos + 4]) || data[pos + 4] == '>' || data[pos + 4] == '/');
+        if (!isVal) {
+            pos = end + 1; // Some other element, e.g. <value> or </val>
+            continue;
+        }
+        
+        ScannedValue value = {0, 0, end + 1, 0};
+        
+        // id="..." or id='...'
+        for (int i = pos + 4; i + 4 < end; ++i) {
+            if (data[i] == 'i' && data[i + 1] == 'd' && data[i + 2] == '='
+                && isXmlSpace(data[i - 1]) && (data[i + 3] == '"' || data[i + 3] == '\'')) {
+                const char quote = data[i + 3];
+                const char *idEnd = static_cast<const char*>(
+                    std::memchr(data + i + 4, quote, end - (i + 4)));
+                if (!idEnd) {
+                    return false;
+                }
+                value.idStart = i + 4;
+                value.idLength = int(idEnd - data) - value.idStart;
+                break;
+            }
+        }
+        
+        pos = end + 1;
+        if (data[end - 1] != '/') {
+            // The text runs up to the closing tag, which is checksummed next
+            const int textEnd = xmlData.indexOf('<', value.textStart);
+            if (textEnd < 0 || !hasAt(xmlData, textEnd, "</val>")) {
+                return false;
+            }
+            value.textLength = textEnd - value.textStart;
+            if (std::memchr(data + value.textStart, '&', value.textLength)) {
+                return false;
+            }
+            pos = textEnd;
+        }
+        scan.values.append(value);
+    }
+    
+    scan.layoutKey = (quint64(markupLength) << 32) | crc;
+    return true;
+}
+
+bool ControllerXmlParser::mapSlots(const QByteArray &xmlData, const ValueScan &scan,
+                                    const XmlPage &page, QVector<FieldSlot> &fieldSlots)
+{
+    // Pair scanned values with parsed fields in document order. Values the
+    // parser dropped (no id, outside a column, empty form) get no field.
+    fieldSlots.clear();
+    fieldSlots.reserve(scan.values.size());
+    
+    int form = 0, column = 0, field = 0;
+    auto skipEmpty = [&]() {
+        while (form < page.forms.size()) {
+            const QList<XmlColumn> &columns = page.forms.at(form).columns;
+            if (column < columns.size() && field < columns.at(column).fields.size()) {
+                return;
+            }
+            if (column < columns.size()) {
+                ++column;
+            } else {
+                ++form;
+                column = 0;
+            }
+            field = 0;
+        }
+    };
+    
+    skipEmpty();
+    for (const ScannedValue &value : scan.values) {
+        FieldSlot slot;
+        if (form < page.forms.size()) {
+            const XmlField &expected = page.forms.at(form).columns.at(column).fields.at(field);
+            const QByteArray id = QByteArray::fromRawData(xmlData.constData() + value.idStart, value.idLength);
+            if (expected.id.toUtf8() == id) {
+                slot.form = form;
+                slot.column = column;
+                slot.field = field;
+                ++field;
+                skipEmpty();
+            }
+        }
+        fieldSlots.append(slot);
+    }
+    
+    // Every parsed field must have been found
+    return form == page.forms.size();
+}
+
+void ControllerXmlParser::patchValues(const QByteArray &xmlData, QVector<XmlValueChange> &changes)
+{
+    const char *data = xmlData.constData();
+    for (int i = 0; i < m_slots.size(); ++i) {
+        const FieldSlot &slot = m_slots.at(i);
+        if (slot.form < 0) {
+            continue;
+        }
+        
+        const ScannedValue &value = m_scan.values.at(i);
+        QByteArray &previous = m_rawValues[i];
+        if (previous.size() == value.textLength
+            && std::memcmp(previous.constData(), data + value.textStart, value.textLength) == 0) {
+            continue;
+        }
+        
+        previous = xmlData.mid(value.textStart, value.textLength);
+        XmlField &field = m_page.forms[slot.form].columns[slot.column].fields[slot.field];
+        const QVariant decoded = decodeValue(QString::fromUtf8(previous), field.calc);
+        if (decoded != field.value) {
+            field.value = decoded;
+            changes.append({field.id, decoded});
+        }
+    }
+}
+
+void ControllerXmlParser::fillValues(const QByteArray &xmlData, XmlPage &page)
+{
+    for (int i = 0; i < m_slots.size(); ++i) {
+        const FieldSlot &slot = m_slots.at(i);
+        if (slot.form >= 0) {
+            const ScannedValue &value = m_scan.values.at(i);
+            XmlField &field = page.forms[slot.form].columns[slot.column].fields[slot.field];
+            field.value = decodeValue(QString::fromUtf8(xmlData.constData() + value.textStart, value.textLength),
+                                      field.calc);
+        }
+    }
+}
+
+bool ControllerXmlParser::findLayout(quint64 key, CachedLayout &layout)
+{
+    if (const CachedLayout *cached = m_layoutCache.object(key)) {
+        layout = *cached;
+        return true;
+    }
+    
+    if (m_layoutCacheDir.isEmpty()) {
+        return false;
+    }
+    QFile file(layoutCacheFile(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // Marks the file as recently used for pruneLayoutFiles(); Windows only
+    // sets file times through a handle opened for writing
+    QFile touch(file.fileName());
+    if (!touch.open(QIODevice::ReadWrite)
+        || !touch.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime)) {
+        qWarning() << "ControllerXmlParser: Failed to mark layout cache file as used" << file.fileName()
+                   << "-" << touch.errorString();
+    }
+    touch.close();
+    
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != LAYOUT_FILE_MAGIC || version != LAYOUT_FILE_VERSION) {
+        return false;
+    }
+    
+    CachedLayout loaded;
+    qint32 formCount = 0;
+    in >> loaded.page.title >> loaded.page.version >> loaded.page.fieldCount >> formCount;
+    for (qint32 f = 0; f < formCount && in.status() == QDataStream::Ok; ++f) {
+        XmlForm form;
+        qint32 columnCount = 0;
+        in >> form.type >> form.title >> columnCount;
+        for (qint32 c = 0; c < columnCount && in.status() == QDataStream::Ok; ++c) {
+            XmlColumn column;
+            qint32 fieldCount = 0;
+            in >> column.title >> column.width >> fieldCount;
+            for (qint32 i = 0; i < fieldCount && in.status() == QDataStream::Ok; ++i) {
+                XmlField field;
+                in >> field.id >> field.label >> field.var >> field.type >> field.unit
+                   >> field.calc >> field.hidden >> field.optds >> field.optdv;
+                column.fields.append(field);
+            }
+            form.columns.append(column);
+        }
+        loaded.page.forms.append(form);
+    }
+    
+    qint32 slotCount = 0;
+    in >> slotCount;
+    for (qint32 i = 0; i < slotCount && in.status() == QDataStream::Ok; ++i) {
+        FieldSlot slot;
+        in >> slot.form >> slot.column >> slot.field;
+        loaded.fieldSlots.append(slot);
+    }
+    
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "ControllerXmlParser: Ignoring corrupt layout cache file" << file.fileName();
+        return false;
+    }
+    // qHash() values are not meant to be persisted
+    loaded.page.layoutHash = computeLayoutHash(loaded.page);
+    
+    layout = loaded;
+    m_layoutCache.insert(key, new CachedLayout(std::move(loaded)));
+    return true;
+}
+
+void ControllerXmlParser::storeLayout(quint64 key, const CachedLayout &layout)
+{
+    // Values change every refresh; only the structure is worth keeping
+    CachedLayout stripped = layout;
+    for (auto &form : stripped.page.forms) {
+        for (auto &column : form.columns) {
+            for (auto &field : column.fields) {
+                field.value = QVariant();
+            }
+        }
+    }
+    m_layoutCache.insert(key, new CachedLayout(stripped));
+    
+    if (m_layoutCacheDir.isEmpty() || !QDir().mkpath(m_layoutCacheDir)) {
+        return;
+    }
+    QSaveFile file(layoutCacheFile(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    const XmlPage &page = stripped.page;
+    out << LAYOUT_FILE_MAGIC << LAYOUT_FILE_VERSION;
+    out << page.title << page.version << qint32(page.fieldCount) << qint32(page.forms.size());
+    for (const auto &form : page.forms) {
+        out << form.type << form.title << qint32(form.columns.size());
+        for (const auto &column : form.columns) {
+            out << column.title << column.width << qint32(column.fields.size());
+            for (const auto &field : column.fields) {
+                out << field.id << field.label << field.var << field.type << field.unit
+                    << field.calc << field.hidden << field.optds << field.optdv;
+            }
+        }
+    }
+    out << qint32(stripped.fieldSlots.size());
+    for (const auto &slot : stripped.fieldSlots) {
+        out << slot.form << slot.column << slot.field;
+    }
+    
+    if (!file.commit()) {
+        qWarning() << "ControllerXmlParser: Failed to write layout cache file" << file.fileName();
+        return;
+    }
+    pruneLayoutFiles();
+}
+
+QString ControllerXmlParser::layoutCacheFile(quint64 key) const
+{
+    return m_layoutCacheDir + QString("/%1.layout").arg(key, 16, 16, QChar('0'));
+}
+
+void ControllerXmlParser::pruneLayoutFiles() const
+{
+    // Newest first; files read from the cache are touched by findLayout()
+    const QFileInfoList files = QDir(m_layoutCacheDir).entryInfoList(QStringList() << "*.layout",
+                                                                     QDir::Files, QDir::Time);
+    for (int i = MAX_LAYOUT_FILES; i < files.size(); ++i) {
+        QFile::remove(files.at(i).absoluteFilePath());
+    }
+}
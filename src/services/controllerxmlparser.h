@@ -0,0 +1,165 @@
+#pragma once
+
+#include "controllerxmlservice.h"
+#include "../utils/calcexpression.h"
+#include "../utils/result.h"
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QXmlStreamReader>
+
+/**
+ * @brief Parser turning controller XML documents into an XmlPage
+ * 
+ * Keeps the page of one document source (one controller page) up to date
+ * across refreshes. The structural part of a page (forms, columns, field
+ * labels, units, options) is cached, keyed by a checksum of the document's
+ * markup - element tags and their attributes, without any text content. A
+ * refreshed document with a known layout is only scanned for the <val>
+ * texts, and only changed values are decoded into the page.
+ * 
+ * The memory cache keeps the MAX_CACHED_LAYOUTS most recently used
+ * layouts. The optional on-disk cache (setLayoutCacheDirectory(), off by
+ * default) survives restarts and is pruned to the MAX_LAYOUT_FILES most
+ * recently used files whenever a layout is added.
+ * 
+ * Pattern: Utility (no QObject), used by ControllerXmlService and
+ * XmlAcquisitionService
+ * Location: src/services/
+ * 
+ * Threading: Not thread-safe. A parser may be used from any thread, but
+ * from one thread at a time. Parsers sharing a layout cache directory may
+ * run concurrently (cache files are replaced atomically).
+ */
+class ControllerXmlParser
+{
+public:
+    using XmlField = ControllerXmlService::XmlField;
+    using XmlColumn = ControllerXmlService::XmlColumn;
+    using XmlForm = ControllerXmlService::XmlForm;
+    using XmlPage = ControllerXmlService::XmlPage;
+    using XmlValueChange = ControllerXmlService::XmlValueChange;
+    using XmlPageDiff = ControllerXmlService::XmlPageDiff;
+    
+    /**
+     * @brief How documents were handled since construction
+     */
+    struct Statistics
+    {
+        int fullParses = 0;         // Documents parsed with QXmlStreamReader
+        int cachedLayouts = 0;      // Layouts taken from the layout cache instead
+        int valueRefreshes = 0;     // Documents that only needed their values scanned
+    };
+    
+    static constexpr int MAX_CACHED_LAYOUTS = 16;   // Layouts kept in memory
+    static constexpr int MAX_LAYOUT_FILES = 64;     // Layout files kept in the cache directory
+    
+    /**
+     * @brief Create a parser caching layouts in memory only
+     */
+    ControllerXmlParser();
+    
+    /**
+     * @brief Directory of the on-disk layout cache; empty (the default) keeps layouts in memory only
+     */
+    void setLayoutCacheDirectory(const QString &directory);
+    QString layoutCacheDirectory() const { return m_layoutCacheDir; }
+    
+    /**
+     * @brief Forget cached layouts (the disk cache is kept)
+     */
+    void clearLayoutCache();
+    
+    /**
+     * @brief Forget the current page; the next document is reported as a new layout
+     */
+    void reset();
+    
+    /**
+     * @brief Apply a fetched document to the current page
+     * @return What changed compared to the previous page (layoutChanged for
+     *         the first document); failure if the document is not valid XML
+     */
+    Result<XmlPageDiff> update(const QByteArray &xmlData);
+    
+    /**
+     * @brief Current page (empty until the first successful update())
+     */
+    const XmlPage& page() const { return m_page; }
+    bool hasPage() const { return m_hasPage; }
+    
+    const Statistics& statistics() const { return m_statistics; }
+    
+    /**
+     * @brief Compare two parsed pages field by field
+     * 
+     * Cheap when the layout is unchanged: the layout hashes are compared
+     * first, then the values are walked in document order without any
+     * lookups or allocations for unchanged fields.
+     */
+    static XmlPageDiff diffPages(const XmlPage &previous, const XmlPage &current);
+
+private:
+    // Position of a scanned <val> in the page, form < 0 if it has no field
+    struct FieldSlot
+    {
+        qint32 form = -1;
+        qint32 column = -1;
+        qint32 field = -1;
+    };
+    
+    // Structural part of a page; field values are left empty
+    struct CachedLayout
+    {
+        XmlPage page;
+        QVector<FieldSlot> fieldSlots; // One per scanned <val>, in document order
+    };
+    
+    // Byte ranges of one <val> element
+    struct ScannedValue
+    {
+        int idStart;
+        int idLength;
+        int textStart;
+        int textLength;
+    };
+    
+    struct ValueScan
+    {
+        quint64 layoutKey = 0;      // Markup length << 32 | CRC-32 of the markup
+        QVector<ScannedValue> values;
+    };
+    
+    XmlPage parseXmlData(const QByteArray &xmlData);
+    void parseUnitPage(QXmlStreamReader &reader, XmlPage &page);
+    void parseForm(QXmlStreamReader &reader, XmlForm &form);
+    void parseColumn(QXmlStreamReader &reader, XmlColumn &column);
+    void parseField(QXmlStreamReader &reader, XmlField &field);
+    QVariant decodeValue(const QString &text, const QString &calc);
+    QVariant applyCalculation(const QString &calc, const QVariant &value);
+    static uint computeLayoutHash(const XmlPage &page);
+    
+    static bool scanValues(const QByteArray &xmlData, ValueScan &scan);
+    static bool mapSlots(const QByteArray &xmlData, const ValueScan &scan,
+                         const XmlPage &page, QVector<FieldSlot> &fieldSlots);
+    void patchValues(const QByteArray &xmlData, QVector<XmlValueChange> &changes);
+    void fillValues(const QByteArray &xmlData, XmlPage &page);
+    bool findLayout(quint64 key, CachedLayout &layout);
+    void storeLayout(quint64 key, const CachedLayout &layout);
+    QString layoutCacheFile(quint64 key) const;
+    void pruneLayoutFiles() const;
+    
+    XmlPage m_page;
+    bool m_hasPage;
+    Statistics m_statistics;
+    
+    QString m_layoutCacheDir;
+    QCache<quint64, CachedLayout> m_layoutCache;    // Layout key -> layout, least recently used dropped
+    quint64 m_layoutKey;                            // Layout of m_page, 0 = not cached
+    QVector<FieldSlot> m_slots;                     // Slots of m_page
+    QVector<QByteArray> m_rawValues;                // Value text per slot, as last received
+    ValueScan m_scan;                               // Reused between refreshes
+    QHash<QString, CalcExpression> m_calcPrograms;  // calc attribute -> compiled program
+};
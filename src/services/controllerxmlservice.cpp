@@ -1,12 +1,13 @@
 #include "controllerxmlservice.h"
+#include "controllerxmlparser.h"
 #include <QNetworkRequest>
 #include <QDebug>
-#include <QRegularExpression>
 
 ControllerXmlService::ControllerXmlService(QObject *parent)
     : QObject(parent)
     , m_networkManager(new QNetworkAccessManager(this))
     , m_refreshTimer(new QTimer(this))
+    , m_parser(new ControllerXmlParser())
     , m_refreshInterval(5000) // Default 5 seconds
 {
     connect(m_refreshTimer, &QTimer::timeout, this, &ControllerXmlService::onAutoRefreshTimeout);
@@ -23,6 +24,8 @@ void ControllerXmlService::setBaseUrl(const QString &baseUrl)
     if (!m_baseUrl.endsWith('/')) {
         m_baseUrl += '/';
     }
+    m_validators.clear();
+    m_parser->reset();
     qDebug() << "ControllerXmlService: Base URL set to" << m_baseUrl;
 }
 
@@ -35,6 +38,35 @@ void ControllerXmlService::setRefreshInterval(int intervalMs)
     qDebug() << "ControllerXmlService: Refresh interval set to" << intervalMs << "ms";
 }
 
+void ControllerXmlService::setLayoutCacheDirectory(const QString &directory)
+{
+    m_parser->setLayoutCacheDirectory(directory);
+}
+
+void ControllerXmlService::clearLayoutCache()
+{
+    m_parser->clearLayoutCache();
+}
+
+const ControllerXmlService::XmlPage& ControllerXmlService::getCurrentPage() const
+{
+    return m_parser->page();
+}
+
+ControllerXmlService::FetchStatistics ControllerXmlService::getStatistics() const
+{
+    FetchStatistics statistics = m_statistics;
+    statistics.fullParses = m_parser->statistics().fullParses;
+    statistics.cachedLayouts = m_parser->statistics().cachedLayouts;
+    statistics.valueRefreshes = m_parser->statistics().valueRefreshes;
+    return statistics;
+}
+
+ControllerXmlService::XmlPageDiff ControllerXmlService::diffPages(const XmlPage &previous, const XmlPage &current)
+{
+    return ControllerXmlParser::diffPages(previous, current);
+}
+
 void ControllerXmlService::fetchXmlFile(const QString &fileName)
 {
     if (m_baseUrl.isEmpty()) {
@@ -42,20 +74,55 @@ void ControllerXmlService::fetchXmlFile(const QString &fileName)
         return;
     }
 
+    if (fileName != m_currentFileName) {
+        m_parser->reset(); // Different page, nothing to diff against
+    }
+    m_currentFileName = fileName;
+
     QUrl url(m_baseUrl + fileName);
+    const QString urlKey = url.toString();
+
+    // A slow controller may still be answering the previous refresh; its
+    // reply serves this fetch too
+    if (m_pendingReplies.contains(urlKey)) {
+        m_statistics.coalesced++;
+        return;
+    }
+
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::UserAgentHeader, "Qt Industrial HMI Client");
+    // Requests to one controller share its persistent connections and may
+    // be pipelined on them. Accept-Encoding is left to QNetworkAccessManager:
+    // it offers gzip/deflate and inflates transparently only if we don't set it.
+    request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    
+    // Only ask for a 304 while we still hold the page it would stand for
+    if (m_parser->hasPage()) {
+        auto validators = m_validators.constFind(urlKey);
+        if (validators != m_validators.constEnd()) {
+            if (!validators->etag.isEmpty()) {
+                request.setRawHeader("If-None-Match", validators->etag);
+            }
+            if (!validators->lastModified.isEmpty()) {
+                request.setRawHeader("If-Modified-Since", validators->lastModified);
+            }
+        }
+    }
     
-    qDebug() << "ControllerXmlService: Fetching" << url.toString();
+    qDebug() << "ControllerXmlService: Fetching" << urlKey;
     
     QNetworkReply *reply = m_networkManager->get(request);
+    reply->setProperty("xmlFileName", fileName);
     connect(reply, &QNetworkReply::finished, this, &ControllerXmlService::onNetworkReply);
-    
-    m_currentFileName = fileName;
+    m_pendingReplies.insert(urlKey, reply);
+    m_statistics.requests++;
 }
 
 void ControllerXmlService::startAutoRefresh(const QString &fileName)
 {
+    if (fileName != m_currentFileName) {
+        m_parser->reset();
+    }
     m_currentFileName = fileName;
     m_refreshTimer->start(m_refreshInterval);
     qDebug() << "ControllerXmlService: Auto-refresh started for" << fileName;
@@ -76,6 +143,10 @@ void ControllerXmlService::onNetworkReply()
     if (!reply) return;
 
     reply->deleteLater();
+    const QString urlKey = reply->request().url().toString();
+    if (m_pendingReplies.value(urlKey) == reply) {
+        m_pendingReplies.remove(urlKey);
+    }
 
     if (reply->error() != QNetworkReply::NoError) {
         QString error = QString("Network error: %1").arg(reply->errorString());
@@ -84,169 +155,62 @@ void ControllerXmlService::onNetworkReply()
         return;
     }
 
-    QByteArray xmlData = reply->readAll();
-    qDebug() << "ControllerXmlService: Received" << xmlData.size() << "bytes of XML data";
-
-    try {
-        parseXmlData(xmlData);
-        if (m_refreshTimer->isActive()) {
-            emit xmlDataUpdated(m_currentPage);
-        } else {
-            emit xmlDataReceived(m_currentPage);
-        }
-    } catch (const std::exception &e) {
-        QString error = QString("XML parsing error: %1").arg(e.what());
-        qDebug() << "ControllerXmlService:" << error;
-        emit parsingError(error);
-    }
-}
-
-void ControllerXmlService::onAutoRefreshTimeout()
-{
-    if (!m_currentFileName.isEmpty()) {
-        fetchXmlFile(m_currentFileName);
+    // Ignore answers for a page we have navigated away from
+    if (reply->property("xmlFileName").toString() != m_currentFileName) {
+        return;
     }
-}
 
-void ControllerXmlService::parseXmlData(const QByteArray &xmlData)
-{
-    QXmlStreamReader reader(xmlData);
-    m_currentPage = XmlPage(); // Reset current page
-
-    while (!reader.atEnd() && !reader.hasError()) {
-        QXmlStreamReader::TokenType token = reader.readNext();
-        
-        if (token == QXmlStreamReader::StartElement) {
-            if (reader.name() == "unit_page") {
-                parseUnitPage(reader);
-            }
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 304) {
+        m_statistics.notModified++;
+        if (m_parser->hasPage()) {
+            emit xmlDataUpdated(m_parser->page());
         }
+        return;
     }
 
-    if (reader.hasError()) {
-        throw std::runtime_error(reader.errorString().toStdString());
-    }
-
-    qDebug() << "ControllerXmlService: Parsed page with" << m_currentPage.forms.size() << "forms";
-}
+    QByteArray xmlData = reply->readAll();
+    m_statistics.bytesReceived += xmlData.size();
+    qDebug() << "ControllerXmlService: Received" << xmlData.size() << "bytes of XML data";
 
-void ControllerXmlService::parseUnitPage(QXmlStreamReader &reader)
-{
-    // Read attributes
-    QXmlStreamAttributes attrs = reader.attributes();
-    m_currentPage.version = attrs.value("version").toString();
-
-    while (!reader.atEnd() && !reader.hasError()) {
-        QXmlStreamReader::TokenType token = reader.readNext();
-        
-        if (token == QXmlStreamReader::StartElement) {
-            if (reader.name() == "hdr") {
-                QXmlStreamAttributes hdrAttrs = reader.attributes();
-                m_currentPage.title = hdrAttrs.value("title").toString();
-            } else if (reader.name() == "frm") {
-                XmlForm form;
-                parseForm(reader, form);
-                if (!form.columns.isEmpty()) {
-                    m_currentPage.forms.append(form);
-                }
-            }
-        } else if (token == QXmlStreamReader::EndElement) {
-            if (reader.name() == "unit_page") {
-                break;
-            }
-        }
+    CacheValidators validators;
+    validators.etag = reply->rawHeader("ETag");
+    validators.lastModified = reply->rawHeader("Last-Modified");
+    if (validators.etag.isEmpty() && validators.lastModified.isEmpty()) {
+        m_validators.remove(urlKey);
+    } else {
+        m_validators.insert(urlKey, validators);
     }
-}
 
-void ControllerXmlService::parseForm(QXmlStreamReader &reader, XmlForm &form)
-{
-    QXmlStreamAttributes attrs = reader.attributes();
-    form.type = attrs.value("type").toString();
-    form.title = attrs.value("title").toString();
-
-    while (!reader.atEnd() && !reader.hasError()) {
-        QXmlStreamReader::TokenType token = reader.readNext();
-        
-        if (token == QXmlStreamReader::StartElement) {
-            if (reader.name() == "col") {
-                XmlColumn column;
-                parseColumn(reader, column);
-                form.columns.append(column);
-            }
-        } else if (token == QXmlStreamReader::EndElement) {
-            if (reader.name() == "frm") {
-                break;
-            }
-        }
-    }
+    processXmlData(xmlData);
 }
 
-void ControllerXmlService::parseColumn(QXmlStreamReader &reader, XmlColumn &column)
+void ControllerXmlService::onAutoRefreshTimeout()
 {
-    QXmlStreamAttributes attrs = reader.attributes();
-    column.width = attrs.value("width").toString();
-    column.title = attrs.value("title").toString();
-
-    while (!reader.atEnd() && !reader.hasError()) {
-        QXmlStreamReader::TokenType token = reader.readNext();
-        
-        if (token == QXmlStreamReader::StartElement) {
-            if (reader.name() == "val") {
-                XmlField field;
-                parseField(reader, field);
-                if (!field.id.isEmpty()) {
-                    column.fields.append(field);
-                }
-            }
-        } else if (token == QXmlStreamReader::EndElement) {
-            if (reader.name() == "col") {
-                break;
-            }
-        }
+    if (!m_currentFileName.isEmpty()) {
+        fetchXmlFile(m_currentFileName);
     }
 }
 
-void ControllerXmlService::parseField(QXmlStreamReader &reader, XmlField &field)
+void ControllerXmlService::processXmlData(const QByteArray &xmlData)
 {
-    QXmlStreamAttributes attrs = reader.attributes();
+    const Result<XmlPageDiff> result = m_parser->update(xmlData);
+    if (result.isFailure()) {
+        QString error = QString("XML parsing error: %1").arg(result.error());
+        qDebug() << "ControllerXmlService:" << error;
+        emit parsingError(error);
+        return;
+    }
     
-    field.id = attrs.value("id").toString();
-    field.label = attrs.value("label").toString();
-    field.var = attrs.value("var").toString();
-    field.type = attrs.value("type").toString();
-    field.unit = attrs.value("unit").toString();
-    field.calc = attrs.value("calc").toString();
-    field.hidden = (attrs.value("hidden").toString() == "true");
-    field.optds = attrs.value("optds").toString();
-    field.optdv = attrs.value("optdv").toString();
-
-    // Skip to end of val element
-    while (!reader.atEnd() && !reader.hasError()) {
-        QXmlStreamReader::TokenType token = reader.readNext();
-        if (token == QXmlStreamReader::EndElement && reader.name() == "val") {
-            break;
+    // Only a changed layout needs the widgets rebuilt; otherwise
+    // listeners patch the changed values in place
+    const XmlPageDiff diff = result.value();
+    if (diff.layoutChanged) {
+        emit xmlDataReceived(m_parser->page());
+    } else {
+        if (!diff.changes.isEmpty()) {
+            emit xmlValuesChanged(diff.changes);
         }
+        emit xmlDataUpdated(m_parser->page());
     }
 }
-
-QVariant ControllerXmlService::applyCalculation(const QString &calc, const QVariant &value)
-{
-    if (calc.isEmpty()) {
-        return value;
-    }
-
-    // Handle simple calculations like "val/10" or "val==0?val:(val+1)/100"
-    QString expression = calc;
-    double val = value.toDouble();
-    
-    // Simple division: "val/10"
-    QRegularExpression divRegex(R"(val/(\d+))");
-    QRegularExpressionMatch divMatch = divRegex.match(expression);
-    if (divMatch.hasMatch()) {
-        double divisor = divMatch.captured(1).toDouble();
-        return val / divisor;
-    }
-
-    // For now, return original value for complex expressions
-    return value;
-}
\ No newline at end of file
@@ -3,17 +3,29 @@
 #include <QObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
-#include <QXmlStreamReader>
 #include <QTimer>
 #include <QUrl>
 #include <QMap>
+#include <QHash>
 #include <QVariant>
+#include <QVector>
+#include <memory>
+
+class ControllerXmlParser;
 
 /**
  * @brief Service for fetching and parsing XML data from industrial controllers
  * 
  * Generic service that can work with any controller that exposes XML data
  * over HTTP. Handles network requests, XML parsing, and data extraction.
+ * 
+ * Refreshes are cheap on slow links: requests are conditional (ETag /
+ * Last-Modified, so an unchanged document costs a 304 and no parsing),
+ * accept gzip/deflate bodies, share persistent pipelined connections, and a
+ * request for a URL that is still in flight is folded into the pending one.
+ * 
+ * Parsing is cheap too: ControllerXmlParser caches page layouts and only
+ * scans refreshed documents for their values.
  */
 class ControllerXmlService : public QObject
 {
@@ -53,6 +65,45 @@ public:
         QString title;
         QString version;
         QList<XmlForm> forms;
+        uint layoutHash = 0;    // Hash of everything except field values
+        int fieldCount = 0;
+    };
+    
+    /**
+     * @brief A field whose value differs from the previous refresh
+     */
+    struct XmlValueChange
+    {
+        QString id;
+        QVariant value;
+    };
+    
+    /**
+     * @brief Result of comparing a refreshed page against the previous one
+     * 
+     * When layoutChanged is false both pages have the same forms, columns
+     * and fields in the same order, and changes lists every field whose
+     * value differs. When it is true the page must be rebuilt and changes
+     * is empty.
+     */
+    struct XmlPageDiff
+    {
+        bool layoutChanged = true;
+        QVector<XmlValueChange> changes;
+    };
+
+    /**
+     * @brief Request counters since construction
+     */
+    struct FetchStatistics
+    {
+        int requests = 0;           // GETs sent
+        int notModified = 0;        // 304 responses (document unchanged)
+        int coalesced = 0;          // Fetches folded into a pending request
+        qint64 bytesReceived = 0;   // Decoded XML bytes of 200 responses
+        int fullParses = 0;         // Documents parsed with QXmlStreamReader
+        int cachedLayouts = 0;      // Layouts taken from the layout cache instead
+        int valueRefreshes = 0;     // Documents that only needed their values scanned
     };
 
     explicit ControllerXmlService(QObject *parent = nullptr);
@@ -60,16 +111,32 @@ public:
 
     void setBaseUrl(const QString &baseUrl);
     void setRefreshInterval(int intervalMs);
+    // Directory of the on-disk layout cache; empty keeps layouts in memory only
+    void setLayoutCacheDirectory(const QString &directory);
+    void clearLayoutCache();
     
     void fetchXmlFile(const QString &fileName);
     void startAutoRefresh(const QString &fileName);
     void stopAutoRefresh();
+    
+    // Handle a fetched document; public for documents obtained elsewhere
+    void processXmlData(const QByteArray &xmlData);
+
+    bool isAutoRefreshActive() const { return m_refreshTimer->isActive(); }
+    
+    const XmlPage& getCurrentPage() const;
+    FetchStatistics getStatistics() const;
 
-    const XmlPage& getCurrentPage() const { return m_currentPage; }
+    // Compare two parsed pages field by field (see ControllerXmlParser::diffPages)
+    static XmlPageDiff diffPages(const XmlPage &previous, const XmlPage &current);
 
 signals:
+    // Emitted for the first page and whenever a refresh changed the layout
     void xmlDataReceived(const XmlPage &page);
+    // Emitted after every refresh
     void xmlDataUpdated(const XmlPage &page);
+    // Emitted after a refresh with an unchanged layout and at least one new value
+    void xmlValuesChanged(const QVector<ControllerXmlService::XmlValueChange> &changes);
     void networkError(const QString &error);
     void parsingError(const QString &error);
 
@@ -78,17 +145,23 @@ private slots:
     void onAutoRefreshTimeout();
 
 private:
-    void parseXmlData(const QByteArray &xmlData);
-    void parseUnitPage(QXmlStreamReader &reader);
-    void parseForm(QXmlStreamReader &reader, XmlForm &form);
-    void parseColumn(QXmlStreamReader &reader, XmlColumn &column);
-    void parseField(QXmlStreamReader &reader, XmlField &field);
-    QVariant applyCalculation(const QString &calc, const QVariant &value);
-
+    // Validators of the last 200 response for a URL
+    struct CacheValidators
+    {
+        QByteArray etag;
+        QByteArray lastModified;
+    };
+    
     QNetworkAccessManager *m_networkManager;
     QTimer *m_refreshTimer;
     QString m_baseUrl;
     QString m_currentFileName;
-    XmlPage m_currentPage;
+    std::unique_ptr<ControllerXmlParser> m_parser;
     int m_refreshInterval;
+    QHash<QString, CacheValidators> m_validators;       // URL -> validators
+    QHash<QString, QNetworkReply*> m_pendingReplies;    // URL -> request in flight
+    FetchStatistics m_statistics;
 };
+
+Q_DECLARE_METATYPE(ControllerXmlService::XmlPage)
+Q_DECLARE_METATYPE(ControllerXmlService::XmlValueChange)
@@ -0,0 +1,396 @@
+#include "historianbackup.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <climits>
+#include <sqlite3.h>
+
+const char* const HistorianBackup::CHECKSUM_FILE = "SHA256SUMS";
+
+namespace {
+
+const char* const BACKUP_PREFIX = "historian-";
+const char* const IN_PROGRESS_SUFFIX = ".tmp";
+
+/**
+ * @brief Closes a native SQLite handle when leaving scope
+ */
+struct NativeConnection {
+    sqlite3* db = nullptr;
+    
+    ~NativeConnection() {
+        if (db) {
+            sqlite3_close(db);
+        }
+    }
+    
+    QString error(const QString& context) const {
+        return context + ": " + QString::fromUtf8(db ? sqlite3_errmsg(db) : "out of memory");
+    }
+};
+
+/**
+ * @brief First column of the first row of a statement as text
+ */
+QString queryText(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* statement = nullptr;
+    QString text;
+    if (sqlite3_prepare_v2(db, sql, -1, &statement, nullptr) == SQLITE_OK
+        && sqlite3_step(statement) == SQLITE_ROW) {
+        text = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)));
+    }
+    sqlite3_finalize(statement);
+    return text;
+}
+
+Result<QByteArray> sha256(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return Result<QByteArray>::failure("Cannot read " + path + ": " + file.errorString());
+    }
+    
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return Result<QByteArray>::failure("Cannot read " + path + ": " + file.errorString());
+    }
+    return Result<QByteArray>::success(hash.result().toHex());
+}
+
+qint64 fileSizeWithWal(const QString& path)
+{
+    return QFileInfo(path).size() + QFileInfo(path + "-wal").size();
+}
+
+} // namespace
+
+struct HistorianBackup::Progress {
+    QElapsedTimer elapsed;          // Since the backup started
+    QElapsedTimer sinceReport;      // Since the last progress signal
+    qint64 bytesDone = 0;           // Bytes of completely copied files
+    qint64 bytesTotal = 0;          // Estimate, corrected as files complete
+};
+
+HistorianBackup::HistorianBackup(const QString& databasePath, const QString& backupDirectory, QObject* parent)
+    : QObject(parent)
+    , m_databasePath(QFileInfo(databasePath).absoluteFilePath())
+    , m_backupDirectory(QFileInfo(backupDirectory).absoluteFilePath())
+    , m_pagesPerStep(DEFAULT_PAGES_PER_STEP)
+    , m_stepPauseMs(DEFAULT_STEP_PAUSE_MS)
+    , m_retainedBackups(DEFAULT_RETAINED_BACKUPS)
+    , m_cancelled(false)
+{
+}
+
+HistorianBackup::~HistorianBackup()
+{
+    cancel();
+    if (m_thread) {
+        m_thread->wait();
+    }
+}
+
+Result<void> HistorianBackup::start()
+{
+    if (isRunning()) {
+        return Result<void>::failure("A backup is already running");
+    }
+    
+    if (m_thread) {
+        m_thread->wait();
+    }
+    
+    m_cancelled = false;
+    const Settings settings{m_pagesPerStep, m_stepPauseMs, m_retainedBackups};
+    
+    m_thread.reset(QThread::create([this, settings]() {
+        QString backupPath;
+        auto result = run(settings, backupPath);
+        if (result.isSuccess()) {
+            emit finished(backupPath);
+        } else {
+            qWarning() << "HistorianBackup:" << result.error();
+            emit failed(result.error());
+        }
+    }));
+    m_thread->setObjectName("HistorianBackup");
+    m_thread->start(QThread::LowPriority);
+    
+    return Result<void>::success();
+}
+
+void HistorianBackup::cancel()
+{
+    m_cancelled = true;
+}
+
+bool HistorianBackup::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+bool HistorianBackup::waitForFinished(int msecs)
+{
+    return !m_thread || m_thread->wait(msecs < 0 ? ULONG_MAX : static_cast<unsigned long>(msecs));
+}
+
+QStringList HistorianBackup::backups() const
+{
+    const QDir root(m_backupDirectory);
+    QStringList paths;
+    for (const QString& name : root.entryList({QString(BACKUP_PREFIX) + "*"}, QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+        if (!name.endsWith(IN_PROGRESS_SUFFIX)) {
+            paths.append(root.absoluteFilePath(name));
+        }
+    }
+    return paths;
+}
+
+Result<void> HistorianBackup::run(const Settings& settings, QString& backupPath)
+{
+    QDir root(m_backupDirectory);
+    if (!root.mkpath(".")) {
+        return Result<void>::failure("Cannot create backup directory " + m_backupDirectory);
+    }
+    
+    // Timestamped names sort chronologically, which retention relies on
+    const QString baseName = BACKUP_PREFIX + QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss");
+    QString name = baseName;
+    for (int suffix = 2; root.exists(name) || root.exists(name + IN_PROGRESS_SUFFIX); ++suffix) {
+        name = baseName + QString("-%1").arg(suffix);
+    }
+    const QString workPath = root.absoluteFilePath(name + IN_PROGRESS_SUFFIX);
+    const QDir work(workPath);
+    if (!root.mkpath(workPath)) {
+        return Result<void>::failure("Cannot create " + workPath);
+    }
+    
+    const QFileInfo mainInfo(m_databasePath);
+    const QString partitionDirName = mainInfo.fileName() + ".partitions";
+    const QDir sourcePartitions(mainInfo.absoluteDir().filePath(partitionDirName));
+    
+    Progress progress;
+    progress.elapsed.start();
+    progress.sinceReport.start();
+    progress.bytesTotal = fileSizeWithWal(m_databasePath);
+    for (const QString& file : sourcePartitions.entryList({"*.db"}, QDir::Files)) {
+        progress.bytesTotal += fileSizeWithWal(sourcePartitions.filePath(file));
+    }
+    
+    QStringList partitionFiles;
+    auto result = copyDatabase(m_databasePath, work.filePath(mainInfo.fileName()), settings, progress, &partitionFiles);
+    
+    for (const QString& file : qAsConst(partitionFiles)) {
+        if (result.isFailure()) {
+            break;
+        }
+        
+        // Removed by retention after the main snapshot was taken
+        const QString source = sourcePartitions.filePath(file);
+        if (!QFileInfo::exists(source)) {
+            continue;
+        }
+        
+        work.mkpath(partitionDirName);
+        result = copyDatabase(source, work.filePath(partitionDirName + "/" + file), settings, progress, nullptr);
+    }
+    
+    if (result.isSuccess()) {
+        result = writeChecksums(workPath);
+    }
+    if (result.isSuccess()) {
+        result = verify(workPath);
+    }
+    
+    const QString finalPath = root.absoluteFilePath(name);
+    if (result.isSuccess() && !root.rename(workPath, finalPath)) {
+        result = Result<void>::failure("Cannot rename " + workPath + " to " + finalPath);
+    }
+    
+    if (result.isFailure()) {
+        QDir(workPath).removeRecursively();
+        return result;
+    }
+    
+    emit this->progress(progress.bytesDone, progress.bytesDone, 0);
+    
+    backupPath = finalPath;
+    applyRetention(settings.retainedBackups);
+    return Result<void>::success();
+}
+
+Result<void> HistorianBackup::copyDatabase(const QString& source, const QString& target, const Settings& settings,
+                                           Progress& progress, QStringList* partitionFiles)
+{
+    NativeConnection src;
+    if (sqlite3_open_v2(source.toUtf8().constData(), &src.db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        return Result<void>::failure(src.error("Cannot open " + source));
+    }
+    sqlite3_busy_timeout(src.db, 5000);
+    
+    // Pin one snapshot for the whole copy: without it, every write to the
+    // source by another connection restarts the backup from page 1
+    if (sqlite3_exec(src.db, "BEGIN; SELECT COUNT(*) FROM sqlite_master;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return Result<void>::failure(src.error("Cannot read " + source));
+    }
+    
+    if (partitionFiles) {
+        sqlite3_stmt* statement = nullptr;
+        if (sqlite3_prepare_v2(src.db, "SELECT file FROM partitions ORDER BY day", -1, &statement, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(statement) == SQLITE_ROW) {
+                partitionFiles->append(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0))));
+            }
+        }
+        sqlite3_finalize(statement);
+    }
+    
+    QFile::remove(target);
+    NativeConnection dst;
+    if (sqlite3_open_v2(target.toUtf8().constData(), &dst.db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        return Result<void>::failure(dst.error("Cannot create " + target));
+    }
+    
+    sqlite3_backup* backup = sqlite3_backup_init(dst.db, "main", src.db, "main");
+    if (!backup) {
+        return Result<void>::failure(dst.error("Cannot start backup of " + source));
+    }
+    
+    const qint64 pageSize = queryText(src.db, "PRAGMA page_size").toLongLong();
+    const qint64 estimate = fileSizeWithWal(source);
+    qint64 fileBytes = 0;
+    int rc = SQLITE_OK;
+    QElapsedTimer busy;             // Running while steps keep returning busy/locked
+    
+    while (!m_cancelled) {
+        rc = sqlite3_backup_step(backup, settings.pagesPerStep);
+        
+        fileBytes = qint64(sqlite3_backup_pagecount(backup)) * pageSize;
+        const qint64 copied = fileBytes - qint64(sqlite3_backup_remaining(backup)) * pageSize;
+        
+        if (progress.sinceReport.elapsed() >= PROGRESS_INTERVAL_MS) {
+            const qint64 done = progress.bytesDone + copied;
+            const qint64 total = qMax(progress.bytesTotal, done);
+            const qint64 eta = done > 0 ? progress.elapsed.elapsed() * (total - done) / done : -1;
+            emit this->progress(done, total, eta);
+            progress.sinceReport.restart();
+        }
+        
+        if (rc == SQLITE_OK) {
+            busy.invalidate();
+        } else if (rc != SQLITE_BUSY && rc != SQLITE_LOCKED) {
+            break;
+        } else if (!busy.isValid()) {
+            busy.start();
+        } else if (busy.hasExpired(BUSY_TIMEOUT_MS)) {
+            break;
+        }
+        QThread::msleep(static_cast<unsigned long>(settings.stepPauseMs));
+    }
+    
+    sqlite3_backup_finish(backup);
+    
+    if (m_cancelled) {
+        return Result<void>::failure("Backup cancelled");
+    }
+    if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        return Result<void>::failure(QString("Backup of %1 failed: database stayed busy for %2 s")
+                                     .arg(source).arg(BUSY_TIMEOUT_MS / 1000));
+    }
+    if (rc != SQLITE_DONE) {
+        return Result<void>::failure(dst.error("Backup of " + source + " failed"));
+    }
+    
+    sqlite3_exec(src.db, "COMMIT", nullptr, nullptr, nullptr);
+    
+    const QString check = queryText(dst.db, "PRAGMA quick_check");
+    if (check != "ok") {
+        return Result<void>::failure("Integrity check of " + target + " failed: " + check);
+    }
+    
+    progress.bytesDone += fileBytes;
+    progress.bytesTotal += fileBytes - estimate;
+    return Result<void>::success();
+}
+
+Result<void> HistorianBackup::writeChecksums(const QString& backupPath)
+{
+    const QDir directory(backupPath);
+    QStringList files;
+    QDirIterator it(backupPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString relative = directory.relativeFilePath(it.next());
+        if (relative != CHECKSUM_FILE) {
+            files.append(relative);
+        }
+    }
+    files.sort();
+    
+    QByteArray manifest;
+    for (const QString& relative : qAsConst(files)) {
+        auto hash = sha256(directory.filePath(relative));
+        if (hash.isFailure()) {
+            return Result<void>::failure(hash.error());
+        }
+        manifest += hash.value() + "  " + relative.toUtf8() + "\n";
+    }
+    
+    QFile file(directory.filePath(CHECKSUM_FILE));
+    if (!file.open(QIODevice::WriteOnly) || file.write(manifest) != manifest.size() || !file.flush()) {
+        return Result<void>::failure("Cannot write " + file.fileName() + ": " + file.errorString());
+    }
+    return Result<void>::success();
+}
+
+Result<void> HistorianBackup::verify(const QString& backupPath)
+{
+    const QDir directory(backupPath);
+    QFile file(directory.filePath(CHECKSUM_FILE));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return Result<void>::failure("Missing checksum manifest in " + backupPath);
+    }
+    
+    int verified = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        
+        const int separator = line.indexOf("  ");
+        if (separator <= 0) {
+            return Result<void>::failure("Malformed checksum line: " + QString::fromUtf8(line));
+        }
+        
+        const QString relative = QString::fromUtf8(line.mid(separator + 2));
+        auto hash = sha256(directory.filePath(relative));
+        if (hash.isFailure()) {
+            return Result<void>::failure(hash.error());
+        }
+        if (hash.value() != line.left(separator)) {
+            return Result<void>::failure("Checksum mismatch: " + relative);
+        }
+        ++verified;
+    }
+    
+    if (verified == 0) {
+        return Result<void>::failure("Empty checksum manifest in " + backupPath);
+    }
+    return Result<void>::success();
+}
+
+void HistorianBackup::applyRetention(int retainedBackups) const
+{
+    QStringList existing = backups();
+    while (existing.size() > retainedBackups) {
+        const QString oldest = existing.takeFirst();
+        if (!QDir(oldest).removeRecursively()) {
+            qWarning() << "HistorianBackup: Failed to remove old backup" << oldest;
+        }
+    }
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include "../utils/result.h"
+
+/**
+ * @brief Online, throttled backup of the SQLite historian
+ * 
+ * Copies the main historian database and all of its partition files
+ * while the HMI keeps writing, using SQLite's online backup API
+ * (sqlite3_backup_step) on a background thread. Each step copies
+ * pagesPerStep() pages and is followed by a stepPause() sleep, so the
+ * backup never competes with ingestion for long.
+ * 
+ * Pattern: Service Layer (RULE-303)
+ * Location: src/services/
+ * Threading: Runs in its own QThread (RULE-501); signals are delivered
+ *            queued to receivers in other threads
+ * 
+ * Features:
+ * - Consistent snapshot per file: a read transaction is held on the source
+ *   for the whole copy. With WAL, writers are not blocked and the backup
+ *   does not restart when the source changes (the WAL grows meanwhile and
+ *   is checkpointed once the backup finishes)
+ * - Partitions listed in the main file's snapshot are copied next to it,
+ *   preserving the on-disk layout, so a backup is restored by copying the
+ *   directory back
+ * - Every copy is checked with PRAGMA quick_check, and a SHA-256 manifest
+ *   (sha256sum format) is written and re-verified from disk
+ * - A copy that cannot make progress for 30 s because the source stays
+ *   busy or locked fails instead of retrying forever
+ * - Keeps the newest retainedBackups() backups and deletes older ones
+ * - Progress and ETA reporting
+ * 
+ * Layout of one backup:
+ * @code
+ * <backupDirectory>/historian-20240131-021500/
+ *     datapoints.db
+ *     datapoints.db.partitions/2024-01-30.db
+ *     datapoints.db.partitions/2024-01-31.db
+ *     SHA256SUMS
+ * @endcode
+ * 
+ * Requires Qt's SQLite driver to use the same (system) SQLite library
+ * the application links against, so only one SQLite copy handles the
+ * files' locks within the process.
+ * 
+ * Example:
+ * @code
+ * HistorianBackup backup("datapoints.db", "/var/backups/hmi");
+ * connect(&backup, &HistorianBackup::progress, this, &Page::showProgress);
+ * connect(&backup, &HistorianBackup::finished, this, &Page::backupDone);
+ * backup.start();
+ * @endcode
+ */
+class HistorianBackup : public QObject {
+    Q_OBJECT
+    
+public:
+    static constexpr int DEFAULT_PAGES_PER_STEP = 256;      // 1 MiB with 4 KiB pages
+    static constexpr int DEFAULT_STEP_PAUSE_MS = 20;
+    static constexpr int DEFAULT_RETAINED_BACKUPS = 7;
+    
+    /**
+     * @brief Name of the checksum manifest inside a backup
+     */
+    static const char* const CHECKSUM_FILE;
+    
+    /**
+     * @param databasePath Main historian database (as passed to SqliteRepository)
+     * @param backupDirectory Directory receiving one sub-directory per backup
+     */
+    HistorianBackup(const QString& databasePath, const QString& backupDirectory, QObject* parent = nullptr);
+    
+    /**
+     * @brief Cancels a running backup and waits for the thread
+     */
+    ~HistorianBackup() override;
+    
+    /**
+     * @brief Start a backup in the background
+     * @return Failure if a backup is already running
+     */
+    Result<void> start();
+    
+    /**
+     * @brief Request cancellation; the partial backup is removed and failed() emitted
+     */
+    void cancel();
+    
+    /**
+     * @brief Check if a backup is running
+     */
+    bool isRunning() const;
+    
+    /**
+     * @brief Block until the running backup ends
+     * @param msecs Timeout (-1 = no timeout)
+     * @return True if no backup is running anymore
+     */
+    bool waitForFinished(int msecs = -1);
+    
+    /**
+     * @brief Completed backups in the backup directory, oldest first (absolute paths)
+     */
+    QStringList backups() const;
+    
+    /**
+     * @brief Recompute the checksums of a backup and compare with its manifest
+     * @param backupPath Backup sub-directory
+     */
+    static Result<void> verify(const QString& backupPath);
+    
+    // Throttling and retention (take effect with the next start())
+    void setPagesPerStep(int pages) { m_pagesPerStep = qMax(1, pages); }
+    int pagesPerStep() const { return m_pagesPerStep; }
+    void setStepPause(int msecs) { m_stepPauseMs = qMax(0, msecs); }
+    int stepPause() const { return m_stepPauseMs; }
+    void setRetainedBackups(int count) { m_retainedBackups = qMax(1, count); }
+    int retainedBackups() const { return m_retainedBackups; }
+
+signals:
+    /**
+     * @brief Emitted while copying (at most every PROGRESS_INTERVAL_MS)
+     * @param bytesCopied Bytes copied so far
+     * @param bytesTotal Estimated total bytes
+     * @param etaMs Estimated time to completion in milliseconds (-1 = unknown)
+     */
+    void progress(qint64 bytesCopied, qint64 bytesTotal, qint64 etaMs);
+    
+    /**
+     * @brief Emitted when a backup completed and was verified
+     * @param backupPath Backup sub-directory
+     */
+    void finished(const QString& backupPath);
+    
+    /**
+     * @brief Emitted when a backup failed or was cancelled
+     */
+    void failed(const QString& error);
+
+private:
+    static constexpr int PROGRESS_INTERVAL_MS = 250;
+    static constexpr int BUSY_TIMEOUT_MS = 30000;   // Longest run of busy/locked steps before giving up
+    
+    struct Settings {
+        int pagesPerStep;
+        int stepPauseMs;
+        int retainedBackups;
+    };
+    
+    /**
+     * @brief Byte counters shared by the copies of one backup run
+     */
+    struct Progress;
+    
+    /**
+     * @brief Perform one backup (backup thread)
+     * @param backupPath Receives the completed backup directory
+     */
+    Result<void> run(const Settings& settings, QString& backupPath);
+    
+    /**
+     * @brief Copy one database file with the backup API (backup thread)
+     * @param partitionFiles If not null, receives the partition manifest of
+     *        the copied snapshot (main file only)
+     */
+    Result<void> copyDatabase(const QString& source, const QString& target, const Settings& settings,
+                              Progress& progress, QStringList* partitionFiles);
+    
+    /**
+     * @brief Write the SHA-256 manifest of a backup directory
+     */
+    static Result<void> writeChecksums(const QString& backupPath);
+    
+    /**
+     * @brief Delete the oldest backups beyond the retention count
+     */
+    void applyRetention(int retainedBackups) const;
+    
+    QString m_databasePath;
+    QString m_backupDirectory;
+    int m_pagesPerStep;
+    int m_stepPauseMs;
+    int m_retainedBackups;
+    
+    std::unique_ptr<QThread> m_thread;  // Current or last backup run
+    std::atomic<bool> m_cancelled;
+};
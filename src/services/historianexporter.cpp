@@ -0,0 +1,553 @@
+#include "historianexporter.h"
+#include "../repositories/sqliterepository.h"
+#include "../utils/checksum.h"
+#include "../utils/columncodec.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <climits>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const char FILE_MAGIC[] = "HCOL";
+const char CHUNK_MAGIC[] = "CHNK";
+const char INDEX_MAGIC[] = "INDX";
+const quint16 FORMAT_VERSION = 1;
+
+const int FILE_HEADER_SIZE = 12;        // magic, version, flags, schema length
+const int CHUNK_HEADER_SIZE = 29;       // magic, tag, rows, first/last timestamp, column count
+const int COLUMN_HEADER_SIZE = 11;      // id, encoding, compression, size, crc
+const int INDEX_ENTRY_SIZE = 32;
+const int TRAILER_SIZE = 12;            // index offset, magic
+
+enum ColumnId : quint8 {
+    TimestampColumn = 0,
+    ValueColumn = 1,
+    QualityColumn = 2,
+    TextColumn = 3
+};
+
+template<typename T>
+void appendLittleEndian(QByteArray& out, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template<typename T>
+T readLittleEndian(const QByteArray& data, int offset)
+{
+    return qFromLittleEndian<T>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+bool isText(const QVariant& value)
+{
+    return value.userType() == QMetaType::QString;
+}
+
+const char* qualityName(DataPoint::Quality quality)
+{
+    switch (quality) {
+        case DataPoint::Quality::Good: return "Good";
+        case DataPoint::Quality::Uncertain: return "Uncertain";
+        case DataPoint::Quality::Bad: return "Bad";
+        case DataPoint::Quality::Stale: return "Stale";
+    }
+    return "Bad";
+}
+
+/**
+ * @brief Output format of one export run
+ */
+class ExportSink {
+public:
+    virtual ~ExportSink() = default;
+    virtual Result<void> begin() = 0;
+    virtual Result<void> writeChunk(int tagIndex, const QList<DataPoint>& samples) = 0;
+    virtual Result<void> finish() = 0;
+};
+
+/**
+ * @brief Columnar format writer (docs/api/historian-export-format.md)
+ */
+class ColumnarSink : public ExportSink {
+public:
+    ColumnarSink(QSaveFile& file, const QStringList& tags, const QDateTime& startTime,
+                 const QDateTime& endTime, int chunkRows)
+        : m_file(file), m_tags(tags), m_startTime(startTime), m_endTime(endTime), m_chunkRows(chunkRows)
+    {
+    }
+    
+    Result<void> begin() override
+    {
+        QJsonObject schema;
+        schema["format"] = "hmi-historian-columnar";
+        schema["version"] = int(FORMAT_VERSION);
+        schema["created"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+        schema["startMs"] = m_startTime.isValid() ? QJsonValue(double(m_startTime.toMSecsSinceEpoch())) : QJsonValue();
+        schema["endMs"] = m_endTime.isValid() ? QJsonValue(double(m_endTime.toMSecsSinceEpoch())) : QJsonValue();
+        schema["chunkRows"] = m_chunkRows;
+        schema["order"] = "ascending";
+        schema["tags"] = QJsonArray::fromStringList(m_tags);
+        schema["columns"] = QJsonArray{
+            QJsonObject{{"id", int(TimestampColumn)}, {"name", "timestamp"}, {"type", "int64"},
+                        {"unit", "ms since 1970-01-01T00:00:00Z"}, {"encoding", "delta-varint"}},
+            QJsonObject{{"id", int(ValueColumn)}, {"name", "value"}, {"type", "float64"},
+                        {"encoding", "byte-stream-split"}},
+            QJsonObject{{"id", int(QualityColumn)}, {"name", "quality"}, {"type", "uint8"},
+                        {"encoding", "plain"},
+                        {"values", QJsonArray{"Good", "Uncertain", "Bad", "Stale"}}},
+            QJsonObject{{"id", int(TextColumn)}, {"name", "text"}, {"type", "utf8"},
+                        {"encoding", "length-prefixed"}, {"optional", true}}
+        };
+        
+        const QByteArray json = QJsonDocument(schema).toJson(QJsonDocument::Compact);
+        QByteArray header(FILE_MAGIC, 4);
+        appendLittleEndian<quint16>(header, FORMAT_VERSION);
+        appendLittleEndian<quint16>(header, 0);
+        appendLittleEndian<quint32>(header, quint32(json.size()));
+        header.append(json);
+        return write(header);
+    }
+    
+    Result<void> writeChunk(int tagIndex, const QList<DataPoint>& samples) override
+    {
+        const int rows = samples.size();
+        QVector<qint64> timestamps(rows);
+        QVector<double> values(rows);
+        QByteArray qualities(rows, Qt::Uninitialized);
+        QStringList texts;
+        
+        bool hasText = false;
+        for (int i = 0; i < rows; ++i) {
+            const DataPoint& sample = samples.at(i);
+            timestamps[i] = sample.timestamp().toMSecsSinceEpoch();
+            qualities[i] = char(sample.quality());
+            hasText = hasText || isText(sample.value());
+        }
+        for (int i = 0; i < rows; ++i) {
+            const QVariant value = samples.at(i).value();
+            const bool text = isText(value);
+            values[i] = text ? std::numeric_limits<double>::quiet_NaN() : value.toDouble();
+            if (hasText) {
+                texts.append(text ? value.toString() : QString());
+            }
+        }
+        
+        QByteArray chunk(CHUNK_MAGIC, 4);
+        appendLittleEndian<quint32>(chunk, quint32(tagIndex));
+        appendLittleEndian<quint32>(chunk, quint32(rows));
+        appendLittleEndian<qint64>(chunk, timestamps.first());
+        appendLittleEndian<qint64>(chunk, timestamps.last());
+        appendLittleEndian<quint8>(chunk, hasText ? 4 : 3);
+        appendColumn(chunk, TimestampColumn, ColumnCodec::Encoding::DeltaVarint,
+                     ColumnCodec::encodeDeltaVarint(timestamps));
+        appendColumn(chunk, ValueColumn, ColumnCodec::Encoding::ByteStreamSplit,
+                     ColumnCodec::encodeByteStreamSplit(values));
+        appendColumn(chunk, QualityColumn, ColumnCodec::Encoding::Plain, qualities);
+        if (hasText) {
+            appendColumn(chunk, TextColumn, ColumnCodec::Encoding::LengthPrefixed,
+                         ColumnCodec::encodeLengthPrefixed(texts));
+        }
+        
+        appendLittleEndian<quint64>(m_index, quint64(m_file.pos()));
+        appendLittleEndian<quint32>(m_index, quint32(tagIndex));
+        appendLittleEndian<quint32>(m_index, quint32(rows));
+        appendLittleEndian<qint64>(m_index, timestamps.first());
+        appendLittleEndian<qint64>(m_index, timestamps.last());
+        ++m_chunkCount;
+        
+        return write(chunk);
+    }
+    
+    Result<void> finish() override
+    {
+        const quint64 indexOffset = quint64(m_file.pos());
+        QByteArray footer(INDEX_MAGIC, 4);
+        appendLittleEndian<quint32>(footer, quint32(m_chunkCount));
+        footer.append(m_index);
+        appendLittleEndian<quint64>(footer, indexOffset);
+        footer.append(FILE_MAGIC, 4);
+        return write(footer);
+    }
+
+private:
+    static void appendColumn(QByteArray& chunk, ColumnId id, ColumnCodec::Encoding encoding,
+                             const QByteArray& encoded)
+    {
+        ColumnCodec::Compression compression;
+        const QByteArray stored = ColumnCodec::compress(encoded, compression);
+        appendLittleEndian<quint8>(chunk, id);
+        appendLittleEndian<quint8>(chunk, quint8(encoding));
+        appendLittleEndian<quint8>(chunk, quint8(compression));
+        appendLittleEndian<quint32>(chunk, quint32(stored.size()));
+        appendLittleEndian<quint32>(chunk, crc32(reinterpret_cast<const uchar*>(stored.constData()), stored.size()));
+        chunk.append(stored);
+    }
+    
+    Result<void> write(const QByteArray& data)
+    {
+        if (m_file.write(data) != data.size()) {
+            return Result<void>::failure("Write failed: " + m_file.errorString());
+        }
+        return Result<void>::success();
+    }
+    
+    QSaveFile& m_file;
+    QStringList m_tags;
+    QDateTime m_startTime;
+    QDateTime m_endTime;
+    int m_chunkRows;
+    QByteArray m_index;         // Index entries written so far (32 bytes per chunk)
+    int m_chunkCount = 0;
+};
+
+/**
+ * @brief CSV writer: tag, ISO 8601 UTC timestamp, value, quality
+ */
+class CsvSink : public ExportSink {
+public:
+    CsvSink(QSaveFile& file, const QStringList& tags)
+        : m_file(file), m_tags(tags)
+    {
+    }
+    
+    Result<void> begin() override
+    {
+        return write("tag,timestamp,value,quality\n");
+    }
+    
+    Result<void> writeChunk(int tagIndex, const QList<DataPoint>& samples) override
+    {
+        const QByteArray tag = quote(m_tags.at(tagIndex));
+        QByteArray lines;
+        lines.reserve(samples.size() * 48);
+        for (const DataPoint& sample : samples) {
+            const QVariant value = sample.value();
+            lines.append(tag).append(',');
+            lines.append(sample.timestamp().toUTC().toString(Qt::ISODateWithMs).toUtf8()).append(',');
+            lines.append(isText(value) ? quote(value.toString())
+                                       : QByteArray::number(value.toDouble(), 'g', 17)).append(',');
+            lines.append(qualityName(sample.quality())).append('\n');
+        }
+        return write(lines);
+    }
+    
+    Result<void> finish() override
+    {
+        return Result<void>::success();
+    }
+
+private:
+    // RFC 4180 quoting, only where needed
+    static QByteArray quote(const QString& text)
+    {
+        QByteArray utf8 = text.toUtf8();
+        if (!utf8.contains(',') && !utf8.contains('"') && !utf8.contains('\n') && !utf8.contains('\r')) {
+            return utf8;
+        }
+        return '"' + utf8.replace("\"", "\"\"") + '"';
+    }
+    
+    Result<void> write(const QByteArray& data)
+    {
+        if (m_file.write(data) != data.size()) {
+            return Result<void>::failure("Write failed: " + m_file.errorString());
+        }
+        return Result<void>::success();
+    }
+    
+    QSaveFile& m_file;
+    QStringList m_tags;
+};
+
+} // namespace
+
+HistorianExporter::HistorianExporter(SqliteRepository& repository, QObject* parent)
+    : QObject(parent)
+    , m_repository(repository)
+    , m_chunkRows(DEFAULT_CHUNK_ROWS)
+    , m_cancelled(false)
+{
+}
+
+HistorianExporter::~HistorianExporter()
+{
+    cancel();
+    if (m_thread) {
+        m_thread->wait();
+    }
+}
+
+Result<void> HistorianExporter::start(const QString& outputPath,
+                                      const QStringList& tags,
+                                      const QDateTime& startTime,
+                                      const QDateTime& endTime,
+                                      Format format)
+{
+    if (isRunning()) {
+        return Result<void>::failure("An export is already running");
+    }
+    if (tags.isEmpty()) {
+        return Result<void>::failure("No tags selected for export");
+    }
+    
+    if (m_thread) {
+        m_thread->wait();
+    }
+    
+    m_cancelled = false;
+    const Job job{outputPath, tags, startTime, endTime, format, m_chunkRows};
+    
+    m_thread.reset(QThread::create([this, job]() {
+        auto result = run(job);
+        if (result.isSuccess()) {
+            emit finished(job.outputPath, result.value());
+        } else {
+            qWarning() << "HistorianExporter:" << result.error();
+            emit failed(result.error());
+        }
+    }));
+    m_thread->setObjectName("HistorianExporter");
+    m_thread->start(QThread::LowPriority);
+    
+    return Result<void>::success();
+}
+
+void HistorianExporter::cancel()
+{
+    m_cancelled = true;
+}
+
+bool HistorianExporter::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+bool HistorianExporter::waitForFinished(int msecs)
+{
+    return !m_thread || m_thread->wait(msecs < 0 ? ULONG_MAX : static_cast<unsigned long>(msecs));
+}
+
+Result<qint64> HistorianExporter::run(const Job& job)
+{
+    // QSaveFile writes next to the target and renames on commit()
+    QSaveFile file(job.outputPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return Result<qint64>::failure("Cannot create " + job.outputPath + ": " + file.errorString());
+    }
+    
+    std::unique_ptr<ExportSink> sink;
+    if (job.format == Format::Csv) {
+        sink.reset(new CsvSink(file, job.tags));
+    } else {
+        sink.reset(new ColumnarSink(file, job.tags, job.startTime, job.endTime, job.chunkRows));
+    }
+    
+    auto fail = [&file](const QString& error) {
+        file.cancelWriting();
+        return Result<qint64>::failure(error);
+    };
+    
+    auto begun = sink->begin();
+    if (begun.isFailure()) {
+        return fail(begun.error());
+    }
+    
+    qint64 written = 0;
+    for (int tagIndex = 0; tagIndex < job.tags.size(); ++tagIndex) {
+        auto cursor = m_repository.openCursor(job.tags.at(tagIndex), job.startTime, job.endTime,
+                                              job.chunkRows, true);
+        while (!cursor->atEnd()) {
+            if (m_cancelled) {
+                return fail("Export cancelled");
+            }
+            
+            auto page = cursor->fetchNext();
+            if (page.isFailure()) {
+                return fail(page.error());
+            }
+            const QList<DataPoint> samples = page.value();
+            if (samples.isEmpty()) {
+                break;
+            }
+            
+            auto chunk = sink->writeChunk(tagIndex, samples);
+            if (chunk.isFailure()) {
+                return fail(chunk.error());
+            }
+            written += samples.size();
+            emit progress(written, tagIndex, job.tags.size());
+        }
+        emit progress(written, tagIndex + 1, job.tags.size());
+    }
+    
+    auto completed = sink->finish();
+    if (completed.isFailure()) {
+        return fail(completed.error());
+    }
+    if (!file.commit()) {
+        return Result<qint64>::failure("Cannot write " + job.outputPath + ": " + file.errorString());
+    }
+    return Result<qint64>::success(written);
+}
+
+Result<void> HistorianExportReader::open(const QString& path)
+{
+    m_file.close();
+    m_file.setFileName(path);
+    m_schema = QJsonObject();
+    m_tags.clear();
+    m_chunks.clear();
+    
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return Result<void>::failure("Cannot open " + path + ": " + m_file.errorString());
+    }
+    
+    const QByteArray header = m_file.read(FILE_HEADER_SIZE);
+    if (header.size() != FILE_HEADER_SIZE || !header.startsWith(FILE_MAGIC)) {
+        return Result<void>::failure(path + " is not a historian export");
+    }
+    if (readLittleEndian<quint16>(header, 4) != FORMAT_VERSION) {
+        return Result<void>::failure(QString("Unsupported export format version %1")
+                                     .arg(readLittleEndian<quint16>(header, 4)));
+    }
+    
+    const qint64 schemaSize = readLittleEndian<quint32>(header, 8);
+    if (schemaSize > m_file.size() - FILE_HEADER_SIZE - TRAILER_SIZE) {
+        return Result<void>::failure(path + " is truncated");
+    }
+    QJsonParseError parseError;
+    const QJsonDocument schema = QJsonDocument::fromJson(m_file.read(schemaSize), &parseError);
+    if (!schema.isObject()) {
+        return Result<void>::failure("Invalid export schema: " + parseError.errorString());
+    }
+    m_schema = schema.object();
+    for (const QJsonValue& tag : m_schema.value("tags").toArray()) {
+        m_tags.append(tag.toString());
+    }
+    
+    // The trailer points at the chunk index
+    m_file.seek(m_file.size() - TRAILER_SIZE);
+    const QByteArray trailer = m_file.read(TRAILER_SIZE);
+    const qint64 indexOffset = qint64(readLittleEndian<quint64>(trailer, 0));
+    if (trailer.size() != TRAILER_SIZE || !trailer.endsWith(FILE_MAGIC)
+        || indexOffset < FILE_HEADER_SIZE + schemaSize || indexOffset > m_file.size() - TRAILER_SIZE - 8) {
+        return Result<void>::failure(path + " is truncated (no chunk index)");
+    }
+    
+    m_file.seek(indexOffset);
+    const QByteArray indexHeader = m_file.read(8);
+    const qint64 chunkCount = readLittleEndian<quint32>(indexHeader, 4);
+    if (!indexHeader.startsWith(INDEX_MAGIC)
+        || indexOffset + 8 + chunkCount * INDEX_ENTRY_SIZE + TRAILER_SIZE != m_file.size()) {
+        return Result<void>::failure(path + " has a corrupt chunk index");
+    }
+    
+    const QByteArray index = m_file.read(chunkCount * INDEX_ENTRY_SIZE);
+    for (int i = 0; i < chunkCount; ++i) {
+        const int entry = i * INDEX_ENTRY_SIZE;
+        Chunk chunk;
+        chunk.offset = qint64(readLittleEndian<quint64>(index, entry));
+        chunk.tagIndex = int(readLittleEndian<quint32>(index, entry + 8));
+        chunk.rowCount = int(readLittleEndian<quint32>(index, entry + 12));
+        chunk.firstMs = readLittleEndian<qint64>(index, entry + 16);
+        chunk.lastMs = readLittleEndian<qint64>(index, entry + 24);
+        if (chunk.tagIndex >= m_tags.size() || chunk.offset >= indexOffset) {
+            return Result<void>::failure(path + " has a corrupt chunk index");
+        }
+        m_chunks.append(chunk);
+    }
+    
+    return Result<void>::success();
+}
+
+Result<QList<DataPoint>> HistorianExportReader::readChunk(int index)
+{
+    if (index < 0 || index >= m_chunks.size()) {
+        return Result<QList<DataPoint>>::failure("No such chunk");
+    }
+    
+    const Chunk& entry = m_chunks.at(index);
+    m_file.seek(entry.offset);
+    const QByteArray header = m_file.read(CHUNK_HEADER_SIZE);
+    if (header.size() != CHUNK_HEADER_SIZE || !header.startsWith(CHUNK_MAGIC)
+        || int(readLittleEndian<quint32>(header, 4)) != entry.tagIndex
+        || int(readLittleEndian<quint32>(header, 8)) != entry.rowCount) {
+        return Result<QList<DataPoint>>::failure(QString("Chunk %1 does not match the index").arg(index));
+    }
+    
+    const int rows = entry.rowCount;
+    QVector<qint64> timestamps;
+    QVector<double> values;
+    QByteArray qualities;
+    QStringList texts;
+    bool hasTimestamps = false;
+    bool hasValues = false;
+    
+    const int columnCount = readLittleEndian<quint8>(header, 28);
+    for (int column = 0; column < columnCount; ++column) {
+        const QByteArray columnHeader = m_file.read(COLUMN_HEADER_SIZE);
+        if (columnHeader.size() != COLUMN_HEADER_SIZE) {
+            return Result<QList<DataPoint>>::failure(QString("Chunk %1 is truncated").arg(index));
+        }
+        const quint8 id = readLittleEndian<quint8>(columnHeader, 0);
+        const auto encoding = ColumnCodec::Encoding(readLittleEndian<quint8>(columnHeader, 1));
+        const auto compression = ColumnCodec::Compression(readLittleEndian<quint8>(columnHeader, 2));
+        const qint64 size = readLittleEndian<quint32>(columnHeader, 3);
+        const quint32 crc = readLittleEndian<quint32>(columnHeader, 7);
+        
+        const QByteArray stored = m_file.read(size);
+        if (stored.size() != size || crc32(reinterpret_cast<const uchar*>(stored.constData()), size) != crc) {
+            return Result<QList<DataPoint>>::failure(QString("Chunk %1 column %2 is corrupt").arg(index).arg(id));
+        }
+        
+        QByteArray encoded;
+        bool ok = ColumnCodec::decompress(stored, compression, encoded);
+        switch (id) {
+            case TimestampColumn:
+                ok = ok && encoding == ColumnCodec::Encoding::DeltaVarint
+                     && ColumnCodec::decodeDeltaVarint(encoded, rows, timestamps);
+                hasTimestamps = ok;
+                break;
+            case ValueColumn:
+                ok = ok && encoding == ColumnCodec::Encoding::ByteStreamSplit
+                     && ColumnCodec::decodeByteStreamSplit(encoded, rows, values);
+                hasValues = ok;
+                break;
+            case QualityColumn:
+                ok = ok && encoding == ColumnCodec::Encoding::Plain && encoded.size() == rows;
+                qualities = encoded;
+                break;
+            case TextColumn:
+                ok = ok && encoding == ColumnCodec::Encoding::LengthPrefixed
+                     && ColumnCodec::decodeLengthPrefixed(encoded, rows, texts);
+                break;
+            default:
+                break;      // Columns added by later minor revisions are skipped
+        }
+        if (!ok) {
+            return Result<QList<DataPoint>>::failure(QString("Chunk %1 column %2 cannot be decoded").arg(index).arg(id));
+        }
+    }
+    
+    if (!hasTimestamps || !hasValues || qualities.size() != rows) {
+        return Result<QList<DataPoint>>::failure(QString("Chunk %1 lacks a required column").arg(index));
+    }
+    
+    const QString tag = m_tags.at(entry.tagIndex);
+    QList<DataPoint> samples;
+    samples.reserve(rows);
+    for (int i = 0; i < rows; ++i) {
+        const QVariant value = (std::isnan(values.at(i)) && !texts.isEmpty()) ? QVariant(texts.at(i))
+                                                                               : QVariant(values.at(i));
+        samples.append(DataPoint(tag, value, QDateTime::fromMSecsSinceEpoch(timestamps.at(i)),
+                                 static_cast<DataPoint::Quality>(qualities.at(i) & 0x3)));
+    }
+    return Result<QList<DataPoint>>::success(samples);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include "../models/datapoint.h"
+#include "../utils/result.h"
+
+class SqliteRepository;
+
+/**
+ * @brief Streaming bulk export of historian samples to a file
+ * 
+ * Exports selected tags over a time range into the self-describing
+ * columnar format specified in docs/api/historian-export-format.md (or
+ * CSV), on a background thread. Samples are streamed from
+ * SqliteRepository::openCursor() one chunk at a time, so memory use is
+ * bounded by chunkRows() regardless of how much history is exported.
+ * 
+ * Pattern: Service Layer (RULE-303)
+ * Location: src/services/
+ * Threading: Runs in its own QThread (RULE-501); signals are delivered
+ *            queued to receivers in other threads. The repository must
+ *            outlive the export.
+ * 
+ * Features:
+ * - Columnar format: schema header (JSON), chunks of up to chunkRows()
+ *   samples of one tag in ascending time order with each column encoded
+ *   and compressed on its own, and a chunk index in the footer for
+ *   seeking by tag and time
+ * - CSV from the same pipeline (tag, ISO 8601 UTC timestamp, value, quality)
+ * - Written through QSaveFile (temporary file renamed when complete), so a
+ *   cancelled or failed export never leaves a truncated file behind
+ * - Progress reporting per chunk; cancellable
+ * 
+ * Example:
+ * @code
+ * HistorianExporter exporter(repository);
+ * connect(&exporter, &HistorianExporter::progress, this, &Page::showProgress);
+ * connect(&exporter, &HistorianExporter::finished, this, &Page::exportDone);
+ * exporter.start("/media/usb/line1.hcol", {"Flow", "Pressure"}, start, end);
+ * @endcode
+ */
+class HistorianExporter : public QObject {
+    Q_OBJECT
+    
+public:
+    enum class Format {
+        Columnar,       // docs/api/historian-export-format.md
+        Csv
+    };
+    
+    static constexpr int DEFAULT_CHUNK_ROWS = 65536;
+    
+    explicit HistorianExporter(SqliteRepository& repository, QObject* parent = nullptr);
+    
+    /**
+     * @brief Cancels a running export and waits for the thread
+     */
+    ~HistorianExporter() override;
+    
+    /**
+     * @brief Start an export in the background
+     * @param outputPath File to create (replaced if it exists)
+     * @param tags Tags to export, in this order
+     * @param startTime Start of time range (inclusive, invalid = unbounded)
+     * @param endTime End of time range (inclusive, invalid = unbounded)
+     * @param format Output format
+     * @return Failure if an export is already running or no tag was given
+     */
+    Result<void> start(const QString& outputPath,
+                       const QStringList& tags,
+                       const QDateTime& startTime = QDateTime(),
+                       const QDateTime& endTime = QDateTime(),
+                       Format format = Format::Columnar);
+    
+    /**
+     * @brief Request cancellation; the partial file is removed and failed() emitted
+     */
+    void cancel();
+    
+    /**
+     * @brief Check if an export is running
+     */
+    bool isRunning() const;
+    
+    /**
+     * @brief Block until the running export ends
+     * @param msecs Timeout (-1 = no timeout)
+     * @return True if no export is running anymore
+     */
+    bool waitForFinished(int msecs = -1);
+    
+    // Samples per chunk (and per cursor page); takes effect with the next start()
+    void setChunkRows(int rows) { m_chunkRows = qMax(1, rows); }
+    int chunkRows() const { return m_chunkRows; }
+
+signals:
+    /**
+     * @brief Emitted after every chunk
+     * @param samplesWritten Samples written so far
+     * @param tagsDone Tags completely exported
+     * @param tagsTotal Tags to export
+     */
+    void progress(qint64 samplesWritten, int tagsDone, int tagsTotal);
+    
+    /**
+     * @brief Emitted when the export completed
+     */
+    void finished(const QString& outputPath, qint64 samplesWritten);
+    
+    /**
+     * @brief Emitted when the export failed or was cancelled
+     */
+    void failed(const QString& error);
+
+private:
+    struct Job {
+        QString outputPath;
+        QStringList tags;
+        QDateTime startTime;
+        QDateTime endTime;
+        Format format;
+        int chunkRows;
+    };
+    
+    /**
+     * @brief Perform one export (export thread)
+     * @return Number of samples written
+     */
+    Result<qint64> run(const Job& job);
+    
+    SqliteRepository& m_repository;
+    int m_chunkRows;
+    
+    std::unique_ptr<QThread> m_thread;  // Current or last export run
+    std::atomic<bool> m_cancelled;
+};
+
+/**
+ * @brief Reader for files written by HistorianExporter in the columnar format
+ * 
+ * Reference implementation of docs/api/historian-export-format.md. Only
+ * the header and the chunk index are read by open(); chunks are read on
+ * demand, so memory use is bounded by the largest chunk.
+ * 
+ * Example:
+ * @code
+ * HistorianExportReader reader;
+ * if (reader.open("line1.hcol").isSuccess()) {
+ *     for (int i = 0; i < reader.chunks().size(); ++i) {
+ *         auto samples = reader.readChunk(i);
+ *     }
+ * }
+ * @endcode
+ */
+class HistorianExportReader {
+public:
+    /**
+     * @brief Chunk index entry
+     */
+    struct Chunk {
+        qint64 offset = 0;      // File offset of the chunk
+        int tagIndex = 0;       // Index into tags()
+        int rowCount = 0;
+        qint64 firstMs = 0;     // Oldest timestamp in the chunk
+        qint64 lastMs = 0;      // Newest timestamp in the chunk
+    };
+    
+    /**
+     * @brief Open a file and read its schema and chunk index
+     */
+    Result<void> open(const QString& path);
+    
+    /**
+     * @brief Schema header (see the format specification)
+     */
+    QJsonObject schema() const { return m_schema; }
+    
+    /**
+     * @brief Exported tags; Chunk::tagIndex refers to this list
+     */
+    QStringList tags() const { return m_tags; }
+    
+    /**
+     * @brief Chunk index in file order
+     */
+    QList<Chunk> chunks() const { return m_chunks; }
+    
+    /**
+     * @brief Decode one chunk, verifying its column checksums
+     * @param index Index into chunks()
+     * @return Samples in ascending time order
+     */
+    Result<QList<DataPoint>> readChunk(int index);
+
+private:
+    QFile m_file;
+    QJsonObject m_schema;
+    QStringList m_tags;
+    QList<Chunk> m_chunks;
+};
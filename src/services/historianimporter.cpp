@@ -0,0 +1,426 @@
+#include "historianimporter.h"
+#include "historianexporter.h"
+#include "../repositories/sqliterepository.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDebug>
+#include <climits>
+
+namespace {
+
+// Rejected rows logged individually before going quiet
+const int MAX_LOGGED_REJECTS = 10;
+
+/**
+ * @brief Split one CSV record (RFC 4180)
+ * @return False if a quoted field is still open at the end of the text
+ */
+bool splitCsvRecord(const QByteArray& text, QList<QByteArray>& fields)
+{
+    fields.clear();
+    QByteArray field;
+    bool quoted = false;
+    
+    for (int i = 0; i < text.size(); ++i) {
+        const char c = text.at(i);
+        if (quoted) {
+            if (c != '"') {
+                field.append(c);
+            } else if (i + 1 < text.size() && text.at(i + 1) == '"') {
+                field.append('"');
+                ++i;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.append(field);
+            field.clear();
+        } else if (c != '\r' && c != '\n') {
+            field.append(c);
+        }
+    }
+    
+    fields.append(field);
+    return !quoted;
+}
+
+bool parseQuality(const QByteArray& text, DataPoint::Quality& quality)
+{
+    static const QHash<QByteArray, DataPoint::Quality> names = {
+        {"Good", DataPoint::Quality::Good}, {"Uncertain", DataPoint::Quality::Uncertain},
+        {"Bad", DataPoint::Quality::Bad}, {"Stale", DataPoint::Quality::Stale}
+    };
+    
+    const QByteArray trimmed = text.trimmed();
+    if (trimmed.isEmpty()) {
+        quality = DataPoint::Quality::Good;
+        return true;
+    }
+    
+    bool isNumber = false;
+    const int code = trimmed.toInt(&isNumber);
+    if (isNumber) {
+        quality = static_cast<DataPoint::Quality>(code);
+        return code >= 0 && code <= 3;
+    }
+    
+    auto it = names.constFind(trimmed);
+    if (it == names.constEnd()) {
+        return false;
+    }
+    quality = it.value();
+    return true;
+}
+
+/**
+ * @brief Column positions taken from a CSV header row
+ */
+struct CsvColumns {
+    int tag = -1;
+    int timestamp = -1;
+    int value = -1;
+    int quality = -1;
+    int required = 0;       // Fields a row needs to have
+    
+    bool parse(const QList<QByteArray>& header)
+    {
+        for (int i = 0; i < header.size(); ++i) {
+            const QByteArray name = header.at(i).trimmed().toLower();
+            if (name == "tag") {
+                tag = i;
+            } else if (name == "timestamp") {
+                timestamp = i;
+            } else if (name == "value") {
+                value = i;
+            } else if (name == "quality") {
+                quality = i;
+            }
+        }
+        required = qMax(qMax(tag, timestamp), value) + 1;
+        return tag >= 0 && timestamp >= 0 && value >= 0;
+    }
+    
+    bool toDataPoint(const QList<QByteArray>& fields, DataPoint& point) const
+    {
+        if (fields.size() < required) {
+            return false;
+        }
+        
+        const QString tagName = QString::fromUtf8(fields.at(tag));
+        if (tagName.isEmpty()) {
+            return false;
+        }
+        
+        const QByteArray timeText = fields.at(timestamp).trimmed();
+        bool isNumber = false;
+        QDateTime time = QDateTime::fromMSecsSinceEpoch(timeText.toLongLong(&isNumber));
+        if (!isNumber) {
+            time = QDateTime::fromString(QString::fromLatin1(timeText), Qt::ISODateWithMs);
+            if (!time.isValid()) {
+                return false;
+            }
+        }
+        
+        DataPoint::Quality pointQuality = DataPoint::Quality::Good;
+        if (quality >= 0 && quality < fields.size() && !parseQuality(fields.at(quality), pointQuality)) {
+            return false;
+        }
+        
+        // Same typing as the historian: integers, then doubles, else text
+        const QByteArray valueText = fields.at(value);
+        QVariant pointValue;
+        const qint64 integer = valueText.trimmed().toLongLong(&isNumber);
+        if (isNumber) {
+            pointValue = integer;
+        } else {
+            const double real = valueText.trimmed().toDouble(&isNumber);
+            pointValue = isNumber ? QVariant(real) : QVariant(QString::fromUtf8(valueText));
+        }
+        
+        point = DataPoint(tagName, pointValue, time, pointQuality);
+        return true;
+    }
+};
+
+} // namespace
+
+struct HistorianImporter::Run {
+    Checkpoint checkpoint;
+    QString sourcePath;
+    qint64 bytesTotal = 0;
+    int batchRows = 0;
+    qint64 rowsThisRun = 0;
+    QElapsedTimer elapsed;
+    
+    double rowsPerSecond() const
+    {
+        return rowsThisRun * 1000.0 / qMax<qint64>(1, elapsed.elapsed());
+    }
+};
+
+HistorianImporter::HistorianImporter(SqliteRepository& repository, QObject* parent)
+    : QObject(parent)
+    , m_repository(repository)
+    , m_batchRows(DEFAULT_BATCH_ROWS)
+    , m_cancelled(false)
+{
+}
+
+HistorianImporter::~HistorianImporter()
+{
+    cancel();
+    if (m_thread) {
+        m_thread->wait();
+    }
+}
+
+Result<void> HistorianImporter::start(const QString& sourcePath)
+{
+    if (isRunning()) {
+        return Result<void>::failure("An import is already running");
+    }
+    if (!QFileInfo(sourcePath).isFile()) {
+        return Result<void>::failure("No such file: " + sourcePath);
+    }
+    
+    if (m_thread) {
+        m_thread->wait();
+    }
+    
+    m_cancelled = false;
+    const int batchRows = m_batchRows;
+    
+    m_thread.reset(QThread::create([this, sourcePath, batchRows]() {
+        auto result = run(sourcePath, batchRows);
+        if (result.isFailure()) {
+            qWarning() << "HistorianImporter:" << result.error();
+            emit failed(result.error());
+        }
+    }));
+    m_thread->setObjectName("HistorianImporter");
+    m_thread->start(QThread::LowPriority);
+    
+    return Result<void>::success();
+}
+
+void HistorianImporter::cancel()
+{
+    m_cancelled = true;
+}
+
+bool HistorianImporter::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+bool HistorianImporter::waitForFinished(int msecs)
+{
+    return !m_thread || m_thread->wait(msecs < 0 ? ULONG_MAX : static_cast<unsigned long>(msecs));
+}
+
+QString HistorianImporter::checkpointPath() const
+{
+    return m_repository.databasePath() + ".import.json";
+}
+
+Result<void> HistorianImporter::run(const QString& sourcePath, int batchRows)
+{
+    const QFileInfo source(sourcePath);
+    
+    Run run;
+    run.sourcePath = source.absoluteFilePath();
+    run.bytesTotal = source.size();
+    run.batchRows = batchRows;
+    run.elapsed.start();
+    
+    // Continue where an earlier run on the same, unchanged file stopped
+    run.checkpoint = loadCheckpoint();
+    if (run.checkpoint.source != run.sourcePath
+        || run.checkpoint.size != source.size()
+        || run.checkpoint.modifiedMs != source.lastModified().toMSecsSinceEpoch()) {
+        run.checkpoint = Checkpoint();
+        run.checkpoint.source = run.sourcePath;
+        run.checkpoint.size = source.size();
+        run.checkpoint.modifiedMs = source.lastModified().toMSecsSinceEpoch();
+    } else if (run.checkpoint.position > 0) {
+        qDebug() << "HistorianImporter: Resuming" << run.sourcePath << "after"
+                 << run.checkpoint.rowsImported << "rows";
+    }
+    
+    QFile probe(run.sourcePath);
+    if (!probe.open(QIODevice::ReadOnly)) {
+        return Result<void>::failure("Cannot open " + run.sourcePath + ": " + probe.errorString());
+    }
+    const bool columnar = probe.peek(4) == "HCOL";
+    probe.close();
+    
+    m_repository.beginBulkLoad();
+    Result<void> loaded = columnar ? importColumnar(run) : importCsv(run);
+    
+    // Runs after failures too, so the repository maintains rollups again
+    Result<void> rebuilt = m_repository.endBulkLoad();
+    if (loaded.isFailure()) {
+        return loaded;
+    }
+    if (rebuilt.isFailure()) {
+        return rebuilt;
+    }
+    
+    QFile::remove(checkpointPath());
+    emit finished(run.checkpoint.rowsImported, run.checkpoint.rowsRejected, run.rowsPerSecond());
+    return Result<void>::success();
+}
+
+Result<void> HistorianImporter::importCsv(Run& run)
+{
+    QFile file(run.sourcePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return Result<void>::failure("Cannot open " + run.sourcePath + ": " + file.errorString());
+    }
+    
+    // The header is read on every run; a checkpoint points past it
+    QList<QByteArray> fields;
+    CsvColumns columns;
+    if (!splitCsvRecord(file.readLine(), fields) || !columns.parse(fields)) {
+        return Result<void>::failure("CSV header must name the columns tag, timestamp and value");
+    }
+    if (run.checkpoint.position > 0 && !file.seek(run.checkpoint.position)) {
+        return Result<void>::failure("Cannot seek to the checkpoint in " + run.sourcePath);
+    }
+    
+    QList<DataPoint> batch;
+    batch.reserve(run.batchRows);
+    while (!file.atEnd()) {
+        if (m_cancelled) {
+            return Result<void>::failure("Import cancelled");
+        }
+        
+        // Quoted fields may span lines
+        const qint64 recordStart = file.pos();
+        QByteArray record = file.readLine();
+        while (!splitCsvRecord(record, fields) && !file.atEnd()) {
+            record += file.readLine();
+        }
+        if (record.trimmed().isEmpty()) {
+            continue;
+        }
+        
+        DataPoint point;
+        if (columns.toDataPoint(fields, point)) {
+            batch.append(point);
+        } else if (++run.checkpoint.rowsRejected <= MAX_LOGGED_REJECTS) {
+            qWarning() << "HistorianImporter: Skipping unparsable row at byte" << recordStart
+                       << ":" << record.left(200).trimmed();
+        }
+        
+        if (batch.size() >= run.batchRows) {
+            auto committed = commitBatch(run, batch, file.pos(), file.pos());
+            if (committed.isFailure()) {
+                return committed;
+            }
+        }
+    }
+    
+    return batch.isEmpty() ? Result<void>::success() : commitBatch(run, batch, file.pos(), file.pos());
+}
+
+Result<void> HistorianImporter::importColumnar(Run& run)
+{
+    HistorianExportReader reader;
+    auto opened = reader.open(run.sourcePath);
+    if (opened.isFailure()) {
+        return opened;
+    }
+    
+    const QList<HistorianExportReader::Chunk> chunks = reader.chunks();
+    QList<DataPoint> batch;
+    for (int i = int(run.checkpoint.position); i < chunks.size(); ++i) {
+        if (m_cancelled) {
+            return Result<void>::failure("Import cancelled");
+        }
+        
+        auto samples = reader.readChunk(i);
+        if (samples.isFailure()) {
+            return Result<void>::failure(samples.error());
+        }
+        batch.append(samples.value());
+        
+        if (batch.size() >= run.batchRows) {
+            const qint64 bytesDone = i + 1 < chunks.size() ? chunks.at(i + 1).offset : run.bytesTotal;
+            auto committed = commitBatch(run, batch, i + 1, bytesDone);
+            if (committed.isFailure()) {
+                return committed;
+            }
+        }
+    }
+    
+    return batch.isEmpty() ? Result<void>::success() : commitBatch(run, batch, chunks.size(), run.bytesTotal);
+}
+
+Result<void> HistorianImporter::commitBatch(Run& run, QList<DataPoint>& batch, qint64 position, qint64 bytesDone)
+{
+    if (!batch.isEmpty()) {
+        auto written = m_repository.importSamples(batch);
+        if (written.isFailure()) {
+            return written;
+        }
+        run.rowsThisRun += batch.size();
+        run.checkpoint.rowsImported += batch.size();
+        batch.clear();
+    }
+    
+    // The checkpoint only moves after the batch is committed
+    run.checkpoint.position = position;
+    auto saved = saveCheckpoint(run.checkpoint);
+    if (saved.isFailure()) {
+        return saved;
+    }
+    
+    emit progress(run.checkpoint.rowsImported, bytesDone, run.bytesTotal, run.rowsPerSecond());
+    return Result<void>::success();
+}
+
+HistorianImporter::Checkpoint HistorianImporter::loadCheckpoint() const
+{
+    Checkpoint checkpoint;
+    QFile file(checkpointPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return checkpoint;
+    }
+    
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+    checkpoint.source = json.value("source").toString();
+    checkpoint.size = qint64(json.value("size").toDouble());
+    checkpoint.modifiedMs = qint64(json.value("modifiedMs").toDouble());
+    checkpoint.position = qint64(json.value("position").toDouble());
+    checkpoint.rowsImported = qint64(json.value("rowsImported").toDouble());
+    checkpoint.rowsRejected = qint64(json.value("rowsRejected").toDouble());
+    return checkpoint;
+}
+
+Result<void> HistorianImporter::saveCheckpoint(const Checkpoint& checkpoint) const
+{
+    QJsonObject json;
+    json["source"] = checkpoint.source;
+    json["size"] = double(checkpoint.size);
+    json["modifiedMs"] = double(checkpoint.modifiedMs);
+    json["position"] = double(checkpoint.position);
+    json["rowsImported"] = double(checkpoint.rowsImported);
+    json["rowsRejected"] = double(checkpoint.rowsRejected);
+    
+    QSaveFile file(checkpointPath());
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(QJsonDocument(json).toJson()) < 0
+        || !file.commit()) {
+        return Result<void>::failure("Cannot write import checkpoint " + checkpointPath() + ": " + file.errorString());
+    }
+    return Result<void>::success();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include "../models/datapoint.h"
+#include "../utils/result.h"
+
+class SqliteRepository;
+
+/**
+ * @brief Resumable bulk backfill of historical samples into the historian
+ * 
+ * Loads a CSV file or a columnar export (docs/api/historian-export-format.md)
+ * into a SqliteRepository on a background thread, for migrations from
+ * other logging systems where per-row saves would take days.
+ * 
+ * Pattern: Service Layer (RULE-303)
+ * Location: src/services/
+ * Threading: Runs in its own QThread (RULE-501); signals are delivered
+ *            queued to receivers in other threads. The repository must
+ *            outlive the import. Parsing happens on the import thread;
+ *            every batch is written by the repository's writer thread,
+ *            which the import thread waits for.
+ * 
+ * How the load is made fast:
+ * - Rows are written in batches of batchRows() with one transaction per
+ *   partition and batch (SqliteRepository::importSamples())
+ * - The repository is put in bulk-load mode, so the per-row rollup
+ *   trigger is dropped from the partitions being loaded and the rollups
+ *   are rebuilt in one pass per partition at the end
+ * - Input sorted by time keeps each batch within few partitions; unsorted
+ *   input is accepted but slower
+ * 
+ * Resuming: after every committed batch the input position is recorded in
+ * "<db>.import.json" (written atomically). Starting the same, unchanged
+ * input file again (same path, size and modification time) continues
+ * from there; rows of a batch interrupted before its checkpoint are
+ * written again, which the historian's upsert on (tag, timestamp) makes harmless.
+ * The checkpoint is removed when an import completes.
+ * 
+ * CSV input: a header row naming the columns tag, timestamp, value and
+ * optionally quality (any order, other columns ignored), RFC 4180 quoting.
+ * Timestamps are milliseconds since epoch or ISO 8601; values are parsed
+ * as integers, then doubles, else kept as text; quality is a name (Good,
+ * Uncertain, Bad, Stale) or 0-3. Rows that cannot be parsed are skipped
+ * and counted. HistorianExporter's CSV output is accepted as is.
+ * 
+ * Example:
+ * @code
+ * HistorianImporter importer(repository);
+ * connect(&importer, &HistorianImporter::progress, this, &Page::showImportProgress);
+ * importer.start("/media/usb/legacy-2019.csv");
+ * @endcode
+ */
+class HistorianImporter : public QObject {
+    Q_OBJECT
+    
+public:
+    static constexpr int DEFAULT_BATCH_ROWS = 100000;
+    
+    explicit HistorianImporter(SqliteRepository& repository, QObject* parent = nullptr);
+    
+    /**
+     * @brief Cancels a running import and waits for the thread
+     * 
+     * A cancelled import keeps its checkpoint and can be resumed.
+     */
+    ~HistorianImporter() override;
+    
+    /**
+     * @brief Start (or resume) importing a file in the background
+     * @param sourcePath CSV file or columnar export (detected by content)
+     * @return Failure if an import is already running or the file does not exist
+     */
+    Result<void> start(const QString& sourcePath);
+    
+    /**
+     * @brief Request cancellation after the current batch; failed() is emitted
+     */
+    void cancel();
+    
+    /**
+     * @brief Check if an import is running
+     */
+    bool isRunning() const;
+    
+    /**
+     * @brief Block until the running import ends
+     * @param msecs Timeout (-1 = no timeout)
+     * @return True if no import is running anymore
+     */
+    bool waitForFinished(int msecs = -1);
+    
+    /**
+     * @brief Checkpoint file used to resume imports into this repository
+     */
+    QString checkpointPath() const;
+    
+    // Rows per transaction batch; takes effect with the next start()
+    void setBatchRows(int rows) { m_batchRows = qMax(1, rows); }
+    int batchRows() const { return m_batchRows; }
+
+signals:
+    /**
+     * @brief Emitted after every committed batch
+     * @param rowsImported Rows imported from this file so far (including earlier runs)
+     * @param bytesDone Input position
+     * @param bytesTotal Input size
+     * @param rowsPerSecond Import rate of this run
+     */
+    void progress(qint64 rowsImported, qint64 bytesDone, qint64 bytesTotal, double rowsPerSecond);
+    
+    /**
+     * @brief Emitted when the import completed and the rollups were rebuilt
+     * @param rowsImported Rows imported from the file (including earlier runs)
+     * @param rowsRejected Rows skipped because they could not be parsed
+     * @param rowsPerSecond Rate of this run, including the rollup rebuild
+     */
+    void finished(qint64 rowsImported, qint64 rowsRejected, double rowsPerSecond);
+    
+    /**
+     * @brief Emitted when the import failed or was cancelled (the checkpoint is kept)
+     */
+    void failed(const QString& error);
+
+private:
+    /**
+     * @brief Resume point of an import, persisted after every batch
+     */
+    struct Checkpoint {
+        QString source;             // Absolute input path
+        qint64 size = 0;            // Input size when the import started
+        qint64 modifiedMs = 0;      // Input modification time when the import started
+        qint64 position = 0;        // CSV: byte offset; columnar: chunk index
+        qint64 rowsImported = 0;
+        qint64 rowsRejected = 0;
+    };
+    
+    /**
+     * @brief Tracks one run's counters and reports progress
+     */
+    struct Run;
+    
+    /**
+     * @brief Perform one import (import thread)
+     */
+    Result<void> run(const QString& sourcePath, int batchRows);
+    
+    Result<void> importCsv(Run& run);
+    Result<void> importColumnar(Run& run);
+    
+    /**
+     * @brief Write a batch and record the new position in the checkpoint
+     */
+    Result<void> commitBatch(Run& run, QList<DataPoint>& batch, qint64 position, qint64 bytesDone);
+    
+    Checkpoint loadCheckpoint() const;
+    Result<void> saveCheckpoint(const Checkpoint& checkpoint) const;
+    
+    SqliteRepository& m_repository;
+    int m_batchRows;
+    
+    std::unique_ptr<QThread> m_thread;  // Current or last import run
+    std::atomic<bool> m_cancelled;
+};
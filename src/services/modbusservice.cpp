@@ -2,7 +2,9 @@
 #include "../../deps/external/libmodbus/src/modbus.h"
 #include "../../deps/external/libmodbus/src/modbus-tcp.h"
 #include <QDebug>
+#include <QMetaMethod>
 #include <QThread>
+#include <algorithm>
 #include <errno.h>
 
 ModbusService::ModbusService(QObject* parent)
@@ -16,6 +18,8 @@ ModbusService::ModbusService(QObject* parent)
     , m_maxReconnectAttempts(5)
     , m_debugEnabled(false)
 {
+    qRegisterMetaType<Sample>("Sample");
+    
     // Connect poll timer
     QObject::connect(m_pollTimer, &QTimer::timeout,
                      this, &ModbusService::onPollTimerTimeout);
@@ -100,12 +104,14 @@ bool ModbusService::isConnected() const {
 
 Result<QVariant> ModbusService::read(const QString& tag) {
     // Look up address for this tag
-    if (!m_tagToAddressMap.contains(tag)) {
+    const quint32 tagId = TagRegistry::instance().find(tag);
+    auto polled = std::find_if(m_polledTags.cbegin(), m_polledTags.cend(),
+                               [tagId](const PolledTag& polledTag) { return polledTag.tagId == tagId; });
+    if (tagId == 0 || polled == m_polledTags.cend()) {
         return Result<QVariant>::failure(QString("Unknown tag: %1").arg(tag));
     }
     
-    int address = m_tagToAddressMap[tag];
-    auto result = readInputRegister(address);
+    auto result = readInputRegister(polled->address);
     
     if (result.isSuccess()) {
         return Result<QVariant>::success(QVariant(result.value()));
@@ -192,15 +198,57 @@ void ModbusService::stopPolling() {
     }
 }
 
+Result<void> ModbusService::addTag(quint32 tagId) {
+    const TagInfo info = TagRegistry::instance().info(tagId);
+    if (!info.isValid() || info.address < 0) {
+        return Result<void>::failure(QString("Tag %1 has no register address").arg(info.isValid() ? info.name : QString::number(tagId)));
+    }
+    
+    const PolledTag tag = {tagId, info.address, info.deadband, 0.0, false};
+    for (PolledTag& polled : m_polledTags) {
+        if (polled.tagId == tagId) {
+            polled = tag;
+            return Result<void>::success();
+        }
+    }
+    m_polledTags.append(tag);
+    return Result<void>::success();
+}
+
+quint32 ModbusService::mapTag(const QString& tag, int address) {
+    TagRegistry& registry = TagRegistry::instance();
+    
+    TagInfo info = registry.info(registry.find(tag));
+    info.name = tag;
+    info.controller = m_address;
+    info.address = address;
+    info.type = TagInfo::ValueType::Int;
+    
+    const quint32 tagId = registry.define(info);
+    addTag(tagId);
+    return tagId;
+}
+
 void ModbusService::onPollTimerTimeout() {
+    const bool stringListeners = isSignalConnected(QMetaMethod::fromSignal(&ModbusService::dataReady));
+    
     // Poll all registered tags
-    for (auto it = m_tagToAddressMap.constBegin(); it != m_tagToAddressMap.constEnd(); ++it) {
-        const QString& tag = it.key();
-        int address = it.value();
+    for (PolledTag& tag : m_polledTags) {
+        auto result = readInputRegister(tag.address);
+        if (!result.isSuccess()) {
+            continue;
+        }
+        
+        const double value = result.value();
+        if (tag.published && tag.deadband > 0.0 && qAbs(value - tag.lastValue) < tag.deadband) {
+            continue;
+        }
+        tag.lastValue = value;
+        tag.published = true;
         
-        auto result = readInputRegister(address);
-        if (result.isSuccess()) {
-            emit dataReady(tag, QVariant(result.value()));
+        emit sampleReady(Sample::ofInt(tag.tagId, Sample::nowNs(), result.value()));
+        if (stringListeners) {
+            emit dataReady(TagRegistry::instance().name(tag.tagId), QVariant(result.value()));
         }
     }
 }
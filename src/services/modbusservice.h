@@ -3,7 +3,9 @@
 #include <QObject>
 #include <QTimer>
 #include <QThread>
+#include <QVector>
 #include "../interfaces/idatasource.h"
+#include "../models/sample.h"
 #include "../utils/result.h"
 
 // Forward declare modbus_t to avoid exposing libmodbus in header
@@ -24,6 +26,9 @@ typedef struct _modbus modbus_t;
  * - Thread-safe operation
  * - Error handling and reporting
  * - Configurable retry attempts
+ * - Polled tags kept as TagRegistry IDs; values published as compact
+ *   Samples (sampleReady()), filtered by each tag's deadband; the
+ *   string-keyed dataReady() is only built when something connects to it
  */
 class ModbusService : public QObject {
     Q_OBJECT
@@ -62,6 +67,27 @@ public:
      */
     Result<void> writeSingleRegister(int address, uint16_t value);
     
+    /**
+     * @brief Poll a registered tag
+     * 
+     * The input register and deadband are taken from the tag's TagRegistry
+     * entry when it is added; add it again after redefining it.
+     * @param tagId Tag ID with an address (TagRegistry)
+     * @return Failure for unknown tags or tags without an address
+     */
+    Result<void> addTag(quint32 tagId);
+    
+    /**
+     * @brief Register a tag on this controller's input register and poll it
+     * 
+     * Convenience for addTag(): sets the tag's controller and address in
+     * TagRegistry, keeping its other metadata.
+     * @param tag Tag name
+     * @param address Register address (0-65535)
+     * @return The tag's ID
+     */
+    quint32 mapTag(const QString& tag, int address);
+    
     /**
      * @brief Set maximum reconnection attempts
      */
@@ -80,6 +106,12 @@ signals:
      */
     void dataReady(const QString& tag, const QVariant& value);
     
+    /**
+     * @brief Emitted for every polled value
+     * @param sample Register value (Int) with tag ID and acquisition time
+     */
+    void sampleReady(const Sample& sample);
+    
     /**
      * @brief Emitted when an error occurs
      * @param error Error message describing what went wrong
@@ -116,5 +148,12 @@ private:
     bool m_debugEnabled;
     
     // For polling specific tags
-    QMap<QString, int> m_tagToAddressMap;  // Map tag names to Modbus addresses
+    struct PolledTag {
+        quint32 tagId;
+        int address;
+        double deadband;        // Publish only changes of at least this much (0 = all)
+        double lastValue;       // Last published value
+        bool published;         // lastValue is set
+    };
+    QVector<PolledTag> m_polledTags;       // Polled tags, in polling order
 };
@@ -0,0 +1,315 @@
+#include "xmlacquisitionservice.h"
+#include <QNetworkRequest>
+#include <QDateTime>
+#include <QRunnable>
+#include <QDebug>
+#include <limits>
+
+XmlAcquisitionService::XmlAcquisitionService(QObject *parent)
+    : QObject(parent)
+    , m_networkManager(new QNetworkAccessManager(this))
+    , m_scheduleTimer(new QTimer(this))
+    , m_nextSourceId(1)
+    , m_visibleSource(-1)
+    , m_maxConcurrentRequests(DEFAULT_MAX_CONCURRENT_REQUESTS)
+    , m_requestTimeout(DEFAULT_REQUEST_TIMEOUT_MS)
+    , m_requestsInFlight(0)
+    , m_running(false)
+{
+    qRegisterMetaType<XmlAcquisitionService::SnapshotPtr>();
+    m_clock.start();
+    m_scheduleTimer->setSingleShot(true);
+    connect(m_scheduleTimer, &QTimer::timeout, this, &XmlAcquisitionService::schedule);
+}
+
+XmlAcquisitionService::~XmlAcquisitionService()
+{
+    m_running = false;
+    for (const auto &source : qAsConst(m_sources)) {
+        if (source->reply) {
+            source->reply->disconnect(this);
+            source->reply->abort();
+        }
+    }
+    // Parse tasks hold a pointer to the service; their queued results are
+    // discarded with the service's pending events
+    m_parserPool.waitForDone();
+}
+
+QString XmlAcquisitionService::sourceKey(const QString &baseUrl, const QString &fileName)
+{
+    QString key = baseUrl;
+    if (!key.endsWith('/')) {
+        key += '/';
+    }
+    return key + fileName;
+}
+
+int XmlAcquisitionService::addSource(const QString &baseUrl, const QString &fileName, int intervalMs)
+{
+    const QString key = sourceKey(baseUrl, fileName);
+    auto existing = m_sourceIds.constFind(key);
+    if (existing != m_sourceIds.constEnd()) {
+        m_sources.value(existing.value())->intervalMs = qMax(0, intervalMs);
+        return existing.value();
+    }
+    
+    auto source = std::make_shared<Source>();
+    source->id = m_nextSourceId++;
+    source->baseUrl = baseUrl;
+    source->fileName = fileName;
+    source->url = QUrl(key);
+    source->intervalMs = qMax(0, intervalMs);
+    source->nextDueMs = m_clock.elapsed();
+    if (!m_layoutCacheDir.isNull()) {
+        source->parser.setLayoutCacheDirectory(m_layoutCacheDir);
+    }
+    
+    m_sources.insert(source->id, source);
+    m_sourceIds.insert(key, source->id);
+    qDebug() << "XmlAcquisitionService: Added source" << source->id << key;
+    
+    if (m_running) {
+        schedule();
+    }
+    return source->id;
+}
+
+void XmlAcquisitionService::removeSource(int sourceId)
+{
+    std::shared_ptr<Source> source = m_sources.take(sourceId);
+    if (!source) return;
+    
+    m_sourceIds.remove(sourceKey(source->baseUrl, source->fileName));
+    if (m_visibleSource == sourceId) {
+        m_visibleSource = -1;
+    }
+    
+    // A running parse task keeps the source alive until it finishes; its
+    // result is dropped in onParsed()
+    if (source->reply) {
+        QNetworkReply *reply = source->reply;
+        source->reply = nullptr;
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+        m_requestsInFlight--;
+        schedule();
+    }
+}
+
+void XmlAcquisitionService::setVisibleSource(int sourceId)
+{
+    m_visibleSource = m_sources.contains(sourceId) ? sourceId : -1;
+    if (m_visibleSource < 0) return;
+    
+    // Show current values right away instead of after the rest of the interval
+    m_sources.value(m_visibleSource)->nextDueMs = m_clock.elapsed();
+    if (m_running) {
+        schedule();
+    }
+}
+
+void XmlAcquisitionService::setMaxConcurrentRequests(int maxRequests)
+{
+    m_maxConcurrentRequests = qMax(1, maxRequests);
+    if (m_running) {
+        schedule();
+    }
+}
+
+void XmlAcquisitionService::setMaxParserThreads(int maxThreads)
+{
+    m_parserPool.setMaxThreadCount(qMax(1, maxThreads));
+}
+
+void XmlAcquisitionService::setRequestTimeout(int timeoutMs)
+{
+    m_requestTimeout = qMax(0, timeoutMs);
+}
+
+void XmlAcquisitionService::setLayoutCacheDirectory(const QString &directory)
+{
+    m_layoutCacheDir = directory;
+}
+
+void XmlAcquisitionService::start()
+{
+    m_running = true;
+    schedule();
+}
+
+void XmlAcquisitionService::stop()
+{
+    // Requests and parses in flight still complete and publish
+    m_running = false;
+    m_scheduleTimer->stop();
+}
+
+XmlAcquisitionService::SnapshotPtr XmlAcquisitionService::snapshot(int sourceId) const
+{
+    const std::shared_ptr<Source> source = m_sources.value(sourceId);
+    return source ? source->snapshot : SnapshotPtr();
+}
+
+std::shared_ptr<XmlAcquisitionService::Source> XmlAcquisitionService::nextDueSource(qint64 now) const
+{
+    // The visible page goes first; the others in the order they became due
+    std::shared_ptr<Source> next;
+    for (const auto &source : m_sources) {
+        if (source->reply || source->parsing || source->nextDueMs > now) {
+            continue;
+        }
+        if (source->id == m_visibleSource) {
+            return source;
+        }
+        if (!next || source->nextDueMs < next->nextDueMs
+            || (source->nextDueMs == next->nextDueMs && source->id < next->id)) {
+            next = source;
+        }
+    }
+    return next;
+}
+
+void XmlAcquisitionService::schedule()
+{
+    if (!m_running) return;
+    
+    const qint64 now = m_clock.elapsed();
+    while (m_requestsInFlight < m_maxConcurrentRequests) {
+        const std::shared_ptr<Source> source = nextDueSource(now);
+        if (!source) break;
+        startFetch(source);
+    }
+    
+    // While all slots are busy the next finished request reschedules
+    m_scheduleTimer->stop();
+    if (m_requestsInFlight >= m_maxConcurrentRequests) return;
+    
+    qint64 nextDueMs = std::numeric_limits<qint64>::max();
+    for (const auto &source : qAsConst(m_sources)) {
+        if (!source->reply && !source->parsing) {
+            nextDueMs = qMin(nextDueMs, source->nextDueMs);
+        }
+    }
+    if (nextDueMs != std::numeric_limits<qint64>::max()) {
+        m_scheduleTimer->start(int(qBound<qint64>(0, nextDueMs - now, std::numeric_limits<int>::max())));
+    }
+}
+
+void XmlAcquisitionService::startFetch(const std::shared_ptr<Source> &source)
+{
+    QNetworkRequest request(source->url);
+    request.setHeader(QNetworkRequest::UserAgentHeader, "Qt Industrial HMI Client");
+    request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    // A controller that stops answering must not hold a request slot forever
+    request.setTransferTimeout(m_requestTimeout);
+    
+    // Only ask for a 304 while we still hold the page it would stand for
+    if (source->snapshot) {
+        if (!source->etag.isEmpty()) {
+            request.setRawHeader("If-None-Match", source->etag);
+        }
+        if (!source->lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", source->lastModified);
+        }
+    }
+    
+    QNetworkReply *reply = m_networkManager->get(request);
+    reply->setProperty("sourceId", source->id);
+    connect(reply, &QNetworkReply::finished, this, &XmlAcquisitionService::onNetworkReply);
+    source->reply = reply;
+    
+    m_requestsInFlight++;
+    m_statistics.requests++;
+    m_statistics.peakConcurrentRequests = qMax(m_statistics.peakConcurrentRequests, m_requestsInFlight);
+}
+
+void XmlAcquisitionService::onNetworkReply()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    
+    reply->deleteLater();
+    const std::shared_ptr<Source> source = m_sources.value(reply->property("sourceId").toInt());
+    if (!source || source->reply != reply) return;
+    
+    source->reply = nullptr;
+    m_requestsInFlight--;
+    const qint64 now = m_clock.elapsed();
+    
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() != QNetworkReply::NoError) {
+        m_statistics.errors++;
+        source->nextDueMs = now + source->intervalMs;
+        QString error = QString("Network error: %1").arg(reply->errorString());
+        qDebug() << "XmlAcquisitionService:" << source->url.toString() << error;
+        emit sourceError(source->id, error);
+    } else if (status == 304) {
+        // Unchanged document: the latest snapshot stays current
+        m_statistics.notModified++;
+        source->nextDueMs = now + source->intervalMs;
+    } else {
+        source->etag = reply->rawHeader("ETag");
+        source->lastModified = reply->rawHeader("Last-Modified");
+        startParse(source, reply->readAll(), QDateTime::currentMSecsSinceEpoch());
+    }
+    
+    schedule();
+}
+
+void XmlAcquisitionService::startParse(const std::shared_ptr<Source> &source, const QByteArray &xmlData, qint64 receivedMs)
+{
+    source->parsing = true;
+    
+    QRunnable *task = QRunnable::create([this, source, xmlData, receivedMs]() {
+        SnapshotPtr snapshot;
+        QString error;
+        const auto result = source->parser.update(xmlData);
+        if (result.isSuccess()) {
+            auto page = std::make_shared<PageSnapshot>();
+            page->sourceId = source->id;
+            page->baseUrl = source->baseUrl;
+            page->fileName = source->fileName;
+            page->page = source->parser.page(); // Implicitly shared with the parser
+            page->changes = result.value().changes;
+            page->layoutChanged = result.value().layoutChanged;
+            page->sequence = ++source->sequence;
+            page->receivedMs = receivedMs;
+            snapshot = std::move(page);
+        } else {
+            error = QString("XML parsing error: %1").arg(result.error());
+        }
+        
+        QMetaObject::invokeMethod(this, [this, source, snapshot, error]() {
+            onParsed(source, snapshot, error);
+        }, Qt::QueuedConnection);
+    });
+    
+    // Parse what the operator is looking at before background pages
+    m_parserPool.start(task, source->id == m_visibleSource ? 1 : 0);
+}
+
+void XmlAcquisitionService::onParsed(const std::shared_ptr<Source> &source, const SnapshotPtr &snapshot, const QString &error)
+{
+    source->parsing = false;
+    source->nextDueMs = m_clock.elapsed() + source->intervalMs;
+    
+    // Removed while parsing
+    if (m_sources.value(source->id) != source) return;
+    
+    if (snapshot) {
+        m_statistics.parses++;
+        source->snapshot = snapshot;
+        emit pageUpdated(source->id, snapshot);
+    } else {
+        m_statistics.errors++;
+        // Without a page the next request must return the full document
+        source->etag.clear();
+        source->lastModified.clear();
+        qDebug() << "XmlAcquisitionService:" << source->url.toString() << error;
+        emit sourceError(source->id, error);
+    }
+    
+    schedule();
+}
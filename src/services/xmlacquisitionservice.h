@@ -0,0 +1,203 @@
+#pragma once
+
+#include "controllerxmlservice.h"
+#include "controllerxmlparser.h"
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QTimer>
+#include <QHash>
+#include <QString>
+#include <memory>
+
+/**
+ * @brief Pooled acquisition of controller XML pages from many controllers
+ * 
+ * Polls the XML pages of any number of controllers through one network
+ * manager. Fetches are scheduled under a global limit of concurrent
+ * requests, so dozens of controllers don't open dozens of connections at
+ * once, and documents are parsed on a worker thread pool instead of the
+ * GUI thread. Every parsed document is published as an immutable, shared
+ * PageSnapshot; subscribers may keep a snapshot as long as they like and
+ * hand it to other threads without copying.
+ * 
+ * The page visible to the operator is fetched first whenever a request
+ * slot frees up, is refreshed immediately when it becomes visible, and is
+ * parsed ahead of background pages.
+ * 
+ * Requests are conditional like those of ControllerXmlService (an
+ * unchanged page costs a 304 and publishes nothing) and each source keeps
+ * its own ControllerXmlParser, so refreshes with a known layout only scan
+ * for values.
+ * 
+ * Pattern: Service (QObject, GUI thread)
+ * Location: src/services/
+ * 
+ * Example:
+ * @code
+ * XmlAcquisitionService acquisition;
+ * const int id = acquisition.addSource("http://10.0.0.12/", "unit/p_operation.xml", 5000);
+ * connect(&acquisition, &XmlAcquisitionService::pageUpdated,
+ *         [](int sourceId, const XmlAcquisitionService::SnapshotPtr &snapshot) {
+ *             // snapshot->page, snapshot->changes
+ *         });
+ * acquisition.setVisibleSource(id);
+ * acquisition.start();
+ * @endcode
+ */
+class XmlAcquisitionService : public QObject
+{
+    Q_OBJECT
+
+public:
+    using XmlPage = ControllerXmlService::XmlPage;
+    using XmlValueChange = ControllerXmlService::XmlValueChange;
+    
+    static constexpr int DEFAULT_MAX_CONCURRENT_REQUESTS = 4;
+    static constexpr int DEFAULT_REQUEST_TIMEOUT_MS = 10000;
+    
+    /**
+     * @brief One parsed document of a source; never modified once published
+     */
+    struct PageSnapshot
+    {
+        int sourceId = -1;
+        QString baseUrl;
+        QString fileName;
+        XmlPage page;
+        QVector<XmlValueChange> changes;    // Against the previous snapshot, if !layoutChanged
+        bool layoutChanged = true;          // First snapshot, or forms/fields differ
+        quint64 sequence = 0;               // 1 for the first snapshot of a source
+        qint64 receivedMs = 0;              // Epoch ms the document arrived
+    };
+    
+    using SnapshotPtr = std::shared_ptr<const PageSnapshot>;
+    
+    /**
+     * @brief Counters since construction
+     */
+    struct Statistics
+    {
+        int requests = 0;               // GETs sent
+        int notModified = 0;            // 304 responses
+        int parses = 0;                 // Documents parsed into snapshots
+        int errors = 0;                 // Network, HTTP and parse errors
+        int peakConcurrentRequests = 0; // Most requests in flight at once
+    };
+    
+    explicit XmlAcquisitionService(QObject *parent = nullptr);
+    ~XmlAcquisitionService();
+    
+    /**
+     * @brief Poll a controller page
+     * @param baseUrl Controller web root, e.g. "http://10.0.0.12/"
+     * @param fileName Page below the base URL, e.g. "unit/p_operation.xml"
+     * @param intervalMs Time between the end of one fetch and the next
+     * @return Source ID; the existing ID if the page is already polled
+     */
+    int addSource(const QString &baseUrl, const QString &fileName, int intervalMs);
+    
+    /**
+     * @brief Stop polling a page; a request in flight is aborted
+     */
+    void removeSource(int sourceId);
+    
+    /**
+     * @brief Mark the page the operator is looking at (-1 for none)
+     * 
+     * The page is refreshed as soon as a request slot is free and is
+     * preferred over all other due pages from then on.
+     */
+    void setVisibleSource(int sourceId);
+    int visibleSource() const { return m_visibleSource; }
+    
+    /**
+     * @brief Limit the number of requests in flight across all sources
+     */
+    void setMaxConcurrentRequests(int maxRequests);
+    int maxConcurrentRequests() const { return m_maxConcurrentRequests; }
+    
+    /**
+     * @brief Limit the number of threads parsing documents
+     */
+    void setMaxParserThreads(int maxThreads);
+    
+    /**
+     * @brief Abort requests that take longer than this (0 = never)
+     */
+    void setRequestTimeout(int timeoutMs);
+    
+    /**
+     * @brief Layout cache directory of the sources' parsers (see ControllerXmlParser)
+     * 
+     * Applies to sources added afterwards.
+     */
+    void setLayoutCacheDirectory(const QString &directory);
+    
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+    
+    /**
+     * @brief Latest snapshot of a source; null until its first document is parsed
+     */
+    SnapshotPtr snapshot(int sourceId) const;
+    
+    int sourceCount() const { return m_sources.size(); }
+    int requestsInFlight() const { return m_requestsInFlight; }
+    const Statistics& getStatistics() const { return m_statistics; }
+
+signals:
+    void pageUpdated(int sourceId, const XmlAcquisitionService::SnapshotPtr &snapshot);
+    void sourceError(int sourceId, const QString &error);
+
+private slots:
+    void onNetworkReply();
+    void schedule();
+
+private:
+    // State of one polled page; shared with its parse task while parsing
+    struct Source
+    {
+        int id = -1;
+        QString baseUrl;
+        QString fileName;
+        QUrl url;
+        int intervalMs = 0;
+        qint64 nextDueMs = 0;           // On m_clock
+        QNetworkReply *reply = nullptr; // Request in flight
+        bool parsing = false;           // Parse task queued or running
+        QByteArray etag;
+        QByteArray lastModified;
+        SnapshotPtr snapshot;           // Latest published snapshot
+        
+        // Only touched by the parse task while parsing is set
+        ControllerXmlParser parser;
+        quint64 sequence = 0;
+    };
+    
+    std::shared_ptr<Source> nextDueSource(qint64 now) const;
+    void startFetch(const std::shared_ptr<Source> &source);
+    void startParse(const std::shared_ptr<Source> &source, const QByteArray &xmlData, qint64 receivedMs);
+    void onParsed(const std::shared_ptr<Source> &source, const SnapshotPtr &snapshot, const QString &error);
+    static QString sourceKey(const QString &baseUrl, const QString &fileName);
+    
+    QNetworkAccessManager *m_networkManager;
+    QTimer *m_scheduleTimer;
+    QThreadPool m_parserPool;
+    QElapsedTimer m_clock;
+    QHash<int, std::shared_ptr<Source>> m_sources;  // Source ID -> source
+    QHash<QString, int> m_sourceIds;                // Base URL + file name -> source ID
+    int m_nextSourceId;
+    int m_visibleSource;
+    int m_maxConcurrentRequests;
+    int m_requestTimeout;
+    int m_requestsInFlight;
+    bool m_running;
+    QString m_layoutCacheDir;
+    Statistics m_statistics;
+};
+
+Q_DECLARE_METATYPE(XmlAcquisitionService::SnapshotPtr)
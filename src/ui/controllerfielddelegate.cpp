@@ -0,0 +1,270 @@
+#include "controllerfielddelegate.h"
+#include "thememanager.h"
+#include "virtualkeyboard.h"
+#include "../models/controllerpagemodel.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QAbstractItemView>
+#include <QSignalBlocker>
+#include <QTimer>
+
+ControllerFieldDelegate::ControllerFieldDelegate(VirtualKeyboard *keyboard, QObject *parent)
+    : QStyledItemDelegate(parent)
+    , m_keyboard(keyboard)
+{
+    m_subHeaderFont.setPixelSize(18);
+    m_subHeaderFont.setWeight(QFont::DemiBold);
+    m_groupFont.setPixelSize(16);
+    m_groupFont.setWeight(QFont::Bold);
+    m_labelFont.setPixelSize(14);
+    m_labelFont.setWeight(QFont::Medium);
+    m_valueFont = m_labelFont;
+    m_inputFont.setPixelSize(14);
+    m_inputFont.setWeight(QFont::DemiBold);
+    m_unitFont.setPixelSize(12);
+    m_unitFont.setItalic(true);
+    m_idFont.setPixelSize(11);
+    m_idFont.setItalic(true);
+}
+
+QSize ControllerFieldDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    Q_UNUSED(option)
+    switch (index.data(ControllerPageModel::RowKindRole).toInt()) {
+    case ControllerPageModel::SubHeaderRow:
+        return QSize(0, SUB_HEADER_HEIGHT);
+    case ControllerPageModel::GroupHeaderRow:
+        return QSize(0, GROUP_HEADER_HEIGHT
+                        + (index.data(ControllerPageModel::GroupGapRole).toBool() ? GROUP_GAP : 0));
+    default:
+        return QSize(2 * MARGIN + LABEL_WIDTH + VALUE_WIDTH + UNIT_WIDTH + 2 * SPACING,
+                     FIELD_ROW_HEIGHT);
+    }
+}
+
+void ControllerFieldDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                    const QModelIndex &index) const
+{
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    
+    switch (index.data(ControllerPageModel::RowKindRole).toInt()) {
+    case ControllerPageModel::SubHeaderRow:
+        paintSubHeader(painter, option.rect, index);
+        break;
+    case ControllerPageModel::GroupHeaderRow:
+        paintGroupHeader(painter, option.rect, index);
+        break;
+    default:
+        paintField(painter, option, index);
+        break;
+    }
+    
+    painter->restore();
+}
+
+void ControllerFieldDelegate::paintSubHeader(QPainter *painter, const QRect &rect, const QModelIndex &index) const
+{
+    ThemeManager *tm = ThemeManager::instance();
+    const QRect textRect = rect.adjusted(0, 12, 0, -8);
+    
+    painter->setFont(m_subHeaderFont);
+    painter->setPen(tm->color(ThemeManager::PrimaryText));
+    painter->drawText(textRect, Qt::AlignLeft | Qt::AlignVCenter, index.data(Qt::DisplayRole).toString());
+    
+    painter->setPen(QPen(tm->color(ThemeManager::SecondaryText), 1));
+    painter->drawLine(rect.left(), rect.bottom(), rect.right(), rect.bottom());
+}
+
+void ControllerFieldDelegate::paintGroupHeader(QPainter *painter, const QRect &rect, const QModelIndex &index) const
+{
+    ThemeManager *tm = ThemeManager::instance();
+    const int gap = index.data(ControllerPageModel::GroupGapRole).toBool() ? GROUP_GAP : 0;
+    const QRect headerRect = rect.adjusted(MARGIN, gap + 4, -MARGIN, -4);
+    
+    QPainterPath background;
+    background.addRoundedRect(headerRect, 6, 6);
+    painter->fillPath(background, tm->color(ThemeManager::SecondaryBackground));
+    
+    painter->setFont(m_groupFont);
+    painter->setPen(tm->color(ThemeManager::PrimaryText));
+    painter->drawText(headerRect.adjusted(8, 0, -8, 0), Qt::AlignLeft | Qt::AlignVCenter,
+                      QString::fromUtf8("📋 ") + index.data(Qt::DisplayRole).toString());
+}
+
+QRect ControllerFieldDelegate::valueRect(const QRect &rowRect) const
+{
+    return QRect(rowRect.left() + MARGIN + LABEL_WIDTH + SPACING, rowRect.top() + 6,
+                 VALUE_WIDTH, rowRect.height() - 12);
+}
+
+void ControllerFieldDelegate::paintField(QPainter *painter, const QStyleOptionViewItem &option,
+                                         const QModelIndex &index) const
+{
+    ThemeManager *tm = ThemeManager::instance();
+    const QRect rowRect = option.rect.adjusted(0, 2, 0, -2);
+    
+    QPainterPath background;
+    background.addRoundedRect(rowRect, 6, 6);
+    painter->fillPath(background, tm->color((option.state & QStyle::State_MouseOver)
+                                            ? ThemeManager::SecondaryBackground
+                                            : ThemeManager::MainBackground));
+    
+    // Label
+    const QString label = index.data(Qt::DisplayRole).toString();
+    const QRect labelRect(rowRect.left() + MARGIN + 8, rowRect.top(), LABEL_WIDTH - 16, rowRect.height());
+    painter->setFont(m_labelFont);
+    painter->setPen(tm->color(ThemeManager::SecondaryText));
+    painter->drawText(labelRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      QFontMetrics(m_labelFont).elidedText(label, Qt::ElideRight, labelRect.width()));
+    
+    // Value box
+    const QRect box = valueRect(option.rect);
+    const QString type = index.data(ControllerPageModel::FieldTypeRole).toString();
+    QPainterPath boxPath;
+    boxPath.addRoundedRect(QRectF(box).adjusted(0.5, 0.5, -0.5, -0.5), 4, 4);
+    
+    if (type == "btn") {
+        painter->fillPath(boxPath, tm->color(ThemeManager::ButtonBackground));
+        painter->setFont(m_inputFont);
+        painter->setPen(Qt::white);
+        painter->drawText(box, Qt::AlignCenter, tr("Execute"));
+    } else {
+        const bool input = index.data(ControllerPageModel::EditableRole).toBool();
+        painter->fillPath(boxPath, tm->color(input ? ThemeManager::MainBackground
+                                                   : ThemeManager::SecondaryBackground));
+        painter->setPen(input ? QPen(tm->color(ThemeManager::ButtonBackground), 2)
+                              : QPen(tm->color(ThemeManager::BorderColor), 1));
+        painter->drawPath(boxPath);
+        
+        QRect textRect = box.adjusted(8, 0, -8, 0);
+        if (type == "drp") {
+            // Drop-down arrow
+            const QPointF tip(box.right() - 12, box.center().y() + 3);
+            const QPointF arrow[3] = { tip + QPointF(-5, -6), tip + QPointF(5, -6), tip };
+            painter->setPen(Qt::NoPen);
+            painter->setBrush(tm->color(ThemeManager::SecondaryText));
+            painter->drawPolygon(arrow, 3);
+            textRect.setRight(textRect.right() - 16);
+        }
+        
+        const QFont &valueFont = input ? m_inputFont : m_valueFont;
+        painter->setFont(valueFont);
+        painter->setPen(tm->color(ThemeManager::PrimaryText));
+        painter->drawText(textRect, Qt::AlignLeft | Qt::AlignVCenter,
+                          QFontMetrics(valueFont).elidedText(
+                              index.data(ControllerPageModel::ValueTextRole).toString(),
+                              Qt::ElideRight, textRect.width()));
+    }
+    
+    // Unit and field ID
+    int x = box.right() + SPACING;
+    const QString unit = index.data(ControllerPageModel::UnitRole).toString();
+    if (!unit.isEmpty()) {
+        painter->setFont(m_unitFont);
+        painter->setPen(tm->color(ThemeManager::SecondaryText));
+        painter->drawText(QRect(x, rowRect.top(), UNIT_WIDTH, rowRect.height()),
+                          Qt::AlignLeft | Qt::AlignVCenter, unit);
+        x += UNIT_WIDTH;
+    }
+    
+    const QString id = index.data(ControllerPageModel::FieldIdRole).toString();
+    if (id != label && x < rowRect.right() - MARGIN) {
+        painter->setFont(m_idFont);
+        painter->setPen(Qt::gray);
+        painter->drawText(QRect(x, rowRect.top(), rowRect.right() - MARGIN - x, rowRect.height()),
+                          Qt::AlignLeft | Qt::AlignVCenter, "[" + id + "]");
+    }
+}
+
+QWidget* ControllerFieldDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &option,
+                                               const QModelIndex &index) const
+{
+    Q_UNUSED(option)
+    ThemeManager *tm = ThemeManager::instance();
+    QPalette palette = parent->palette();
+    palette.setColor(QPalette::Base, tm->color(ThemeManager::MainBackground));
+    palette.setColor(QPalette::Text, tm->color(ThemeManager::PrimaryText));
+    palette.setColor(QPalette::Button, tm->color(ThemeManager::SecondaryBackground));
+    palette.setColor(QPalette::ButtonText, tm->color(ThemeManager::PrimaryText));
+    
+    if (index.data(ControllerPageModel::FieldTypeRole).toString() == "drp") {
+        QComboBox *combo = new QComboBox(parent);
+        combo->setPalette(palette);
+        combo->setFont(m_valueFont);
+        combo->addItems(index.data(ControllerPageModel::OptionsRole).toStringList());
+        connect(combo, QOverload<int>::of(&QComboBox::activated),
+                this, &ControllerFieldDelegate::commitAndCloseEditor);
+        // One tap opens the list, as it did with a combo box per field
+        QTimer::singleShot(0, combo, &QComboBox::showPopup);
+        return combo;
+    }
+    
+    if (!index.data(ControllerPageModel::EditableRole).toBool()) {
+        return nullptr;
+    }
+    
+    QLineEdit *lineEdit = new QLineEdit(parent);
+    lineEdit->setPalette(palette);
+    lineEdit->setFont(m_inputFont);
+    lineEdit->setPlaceholderText(tr("Enter value..."));
+    if (m_keyboard) {
+        m_keyboard->installInputEventFilter(lineEdit);
+    }
+    return lineEdit;
+}
+
+void ControllerFieldDelegate::setEditorData(QWidget *editor, const QModelIndex &index) const
+{
+    if (QLineEdit *lineEdit = qobject_cast<QLineEdit*>(editor)) {
+        // Never overwrite what the operator is typing
+        if (lineEdit->hasFocus()) {
+            return;
+        }
+        lineEdit->setText(index.data(ControllerPageModel::ValueTextRole).toString());
+    } else if (QComboBox *combo = qobject_cast<QComboBox*>(editor)) {
+        if (combo->view()->isVisible()) {
+            return; // Popup open
+        }
+        const int option = ControllerPageModel::optionIndex(
+            index.data(ControllerPageModel::OptionValuesRole).toStringList(),
+            combo->count(), index.data(ControllerPageModel::ValueRole));
+        if (option >= 0) {
+            const QSignalBlocker blocker(combo);
+            combo->setCurrentIndex(option);
+        }
+    }
+}
+
+void ControllerFieldDelegate::setModelData(QWidget *editor, QAbstractItemModel *model,
+                                           const QModelIndex &index) const
+{
+    if (QLineEdit *lineEdit = qobject_cast<QLineEdit*>(editor)) {
+        model->setData(index, lineEdit->text(), Qt::EditRole);
+    } else if (QComboBox *combo = qobject_cast<QComboBox*>(editor)) {
+        const int option = combo->currentIndex();
+        if (option < 0) {
+            return;
+        }
+        // Store what a refresh would report for this option
+        const QStringList optionValues = index.data(ControllerPageModel::OptionValuesRole).toStringList();
+        model->setData(index, optionValues.isEmpty() ? QVariant(option) : QVariant(optionValues.value(option)),
+                       Qt::EditRole);
+    }
+}
+
+void ControllerFieldDelegate::updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option,
+                                                   const QModelIndex &index) const
+{
+    Q_UNUSED(index)
+    editor->setGeometry(valueRect(option.rect));
+}
+
+void ControllerFieldDelegate::commitAndCloseEditor()
+{
+    QWidget *editor = qobject_cast<QWidget*>(sender());
+    emit commitData(editor);
+    emit closeEditor(editor);
+}
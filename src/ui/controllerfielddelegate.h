@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QStyledItemDelegate>
+#include <QFont>
+
+class VirtualKeyboard;
+
+/**
+ * @brief Paints the rows of a ControllerPageModel and edits its fields
+ * 
+ * Draws headers and field rows (label, value box, unit, field ID)
+ * directly with QPainter in the theme colors, so a controller page needs
+ * no widgets per field. An editor is created only for the row the
+ * operator taps: a line edit (with the virtual keyboard) for input
+ * fields, a combo box for dropdowns.
+ * 
+ * Refreshed values never overwrite an editor the operator is typing in
+ * or whose popup is open.
+ * 
+ * Pattern: Delegate (Qt model/view)
+ * Location: src/ui/
+ */
+class ControllerFieldDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit ControllerFieldDelegate(VirtualKeyboard *keyboard, QObject *parent = nullptr);
+    
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    
+    QWidget* createEditor(QWidget *parent, const QStyleOptionViewItem &option,
+                          const QModelIndex &index) const override;
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override;
+    void setModelData(QWidget *editor, QAbstractItemModel *model,
+                      const QModelIndex &index) const override;
+    void updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option,
+                              const QModelIndex &index) const override;
+
+private slots:
+    void commitAndCloseEditor();
+
+private:
+    // Row geometry, matching the former widget layout
+    static constexpr int FIELD_ROW_HEIGHT = 44;
+    static constexpr int GROUP_HEADER_HEIGHT = 42;
+    static constexpr int GROUP_GAP = 12;
+    static constexpr int SUB_HEADER_HEIGHT = 48;
+    static constexpr int MARGIN = 8;
+    static constexpr int SPACING = 12;
+    static constexpr int LABEL_WIDTH = 200;
+    static constexpr int VALUE_WIDTH = 200;
+    static constexpr int UNIT_WIDTH = 80;
+    
+    QRect valueRect(const QRect &rowRect) const;
+    
+    void paintSubHeader(QPainter *painter, const QRect &rect, const QModelIndex &index) const;
+    void paintGroupHeader(QPainter *painter, const QRect &rect, const QModelIndex &index) const;
+    void paintField(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+    
+    VirtualKeyboard *m_keyboard;
+    QFont m_subHeaderFont;
+    QFont m_groupFont;
+    QFont m_labelFont;
+    QFont m_valueFont;
+    QFont m_inputFont;
+    QFont m_unitFont;
+    QFont m_idFont;
+};
@@ -1,6 +1,7 @@
 #include "modernmainwindow.h"
 #include "controllercardwidget.h"
 #include "thememanager.h"
+#include "themestyle.h"
 #include "applestyle.h"
 #include "../pages/overviewpage.h"
 #include "../pages/dashboardpage.h"
@@ -48,10 +49,6 @@ ModernMainWindow::ModernMainWindow(QWidget *parent)
     setupNavigation();
     setupStyling();
 
-    // Connect to theme system
-    connect(ThemeManager::instance(), &ThemeManager::themeChanged,
-            this, &ModernMainWindow::onThemeChanged);
-
     // Initialize UDP service for controller discovery
     m_udpService = new UdpService(this);
     connect(m_udpService, &UdpService::moduleDiscovered,
@@ -140,20 +137,8 @@ void ModernMainWindow::createHeaderBar()
     m_hamburgerButton->setMinimumSize(60, 60); // Touch-friendly size
     m_hamburgerButton->setMaximumSize(60, 60);
     m_hamburgerButton->setToolTip("Open Navigation Menu");
-    m_hamburgerButton->setStyleSheet(
-        "QPushButton {"
-        "    background: transparent;"
-        "    border: none;"
-        "    font-size: 24px;"
-        "    font-weight: bold;"
-        "}"
-        "QPushButton:hover {"
-        "    background: rgba(255, 255, 255, 0.1);"
-        "}"
-        "QPushButton:pressed {"
-        "    background: rgba(255, 255, 255, 0.2);"
-        "}"
-    );
+    m_hamburgerButton->setFont(boldFont(24));
+    ThemeStyle::setVariant(m_hamburgerButton, ThemeStyle::FlatButton);
     connect(m_hamburgerButton, &QPushButton::clicked, this, [this]() {
         if (m_hamburgerMenu) {
             m_hamburgerMenu->toggleMenu();
@@ -166,23 +151,8 @@ void ModernMainWindow::createHeaderBar()
     m_backButton->setMinimumSize(50, 60); // Slightly smaller than hamburger
     m_backButton->setMaximumSize(50, 60);
     m_backButton->setToolTip("Go Back");
-    m_backButton->setStyleSheet(
-        "QPushButton {"
-        "    background: transparent;"
-        "    border: none;"
-        "    font-size: 20px;"
-        "    font-weight: bold;"
-        "}"
-        "QPushButton:hover {"
-        "    background: rgba(255, 255, 255, 0.1);"
-        "}"
-        "QPushButton:pressed {"
-        "    background: rgba(255, 255, 255, 0.2);"
-        "}"
-        "QPushButton:disabled {"
-        "    color: rgba(255, 255, 255, 0.3);"
-        "}"
-    );
+    m_backButton->setFont(boldFont(20));
+    ThemeStyle::setVariant(m_backButton, ThemeStyle::FlatButton);
     connect(m_backButton, &QPushButton::clicked, this, [this]() {
         qDebug() << "Header back button clicked!";
         if (m_navigationManager) {
@@ -196,20 +166,8 @@ void ModernMainWindow::createHeaderBar()
     m_homeButton->setMinimumSize(50, 60); // Slightly smaller than hamburger
     m_homeButton->setMaximumSize(50, 60);
     m_homeButton->setToolTip("Go Home");
-    m_homeButton->setStyleSheet(
-        "QPushButton {"
-        "    background: transparent;"
-        "    border: none;"
-        "    font-size: 16px;"
-        "    font-weight: bold;"
-        "}"
-        "QPushButton:hover {"
-        "    background: rgba(255, 255, 255, 0.1);"
-        "}"
-        "QPushButton:pressed {"
-        "    background: rgba(255, 255, 255, 0.2);"
-        "}"
-    );
+    m_homeButton->setFont(boldFont(16));
+    ThemeStyle::setVariant(m_homeButton, ThemeStyle::FlatButton);
     connect(m_homeButton, &QPushButton::clicked, this, [this]() {
         qDebug() << "Header home button clicked!";
         if (m_navigationManager) {
@@ -238,6 +196,8 @@ void ModernMainWindow::createHeaderBar()
     themeToggleBtn->setObjectName("themeToggleBtn");
     themeToggleBtn->setMinimumSize(60, 60); // Touch-friendly size
     themeToggleBtn->setMaximumSize(60, 60);
+    themeToggleBtn->setFont(boldFont(20));
+    ThemeStyle::setVariant(themeToggleBtn, ThemeStyle::PrimaryButton);
     themeToggleBtn->setToolTip("Tap to switch theme (Dark/Light/High Contrast/Apple Light/Apple Dark)");
     connect(themeToggleBtn, &QPushButton::clicked, this, &ModernMainWindow::toggleTheme);
 
@@ -263,6 +223,7 @@ void ModernMainWindow::createSystemStatusStrip()
     m_statusStrip = new QWidget();
     m_statusStrip->setFixedHeight(56); // Increased from 40px for touch
     m_statusStrip->setObjectName("statusStrip");
+    ThemeStyle::setVariant(m_statusStrip, ThemeStyle::StatusStrip);
 
     QHBoxLayout *statusLayout = new QHBoxLayout(m_statusStrip);
     statusLayout->setContentsMargins(24, 12, 24, 12); // Increased margins
@@ -270,15 +231,19 @@ void ModernMainWindow::createSystemStatusStrip()
 
     m_discoveryStatus = new QLabel("📡 Discovery: Active");
     m_discoveryStatus->setObjectName("statusLabel");
+    ThemeStyle::setVariant(m_discoveryStatus, ThemeStyle::StatusLabel);
 
     m_modbusStatus = new QLabel("🔗 Modbus: Ready");
     m_modbusStatus->setObjectName("statusLabel");
+    ThemeStyle::setVariant(m_modbusStatus, ThemeStyle::StatusLabel);
 
     m_eventsStatus = new QLabel("⚡ Events: 0 New");
     m_eventsStatus->setObjectName("statusLabel");
+    ThemeStyle::setVariant(m_eventsStatus, ThemeStyle::StatusLabel);
 
     m_dataStatus = new QLabel("📊 Data: Live");
     m_dataStatus->setObjectName("statusLabel");
+    ThemeStyle::setVariant(m_dataStatus, ThemeStyle::StatusLabel);
 
     statusLayout->addWidget(m_discoveryStatus);
     statusLayout->addWidget(m_modbusStatus);
@@ -319,9 +284,11 @@ void ModernMainWindow::createControllerGrid()
 
     QLabel *titleLabel = new QLabel("🎛️ ACTIVE CONTROLLERS");
     titleLabel->setObjectName("sectionTitle");
+    ThemeStyle::setVariant(titleLabel, ThemeStyle::SectionTitle);
 
     QPushButton *refreshButton = new QPushButton("🔄 Refresh");
     refreshButton->setObjectName("actionButton");
+    ThemeStyle::setVariant(refreshButton, ThemeStyle::PrimaryButton);
     refreshButton->setMinimumSize(120, 60); // Touch-optimized size
     connect(refreshButton, &QPushButton::clicked, this, &ModernMainWindow::refreshControllers);
 
@@ -335,6 +302,7 @@ void ModernMainWindow::createControllerGrid()
     m_controllerScrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     m_controllerScrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
     m_controllerScrollArea->setObjectName("controllerScrollArea");
+    m_controllerScrollArea->setFrameShape(QFrame::NoFrame);
 
     // Grid widget to hold controller cards
     m_controllerGridWidget = new QWidget();
@@ -346,6 +314,8 @@ void ModernMainWindow::createControllerGrid()
     QPushButton *addControllerCard = new QPushButton("➕ ADD\nCONTROLLER\n\nAuto-Discover\nor Manual");
     addControllerCard->setFixedSize(320, 220); // Larger touch target
     addControllerCard->setObjectName("addControllerCard");
+    addControllerCard->setFont(boldFont(18));
+    ThemeStyle::setVariant(addControllerCard, ThemeStyle::ActionButton);
     connect(addControllerCard, &QPushButton::clicked, this, &ModernMainWindow::refreshControllers);
 
     m_controllerGridLayout->addWidget(addControllerCard, 0, 0);
@@ -360,12 +330,14 @@ void ModernMainWindow::createControllerGrid()
     m_controllerScrollArea->setWidget(controllerSection);
     m_controllerScrollArea->setWidgetResizable(true);
     m_controllerScrollArea->setObjectName("controllerScrollArea");
+    m_controllerScrollArea->setFrameShape(QFrame::NoFrame);
 }
 
 void ModernMainWindow::createQuickActionsPanel()
 {
-    m_quickActionsPanel = new QWidget();
+    m_quickActionsPanel = new QFrame();
     m_quickActionsPanel->setObjectName("quickActionsPanel");
+    ThemeStyle::setVariant(m_quickActionsPanel, ThemeStyle::Panel);
 
     QVBoxLayout *panelLayout = new QVBoxLayout(m_quickActionsPanel);
     panelLayout->setContentsMargins(24, 0, 0, 0); // Increased margins
@@ -409,6 +381,7 @@ void ModernMainWindow::createQuickActionsPanel()
     for (QPushButton *btn : actionButtons)
     {
         btn->setObjectName("quickActionButton");
+        ThemeStyle::setVariant(btn, ThemeStyle::ActionButton);
         btn->setFixedHeight(60);   // Touch-optimized height (was 35px)
         btn->setMinimumWidth(200); // Ensure good touch width
         actionsLayout->addWidget(btn);
@@ -432,9 +405,10 @@ void ModernMainWindow::createQuickActionsPanel()
 
 void ModernMainWindow::createStatusBar()
 {
-    m_bottomStatusBar = new QWidget();
+    m_bottomStatusBar = new QFrame();
     m_bottomStatusBar->setFixedHeight(48); // Increased from 32px for touch
     m_bottomStatusBar->setObjectName("bottomStatusBar");
+    ThemeStyle::setVariant(m_bottomStatusBar, ThemeStyle::Panel);
 
     QHBoxLayout *statusLayout = new QHBoxLayout(m_bottomStatusBar);
     statusLayout->setContentsMargins(24, 8, 24, 8); // Increased margins
@@ -449,6 +423,7 @@ void ModernMainWindow::createStatusBar()
     for (QLabel *label : statusLabels)
     {
         label->setObjectName("statusBarLabel");
+        ThemeStyle::setVariant(label, ThemeStyle::StatusLabel);
         statusLayout->addWidget(label);
     }
 
@@ -457,8 +432,18 @@ void ModernMainWindow::createStatusBar()
 
 void ModernMainWindow::setupStyling()
 {
-    // Apply initial theme styling
-    onThemeChanged();
+    // Widgets are drawn by ThemeStyle from the theme palette, so a theme
+    // switch needs no stylesheets here: ThemeManager swaps the palette
+    // and every widget repaints once
+    ThemeManager::instance()->applyToApplication();
+}
+
+QFont ModernMainWindow::boldFont(int pixelSize)
+{
+    QFont font = ThemeManager::instance()->font(ThemeManager::ButtonFont);
+    font.setPixelSize(pixelSize);
+    font.setWeight(QFont::Bold);
+    return font;
 }
 
 void ModernMainWindow::toggleTheme()
@@ -481,191 +466,6 @@ void ModernMainWindow::toggleTheme()
     }
 }
 
-void ModernMainWindow::onThemeChanged()
-{
-    ThemeManager *tm = ThemeManager::instance();
-
-    // Get current theme colors for clean, borderless design
-    QString mainBg = tm->colorString(ThemeManager::MainBackground);
-    QString secondaryBg = tm->colorString(ThemeManager::SecondaryBackground);
-    QString headerBg = tm->colorString(ThemeManager::HeaderBackground);
-    QString cardBg = tm->colorString(ThemeManager::CardBackground);
-    QString statusBg = tm->colorString(ThemeManager::StatusStripBackground);
-
-    QString primaryText = tm->colorString(ThemeManager::PrimaryText);
-    QString secondaryText = tm->colorString(ThemeManager::SecondaryText);
-    QString accentText = tm->colorString(ThemeManager::AccentText);
-    QString statusText = tm->colorString(ThemeManager::StatusText);
-
-    QString buttonBg = tm->colorString(ThemeManager::ButtonBackground);
-    QString buttonHover = tm->colorString(ThemeManager::ButtonHover);
-    QString buttonPressed = tm->colorString(ThemeManager::ButtonPressed);
-
-    // Clean, borderless base styles
-    QString baseStyles = QString(
-                             "QMainWindow { "
-                             "  background-color: %1; "
-                             "  color: %2; "
-                             "} "
-                             "QWidget { "
-                             "  background-color: %1; "
-                             "  color: %2; "
-                             "  border: none; "
-                             "} "
-                             "QWidget#headerBar { "
-                             "  background-color: %1; "
-                             "  border: none; "
-                             "} "
-                             "QWidget#statusStrip { "
-                             "  background-color: %4; "
-                             "  border: none; "
-                             "} "
-                             "QWidget#mainContent { "
-                             "  background-color: %1; "
-                             "  border: none; "
-                             "} "
-                             "QScrollArea { "
-                             "  background-color: %1; "
-                             "  border: none; "
-                             "} "
-                             "QScrollBar:vertical { "
-                             "  background-color: %3; "
-                             "  border: none; "
-                             "  width: 12px; "
-                             "} "
-                             "QScrollBar::handle:vertical { "
-                             "  background-color: %4; "
-                             "  border: none; "
-                             "  border-radius: 6px; "
-                             "} ")
-                             .arg(mainBg)         // %1
-                             .arg(primaryText)    // %2
-                             .arg(statusBg)       // %3 (was headerBg, now statusBg since headerBg uses %1)
-                             .arg(secondaryText); // %4 (was %5, now %4)
-
-    // Clean theme-aware component styles (no borders)
-    QString customStyles = QString(
-                               "QPushButton#themeToggleBtn { "
-                               "  background-color: %1; "
-                               "  color: %2; "
-                               "  border: none; "
-                               "  border-radius: 8px; "
-                               "  font-size: 20px; "
-                               "  font-weight: bold; "
-                               "  padding: 8px 16px; "
-                               "}"
-                               "QPushButton#themeToggleBtn:hover { "
-                               "  background-color: %3; "
-                               "}"
-                               "QPushButton#themeToggleBtn:pressed { "
-                               "  background-color: %4; "
-                               "}"
-                               "QPushButton#addControllerCard { "
-                               "  background-color: %5; "
-                               "  color: %6; "
-                               "  border: none; "
-                               "  border-radius: 12px; "
-                               "  font-size: 18px; "
-                               "  font-weight: bold; "
-                               "  padding: 16px; "
-                               "}"
-                               "QPushButton#addControllerCard:hover { "
-                               "  background-color: %3; "
-                               "}"
-                               "QPushButton#addControllerCard:pressed { "
-                               "  background-color: %4; "
-                               "}"
-                               "QWidget#quickActionsPanel { "
-                               "  background-color: %6; "
-                               "  border: none; "
-                               "  border-radius: 12px; "
-                               "  padding: 16px; "
-                               "} "
-                               "QGroupBox { "
-                               "  font-size: 18px; "
-                               "  font-weight: bold; "
-                               "  color: %2; "
-                               "  border: none; "
-                               "  border-radius: 12px; "
-                               "  padding-top: 16px; "
-                               "} "
-                               "QLabel#sectionTitle { "
-                               "  font-size: 22px; "
-                               "  font-weight: 700; "
-                               "  color: %2; "
-                               "} "
-                               "QLabel#alertLabel { "
-                               "  font-size: 17px; "
-                               "  font-weight: 400; "
-                               "  color: %7; "
-                               "  padding: 8px; "
-                               "} "
-                               "QPushButton#quickActionButton { "
-                               "  background-color: %5; "
-                               "  color: %2; "
-                               "  border: none; "
-                               "  border-radius: 8px; "
-                               "  font-size: 16px; "
-                               "  padding: 12px 16px; "
-                               "}"
-                               "QPushButton#quickActionButton:hover { "
-                               "  background-color: %3; "
-                               "}"
-                               "QPushButton#quickActionButton:pressed { "
-                               "  background-color: %4; "
-                               "}"
-                               "QPushButton#actionButton { "
-                               "  background-color: %8; "
-                               "  color: %9; "
-                               "  border: none; "
-                               "  border-radius: 8px; "
-                               "  font-size: 16px; "
-                               "  font-weight: 600; "
-                               "  padding: 12px 24px; "
-                               "}"
-                               "QPushButton#actionButton:hover { "
-                               "  background-color: %10; "
-                               "}"
-                               "QPushButton#actionButton:pressed { "
-                               "  background-color: %11; "
-                               "}"
-                               "QWidget#bottomStatusBar { "
-                               "  background-color: %6; "
-                               "  border: none; "
-                               "  border-radius: 8px; "
-                               "} "
-                               "QLabel#statusBarLabel { "
-                               "  font-size: 15px; "
-                               "  color: %7; "
-                               "  font-weight: 400; "
-                               "}")
-                               .arg(buttonBg)                               // %1 - theme toggle background
-                               .arg(primaryText)                            // %2 - primary text
-                               .arg(buttonHover)                            // %3 - hover state
-                               .arg(buttonPressed)                          // %4 - pressed state
-                               .arg(cardBg)                                 // %5 - card background
-                               .arg(secondaryBg)                            // %6 - secondary background
-                               .arg(secondaryText)                          // %7 - secondary text
-                               .arg(tm->colorString(ThemeManager::Primary)) // %8 - primary button bg
-                               .arg(primaryText)                            // %9 - primary button text
-                               .arg(buttonHover)                            // %10 - primary button hover
-                               .arg(buttonPressed);                         // %11 - primary button pressed
-
-    // Apply the complete stylesheet
-    setStyleSheet(baseStyles + customStyles);
-
-    // Update any existing controller cards
-    for (ControllerCardWidget *card : m_controllerCards)
-    {
-        // Update controller card styling
-        card->style()->unpolish(card);
-        card->style()->polish(card);
-    }
-
-    // Debug output
-    qDebug() << "Clean borderless theme applied:" << tm->themeName();
-}
-
 void ModernMainWindow::navigateToPage(int index)
 {
     qDebug() << "Legacy navigation to page" << index << "requested";
@@ -61,7 +61,6 @@ private slots:
     void showControllerDetails(const QString &ip);
     void refreshControllers();
     void toggleTheme();
-    void onThemeChanged();
     void onBreadcrumbClicked(int index);
     void onNavigationStateChanged();
 
@@ -73,6 +72,7 @@ private:
     void setupUI();
     void setupNavigation();
     void setupStyling();
+    static QFont boldFont(int pixelSize);
     void createHeaderBar();
     void createBreadcrumbNavigation();
     void createSystemStatusStrip();
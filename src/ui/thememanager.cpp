@@ -1,6 +1,8 @@
 #include "thememanager.h"
+#include "themestyle.h"
 #include <QApplication>
 #include <QDebug>
+#include <QTimer>
 
 ThemeManager *ThemeManager::s_instance = nullptr;
 
@@ -14,9 +16,11 @@ ThemeManager *ThemeManager::instance()
 }
 
 ThemeManager::ThemeManager(QObject *parent)
-    : QObject(parent), m_currentTheme(Light), m_settings(new QSettings("QuantumTactical", "SciFiHMI", this))
+    : QObject(parent), m_currentTheme(Light), m_current(nullptr), m_appliedToApplication(false),
+      m_settings(new QSettings("QuantumTactical", "SciFiHMI", this))
 {
     initializeThemes();
+    initializeFonts();
     loadTheme(); // Load saved theme preference
 }
 
@@ -89,6 +93,9 @@ void ThemeManager::initializeThemes()
 
     m_themes[Dark] = darkTheme;
 
+    m_resources[Light] = buildResources(lightTheme);
+    m_resources[Dark] = buildResources(darkTheme);
+
     // Load initial theme
     loadThemeColors(m_currentTheme);
 }
@@ -99,6 +106,12 @@ void ThemeManager::setTheme(Theme theme)
     {
         m_currentTheme = theme;
         loadThemeColors(theme);
+        if (m_appliedToApplication)
+        {
+            // ThemeStyle reads its colors from the palette and the cached
+            // pens and brushes, so this repaints every widget once
+            QApplication::setPalette(m_current->palette);
+        }
         saveTheme();
         emit themeChanged(theme);
         qDebug() << "Theme changed to:" << themeName();
@@ -120,7 +133,11 @@ QString ThemeManager::themeName() const
 
 QColor ThemeManager::color(ColorRole role) const
 {
-    return m_currentColors.value(role, QColor("#FF00FF")); // Magenta as error indicator
+    if (role < 0 || role >= ColorRoleCount)
+    {
+        return QColor(255, 0, 255); // Magenta as error indicator
+    }
+    return m_current->colors[role];
 }
 
 QString ThemeManager::colorString(ColorRole role) const
@@ -128,17 +145,106 @@ QString ThemeManager::colorString(ColorRole role) const
     return color(role).name();
 }
 
+const QPen &ThemeManager::pen(ColorRole role) const
+{
+    return m_current->pens[qBound(0, int(role), ColorRoleCount - 1)];
+}
+
+const QBrush &ThemeManager::brush(ColorRole role) const
+{
+    return m_current->brushes[qBound(0, int(role), ColorRoleCount - 1)];
+}
+
+const QFont &ThemeManager::font(FontRole role) const
+{
+    return m_fonts[qBound(0, int(role), FontRoleCount - 1)];
+}
+
+void ThemeManager::applyToApplication()
+{
+    if (!m_appliedToApplication)
+    {
+        QApplication::setStyle(new ThemeStyle);
+        m_appliedToApplication = true;
+    }
+    QApplication::setPalette(m_current->palette);
+}
+
 void ThemeManager::loadThemeColors(Theme theme)
 {
     if (m_themes.contains(theme))
     {
-        m_currentColors = m_themes[theme];
+        m_current = &m_resources[theme];
     }
     else
     {
         qWarning() << "Theme not found:" << theme;
-        m_currentColors = m_themes[Dark]; // Fallback to dark theme
+        m_current = &m_resources[Dark]; // Fallback to dark theme
+    }
+}
+
+ThemeManager::ThemeResources ThemeManager::buildResources(const QMap<ColorRole, QColor> &colors)
+{
+    ThemeResources resources;
+    for (int role = 0; role < ColorRoleCount; ++role)
+    {
+        const QColor color = colors.value(static_cast<ColorRole>(role), QColor(255, 0, 255));
+        resources.colors[role] = color;
+        resources.pens[role] = QPen(color, 1);
+        resources.brushes[role] = QBrush(color);
     }
+
+    // Widgets without their own painting follow the theme through the
+    // palette; labels pick AccentText (Link) or StatusText
+    // (PlaceholderText) with their foreground role
+    const auto &c = resources.colors;
+    QPalette &palette = resources.palette;
+    palette.setColor(QPalette::Window, c[MainBackground]);
+    palette.setColor(QPalette::WindowText, c[PrimaryText]);
+    palette.setColor(QPalette::Base, c[MainBackground]);
+    palette.setColor(QPalette::AlternateBase, c[SecondaryBackground]);
+    palette.setColor(QPalette::Text, c[PrimaryText]);
+    palette.setColor(QPalette::PlaceholderText, c[StatusText]);
+    palette.setColor(QPalette::Button, c[CardBackground]);
+    palette.setColor(QPalette::ButtonText, c[PrimaryText]);
+    palette.setColor(QPalette::BrightText, c[Error]);
+    palette.setColor(QPalette::Highlight, c[Primary]);
+    palette.setColor(QPalette::HighlightedText, Qt::white);
+    palette.setColor(QPalette::Link, c[AccentText]);
+    palette.setColor(QPalette::LinkVisited, c[AccentText]);
+    palette.setColor(QPalette::ToolTipBase, c[SecondaryBackground]);
+    palette.setColor(QPalette::ToolTipText, c[PrimaryText]);
+    palette.setColor(QPalette::Light, c[ButtonHover]);
+    palette.setColor(QPalette::Midlight, c[ButtonHover]);
+    palette.setColor(QPalette::Mid, c[BorderColor]);
+    palette.setColor(QPalette::Dark, c[ButtonPressed]);
+    palette.setColor(QPalette::Shadow, c[BorderColor]);
+    for (QPalette::ColorRole role : {QPalette::WindowText, QPalette::Text, QPalette::ButtonText})
+    {
+        palette.setColor(QPalette::Disabled, role, c[StatusText]);
+    }
+    return resources;
+}
+
+void ThemeManager::initializeFonts()
+{
+    // Touch-sized type, shared by both themes
+    auto makeFont = [](int pixelSize, QFont::Weight weight) {
+        QFont font;
+        font.setPixelSize(pixelSize);
+        font.setWeight(weight);
+        return font;
+    };
+    m_fonts[PageTitleFont] = makeFont(24, QFont::Bold);
+    m_fonts[TitleFont] = makeFont(22, QFont::Bold);
+    m_fonts[ButtonFont] = makeFont(16, QFont::DemiBold);
+    m_fonts[BodyFont] = makeFont(16, QFont::Normal);
+    m_fonts[StatusFont] = makeFont(15, QFont::Medium);
+
+    QFont mono("Courier New");
+    mono.setStyleHint(QFont::Monospace);
+    mono.setPixelSize(12);
+    m_fonts[MonoFont] = mono;
 }
 
 QString ThemeManager::generateStyleSheet() const
@@ -253,8 +359,10 @@ QString ThemeManager::generateHeaderStyle() const
 
 void ThemeManager::saveTheme()
 {
+    // Synced once control returns to the event loop, keeping disk I/O
+    // out of the toggle's repaint
     m_settings->setValue("theme", static_cast<int>(m_currentTheme));
-    m_settings->sync();
+    QTimer::singleShot(0, m_settings, [this]() { m_settings->sync(); });
 }
 
 void ThemeManager::loadTheme()
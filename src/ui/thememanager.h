@@ -5,12 +5,24 @@
 #include <QMap>
 #include <QString>
 #include <QSettings>
+#include <QPalette>
+#include <QPen>
+#include <QBrush>
+#include <QFont>
+#include <array>
 
 /**
  * @brief Theme management system for industrial HMI
  *
  * Provides centralized theme switching between dark/light modes
  * with industrial-grade color palettes optimized for touch interfaces.
+ *
+ * Colors, pens, brushes and a QPalette are built once per theme, so
+ * painting code and ThemeStyle fetch them by role without lookups or
+ * allocations. Once applyToApplication() has installed ThemeStyle,
+ * switching themes swaps the application palette and Qt repaints every
+ * widget once; widgets styled through ThemeStyle variants need no
+ * stylesheet and are not re-polished.
  */
 class ThemeManager : public QObject
 {
@@ -58,10 +70,25 @@ public:
         ControllerFault,
         DataGood,
         DataStale,
-        DataError
+        DataError,
+
+        ColorRoleCount
     };
     Q_ENUM(ColorRole)
 
+    enum FontRole
+    {
+        PageTitleFont, // Page headings
+        TitleFont,     // Section and panel titles
+        ButtonFont,
+        BodyFont,
+        StatusFont, // Status strip and status bar
+        MonoFont,   // Raw protocol data
+
+        FontRoleCount
+    };
+    Q_ENUM(FontRole)
+
     static ThemeManager *instance();
 
     // Theme management
@@ -73,6 +100,15 @@ public:
     QColor color(ColorRole role) const;
     QString colorString(ColorRole role) const;
 
+    // Cached drawing resources of the current theme
+    const QPen &pen(ColorRole role) const;
+    const QBrush &brush(ColorRole role) const;
+    const QFont &font(FontRole role) const;
+    const QPalette &palette() const { return m_current->palette; }
+
+    // Install ThemeStyle and the theme palette application-wide
+    void applyToApplication();
+
     // Style generation
     QString generateStyleSheet() const;
     QString generateButtonStyle(const QString &objectName = "") const;
@@ -87,13 +123,26 @@ signals:
     void themeChanged(Theme newTheme);
 
 private:
+    struct ThemeResources
+    {
+        std::array<QColor, ColorRoleCount> colors;
+        std::array<QPen, ColorRoleCount> pens;
+        std::array<QBrush, ColorRoleCount> brushes;
+        QPalette palette;
+    };
+
     explicit ThemeManager(QObject *parent = nullptr);
     void initializeThemes();
+    void initializeFonts();
     void loadThemeColors(Theme theme);
+    static ThemeResources buildResources(const QMap<ColorRole, QColor> &colors);
 
     Theme m_currentTheme;
-    QMap<ColorRole, QColor> m_currentColors;
     QMap<Theme, QMap<ColorRole, QColor>> m_themes;
+    std::array<ThemeResources, 2> m_resources; // Indexed by Theme
+    const ThemeResources *m_current;
+    std::array<QFont, FontRoleCount> m_fonts;
+    bool m_appliedToApplication;
     QSettings *m_settings;
 
     static ThemeManager *s_instance;
@@ -0,0 +1,240 @@
+#include "themestyle.h"
+#include "thememanager.h"
+#include "applestyle.h"
+#include <QStyleFactory>
+#include <QStyleOption>
+#include <QPainter>
+#include <QPushButton>
+#include <QFrame>
+
+namespace {
+const char *const VARIANT_PROPERTY = "themeVariant";
+}
+
+ThemeStyle::ThemeStyle()
+    : QProxyStyle(QStyleFactory::create("Fusion")) // Fusion honours the palette on every platform
+{
+}
+
+void ThemeStyle::setVariant(QWidget *widget, Variant variant)
+{
+    widget->setProperty(VARIANT_PROPERTY, int(variant));
+    if (widget->testAttribute(Qt::WA_WState_Polished)) {
+        widget->style()->unpolish(widget);
+        widget->style()->polish(widget);
+        widget->update();
+    }
+}
+
+ThemeStyle::Variant ThemeStyle::variant(const QWidget *widget)
+{
+    return widget ? static_cast<Variant>(widget->property(VARIANT_PROPERTY).toInt()) : NoVariant;
+}
+
+void ThemeStyle::polish(QWidget *widget)
+{
+    QProxyStyle::polish(widget);
+    
+    const Variant widgetVariant = variant(widget);
+    if (widgetVariant == NoVariant) {
+        return;
+    }
+    
+    ThemeManager *tm = ThemeManager::instance();
+    auto applyFont = [widget, tm](ThemeManager::FontRole role) {
+        if (!widget->testAttribute(Qt::WA_SetFont)) {
+            widget->setFont(tm->font(role));
+        }
+    };
+    
+    switch (widgetVariant) {
+    case PrimaryButton:
+    case ActionButton:
+        applyFont(ThemeManager::ButtonFont);
+        widget->setAttribute(Qt::WA_Hover);
+        break;
+    case FlatButton:
+        widget->setAttribute(Qt::WA_Hover);
+        break;
+    case PageTitle:
+        applyFont(ThemeManager::PageTitleFont);
+        break;
+    case Title:
+        applyFont(ThemeManager::TitleFont);
+        widget->setForegroundRole(QPalette::Link);
+        break;
+    case SectionTitle:
+        applyFont(ThemeManager::TitleFont);
+        break;
+    case StatusLabel:
+        applyFont(ThemeManager::StatusFont);
+        widget->setForegroundRole(QPalette::PlaceholderText);
+        break;
+    case StatusStrip:
+        widget->setAttribute(Qt::WA_StyledBackground); // Paints PE_Widget
+        break;
+    case Panel:
+    case Console:
+        if (widgetVariant == Console) {
+            applyFont(ThemeManager::MonoFont);
+        }
+        if (QFrame *frame = qobject_cast<QFrame*>(widget)) {
+            if (frame->frameShape() == QFrame::NoFrame) {
+                frame->setFrameShape(QFrame::StyledPanel);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void ThemeStyle::drawPrimitive(PrimitiveElement element, const QStyleOption *option,
+                               QPainter *painter, const QWidget *widget) const
+{
+    switch (element) {
+    case PE_PanelButtonCommand:
+        if (qobject_cast<const QPushButton*>(widget)) {
+            drawButtonPanel(option, painter, variant(widget));
+            return;
+        }
+        break;
+    case PE_FrameFocusRect:
+        if (qobject_cast<const QPushButton*>(widget)) {
+            return; // Touch screen: the pressed state is feedback enough
+        }
+        break;
+    case PE_FrameGroupBox:
+        return; // Borderless design
+    case PE_Widget:
+        if (variant(widget) == StatusStrip) {
+            painter->fillRect(option->rect, ThemeManager::instance()->brush(ThemeManager::StatusStripBackground));
+            return;
+        }
+        break;
+    case PE_Frame: {
+        const Variant widgetVariant = variant(widget);
+        if (widgetVariant != Panel && widgetVariant != Console) {
+            break;
+        }
+        ThemeManager *tm = ThemeManager::instance();
+        painter->save();
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        if (widgetVariant == Panel) {
+            painter->setPen(Qt::NoPen);
+            painter->setBrush(tm->brush(ThemeManager::SecondaryBackground));
+            painter->drawRoundedRect(option->rect, AppleStyle::RADIUS_M, AppleStyle::RADIUS_M);
+        } else {
+            painter->setPen(QPen(tm->brush(ThemeManager::FocusColor), 2));
+            painter->setBrush(tm->brush(ThemeManager::MainBackground));
+            painter->drawRoundedRect(QRectF(option->rect).adjusted(1, 1, -1, -1),
+                                     AppleStyle::RADIUS_S, AppleStyle::RADIUS_S);
+        }
+        painter->restore();
+        return;
+    }
+    default:
+        break;
+    }
+    QProxyStyle::drawPrimitive(element, option, painter, widget);
+}
+
+void ThemeStyle::drawButtonPanel(const QStyleOption *option, QPainter *painter, Variant variant) const
+{
+    ThemeManager *tm = ThemeManager::instance();
+    const bool enabled = option->state & State_Enabled;
+    const bool pressed = option->state & (State_Sunken | State_On);
+    const bool hovered = option->state & State_MouseOver;
+    
+    QBrush fill;
+    switch (variant) {
+    case PrimaryButton:
+        if (!enabled) {
+            fill = tm->brush(ThemeManager::ControllerInactive);
+        } else if (pressed || hovered) {
+            fill = tm->color(ThemeManager::Primary).darker(pressed ? 140 : 120);
+        } else {
+            fill = tm->brush(ThemeManager::Primary);
+        }
+        break;
+    case FlatButton:
+        if (!enabled || !(pressed || hovered)) {
+            return;
+        }
+        fill = tm->brush(pressed ? ThemeManager::ButtonPressed : ThemeManager::ButtonHover);
+        break;
+    default:
+        fill = tm->brush(pressed ? ThemeManager::ButtonPressed
+                                 : hovered ? ThemeManager::ButtonHover
+                                           : ThemeManager::CardBackground);
+        break;
+    }
+    
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(fill);
+    painter->drawRoundedRect(option->rect, AppleStyle::RADIUS_S, AppleStyle::RADIUS_S);
+    painter->restore();
+}
+
+void ThemeStyle::drawControl(ControlElement element, const QStyleOption *option,
+                             QPainter *painter, const QWidget *widget) const
+{
+    if (element == CE_PushButtonLabel && variant(widget) == PrimaryButton) {
+        if (const QStyleOptionButton *button = qstyleoption_cast<const QStyleOptionButton*>(option)) {
+            QStyleOptionButton label(*button);
+            label.palette.setColor(QPalette::ButtonText, Qt::white);
+            QProxyStyle::drawControl(element, &label, painter, widget);
+            return;
+        }
+    }
+    QProxyStyle::drawControl(element, option, painter, widget);
+}
+
+void ThemeStyle::drawComplexControl(ComplexControl control, const QStyleOptionComplex *option,
+                                    QPainter *painter, const QWidget *widget) const
+{
+    if (control != CC_ScrollBar) {
+        QProxyStyle::drawComplexControl(control, option, painter, widget);
+        return;
+    }
+    
+    // Flat groove in the status strip color with a rounded handle; the
+    // arrow buttons blend into the groove
+    ThemeManager *tm = ThemeManager::instance();
+    painter->fillRect(option->rect, tm->brush(ThemeManager::StatusStripBackground));
+    const QRect handle = subControlRect(control, option, SC_ScrollBarSlider, widget);
+    if (handle.isEmpty() || !(option->state & State_Enabled)) {
+        return;
+    }
+    const qreal radius = qMin(handle.width(), handle.height()) / 2.0;
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(tm->brush(ThemeManager::SecondaryText));
+    painter->drawRoundedRect(handle, radius, radius);
+    painter->restore();
+}
+
+int ThemeStyle::pixelMetric(PixelMetric metric, const QStyleOption *option, const QWidget *widget) const
+{
+    switch (metric) {
+    case PM_DefaultFrameWidth:
+        if (variant(widget) == Panel) {
+            return 0;
+        }
+        if (variant(widget) == Console) {
+            return 2;
+        }
+        break;
+    case PM_ButtonShiftHorizontal:
+    case PM_ButtonShiftVertical:
+        return 0;
+    case PM_ScrollBarExtent:
+        return 12;
+    default:
+        break;
+    }
+    return QProxyStyle::pixelMetric(metric, option, widget);
+}
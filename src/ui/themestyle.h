@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QProxyStyle>
+
+/**
+ * @brief Application style that draws widgets in the current theme
+ * 
+ * Replaces per-widget stylesheets: buttons, panels and text areas are
+ * painted with the cached pens and brushes of ThemeManager, and other
+ * widgets follow the theme through the application palette. Widgets
+ * choose a look with setVariant() instead of a stylesheet; the variant
+ * sets fonts once when the widget is polished and selects how it is
+ * painted. Because nothing is parsed or re-polished, a theme switch is
+ * a palette swap and one repaint.
+ * 
+ * Fonts given to a widget with setFont() take precedence over the
+ * variant font. Scroll bars are slim (12 px) with a rounded handle.
+ * 
+ * Pattern: Proxy (QProxyStyle over Fusion)
+ * Location: src/ui/
+ */
+class ThemeStyle : public QProxyStyle
+{
+    Q_OBJECT
+
+public:
+    enum Variant
+    {
+        NoVariant,
+        PrimaryButton,  // Filled in the primary color, white text
+        ActionButton,   // Card-colored button with the button font
+        FlatButton,     // Transparent until hovered or pressed (header icons)
+        PageTitle,      // Page heading
+        Title,          // Heading in the accent color
+        SectionTitle,   // Section heading
+        StatusLabel,    // Status strip and status bar text
+        StatusStrip,    // Plain QWidget filled in the status strip background
+        Panel,          // Rounded panel in the secondary background (QFrame)
+        Console         // Text area with an accent border and monospace font
+    };
+    Q_ENUM(Variant)
+    
+    ThemeStyle();
+    
+    /**
+     * @brief Select how a widget is drawn; re-polishes polished widgets
+     */
+    static void setVariant(QWidget *widget, Variant variant);
+    static Variant variant(const QWidget *widget);
+    
+    using QProxyStyle::polish;
+    void polish(QWidget *widget) override;
+    
+    void drawPrimitive(PrimitiveElement element, const QStyleOption *option,
+                       QPainter *painter, const QWidget *widget = nullptr) const override;
+    void drawControl(ControlElement element, const QStyleOption *option,
+                     QPainter *painter, const QWidget *widget = nullptr) const override;
+    void drawComplexControl(ComplexControl control, const QStyleOptionComplex *option,
+                            QPainter *painter, const QWidget *widget = nullptr) const override;
+    int pixelMetric(PixelMetric metric, const QStyleOption *option = nullptr,
+                    const QWidget *widget = nullptr) const override;
+
+private:
+    void drawButtonPanel(const QStyleOption *option, QPainter *painter, Variant variant) const;
+};
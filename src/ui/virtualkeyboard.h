@@ -11,6 +11,7 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QFocusEvent>
+#include <QPointer>
 
 /**
  * @brief Touch-optimized virtual keyboard for industrial HMI
@@ -98,7 +99,7 @@ protected:
 
 private:
     QBoxLayout* m_layout;
-    QWidget* m_targetWidget;
+    QPointer<QWidget> m_targetWidget;   // Editors may be deleted while targeted
     bool m_keyboardVisible;
     
     // Keyboard layout widgets
@@ -0,0 +1,501 @@
+#include "calcexpression.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Operand of a bitwise operator: truncated towards zero, 0 if not representable
+inline qint64 toInteger(double value)
+{
+    if (!(value > -9.2e18 && value < 9.2e18)) {
+        return 0; // NaN, inf or out of range
+    }
+    return static_cast<qint64>(value);
+}
+
+} // namespace
+
+/**
+ * @brief Recursive-descent parser emitting CalcExpression bytecode
+ * 
+ * One function per precedence level; each leaves exactly one value on the
+ * operand stack. Tracks the stack depth so programs that would overflow
+ * the fixed evaluation stack are rejected at compile time, and bounds the
+ * recursion of parentheses, conditionals and unary operators so deeply
+ * nested input fails instead of overflowing the native stack.
+ */
+class CalcCompiler {
+public:
+    explicit CalcCompiler(const QString& source)
+        : m_source(source)
+        , m_pos(0)
+        , m_depth(0)
+        , m_maxDepth(0)
+        , m_nesting(0)
+    {
+    }
+    
+    Result<CalcExpression> compile()
+    {
+        CalcExpression program;
+        program.m_code.clear();
+        m_code = &program.m_code;
+        
+        if (!parseTernary()) {
+            return Result<CalcExpression>::failure(m_error);
+        }
+        skipSpaces();
+        if (m_pos < m_source.size()) {
+            return Result<CalcExpression>::failure(unexpected());
+        }
+        if (m_maxDepth > CalcExpression::MAX_STACK_DEPTH) {
+            return Result<CalcExpression>::failure("Expression too deeply nested");
+        }
+        return Result<CalcExpression>::success(program);
+    }
+
+private:
+    using Op = CalcExpression::Op;
+    
+    static constexpr int MAX_NESTING = 128;    // Active parseTernary()/parseUnary() calls
+    
+    // Counts one level of recursion for as long as it is alive
+    class NestingScope {
+    public:
+        explicit NestingScope(int& nesting) : m_nesting(nesting) { ++m_nesting; }
+        ~NestingScope() { --m_nesting; }
+    private:
+        int& m_nesting;
+    };
+    
+    // Level parsers, lowest precedence first
+    
+    bool parseTernary()
+    {
+        const NestingScope scope(m_nesting);
+        if (m_nesting > MAX_NESTING) return fail("Expression too deeply nested");
+        if (!parseLogicalOr()) return false;
+        if (!match("?")) return true;
+        
+        // cond JumpIfZero(else) a Jump(end) else: b end:
+        const int jumpToElse = emitJump(Op::JumpIfZero);
+        const int depth = m_depth;
+        if (!parseTernary()) return false;
+        if (!match(":")) return fail("Expected ':'");
+        const int jumpToEnd = emitJump(Op::Jump);
+        patch(jumpToElse);
+        m_depth = depth; // Only one branch runs
+        if (!parseTernary()) return false;
+        patch(jumpToEnd);
+        return true;
+    }
+    
+    bool parseLogicalOr()
+    {
+        if (!parseLogicalAnd()) return false;
+        while (match("||")) {
+            // a JumpIfNonZero(true) b ToBool Jump(end) true: 1 end:
+            const int jumpToTrue = emitJump(Op::JumpIfNonZero);
+            const int depth = m_depth;
+            if (!parseLogicalAnd()) return false;
+            append(Op::ToBool, 0);
+            const int jumpToEnd = emitJump(Op::Jump);
+            patch(jumpToTrue);
+            m_depth = depth;
+            emitConstant(1.0);
+            patch(jumpToEnd);
+        }
+        return true;
+    }
+    
+    bool parseLogicalAnd()
+    {
+        if (!parseBitOr()) return false;
+        while (match("&&")) {
+            const int jumpToFalse = emitJump(Op::JumpIfZero);
+            const int depth = m_depth;
+            if (!parseBitOr()) return false;
+            append(Op::ToBool, 0);
+            const int jumpToEnd = emitJump(Op::Jump);
+            patch(jumpToFalse);
+            m_depth = depth;
+            emitConstant(0.0);
+            patch(jumpToEnd);
+        }
+        return true;
+    }
+    
+    bool parseBitOr()
+    {
+        if (!parseBitXor()) return false;
+        while (peekSingle('|')) {
+            if (!parseBitXor()) return false;
+            append(Op::BitOr, -1);
+        }
+        return true;
+    }
+    
+    bool parseBitXor()
+    {
+        if (!parseBitAnd()) return false;
+        while (match("^")) {
+            if (!parseBitAnd()) return false;
+            append(Op::BitXor, -1);
+        }
+        return true;
+    }
+    
+    bool parseBitAnd()
+    {
+        if (!parseEquality()) return false;
+        while (peekSingle('&')) {
+            if (!parseEquality()) return false;
+            append(Op::BitAnd, -1);
+        }
+        return true;
+    }
+    
+    bool parseEquality()
+    {
+        if (!parseRelational()) return false;
+        for (;;) {
+            Op op;
+            if (match("==")) op = Op::Equal;
+            else if (match("!=")) op = Op::NotEqual;
+            else return true;
+            if (!parseRelational()) return false;
+            append(op, -1);
+        }
+    }
+    
+    bool parseRelational()
+    {
+        if (!parseShift()) return false;
+        for (;;) {
+            Op op;
+            if (match("<=")) op = Op::LessEqual;
+            else if (match(">=")) op = Op::GreaterEqual;
+            else if (!lookingAt("<<") && match("<")) op = Op::Less;
+            else if (!lookingAt(">>") && match(">")) op = Op::Greater;
+            else return true;
+            if (!parseShift()) return false;
+            append(op, -1);
+        }
+    }
+    
+    bool parseShift()
+    {
+        if (!parseAdditive()) return false;
+        for (;;) {
+            Op op;
+            if (match("<<")) op = Op::ShiftLeft;
+            else if (match(">>")) op = Op::ShiftRight;
+            else return true;
+            if (!parseAdditive()) return false;
+            append(op, -1);
+        }
+    }
+    
+    bool parseAdditive()
+    {
+        if (!parseMultiplicative()) return false;
+        for (;;) {
+            Op op;
+            if (match("+")) op = Op::Add;
+            else if (match("-")) op = Op::Subtract;
+            else return true;
+            if (!parseMultiplicative()) return false;
+            append(op, -1);
+        }
+    }
+    
+    bool parseMultiplicative()
+    {
+        if (!parseUnary()) return false;
+        for (;;) {
+            Op op;
+            if (match("*")) op = Op::Multiply;
+            else if (match("/")) op = Op::Divide;
+            else if (match("%")) op = Op::Modulo;
+            else return true;
+            if (!parseUnary()) return false;
+            append(op, -1);
+        }
+    }
+    
+    bool parseUnary()
+    {
+        const NestingScope scope(m_nesting);
+        if (m_nesting > MAX_NESTING) return fail("Expression too deeply nested");
+        if (match("-")) {
+            if (!parseUnary()) return false;
+            append(Op::Negate, 0);
+            return true;
+        }
+        if (match("+")) {
+            return parseUnary();
+        }
+        if (!lookingAt("!=") && match("!")) {
+            if (!parseUnary()) return false;
+            append(Op::Not, 0);
+            return true;
+        }
+        if (match("~")) {
+            if (!parseUnary()) return false;
+            append(Op::BitNot, 0);
+            return true;
+        }
+        return parsePrimary();
+    }
+    
+    bool parsePrimary()
+    {
+        skipSpaces();
+        if (m_pos >= m_source.size()) {
+            return fail("Unexpected end of expression");
+        }
+        
+        if (match("(")) {
+            if (!parseTernary()) return false;
+            if (!match(")")) return fail("Expected ')'");
+            return true;
+        }
+        
+        const QChar c = m_source.at(m_pos);
+        if (c.isDigit() || (c == '.' && m_pos + 1 < m_source.size() && m_source.at(m_pos + 1).isDigit())) {
+            return parseNumber();
+        }
+        
+        if (c.isLetter() || c == '_') {
+            const int start = m_pos;
+            while (m_pos < m_source.size() && (m_source.at(m_pos).isLetterOrNumber() || m_source.at(m_pos) == '_')) {
+                ++m_pos;
+            }
+            if (m_source.midRef(start, m_pos - start) == QLatin1String("val")) {
+                append(Op::LoadVal, 1);
+                return true;
+            }
+            m_pos = start;
+            return fail(QString("Unknown identifier at position %1").arg(start));
+        }
+        
+        return fail(unexpected());
+    }
+    
+    bool parseNumber()
+    {
+        const int start = m_pos;
+        bool ok = false;
+        double value = 0.0;
+        
+        if (m_source.midRef(m_pos, 2).compare(QLatin1String("0x"), Qt::CaseInsensitive) == 0) {
+            m_pos += 2;
+            while (m_pos < m_source.size() && isHexDigit(m_source.at(m_pos))) {
+                ++m_pos;
+            }
+            value = double(m_source.midRef(start + 2, m_pos - start - 2).toULongLong(&ok, 16));
+        } else {
+            while (m_pos < m_source.size() && (m_source.at(m_pos).isDigit() || m_source.at(m_pos) == '.')) {
+                ++m_pos;
+            }
+            // Exponent: e[+-]digits
+            if (m_pos < m_source.size() && (m_source.at(m_pos) == 'e' || m_source.at(m_pos) == 'E')) {
+                int end = m_pos + 1;
+                if (end < m_source.size() && (m_source.at(end) == '+' || m_source.at(end) == '-')) {
+                    ++end;
+                }
+                if (end < m_source.size() && m_source.at(end).isDigit()) {
+                    m_pos = end;
+                    while (m_pos < m_source.size() && m_source.at(m_pos).isDigit()) {
+                        ++m_pos;
+                    }
+                }
+            }
+            value = m_source.midRef(start, m_pos - start).toDouble(&ok);
+        }
+        
+        if (!ok) {
+            m_pos = start;
+            return fail(QString("Invalid number at position %1").arg(start));
+        }
+        emitConstant(value);
+        return true;
+    }
+    
+    // Code generation
+    
+    void append(Op op, int stackEffect, double constant = 0.0)
+    {
+        m_code->append({op, 0, constant});
+        m_depth += stackEffect;
+        m_maxDepth = qMax(m_maxDepth, m_depth);
+    }
+    
+    void emitConstant(double value)
+    {
+        append(Op::LoadConst, 1, value);
+    }
+    
+    int emitJump(Op op)
+    {
+        // Conditional jumps consume the condition
+        append(op, op == Op::Jump ? 0 : -1);
+        return m_code->size() - 1;
+    }
+    
+    void patch(int jump)
+    {
+        (*m_code)[jump].target = m_code->size();
+    }
+    
+    // Lexing
+    
+    void skipSpaces()
+    {
+        while (m_pos < m_source.size() && m_source.at(m_pos).isSpace()) {
+            ++m_pos;
+        }
+    }
+    
+    bool lookingAt(const char* token)
+    {
+        skipSpaces();
+        return m_source.midRef(m_pos).startsWith(QLatin1String(token));
+    }
+    
+    bool match(const char* token)
+    {
+        if (!lookingAt(token)) {
+            return false;
+        }
+        m_pos += int(qstrlen(token));
+        return true;
+    }
+    
+    // Matches '|' but not '||' (same for '&')
+    bool peekSingle(char c)
+    {
+        skipSpaces();
+        if (m_pos < m_source.size() && m_source.at(m_pos) == c
+            && !(m_pos + 1 < m_source.size() && m_source.at(m_pos + 1) == c)) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+    
+    static bool isHexDigit(QChar c)
+    {
+        return c.isDigit() || (c.toLower() >= 'a' && c.toLower() <= 'f');
+    }
+    
+    QString unexpected() const
+    {
+        return QString("Unexpected '%1' at position %2").arg(m_source.at(m_pos)).arg(m_pos);
+    }
+    
+    bool fail(const QString& error)
+    {
+        m_error = error;
+        return false;
+    }
+    
+    const QString& m_source;
+    int m_pos;
+    int m_depth;
+    int m_maxDepth;
+    int m_nesting;
+    QString m_error;
+    QVector<CalcExpression::Instruction>* m_code = nullptr;
+};
+
+CalcExpression::CalcExpression()
+{
+    m_code.append({Op::LoadVal, 0, 0.0});
+}
+
+Result<CalcExpression> CalcExpression::compile(const QString& source)
+{
+    return CalcCompiler(source).compile();
+}
+
+double CalcExpression::evaluate(double val) const
+{
+    double stack[MAX_STACK_DEPTH];
+    int top = -1;
+    
+    const Instruction* code = m_code.constData();
+    const int size = m_code.size();
+    for (int pc = 0; pc < size; ++pc) {
+        const Instruction& in = code[pc];
+        switch (in.op) {
+            case Op::LoadVal:       stack[++top] = val; break;
+            case Op::LoadConst:     stack[++top] = in.constant; break;
+            
+            case Op::Negate:        stack[top] = -stack[top]; break;
+            case Op::Not:           stack[top] = stack[top] == 0.0 ? 1.0 : 0.0; break;
+            case Op::BitNot:        stack[top] = double(~toInteger(stack[top])); break;
+            case Op::ToBool:        stack[top] = stack[top] != 0.0 ? 1.0 : 0.0; break;
+            
+            case Op::Add:           --top; stack[top] += stack[top + 1]; break;
+            case Op::Subtract:      --top; stack[top] -= stack[top + 1]; break;
+            case Op::Multiply:      --top; stack[top] *= stack[top + 1]; break;
+            case Op::Divide:        --top; stack[top] /= stack[top + 1]; break;
+            case Op::Modulo:        --top; stack[top] = std::fmod(stack[top], stack[top + 1]); break;
+            
+            case Op::Equal:         --top; stack[top] = stack[top] == stack[top + 1] ? 1.0 : 0.0; break;
+            case Op::NotEqual:      --top; stack[top] = stack[top] != stack[top + 1] ? 1.0 : 0.0; break;
+            case Op::Less:          --top; stack[top] = stack[top] < stack[top + 1] ? 1.0 : 0.0; break;
+            case Op::LessEqual:     --top; stack[top] = stack[top] <= stack[top + 1] ? 1.0 : 0.0; break;
+            case Op::Greater:       --top; stack[top] = stack[top] > stack[top + 1] ? 1.0 : 0.0; break;
+            case Op::GreaterEqual:  --top; stack[top] = stack[top] >= stack[top + 1] ? 1.0 : 0.0; break;
+            
+            case Op::BitAnd:
+                --top;
+                stack[top] = double(toInteger(stack[top]) & toInteger(stack[top + 1]));
+                break;
+            case Op::BitOr:
+                --top;
+                stack[top] = double(toInteger(stack[top]) | toInteger(stack[top + 1]));
+                break;
+            case Op::BitXor:
+                --top;
+                stack[top] = double(toInteger(stack[top]) ^ toInteger(stack[top + 1]));
+                break;
+            case Op::ShiftLeft:
+                // Shifted unsigned to stay defined, read back signed like the other bit operators
+                --top;
+                stack[top] = double(qint64(quint64(toInteger(stack[top])) << (toInteger(stack[top + 1]) & 63)));
+                break;
+            case Op::ShiftRight:
+                --top;
+                stack[top] = double(toInteger(stack[top]) >> (toInteger(stack[top + 1]) & 63));
+                break;
+            
+            case Op::Jump:
+                pc = in.target - 1;
+                break;
+            case Op::JumpIfZero:
+                if (stack[top--] == 0.0) pc = in.target - 1;
+                break;
+            case Op::JumpIfNonZero:
+                if (stack[top--] != 0.0) pc = in.target - 1;
+                break;
+        }
+    }
+    return stack[top];
+}
+
+void CalcExpression::evaluate(const double* values, double* results, int count) const
+{
+    if (isIdentity()) {
+        if (results != values) {
+            std::copy(values, values + count, results);
+        }
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        results[i] = evaluate(values[i]);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "result.h"
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Compiled calculation of a controller XML field (the calc attribute)
+ * 
+ * Controllers describe how a raw register value is shown with a C-like
+ * expression over the variable val, e.g. "val/10" or
+ * "val==0?val:(val+1)/100". compile() parses the expression once into
+ * stack-machine bytecode; evaluate() then runs it without any parsing or
+ * allocation, so a program can be cached per expression string and
+ * applied to every refresh of every field.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * 
+ * Supported syntax, in C precedence order (lowest first):
+ * @code
+ * c ? a : b                    ternary (right associative)
+ * ||  &&                       logical, short-circuit, result 0 or 1
+ * |  ^  &                      bitwise on 64-bit integers
+ * ==  !=  <  <=  >  >=         comparison, result 0 or 1
+ * <<  >>                       shifts on 64-bit integers
+ * +  -  *  /  %                arithmetic on doubles (% is fmod)
+ * -  +  !  ~                   unary
+ * val, 12, 0.5, 1e3, 0x1F, ( ) operands
+ * @endcode
+ * Division by zero follows IEEE 754 (inf or nan). Operands of bitwise
+ * operators are truncated towards zero; non-finite ones count as 0.
+ * Results are signed, and shift counts are taken modulo 64.
+ * 
+ * Example:
+ * @code
+ * auto program = CalcExpression::compile("val==0?val:(val+1)/100");
+ * if (program.isSuccess()) {
+ *     double shown = program.value().evaluate(raw);
+ * }
+ * @endcode
+ */
+class CalcExpression {
+public:
+    /**
+     * @brief Deepest operand stack a program may need
+     */
+    static constexpr int MAX_STACK_DEPTH = 32;
+    
+    /**
+     * @brief Identity program (evaluates to val)
+     */
+    CalcExpression();
+    
+    /**
+     * @brief Compile an expression
+     * @param source Expression text, e.g. "val/10"
+     * @return Program, or failure naming the position of the syntax error
+     */
+    static Result<CalcExpression> compile(const QString& source);
+    
+    /**
+     * @brief Evaluate the program for one value
+     */
+    double evaluate(double val) const;
+    
+    /**
+     * @brief Evaluate the program for many values
+     * @param values Input values
+     * @param results Output, may be the same array as values
+     * @param count Number of values
+     */
+    void evaluate(const double* values, double* results, int count) const;
+    
+    /**
+     * @brief Check if the program just returns val
+     */
+    bool isIdentity() const { return m_code.size() == 1 && m_code.first().op == Op::LoadVal; }
+
+private:
+    enum class Op : quint8 {
+        LoadVal, LoadConst,
+        Negate, Not, BitNot,
+        Add, Subtract, Multiply, Divide, Modulo,
+        Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+        BitAnd, BitOr, BitXor, ShiftLeft, ShiftRight,
+        ToBool,
+        Jump, JumpIfZero, JumpIfNonZero
+    };
+    
+    struct Instruction {
+        Op op;
+        qint32 target;      // Jump destination (index into m_code)
+        double constant;    // LoadConst operand
+    };
+    
+    friend class CalcCompiler;
+    
+    QVector<Instruction> m_code;
+};
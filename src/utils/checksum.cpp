@@ -0,0 +1,30 @@
+#include "checksum.h"
+#include <array>
+
+namespace {
+
+std::array<quint32, 256> makeTable()
+{
+    std::array<quint32, 256> table{};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+} // namespace
+
+quint32 crc32(const uchar* data, qint64 size, quint32 crc)
+{
+    static const std::array<quint32, 256> table = makeTable();
+    
+    crc ^= 0xFFFFFFFFu;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as used by zlib and PNG) of a byte range
+ * 
+ * Used to detect torn or corrupted records in the historian's own file
+ * formats (time-series segments, store-and-forward spool).
+ * 
+ * Location: src/utils/
+ * 
+ * @param data First byte
+ * @param size Number of bytes
+ * @param crc Running CRC of preceding data, to checksum discontiguous ranges
+ */
+quint32 crc32(const uchar* data, qint64 size, quint32 crc = 0);
@@ -0,0 +1,158 @@
+#include "columncodec.h"
+#include <cstring>
+
+namespace {
+
+void writeVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+bool readVarint(const uchar*& p, const uchar* end, quint64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar byte = *p++;
+        value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+} // namespace
+
+QByteArray ColumnCodec::encodeDeltaVarint(const QVector<qint64>& values)
+{
+    QByteArray out;
+    out.reserve(values.size() * 2);
+    
+    // Wrapping arithmetic, decoded the same way
+    quint64 previous = 0;
+    for (qint64 value : values) {
+        writeVarint(out, zigzag(qint64(quint64(value) - previous)));
+        previous = quint64(value);
+    }
+    return out;
+}
+
+bool ColumnCodec::decodeDeltaVarint(const QByteArray& data, int count, QVector<qint64>& values)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    const uchar* end = p + data.size();
+    
+    values.resize(count);
+    quint64 previous = 0;
+    for (int i = 0; i < count; ++i) {
+        quint64 delta;
+        if (!readVarint(p, end, delta)) {
+            return false;
+        }
+        previous += quint64(unzigzag(delta));
+        values[i] = qint64(previous);
+    }
+    return p == end;
+}
+
+QByteArray ColumnCodec::encodeByteStreamSplit(const QVector<double>& values)
+{
+    const int count = values.size();
+    QByteArray out(count * 8, Qt::Uninitialized);
+    char* streams = out.data();
+    
+    for (int i = 0; i < count; ++i) {
+        quint64 bits;
+        std::memcpy(&bits, &values[i], sizeof(bits));
+        for (int byte = 0; byte < 8; ++byte) {
+            streams[byte * count + i] = char(bits >> (byte * 8));
+        }
+    }
+    return out;
+}
+
+bool ColumnCodec::decodeByteStreamSplit(const QByteArray& data, int count, QVector<double>& values)
+{
+    if (data.size() != count * 8) {
+        return false;
+    }
+    
+    const uchar* streams = reinterpret_cast<const uchar*>(data.constData());
+    values.resize(count);
+    for (int i = 0; i < count; ++i) {
+        quint64 bits = 0;
+        for (int byte = 0; byte < 8; ++byte) {
+            bits |= quint64(streams[byte * count + i]) << (byte * 8);
+        }
+        std::memcpy(&values[i], &bits, sizeof(bits));
+    }
+    return true;
+}
+
+QByteArray ColumnCodec::encodeLengthPrefixed(const QStringList& values)
+{
+    QByteArray out;
+    for (const QString& value : values) {
+        const QByteArray utf8 = value.toUtf8();
+        writeVarint(out, quint64(utf8.size()));
+        out.append(utf8);
+    }
+    return out;
+}
+
+bool ColumnCodec::decodeLengthPrefixed(const QByteArray& data, int count, QStringList& values)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    const uchar* end = p + data.size();
+    
+    values.clear();
+    values.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        quint64 length;
+        if (!readVarint(p, end, length) || length > quint64(end - p)) {
+            return false;
+        }
+        values.append(QString::fromUtf8(reinterpret_cast<const char*>(p), int(length)));
+        p += length;
+    }
+    return p == end;
+}
+
+QByteArray ColumnCodec::compress(const QByteArray& encoded, Compression& used)
+{
+    QByteArray compressed = qCompress(encoded);
+    if (compressed.size() < encoded.size()) {
+        used = Compression::Zlib;
+        return compressed;
+    }
+    used = Compression::None;
+    return encoded;
+}
+
+bool ColumnCodec::decompress(const QByteArray& stored, Compression compression, QByteArray& encoded)
+{
+    switch (compression) {
+        case Compression::None:
+            encoded = stored;
+            return true;
+        case Compression::Zlib:
+            // qUncompress() returns an empty array for corrupt input
+            encoded = qUncompress(stored);
+            return !encoded.isEmpty() || (stored.size() >= 4 && stored.startsWith(QByteArray(4, '\0')));
+    }
+    return false;
+}
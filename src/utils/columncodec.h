@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Per-column encodings of the historian columnar export format
+ * 
+ * Each column of a chunk is first transformed by an encoding that makes
+ * it compressible, then optionally zlib-compressed. The byte layouts are
+ * part of the export format and documented in
+ * docs/api/historian-export-format.md; changing them requires a new
+ * format version.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * 
+ * Encodings:
+ * @code
+ * DeltaVarint      int64: first value, then differences to the previous
+ *                  value, each zigzag-mapped and written as LEB128 varint
+ * ByteStreamSplit  float64: byte 0 of every value, then byte 1 of every
+ *                  value, ... byte 7 (IEEE 754, little endian)
+ * Plain            uint8: one byte per value
+ * LengthPrefixed   UTF-8 text: LEB128 byte length, then the bytes, per value
+ * @endcode
+ */
+class ColumnCodec {
+public:
+    enum class Encoding : quint8 {
+        Plain = 0,
+        DeltaVarint = 1,
+        ByteStreamSplit = 2,
+        LengthPrefixed = 3
+    };
+    
+    enum class Compression : quint8 {
+        None = 0,
+        Zlib = 1        // 4-byte big-endian raw size + zlib stream (qCompress())
+    };
+    
+    static QByteArray encodeDeltaVarint(const QVector<qint64>& values);
+    static bool decodeDeltaVarint(const QByteArray& data, int count, QVector<qint64>& values);
+    
+    static QByteArray encodeByteStreamSplit(const QVector<double>& values);
+    static bool decodeByteStreamSplit(const QByteArray& data, int count, QVector<double>& values);
+    
+    static QByteArray encodeLengthPrefixed(const QStringList& values);
+    static bool decodeLengthPrefixed(const QByteArray& data, int count, QStringList& values);
+    
+    /**
+     * @brief Compress an encoded column if that makes it smaller
+     * @param encoded Encoded column
+     * @param used Receives the compression that was applied
+     */
+    static QByteArray compress(const QByteArray& encoded, Compression& used);
+    
+    /**
+     * @brief Undo compress()
+     * @return False if the compression is unknown or the data is corrupt
+     */
+    static bool decompress(const QByteArray& stored, Compression compression, QByteArray& encoded);
+};
@@ -0,0 +1,239 @@
+#include "gorillacodec.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+namespace {
+
+quint64 doubleBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Sign-extend the low 'bits' bits of value
+qint64 signExtend(quint64 value, int bits)
+{
+    const quint64 sign = quint64(1) << (bits - 1);
+    return qint64((value ^ sign) - sign);
+}
+
+} // namespace
+
+GorillaEncoder::GorillaEncoder()
+    : m_pending(0)
+    , m_pendingBits(0)
+    , m_count(0)
+    , m_previousTimestamp(0)
+    , m_previousDelta(0)
+    , m_previousValue(0)
+    , m_previousLeading(-1)
+    , m_previousTrailing(0)
+    , m_previousQuality(0)
+{
+}
+
+void GorillaEncoder::append(qint64 timestampMs, double value, quint8 quality)
+{
+    const quint64 valueBits = doubleBits(value);
+    
+    if (m_count == 0) {
+        writeBits(quint64(timestampMs), 64);
+        writeBits(valueBits, 64);
+    } else {
+        // Timestamp: delta-of-delta (wrapping arithmetic, decoded the same way)
+        const qint64 delta = qint64(quint64(timestampMs) - quint64(m_previousTimestamp));
+        const qint64 deltaOfDelta = qint64(quint64(delta) - quint64(m_previousDelta));
+        m_previousDelta = delta;
+        
+        if (deltaOfDelta == 0) {
+            writeBits(0, 1);
+        } else if (deltaOfDelta >= -64 && deltaOfDelta <= 63) {
+            writeBits(0x2, 2);
+            writeBits(quint64(deltaOfDelta), 7);
+        } else if (deltaOfDelta >= -256 && deltaOfDelta <= 255) {
+            writeBits(0x6, 3);
+            writeBits(quint64(deltaOfDelta), 9);
+        } else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047) {
+            writeBits(0xE, 4);
+            writeBits(quint64(deltaOfDelta), 12);
+        } else {
+            writeBits(0xF, 4);
+            writeBits(quint64(deltaOfDelta), 64);
+        }
+        
+        // Value: XOR with the previous value
+        const quint64 x = valueBits ^ m_previousValue;
+        if (x == 0) {
+            writeBits(0, 1);
+        } else {
+            const int leading = qMin(int(qCountLeadingZeroBits(x)), 31);
+            const int trailing = int(qCountTrailingZeroBits(x));
+            
+            if (m_previousLeading >= 0 && leading >= m_previousLeading && trailing >= m_previousTrailing) {
+                writeBits(0x2, 2);
+                writeBits(x >> m_previousTrailing, 64 - m_previousLeading - m_previousTrailing);
+            } else {
+                const int length = 64 - leading - trailing;
+                writeBits(0x3, 2);
+                writeBits(quint64(leading), 5);
+                writeBits(quint64(length - 1), 6);
+                writeBits(x >> trailing, length);
+                m_previousLeading = leading;
+                m_previousTrailing = trailing;
+            }
+        }
+    }
+    
+    // Quality
+    if (quality == m_previousQuality) {
+        writeBits(0, 1);
+    } else {
+        writeBits(0x4 | (quality & 0x3), 3);
+        m_previousQuality = quality & 0x3;
+    }
+    
+    m_previousTimestamp = timestampMs;
+    m_previousValue = valueBits;
+    ++m_count;
+}
+
+QByteArray GorillaEncoder::data() const
+{
+    QByteArray result = m_bytes;
+    if (m_pendingBits > 0) {
+        result.append(char(quint8(m_pending << (8 - m_pendingBits))));
+    }
+    return result;
+}
+
+void GorillaEncoder::writeBits(quint64 value, int bits)
+{
+    // At most 7 bits are pending, so writing in 32-bit pieces never
+    // overflows the 64-bit accumulator
+    if (bits > 32) {
+        writeBits(value >> 32, bits - 32);
+        bits = 32;
+    }
+    
+    const quint64 mask = (quint64(1) << bits) - 1;
+    m_pending = (m_pending << bits) | (value & mask);
+    m_pendingBits += bits;
+    
+    while (m_pendingBits >= 8) {
+        m_pendingBits -= 8;
+        m_bytes.append(char(quint8(m_pending >> m_pendingBits)));
+    }
+    m_pending &= (quint64(1) << m_pendingBits) - 1;
+}
+
+GorillaDecoder::GorillaDecoder(const uchar* data, qint64 size, int count)
+    : m_data(data)
+    , m_end(data + size)
+    , m_window(0)
+    , m_windowBits(0)
+    , m_overrun(false)
+    , m_remaining(count)
+    , m_first(true)
+    , m_previousTimestamp(0)
+    , m_previousDelta(0)
+    , m_previousValue(0)
+    , m_previousLeading(0)
+    , m_previousTrailing(0)
+    , m_previousQuality(0)
+{
+}
+
+inline void GorillaDecoder::refill()
+{
+    while (m_windowBits <= 56 && m_data < m_end) {
+        m_window = (m_window << 8) | *m_data++;
+        m_windowBits += 8;
+    }
+}
+
+inline quint64 GorillaDecoder::readBits(int bits)
+{
+    // bits <= 32
+    if (m_windowBits < bits) {
+        refill();
+        if (m_windowBits < bits) {
+            m_overrun = true;
+            return 0;
+        }
+    }
+    
+    m_windowBits -= bits;
+    return (m_window >> m_windowBits) & ((quint64(1) << bits) - 1);
+}
+
+inline quint64 GorillaDecoder::readBits64()
+{
+    const quint64 high = readBits(32);
+    return (high << 32) | readBits(32);
+}
+
+int GorillaDecoder::decode(qint64* timestamps, double* values, quint8* qualities, int maxCount)
+{
+    int decoded = 0;
+    
+    while (decoded < maxCount && m_remaining > 0) {
+        if (m_first) {
+            m_previousTimestamp = qint64(readBits64());
+            m_previousValue = readBits64();
+            m_first = false;
+        } else {
+            // Timestamp
+            qint64 deltaOfDelta = 0;
+            if (readBits(1)) {
+                if (!readBits(1)) {
+                    deltaOfDelta = signExtend(readBits(7), 7);
+                } else if (!readBits(1)) {
+                    deltaOfDelta = signExtend(readBits(9), 9);
+                } else if (!readBits(1)) {
+                    deltaOfDelta = signExtend(readBits(12), 12);
+                } else {
+                    deltaOfDelta = qint64(readBits64());
+                }
+            }
+            m_previousDelta = qint64(quint64(m_previousDelta) + quint64(deltaOfDelta));
+            m_previousTimestamp = qint64(quint64(m_previousTimestamp) + quint64(m_previousDelta));
+            
+            // Value
+            if (readBits(1)) {
+                if (readBits(1)) {
+                    m_previousLeading = int(readBits(5));
+                    m_previousTrailing = 64 - m_previousLeading - int(readBits(6)) - 1;
+                }
+                const int length = 64 - m_previousLeading - m_previousTrailing;
+                const quint64 meaningful = length > 32 ? (readBits(length - 32) << 32) | readBits(32)
+                                                       : readBits(length);
+                m_previousValue ^= meaningful << m_previousTrailing;
+            }
+        }
+        
+        // Quality
+        if (readBits(1)) {
+            m_previousQuality = quint8(readBits(2));
+        }
+        
+        if (m_overrun || m_previousTrailing < 0) {
+            return -1;
+        }
+        
+        timestamps[decoded] = m_previousTimestamp;
+        values[decoded] = bitsDouble(m_previousValue);
+        qualities[decoded] = m_previousQuality;
+        ++decoded;
+        --m_remaining;
+    }
+    
+    return decoded;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtGlobal>
+
+/**
+ * @brief Gorilla-style compressor for (timestamp, value, quality) samples
+ * 
+ * Encodes one tag's samples into a compact bit stream, following the
+ * scheme of Facebook's Gorilla time-series database:
+ * - Timestamps as delta-of-delta, with short codes for the regular
+ *   sampling intervals typical of polled process data ('0' when the
+ *   interval did not change)
+ * - Values as the XOR with the previous value, storing only the
+ *   meaningful bits ('0' when the value did not change)
+ * - Quality as a single '0' bit while it stays the same
+ * 
+ * A slowly changing, regularly sampled signal therefore costs about
+ * 3 bits per sample. Values are stored as IEEE 754 doubles, which
+ * represent every integer up to 2^53 exactly.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * 
+ * Bit stream layout per sample:
+ * @code
+ * first sample:  ts (64 bits) | value bits (64 bits) | quality code
+ * later samples: timestamp code | value code | quality code
+ * 
+ * timestamp code (dod = delta - previous delta, in ms):
+ *   '0'                        dod == 0
+ *   '10'   + 7 bits            dod in [-64, 63]
+ *   '110'  + 9 bits            dod in [-256, 255]
+ *   '1110' + 12 bits           dod in [-2048, 2047]
+ *   '1111' + 64 bits           anything else
+ * value code (x = value bits XOR previous value bits):
+ *   '0'                        x == 0
+ *   '10'   + meaningful bits   x fits the previous leading/trailing zero window
+ *   '11'   + 5 bits leading zeros + 6 bits (length - 1) + meaningful bits
+ * quality code:
+ *   '0'                        same quality as the previous sample (initially 0)
+ *   '1'    + 2 bits            new quality
+ * @endcode
+ */
+class GorillaEncoder {
+public:
+    GorillaEncoder();
+    
+    /**
+     * @brief Append a sample to the stream
+     * @param timestampMs Milliseconds since epoch
+     * @param value Sample value
+     * @param quality Quality code (0-3)
+     */
+    void append(qint64 timestampMs, double value, quint8 quality);
+    
+    /**
+     * @brief Number of samples appended so far
+     */
+    int count() const { return m_count; }
+    
+    /**
+     * @brief Encoded stream, padded with zero bits to a whole byte
+     */
+    QByteArray data() const;
+    
+    /**
+     * @brief Size of the encoded stream in bytes (including padding)
+     */
+    int size() const { return m_bytes.size() + (m_pendingBits > 0 ? 1 : 0); }
+
+private:
+    void writeBits(quint64 value, int bits);
+    
+    QByteArray m_bytes;         // Completed bytes
+    quint64 m_pending;          // Bits not yet forming a whole byte (right aligned)
+    int m_pendingBits;          // Number of bits in m_pending (< 8)
+    
+    int m_count;                // Samples encoded
+    qint64 m_previousTimestamp;
+    qint64 m_previousDelta;
+    quint64 m_previousValue;    // Raw IEEE 754 bits
+    int m_previousLeading;      // Leading zeros of the last stored XOR (-1 = none yet)
+    int m_previousTrailing;     // Trailing zeros of the last stored XOR
+    quint8 m_previousQuality;
+};
+
+/**
+ * @brief Decoder for streams produced by GorillaEncoder
+ * 
+ * Reads directly from a caller-owned buffer (e.g. a memory-mapped
+ * segment file), so no copy of the compressed data is made.
+ * 
+ * Example:
+ * @code
+ * GorillaDecoder decoder(chunk, chunkSize, sampleCount);
+ * QVector<qint64> timestamps(sampleCount);
+ * QVector<double> values(sampleCount);
+ * QVector<quint8> qualities(sampleCount);
+ * int decoded = decoder.decode(timestamps.data(), values.data(), qualities.data(), sampleCount);
+ * @endcode
+ */
+class GorillaDecoder {
+public:
+    /**
+     * @brief Create a decoder
+     * @param data Encoded stream
+     * @param size Size of the stream in bytes
+     * @param count Number of samples in the stream
+     */
+    GorillaDecoder(const uchar* data, qint64 size, int count);
+    
+    /**
+     * @brief Decode up to maxCount samples
+     * 
+     * Can be called repeatedly to decode a stream in batches.
+     * @return Number of samples decoded; less than requested at the end of
+     *         the stream, or -1 if the stream is truncated or malformed
+     */
+    int decode(qint64* timestamps, double* values, quint8* qualities, int maxCount);
+    
+    /**
+     * @brief Number of samples not decoded yet
+     */
+    int remaining() const { return m_remaining; }
+
+private:
+    inline void refill();
+    inline quint64 readBits(int bits);
+    inline quint64 readBits64();
+    
+    const uchar* m_data;        // Next unread byte
+    const uchar* m_end;         // End of stream
+    quint64 m_window;           // Prefetched bits (right aligned)
+    int m_windowBits;           // Valid bits in m_window
+    bool m_overrun;             // Read past the end of the stream
+    
+    int m_remaining;            // Samples left to decode
+    bool m_first;               // Next sample is the first of the stream
+    qint64 m_previousTimestamp;
+    qint64 m_previousDelta;
+    quint64 m_previousValue;
+    int m_previousLeading;
+    int m_previousTrailing;
+    quint8 m_previousQuality;
+};
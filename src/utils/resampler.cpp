@@ -0,0 +1,144 @@
+#include "resampler.h"
+#include <limits>
+
+namespace {
+
+const double NO_DATA = std::numeric_limits<double>::quiet_NaN();
+
+} // namespace
+
+Resampler::Resampler(ResampleMode mode, qint64 startMs, qint64 stepMs, int slots)
+    : m_mode(mode)
+    , m_startMs(startMs)
+    , m_stepMs(qMax<qint64>(1, stepMs))
+    , m_slots(qMax(0, slots))
+    , m_nextSlot(0)
+    , m_hasPrevious(false)
+    , m_previousMs(0)
+    , m_previousValue(0.0)
+    , m_weightedSum(0.0)
+    , m_coveredMs(0)
+    , m_min(0.0)
+    , m_max(0.0)
+    , m_hasExtremes(false)
+{
+    m_values.reserve(m_slots);
+    if (m_mode == ResampleMode::MinMax) {
+        m_maxValues.reserve(m_slots);
+    }
+}
+
+void Resampler::add(qint64 timestampMs, double value)
+{
+    switch (m_mode) {
+        case ResampleMode::Previous:
+            // Slots starting before this sample hold the previous value
+            while (m_nextSlot < m_slots && slotStart(m_nextSlot) < timestampMs) {
+                closeSlot(m_hasPrevious ? m_previousValue : NO_DATA);
+            }
+            break;
+            
+        case ResampleMode::Linear:
+            while (m_nextSlot < m_slots && slotStart(m_nextSlot) < timestampMs) {
+                const qint64 t = slotStart(m_nextSlot);
+                if (!m_hasPrevious || t < m_previousMs) {
+                    closeSlot(NO_DATA);
+                } else {
+                    const double fraction = double(t - m_previousMs) / double(timestampMs - m_previousMs);
+                    closeSlot(m_previousValue + (value - m_previousValue) * fraction);
+                }
+            }
+            break;
+            
+        case ResampleMode::TimeWeightedAverage:
+            if (m_hasPrevious) {
+                accumulateHeld(m_previousMs, timestampMs);
+            }
+            break;
+            
+        case ResampleMode::MinMax:
+            // Close every slot that ends at or before this sample
+            while (m_nextSlot < m_slots && slotStart(m_nextSlot) + m_stepMs <= timestampMs) {
+                closeSlot(m_hasExtremes ? m_min : NO_DATA, m_hasExtremes ? m_max : NO_DATA);
+            }
+            if (m_nextSlot < m_slots && timestampMs >= slotStart(m_nextSlot)) {
+                m_min = m_hasExtremes ? qMin(m_min, value) : value;
+                m_max = m_hasExtremes ? qMax(m_max, value) : value;
+                m_hasExtremes = true;
+            }
+            break;
+    }
+    
+    m_hasPrevious = true;
+    m_previousMs = timestampMs;
+    m_previousValue = value;
+}
+
+void Resampler::finish()
+{
+    switch (m_mode) {
+        case ResampleMode::Previous:
+            while (m_nextSlot < m_slots) {
+                closeSlot(m_hasPrevious && slotStart(m_nextSlot) >= m_previousMs ? m_previousValue : NO_DATA);
+            }
+            break;
+            
+        case ResampleMode::Linear:
+            // Nothing follows: only a slot starting exactly on the last sample has a value
+            while (m_nextSlot < m_slots) {
+                closeSlot(m_hasPrevious && slotStart(m_nextSlot) == m_previousMs ? m_previousValue : NO_DATA);
+            }
+            break;
+            
+        case ResampleMode::TimeWeightedAverage:
+            // The last value is held to the end of the grid
+            if (m_hasPrevious) {
+                accumulateHeld(m_previousMs, slotStart(m_slots));
+            }
+            while (m_nextSlot < m_slots) {
+                closeSlot(m_coveredMs > 0 ? m_weightedSum / m_coveredMs : NO_DATA);
+            }
+            break;
+            
+        case ResampleMode::MinMax:
+            while (m_nextSlot < m_slots) {
+                closeSlot(m_hasExtremes ? m_min : NO_DATA, m_hasExtremes ? m_max : NO_DATA);
+            }
+            break;
+    }
+}
+
+void Resampler::accumulateHeld(qint64 fromMs, qint64 toMs)
+{
+    while (m_nextSlot < m_slots) {
+        const qint64 slotBegin = slotStart(m_nextSlot);
+        const qint64 slotEnd = slotBegin + m_stepMs;
+        if (slotBegin >= toMs) {
+            return;
+        }
+        
+        const qint64 overlap = qMin(slotEnd, toMs) - qMax(slotBegin, fromMs);
+        if (overlap > 0) {
+            m_weightedSum += m_previousValue * overlap;
+            m_coveredMs += overlap;
+        }
+        
+        if (slotEnd > toMs) {
+            return;     // Slot continues past this segment
+        }
+        closeSlot(m_coveredMs > 0 ? m_weightedSum / m_coveredMs : NO_DATA);
+    }
+}
+
+void Resampler::closeSlot(double value, double maxValue)
+{
+    m_values.append(value);
+    if (m_mode == ResampleMode::MinMax) {
+        m_maxValues.append(maxValue);
+    }
+    
+    ++m_nextSlot;
+    m_weightedSum = 0.0;
+    m_coveredMs = 0;
+    m_hasExtremes = false;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../models/resampledseries.h"
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Single-pass resampler for one tag's samples
+ * 
+ * Turns a stream of samples, fed in ascending timestamp order, into one
+ * value per slot of a regular grid. Each sample is looked at once and
+ * each slot is finalized as soon as no later sample can change it, so
+ * the work is O(samples + slots) and no raw samples are kept.
+ * 
+ * What to feed for a grid covering [startMs, endMs) with endMs =
+ * startMs + slots * stepMs:
+ * - Previous, Linear, TimeWeightedAverage: the last sample before startMs
+ *   (if any), so the first slots have a value to hold or interpolate from
+ * - All modes: every sample in [startMs, endMs)
+ * - Linear: the first sample at or after endMs (if any), so the last
+ *   slots can be interpolated
+ * 
+ * Samples outside the range a mode needs are ignored.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * 
+ * Example:
+ * @code
+ * Resampler resampler(ResampleMode::TimeWeightedAverage, start, 60000, 60);
+ * for (const auto& sample : ascendingSamples) {
+ *     resampler.add(sample.ts, sample.value);
+ * }
+ * resampler.finish();
+ * const QVector<double>& perMinute = resampler.values();
+ * @endcode
+ */
+class Resampler {
+public:
+    /**
+     * @param mode Resampling mode
+     * @param startMs Start of the first slot
+     * @param stepMs Slot width (> 0)
+     * @param slots Number of slots
+     */
+    Resampler(ResampleMode mode, qint64 startMs, qint64 stepMs, int slots);
+    
+    /**
+     * @brief Feed the next sample (timestamps must be strictly ascending)
+     */
+    void add(qint64 timestampMs, double value);
+    
+    /**
+     * @brief Finalize the remaining slots; call once after the last add()
+     */
+    void finish();
+    
+    /**
+     * @brief Value per slot (NaN = no data); the minimum in MinMax mode
+     */
+    const QVector<double>& values() const { return m_values; }
+    
+    /**
+     * @brief Maximum per slot (MinMax mode only)
+     */
+    const QVector<double>& maxValues() const { return m_maxValues; }
+
+private:
+    qint64 slotStart(int slot) const { return m_startMs + slot * m_stepMs; }
+    
+    /**
+     * @brief Add the held value over [fromMs, toMs) to the time-weighted slots
+     */
+    void accumulateHeld(qint64 fromMs, qint64 toMs);
+    
+    /**
+     * @brief Store the current slot's result and move to the next slot
+     */
+    void closeSlot(double value, double maxValue = 0.0);
+    
+    ResampleMode m_mode;
+    qint64 m_startMs;
+    qint64 m_stepMs;
+    int m_slots;
+    
+    int m_nextSlot;             // First slot not finalized yet
+    bool m_hasPrevious;         // A sample has been seen
+    qint64 m_previousMs;        // Timestamp of the last sample
+    double m_previousValue;     // Value of the last sample
+    
+    double m_weightedSum;       // TimeWeightedAverage: integral over the current slot
+    qint64 m_coveredMs;         // TimeWeightedAverage: time with a known value in the current slot
+    double m_min;               // MinMax: current slot
+    double m_max;
+    bool m_hasExtremes;
+    
+    QVector<double> m_values;
+    QVector<double> m_maxValues;
+};
@@ -0,0 +1,64 @@
+#include "stringinterner.h"
+#include <QDebug>
+
+StringInterner::StringInterner(int capacity)
+    : m_capacity(qMax(1, capacity))
+    , m_full(false)
+{
+    m_strings.append(QString());
+    m_ids.insert(QString(), 0);
+}
+
+quint32 StringInterner::intern(const QString& text)
+{
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_ids.constFind(text);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+    }
+    
+    QWriteLocker locker(&m_lock);
+    auto it = m_ids.constFind(text);
+    if (it != m_ids.constEnd()) {
+        return it.value();     // Interned by another thread meanwhile
+    }
+    
+    if (m_strings.size() >= m_capacity) {
+        if (!m_full) {
+            qWarning() << "StringInterner: Full at" << m_capacity << "strings, new strings map to ID 0";
+            m_full = true;
+        }
+        return 0;
+    }
+    
+    const quint32 id = quint32(m_strings.size());
+    m_strings.append(text);
+    m_ids.insert(text, id);
+    return id;
+}
+
+quint32 StringInterner::find(const QString& text) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(text, 0);
+}
+
+QString StringInterner::value(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < quint32(m_strings.size()) ? m_strings.at(int(id)) : QString();
+}
+
+int StringInterner::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_strings.size();
+}
+
+StringInterner& StringInterner::texts()
+{
+    static StringInterner instance(TEXT_CAPACITY);
+    return instance;
+}
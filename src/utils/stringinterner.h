@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+#include <limits>
+
+/**
+ * @brief Maps strings to dense 32-bit IDs, process-wide and append-only
+ * 
+ * Lets hot data paths carry and compare a quint32 instead of a QString:
+ * Sample stores text values as IDs from texts(), interned once where they
+ * enter the system and looked up again only for display or storage. (Tag
+ * names have their own dictionary with metadata, TagRegistry.)
+ * IDs are assigned in order starting at 1 and are never reused; ID 0 is
+ * the empty string.
+ * 
+ * Strings are never released, so only intern sets that stay small, such
+ * as the states of text tags ("Auto", "Manual", ...). An interner holds at
+ * most capacity() strings; once full, new strings are not interned and
+ * get ID 0, so free-form text cannot grow it without bound.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * Threading: All methods are thread-safe.
+ * 
+ * Example:
+ * @code
+ * const quint32 automatic = StringInterner::texts().intern("Auto");
+ * if (sample.type == Sample::Type::Text && sample.textId == automatic) { ... }
+ * qDebug() << StringInterner::texts().value(sample.textId);  // "Auto"
+ * @endcode
+ */
+class StringInterner {
+public:
+    static constexpr int TEXT_CAPACITY = 4096;     // Capacity of texts()
+    
+    explicit StringInterner(int capacity = std::numeric_limits<int>::max());
+    
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    
+    /**
+     * @brief Get the ID of a string, assigning the next free ID if it is new
+     * @return The ID, or 0 if the string is new and the interner is full
+     */
+    quint32 intern(const QString& text);
+    
+    /**
+     * @brief Get the ID of a string without interning it
+     * @return The ID, or 0 if the string was never interned
+     */
+    quint32 find(const QString& text) const;
+    
+    /**
+     * @brief Get the string of an ID
+     * @return The string, or an empty string for unknown IDs
+     */
+    QString value(quint32 id) const;
+    
+    /**
+     * @brief Number of IDs handed out (including the empty string)
+     */
+    int size() const;
+    
+    /**
+     * @brief Maximum number of IDs (including the empty string)
+     */
+    int capacity() const { return m_capacity; }
+    
+    /**
+     * @brief Interner for text sample values, holding at most TEXT_CAPACITY strings
+     */
+    static StringInterner& texts();
+
+private:
+    mutable QReadWriteLock m_lock;
+    QHash<QString, quint32> m_ids;
+    QVector<QString> m_strings;     // Indexed by ID
+    const int m_capacity;
+    bool m_full;                    // Warned that new strings are being refused
+};
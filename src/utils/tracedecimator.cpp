@@ -0,0 +1,273 @@
+#include "tracedecimator.h"
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRACEDECIMATOR_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRACEDECIMATOR_NEON
+#endif
+
+namespace {
+
+const double NO_DATA = std::numeric_limits<double>::quiet_NaN();
+const double INF = std::numeric_limits<double>::infinity();
+
+// Writes the minimum and maximum of a run of samples to out in the order
+// they occur, skipping NaN; both NaN if there is no number. out may alias
+// the start of run.
+void extremesInOrder(const double* run, int count, double* out)
+{
+    int minIndex = -1;
+    int maxIndex = -1;
+    for (int i = 0; i < count; ++i) {
+        if (std::isnan(run[i])) {
+            continue;
+        }
+        if (minIndex < 0 || run[i] < run[minIndex]) {
+            minIndex = i;
+        }
+        if (maxIndex < 0 || run[i] > run[maxIndex]) {
+            maxIndex = i;
+        }
+    }
+    if (minIndex < 0) {
+        out[0] = NO_DATA;
+        out[1] = NO_DATA;
+        return;
+    }
+    const double first = run[qMin(minIndex, maxIndex)];
+    const double second = run[qMax(minIndex, maxIndex)];
+    out[0] = first;
+    out[1] = second;
+}
+
+} // namespace
+
+TraceDecimator::Extremes TraceDecimator::extremes(const double* values, int count)
+{
+    double minValue = INF;
+    double maxValue = -INF;
+    int i = 0;
+
+#if defined(TRACEDECIMATOR_SSE2)
+    // minpd/maxpd return the second operand if either is NaN, so with the
+    // sample first a NaN leaves the accumulator as it was. Two accumulator
+    // pairs keep both execution ports busy.
+    __m128d min0 = _mm_set1_pd(INF);
+    __m128d min1 = min0;
+    __m128d max0 = _mm_set1_pd(-INF);
+    __m128d max1 = max0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128d a = _mm_loadu_pd(values + i);
+        const __m128d b = _mm_loadu_pd(values + i + 2);
+        min0 = _mm_min_pd(a, min0);
+        max0 = _mm_max_pd(a, max0);
+        min1 = _mm_min_pd(b, min1);
+        max1 = _mm_max_pd(b, max1);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+    minValue = qMin(lanes[0], lanes[1]);
+    _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+    maxValue = qMax(lanes[0], lanes[1]);
+#elif defined(TRACEDECIMATOR_NEON)
+    // fminnm/fmaxnm return the number when one operand is NaN
+    float64x2_t min0 = vdupq_n_f64(INF);
+    float64x2_t min1 = min0;
+    float64x2_t max0 = vdupq_n_f64(-INF);
+    float64x2_t max1 = max0;
+    for (; i + 4 <= count; i += 4) {
+        const float64x2_t a = vld1q_f64(values + i);
+        const float64x2_t b = vld1q_f64(values + i + 2);
+        min0 = vminnmq_f64(a, min0);
+        max0 = vmaxnmq_f64(a, max0);
+        min1 = vminnmq_f64(b, min1);
+        max1 = vmaxnmq_f64(b, max1);
+    }
+    minValue = vminnmvq_f64(vminnmq_f64(min0, min1));
+    maxValue = vmaxnmvq_f64(vmaxnmq_f64(max0, max1));
+#endif
+
+    // Remainder (or everything without SIMD); comparisons with NaN are false
+    for (; i < count; ++i) {
+        const double value = values[i];
+        if (value < minValue) {
+            minValue = value;
+        }
+        if (value > maxValue) {
+            maxValue = value;
+        }
+    }
+    return {minValue, maxValue};
+}
+
+QVector<QPointF> TraceDecimator::decimate(const double* values, int count, int columns, Mode mode)
+{
+    if (count <= 0 || columns <= 0) {
+        return {};
+    }
+    if (count <= 2 * columns) {
+        // Nothing to reduce
+        QVector<QPointF> points;
+        points.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            points.append(QPointF(i, values[i]));
+        }
+        return points;
+    }
+    return mode == Lttb ? largestTriangles(values, count, 2 * columns)
+                        : minMax(values, count, columns);
+}
+
+QVector<QPointF> TraceDecimator::minMax(const double* values, int count, int columns)
+{
+    QVector<QPointF> points;
+    points.reserve(2 * columns);
+    double previous = NO_DATA;
+    
+    for (int column = 0; column < columns; ++column) {
+        const int begin = int(qint64(column) * count / columns);
+        const int end = int(qint64(column + 1) * count / columns);
+        const Extremes range = extremes(values + begin, end - begin);
+        
+        if (!range.isValid()) {
+            points.append(QPointF(begin, NO_DATA)); // Gap
+        } else if (range.min == range.max) {
+            points.append(QPointF(begin, range.min));
+        } else if (!std::isnan(previous) && std::abs(previous - range.max) < std::abs(previous - range.min)) {
+            // Start the stroke at the end nearer the previous column, so the
+            // connecting segment doesn't cross it
+            points.append(QPointF(begin, range.max));
+            points.append(QPointF(begin, range.min));
+        } else {
+            points.append(QPointF(begin, range.min));
+            points.append(QPointF(begin, range.max));
+        }
+        previous = points.last().y();
+    }
+    return points;
+}
+
+QVector<QPointF> TraceDecimator::largestTriangles(const double* values, int count, int buckets)
+{
+    // First and last sample are kept; the rest is split into buckets - 2
+    // buckets, each represented by the sample forming the largest triangle
+    // with the previous pick and the average of the next bucket. NaN
+    // samples are never picked while the bucket has a number; if the
+    // previous pick or the next bucket has none, the sample farthest from
+    // the other one is taken. A bucket without any number becomes a gap.
+    QVector<QPointF> points;
+    points.reserve(buckets);
+    points.append(QPointF(0, values[0]));
+    
+    const double bucketSize = double(count - 2) / (buckets - 2);
+    int picked = 0;
+    for (int bucket = 0; bucket < buckets - 2; ++bucket) {
+        const int begin = int(bucket * bucketSize) + 1;
+        const int end = int((bucket + 1) * bucketSize) + 1;
+        const int nextEnd = qMin(int((bucket + 2) * bucketSize) + 1, count);
+        
+        double sumX = 0.0;
+        double sumY = 0.0;
+        int valid = 0;
+        for (int i = end; i < nextEnd; ++i) {
+            if (!std::isnan(values[i])) {
+                sumX += i;
+                sumY += values[i];
+                ++valid;
+            }
+        }
+        const bool hasAverage = valid > 0;
+        const double averageX = hasAverage ? sumX / valid : NO_DATA;
+        const double averageY = hasAverage ? sumY / valid : NO_DATA;
+        
+        const double pickedX = picked;
+        const double pickedY = values[picked];
+        const bool hasPicked = !std::isnan(pickedY);
+        int best = begin;
+        double bestArea = -1.0;
+        for (int i = begin; i < end; ++i) {
+            const double value = values[i];
+            if (std::isnan(value)) {
+                continue;
+            }
+            double area = 0.0;
+            if (hasPicked && hasAverage) {
+                // Twice the triangle area
+                area = std::abs((pickedX - averageX) * (value - pickedY)
+                                - (pickedX - i) * (averageY - pickedY));
+            } else if (hasPicked) {
+                area = std::abs(value - pickedY);
+            } else if (hasAverage) {
+                area = std::abs(value - averageY);
+            }
+            if (area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        points.append(QPointF(best, values[best]));
+        picked = best;
+    }
+    
+    points.append(QPointF(count - 1, values[count - 1]));
+    return points;
+}
+
+TraceEnvelope::TraceEnvelope(int maxBuckets)
+{
+    reset(maxBuckets);
+}
+
+void TraceEnvelope::reset(int maxBuckets)
+{
+    // Even, so halving leaves every bucket full
+    m_maxBuckets = qMax(2, maxBuckets & ~1);
+    m_bucketSize = 1;
+    m_samples = 0;
+    m_values.clear();
+}
+
+void TraceEnvelope::append(double value)
+{
+    const int size = m_values.size();
+    if (m_samples % m_bucketSize != 0) {
+        // Fold the sample into the open bucket
+        const double run[3] = {m_values[size - 2], m_values[size - 1], value};
+        extremesInOrder(run, 3, m_values.data() + size - 2);
+    } else {
+        if (size / 2 == m_maxBuckets) {
+            halve();
+        }
+        m_values.append(value);
+        m_values.append(value);
+    }
+    ++m_samples;
+}
+
+void TraceEnvelope::append(const double* values, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        append(values[i]);
+    }
+}
+
+double TraceEnvelope::sampleIndex(int index) const
+{
+    const qint64 first = qint64(index / 2) * m_bucketSize;
+    return index % 2 == 0 ? double(first) : double(qMin<qint64>(first + m_bucketSize, m_samples) - 1);
+}
+
+void TraceEnvelope::halve()
+{
+    // Merge neighbouring buckets: four extremes in time order become two
+    double* data = m_values.data();
+    for (int bucket = 0; bucket < m_maxBuckets / 2; ++bucket) {
+        extremesInOrder(data + 4 * bucket, 4, data + 2 * bucket);
+    }
+    m_values.resize(m_maxBuckets);
+    m_bucketSize *= 2;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Reduces a trend's samples to what a given pixel width can show
+ * 
+ * A trace drawn into N pixel columns never needs more than about 2N
+ * vertices: the samples falling into one column collapse into a
+ * vertical stroke from their minimum to their maximum. decimate() splits
+ * the samples evenly into columns and keeps those extremes (MinMax), or
+ * picks the visually most significant sample per bucket with
+ * Largest-Triangle-Three-Buckets (Lttb), so drawing costs the same for
+ * ten thousand samples as for ten million.
+ * 
+ * The per-column scan runs on SSE2 (x86-64) or NEON (AArch64), both part
+ * of the baseline instruction set, with a scalar fallback elsewhere.
+ * 
+ * Output points have the sample index as x and the value as y. NaN marks
+ * a gap: MinMax emits a NaN point for a column without any valid sample,
+ * and Lttb one for a bucket without any, so the caller can break the
+ * line there.
+ * 
+ * For a history that keeps growing, TraceEnvelope keeps the extremes of
+ * a bounded number of buckets up to date per sample; decimating its
+ * values instead of the samples makes a redraw independent of the
+ * history length.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ * 
+ * Example:
+ * @code
+ * const QVector<QPointF> points = TraceDecimator::decimate(
+ *     history.constData(), history.size(), plotWidthInPixels);
+ * @endcode
+ */
+class TraceDecimator {
+public:
+    enum Mode {
+        MinMax,     // Minimum and maximum per column, keeps every spike
+        Lttb        // One sample per bucket, 2 buckets per column, smoother shape
+    };
+    
+    /**
+     * @brief Smallest and largest value of a run of samples
+     */
+    struct Extremes {
+        double min;
+        double max;
+        
+        bool isValid() const { return min <= max; }
+    };
+    
+    /**
+     * @brief Scan a contiguous array for its extremes, skipping NaN
+     * @return Extremes, invalid (min > max) if no sample is a number
+     */
+    static Extremes extremes(const double* values, int count);
+    
+    /**
+     * @brief Reduce samples to at most about two vertices per column
+     * @param values Samples in time order
+     * @param count Number of samples
+     * @param columns Pixel columns the trace is drawn into
+     * @param mode Decimation algorithm
+     * @return Vertices (x = sample index, y = value); all samples if there
+     *         are no more than two per column
+     */
+    static QVector<QPointF> decimate(const double* values, int count, int columns, Mode mode = MinMax);
+
+private:
+    static QVector<QPointF> minMax(const double* values, int count, int columns);
+    static QVector<QPointF> largestTriangles(const double* values, int count, int buckets);
+};
+
+/**
+ * @brief Running min/max summary of a growing series of samples
+ * 
+ * Samples are grouped into buckets of bucketSize() consecutive samples,
+ * each summarised by its minimum and maximum in the order they occur (or
+ * two NaN if it holds no number). When the buckets would exceed the
+ * limit, neighbours are merged and the bucket size doubles, so append()
+ * is amortised O(1) and the summary never exceeds 2 * maxBuckets values.
+ * 
+ * values() can be passed to TraceDecimator::decimate() in place of the
+ * samples; sampleIndex() maps an x of its output back to a sample index.
+ * With four buckets per pixel column a bucket spans at most half a
+ * column, so no spike is lost and none moves by more than that.
+ * 
+ * Pattern: Utility (pure C++, no QObject)
+ * Location: src/utils/
+ */
+class TraceEnvelope {
+public:
+    explicit TraceEnvelope(int maxBuckets = 4096);
+    
+    /**
+     * @brief Drop all samples and set the bucket limit
+     */
+    void reset(int maxBuckets);
+    
+    void append(double value);
+    void append(const double* values, int count);
+    
+    // Two values per bucket, earlier extreme first
+    const double* values() const { return m_values.constData(); }
+    int size() const { return m_values.size(); }
+    
+    int sampleCount() const { return m_samples; }
+    int bucketSize() const { return m_bucketSize; }
+    
+    /**
+     * @brief Sample index for a position in values()
+     * @return First sample of the bucket for its first value, last sample
+     *         for its second
+     */
+    double sampleIndex(int index) const;
+
+private:
+    void halve();
+    
+    QVector<double> m_values;
+    int m_maxBuckets = 2;
+    int m_bucketSize = 1;       // Samples per bucket, a power of two
+    int m_samples = 0;
+};
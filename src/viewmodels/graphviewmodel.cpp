@@ -1,22 +1,26 @@
 #include "graphviewmodel.h"
 #include "../services/modbusservice.h"
 #include <QDebug>
+#include <QMetaMethod>
 
 GraphViewModel::GraphViewModel(ModbusService* modbusService, QObject* parent)
     : QObject(parent)
     , m_modbusService(modbusService)
     , m_currentEegValue(0.0)
-    , m_lastDataPoint()
+    , m_lastSample()
     , m_isPolling(false)
+    , m_eegTagId(0)
 {
     if (!m_modbusService) {
         qWarning() << "GraphViewModel: modbusService is nullptr!";
         return;
     }
     
+    m_eegTagId = m_modbusService->mapTag("EEG", EEG_REGISTER);
+    
     // Connect to Modbus service signals
-    connect(m_modbusService, &ModbusService::dataReady,
-            this, &GraphViewModel::onDataSourceDataReady);
+    connect(m_modbusService, &ModbusService::sampleReady,
+            this, &GraphViewModel::onDataSourceSampleReady);
     connect(m_modbusService, &ModbusService::errorOccurred,
             this, &GraphViewModel::onDataSourceError);
     connect(m_modbusService, &ModbusService::connectionStateChanged,
@@ -47,22 +51,23 @@ bool GraphViewModel::isPolling() const {
     return m_isPolling;
 }
 
-void GraphViewModel::onDataSourceDataReady(const QString& tag, const QVariant& value) {
+void GraphViewModel::onDataSourceSampleReady(const Sample& sample) {
     // Check if this is EEG data (could be expanded to handle other tags)
-    if (tag == "EEG" || tag == "25") {  // Tag "25" is the Modbus address
+    if (sample.tagId == m_eegTagId) {
         // Get raw value and scale it
-        uint16_t rawValue = value.toUInt();
+        uint16_t rawValue = static_cast<uint16_t>(sample.toDouble());
         double scaledValue = scaleEegValue(rawValue);
         
         // Update current value
         m_currentEegValue = scaledValue;
-        
-        // Create data point
-        m_lastDataPoint = DataPoint(tag, scaledValue);
+        m_lastSample = Sample::ofDouble(sample.tagId, sample.timestampNs, scaledValue, sample.dataQuality());
         
         // Emit signals
         emit eegDataUpdated(scaledValue);
-        emit dataPointReceived(m_lastDataPoint);
+        emit sampleReceived(m_lastSample);
+        if (isSignalConnected(QMetaMethod::fromSignal(&GraphViewModel::dataPointReceived))) {
+            emit dataPointReceived(m_lastSample.toDataPoint());
+        }
         
         qDebug() << "GraphViewModel: EEG data updated -" 
                  << "Raw:" << rawValue 
@@ -3,6 +3,7 @@
 #include <QObject>
 #include <QTimer>
 #include "../models/datapoint.h"
+#include "../models/sample.h"
 
 // Forward declaration
 class ModbusService;
@@ -19,6 +20,11 @@ class ModbusService;
  * Pattern: MVVM (Model-View-ViewModel) - RULE-200
  * Location: src/viewmodels/ (RULE-301)
  * 
+ * Values arrive as compact Samples (ModbusService::sampleReady()) and are
+ * matched by TagRegistry ID, so the polling path neither allocates nor
+ * compares strings. DataPoints are only built for dataPointReceived()
+ * listeners.
+ * 
  * The View (GraphsPage) connects to this ViewModel's signals for UI updates.
  * This separation allows testing without UI and reusing logic across platforms.
  */
@@ -26,6 +32,11 @@ class GraphViewModel : public QObject {
     Q_OBJECT
     
 public:
+    /**
+     * @brief Input register holding the raw EEG value
+     */
+    static constexpr int EEG_REGISTER = 25;
+    
     explicit GraphViewModel(ModbusService* modbusService, QObject* parent = nullptr);
     ~GraphViewModel() override;
     
@@ -53,7 +64,12 @@ public:
     /**
      * @brief Get the last data point
      */
-    DataPoint lastDataPoint() const { return m_lastDataPoint; }
+    DataPoint lastDataPoint() const { return m_lastSample.toDataPoint(); }
+    
+    /**
+     * @brief Get the last sample (scaled value)
+     */
+    Sample lastSample() const { return m_lastSample; }
 
 signals:
     /**
@@ -68,6 +84,12 @@ signals:
      */
     void dataPointReceived(const DataPoint& dataPoint);
     
+    /**
+     * @brief Emitted when a new sample is available (same data as dataPointReceived())
+     * @param sample The scaled sample
+     */
+    void sampleReceived(const Sample& sample);
+    
     /**
      * @brief Emitted when an error occurs
      * @param error Error message describing what went wrong
@@ -81,7 +103,7 @@ signals:
     void connectionStateChanged(bool connected);
 
 private slots:
-    void onDataSourceDataReady(const QString& tag, const QVariant& value);
+    void onDataSourceSampleReady(const Sample& sample);
     void onDataSourceError(const QString& error);
     void onDataSourceConnectionChanged(bool connected);
 
@@ -93,6 +115,7 @@ private:
     
     ModbusService* m_modbusService;
     double m_currentEegValue;
-    DataPoint m_lastDataPoint;
+    Sample m_lastSample;
     bool m_isPolling;
+    quint32 m_eegTagId;         // TagRegistry ID of "EEG"
 };
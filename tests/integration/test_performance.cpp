@@ -0,0 +1,826 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include "../src/models/sample.h"
+#include "../src/repositories/circularbufferrepository.h"
+#include "../src/repositories/sqliterepository.h"
+#include "../src/repositories/timeseriesrepository.h"
+#include "../src/services/controllerxmlservice.h"
+#include "../src/models/controllerpagemodel.h"
+#include "../src/utils/calcexpression.h"
+#include "../src/utils/tracedecimator.h"
+#include "../src/ui/thememanager.h"
+#include "../src/ui/themestyle.h"
+#include "../src/graphwidget.h"
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QLoggingCategory>
+#include <QVBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+
+namespace {
+
+// Counts C++ heap allocations (operator new) of the whole test process.
+// QString/QByteArray data is allocated with malloc and not counted, so
+// the DataPoint figures below are lower bounds.
+std::atomic<qint64> g_allocations(0);
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    ++g_allocations;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/**
+ * @brief Performance tests for the sample data pipeline
+ * 
+ * Compares DataPoint with its compact form Sample along the acquisition
+ * path (ring buffer) and the historian read path, by time (QBENCHMARK)
+ * and by heap allocations per sample, and measures the decode throughput
+ * of the compressed time-series engine into either form. Also compares a full parse of a
+ * controller XML page with a value-only refresh of a cached layout,
+ * compiled calc expressions with matching them by regular expression, and
+ * theming pages with stylesheets with drawing them through ThemeStyle
+ * (page construction and theme toggle, including the repaint), and
+ * repainting a trend graph from scratch with the strip a sample dirties,
+ * and decimating long trend histories to the pixel columns of the graph.
+ */
+class TestPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testSampleConversion();
+    void testAllocationsPerSample();
+    
+    void benchmarkRingSaveDataPoint();
+    void benchmarkRingSaveSample();
+    void benchmarkHistorianReadDataPoints();
+    void benchmarkHistorianReadSamples();
+    void benchmarkTimeSeriesDecodeDataPoints();
+    void benchmarkTimeSeriesDecodeSamples();
+
+    void testXmlRefreshAllocations();
+    void benchmarkXmlFullParse();
+    void benchmarkXmlValueRefresh();
+    void benchmarkPageModelBuild();
+    void benchmarkPageModelRefresh();
+    void benchmarkCalcRegex();
+    void benchmarkCalcCompiled();
+    void benchmarkPageStyleSheets();
+    void benchmarkPageThemeStyle();
+    void benchmarkThemeToggleStyleSheets();
+    void benchmarkThemeTogglePalette();
+    void testGraphIncrementalTrace();
+    void benchmarkGraphFullRepaint();
+    void benchmarkGraphSampleRepaint();
+    void testTraceDecimation();
+    void testTraceEnvelope();
+    void benchmarkDecimateMinMax();
+    void benchmarkDecimateLttb();
+    void benchmarkGraphHistoryRepaint_data();
+    void benchmarkGraphHistoryRepaint();
+    void benchmarkGraphHistorySample();
+
+private:
+    void fillHistorian(SqliteRepository& repo);
+    void fillTimeSeries(TimeSeriesRepository& repo);
+    static QByteArray makeXmlPage(int generation);
+    static ThemeManager* prepareTheme();
+    static void toggleTheme();
+    static QWidget* buildThemedPage(bool styleSheets);
+    static void applyStyleSheets(QWidget* page);
+    static qreal graphSample(int index);
+    static QVector<double> graphHistory(int count);
+    
+    static constexpr int SAMPLES = 10000;
+    static constexpr int HISTORIAN_SAMPLES = 20000;
+    static constexpr int TIMESERIES_SAMPLES = 100 * TimeSeriesRepository::SAMPLES_PER_CHUNK;
+    static constexpr int XML_FIELDS = 500;
+    static constexpr int THEMED_ROWS = 50;
+    static constexpr int HISTORY_SAMPLES = 1000000;
+    static constexpr int GRAPH_COLUMNS = 800;
+    
+    QTemporaryDir *m_tempDir;
+    qint64 m_baseMs;
+};
+
+void TestPerformance::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+    m_baseMs = 1700000000000;
+}
+
+void TestPerformance::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+    QLoggingCategory::setFilterRules(QString());
+}
+
+void TestPerformance::fillHistorian(SqliteRepository& repo)
+{
+    QList<DataPoint> points;
+    for (int i = 0; i < HISTORIAN_SAMPLES; ++i) {
+        points.append(DataPoint("Flow", 50.0 + (i % 100) * 0.5, QDateTime::fromMSecsSinceEpoch(m_baseMs + i * 1000LL)));
+    }
+    QVERIFY(repo.saveAll(points).isSuccess());
+}
+
+void TestPerformance::fillTimeSeries(TimeSeriesRepository& repo)
+{
+    for (int i = 0; i < TIMESERIES_SAMPLES; ++i) {
+        const double value = std::round((50.0 + 10.0 * std::sin(i / 600.0)) * 10.0) / 10.0;
+        QVERIFY(repo.save(DataPoint("Flow", value, QDateTime::fromMSecsSinceEpoch(m_baseMs + i * 1000LL))).isSuccess());
+    }
+    QVERIFY(repo.flush().isSuccess());
+}
+
+QByteArray TestPerformance::makeXmlPage(int generation)
+{
+    // One in ten values moves between generations, like a live process page
+    QByteArray xml = "<unit_page version=\"1\"><hdr title=\"unit\"/><frm type=\"cnt\">";
+    for (int i = 0; i < XML_FIELDS; ++i) {
+        if (i % 50 == 0) {
+            xml += i ? "</col><col title=\"Group\">" : "<col title=\"Group\">";
+        }
+        const int value = i % 10 == 0 ? i + generation : i;
+        xml += QString("<val id=\"f%1\" label=\"Field %1\" var=\"v%1\" unit=\"bar\" calc=\"val/10\" "
+                       "optds=\"Off,On\" optdv=\"0,1\">%2</val>").arg(i).arg(value).toUtf8();
+    }
+    xml += "</col></frm></unit_page>";
+    return xml;
+}
+
+void TestPerformance::testSampleConversion()
+{
+    QCOMPARE(sizeof(Sample), size_t(24));
+    
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(m_baseMs + 123);
+    const QList<DataPoint> points = {
+        DataPoint("Flow", 42.5, time),
+        DataPoint("Count", qint64(1) << 40, time, DataPoint::Quality::Uncertain),
+        DataPoint("Running", true, time),
+        DataPoint("Mode", QString("Auto"), time, DataPoint::Quality::Stale)
+    };
+    
+    for (const DataPoint& point : points) {
+        const Sample sample = Sample::fromDataPoint(point);
+        QCOMPARE(sample.tagId, TagRegistry::instance().find(point.tag()));
+        QCOMPARE(sample.timestampNs, (m_baseMs + 123) * Sample::NSECS_PER_MSEC);
+        
+        const DataPoint back = sample.toDataPoint();
+        QCOMPARE(back.tag(), point.tag());
+        QCOMPARE(back.timestamp(), point.timestamp());
+        QCOMPARE(back.quality(), point.quality());
+        QCOMPARE(back.value(), point.value());
+    }
+    
+    QCOMPARE(Sample::fromDataPoint(points.at(1)).type, Sample::Type::Int);
+    QCOMPARE(Sample::fromDataPoint(points.at(3)).type, Sample::Type::Text);
+    QCOMPARE(Sample::fromDataPoint(points.at(2)).toDouble(), 1.0);
+    
+    // A full interner refuses new strings instead of growing
+    StringInterner interner(3);
+    QCOMPARE(interner.intern("Auto"), quint32(1));
+    QCOMPARE(interner.intern("Manual"), quint32(2));
+    QCOMPARE(interner.intern("Fault 17 at 12:00"), quint32(0));
+    QCOMPARE(interner.intern("Auto"), quint32(1));
+    QCOMPARE(interner.size(), 3);
+    
+    // The ring keeps DataPoint values as given, without interning free-form text
+    CircularBufferRepository ring(4);
+    const int interned = StringInterner::texts().size();
+    QVERIFY(ring.save(DataPoint("Count", 7, time)).isSuccess());
+    QVERIFY(ring.save(DataPoint("Message", QString("Valve 3 opened by operator"), time)).isSuccess());
+    QVERIFY(ring.save(DataPoint("Spare", QVariant(), time)).isSuccess());
+    QCOMPARE(StringInterner::texts().size(), interned);
+    
+    const QList<DataPoint> stored = ring.findAll().value();
+    QCOMPARE(stored.at(0).value().userType(), int(QMetaType::Int));
+    QCOMPARE(stored.at(1).value().toString(), QString("Valve 3 opened by operator"));
+    QVERIFY(!stored.at(2).value().isValid());
+    QCOMPARE(ring.recentSamples(3).last().integer, qint64(7));
+}
+
+void TestPerformance::testAllocationsPerSample()
+{
+    const quint32 flow = TagRegistry::instance().intern("Flow");
+    CircularBufferRepository ring(SAMPLES);
+    
+    // Ring of samples: fill and wrap once, no allocation per sample
+    qint64 before = g_allocations;
+    for (int i = 0; i < 2 * SAMPLES; ++i) {
+        QVERIFY(ring.saveSample(Sample::ofDouble(flow, (m_baseMs + i) * Sample::NSECS_PER_MSEC, i)).isSuccess());
+    }
+    const qint64 sampleAllocations = g_allocations - before;
+    
+    // The same values as DataPoints in a pre-sized list
+    QList<DataPoint> points;
+    points.reserve(SAMPLES);
+    before = g_allocations;
+    for (int i = 0; i < SAMPLES; ++i) {
+        points.append(DataPoint("Flow", double(i), QDateTime::fromMSecsSinceEpoch(m_baseMs + i)));
+    }
+    const qint64 dataPointAllocations = g_allocations - before;
+    
+    qDebug() << "Allocations per sample - Sample ring:" << double(sampleAllocations) / (2 * SAMPLES)
+             << "DataPoint list:" << double(dataPointAllocations) / SAMPLES;
+    
+    QCOMPARE(sampleAllocations, qint64(0));
+    QVERIFY(dataPointAllocations >= SAMPLES);
+    QCOMPARE(ring.samplesByTag(flow, 0, std::numeric_limits<qint64>::max()).size(), SAMPLES);
+}
+
+void TestPerformance::benchmarkRingSaveDataPoint()
+{
+    CircularBufferRepository ring(SAMPLES);
+    
+    QBENCHMARK {
+        for (int i = 0; i < SAMPLES; ++i) {
+            ring.save(DataPoint("Flow", double(i), QDateTime::fromMSecsSinceEpoch(m_baseMs + i)));
+        }
+    }
+}
+
+void TestPerformance::benchmarkRingSaveSample()
+{
+    CircularBufferRepository ring(SAMPLES);
+    const quint32 flow = TagRegistry::instance().intern("Flow");
+    
+    QBENCHMARK {
+        for (int i = 0; i < SAMPLES; ++i) {
+            ring.saveSample(Sample::ofDouble(flow, (m_baseMs + i) * Sample::NSECS_PER_MSEC, i));
+        }
+    }
+}
+
+void TestPerformance::benchmarkHistorianReadDataPoints()
+{
+    SqliteRepository repo(m_tempDir->filePath("datapoints.db"));
+    fillHistorian(repo);
+    
+    const qint64 before = g_allocations;
+    QCOMPARE(repo.findByTag("Flow").value().size(), HISTORIAN_SAMPLES);
+    qDebug() << "DataPoint read: allocations per row" << double(g_allocations - before) / HISTORIAN_SAMPLES;
+    
+    QBENCHMARK {
+        repo.findByTag("Flow");
+    }
+}
+
+void TestPerformance::benchmarkHistorianReadSamples()
+{
+    SqliteRepository repo(m_tempDir->filePath("datapoints.db"));
+    fillHistorian(repo);
+    
+    const qint64 before = g_allocations;
+    QCOMPARE(repo.findSamples("Flow").value().size(), HISTORIAN_SAMPLES);
+    qDebug() << "Sample read: allocations per row" << double(g_allocations - before) / HISTORIAN_SAMPLES;
+    
+    QBENCHMARK {
+        repo.findSamples("Flow");
+    }
+}
+
+void TestPerformance::benchmarkTimeSeriesDecodeDataPoints()
+{
+    TimeSeriesRepository repo(m_tempDir->filePath("timeseries"));
+    fillTimeSeries(repo);
+    
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(repo.findByTag("Flow").value().size(), TIMESERIES_SAMPLES);
+    qDebug() << "Time-series decode to DataPoint:" << TIMESERIES_SAMPLES * 1000.0 / qMax<qint64>(timer.elapsed(), 1)
+             << "samples/s";
+    
+    QBENCHMARK {
+        repo.findByTag("Flow");
+    }
+}
+
+void TestPerformance::benchmarkTimeSeriesDecodeSamples()
+{
+    TimeSeriesRepository repo(m_tempDir->filePath("timeseries"));
+    fillTimeSeries(repo);
+    
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(repo.findSamples("Flow").value().size(), TIMESERIES_SAMPLES);
+    qDebug() << "Time-series decode to Sample:" << TIMESERIES_SAMPLES * 1000.0 / qMax<qint64>(timer.elapsed(), 1)
+             << "samples/s";
+    
+    QBENCHMARK {
+        repo.findSamples("Flow");
+    }
+}
+
+void TestPerformance::testXmlRefreshAllocations()
+{
+    const QByteArray first = makeXmlPage(0);
+    const QByteArray second = makeXmlPage(1);
+    
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    
+    qint64 before = g_allocations;
+    service.processXmlData(first);
+    const qint64 parseAllocations = g_allocations - before;
+    
+    before = g_allocations;
+    service.processXmlData(second);
+    const qint64 refreshAllocations = g_allocations - before;
+    
+    qDebug() << "XML page of" << XML_FIELDS << "fields - allocations for full parse:" << parseAllocations
+             << "value-only refresh:" << refreshAllocations;
+    
+    QCOMPARE(service.getStatistics().fullParses, 1);
+    QCOMPARE(service.getStatistics().valueRefreshes, 1);
+    QCOMPARE(service.getCurrentPage().forms[0].columns[0].fields[10].value.toDouble(), 1.1);
+    QVERIFY(refreshAllocations * 10 <= parseAllocations);
+}
+
+void TestPerformance::benchmarkXmlFullParse()
+{
+    const QByteArray page = makeXmlPage(0);
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    
+    // Every document parsed as if its layout were new (includes caching it)
+    QBENCHMARK {
+        service.clearLayoutCache();
+        service.processXmlData(page);
+    }
+}
+
+void TestPerformance::benchmarkXmlValueRefresh()
+{
+    const QByteArray pages[] = { makeXmlPage(0), makeXmlPage(1) };
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(pages[0]);
+    
+    int generation = 0;
+    QBENCHMARK {
+        service.processXmlData(pages[++generation % 2]);
+    }
+}
+
+void TestPerformance::benchmarkPageModelBuild()
+{
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(makeXmlPage(0));
+    ControllerPageModel model;
+    
+    // What opening a page costs before anything is painted
+    QBENCHMARK {
+        model.setPage(service.getCurrentPage());
+    }
+    QCOMPARE(model.rowForField("f0"), 1);
+}
+
+void TestPerformance::benchmarkPageModelRefresh()
+{
+    const QByteArray pages[] = { makeXmlPage(0), makeXmlPage(1) };
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(pages[0]);
+    ControllerPageModel model;
+    model.setPage(service.getCurrentPage());
+    connect(&service, &ControllerXmlService::xmlValuesChanged, &model, &ControllerPageModel::updateValues);
+    
+    int generation = 0;
+    QBENCHMARK {
+        service.processXmlData(pages[++generation % 2]);
+    }
+}
+
+void TestPerformance::benchmarkCalcRegex()
+{
+    // How field values were calculated before: a regex per value,
+    // understanding only "val/N"
+    QVector<double> values(XML_FIELDS);
+    for (int i = 0; i < XML_FIELDS; ++i) {
+        values[i] = i;
+    }
+    QVector<double> results(XML_FIELDS);
+    const QString calc = "val/10";
+    
+    QBENCHMARK {
+        for (int i = 0; i < XML_FIELDS; ++i) {
+            QRegularExpression divRegex(R"(val/(\d+))");
+            QRegularExpressionMatch divMatch = divRegex.match(calc);
+            if (divMatch.hasMatch()) {
+                results[i] = values[i] / divMatch.captured(1).toDouble();
+            }
+        }
+    }
+}
+
+void TestPerformance::benchmarkCalcCompiled()
+{
+    QVector<double> values(XML_FIELDS);
+    for (int i = 0; i < XML_FIELDS; ++i) {
+        values[i] = i;
+    }
+    QVector<double> results(XML_FIELDS);
+    const CalcExpression program = CalcExpression::compile("val/10").value();
+    QCOMPARE(program.evaluate(235.0), 23.5);
+    
+    QBENCHMARK {
+        program.evaluate(values.constData(), results.data(), XML_FIELDS);
+    }
+}
+
+ThemeManager* TestPerformance::prepareTheme()
+{
+    // Keep the theme setting out of the user's configuration and the
+    // theme change log line out of the benchmark output
+    QStandardPaths::setTestModeEnabled(true);
+    QLoggingCategory::setFilterRules("default.debug=false");
+    ThemeManager* tm = ThemeManager::instance();
+    tm->applyToApplication();
+    return tm;
+}
+
+void TestPerformance::toggleTheme()
+{
+    ThemeManager* tm = ThemeManager::instance();
+    tm->setTheme(tm->currentTheme() == ThemeManager::Light ? ThemeManager::Dark : ThemeManager::Light);
+}
+
+QWidget* TestPerformance::buildThemedPage(bool styleSheets)
+{
+    // Titles, buttons and info panels like UdpResponsePage, many times over
+    QWidget* page = new QWidget;
+    QVBoxLayout* layout = new QVBoxLayout(page);
+    for (int i = 0; i < THEMED_ROWS; ++i) {
+        QLabel* title = new QLabel(QString("Controller %1").arg(i));
+        title->setObjectName("title");
+        QPushButton* button = new QPushButton("Connect");
+        button->setObjectName("primary");
+        QLabel* info = new QLabel("Protocol version = 1.00;FB type = EPIC4;Status = Running");
+        info->setObjectName("panel");
+        if (!styleSheets) {
+            ThemeStyle::setVariant(title, ThemeStyle::Title);
+            ThemeStyle::setVariant(button, ThemeStyle::PrimaryButton);
+            info->setMargin(16);
+            ThemeStyle::setVariant(info, ThemeStyle::Panel);
+        }
+        layout->addWidget(title);
+        layout->addWidget(button);
+        layout->addWidget(info);
+    }
+    if (styleSheets) {
+        applyStyleSheets(page);
+    }
+    page->resize(800, THEMED_ROWS * 120);
+    page->ensurePolished();
+    return page;
+}
+
+void TestPerformance::applyStyleSheets(QWidget* page)
+{
+    // How pages were themed before: a stylesheet per widget, rebuilt from
+    // the theme colors whenever the theme changed
+    ThemeManager* tm = ThemeManager::instance();
+    const QString titleStyle = QString("QLabel { font-size: 22px; font-weight: bold; color: %1; }")
+        .arg(tm->colorString(ThemeManager::AccentText));
+    const QString buttonStyle = QString("QPushButton { background: %1; color: white; border: none; border-radius: 8px; "
+                                        "padding: 8px 16px; font-weight: bold; } "
+                                        "QPushButton:hover { background: %2; } QPushButton:pressed { background: %3; }")
+        .arg(tm->colorString(ThemeManager::Primary), tm->colorString(ThemeManager::ButtonHover),
+             tm->colorString(ThemeManager::ButtonPressed));
+    const QString panelStyle = QString("QLabel { background: %1; border-radius: 12px; padding: 16px; }")
+        .arg(tm->colorString(ThemeManager::SecondaryBackground));
+    
+    for (QWidget* widget : page->findChildren<QWidget*>()) {
+        const QString name = widget->objectName();
+        if (name == "title") {
+            widget->setStyleSheet(titleStyle);
+        } else if (name == "primary") {
+            widget->setStyleSheet(buttonStyle);
+        } else if (name == "panel") {
+            widget->setStyleSheet(panelStyle);
+        }
+    }
+}
+
+void TestPerformance::benchmarkPageStyleSheets()
+{
+    prepareTheme();
+    QBENCHMARK {
+        delete buildThemedPage(true);
+    }
+}
+
+void TestPerformance::benchmarkPageThemeStyle()
+{
+    prepareTheme();
+    QBENCHMARK {
+        delete buildThemedPage(false);
+    }
+}
+
+void TestPerformance::benchmarkThemeToggleStyleSheets()
+{
+    prepareTheme();
+    QScopedPointer<QWidget> page(buildThemedPage(true));
+    
+    // Theme change, re-styling and the repaint it causes
+    QBENCHMARK {
+        toggleTheme();
+        applyStyleSheets(page.data());
+        page->grab();
+    }
+}
+
+void TestPerformance::benchmarkThemeTogglePalette()
+{
+    ThemeManager* tm = prepareTheme();
+    QScopedPointer<QWidget> page(buildThemedPage(false));
+    
+    // Theme change (a palette swap) and the repaint it causes
+    QBENCHMARK {
+        toggleTheme();
+        page->grab();
+    }
+    
+    QCOMPARE(page->palette().color(QPalette::Window), tm->color(ThemeManager::MainBackground));
+    QCOMPARE(page->findChild<QLabel*>("title")->font().pixelSize(), 22);
+    QVERIFY(page->styleSheet().isEmpty());
+}
+
+qreal TestPerformance::graphSample(int index)
+{
+    return 50.0 + 40.0 * std::sin(index * 0.3);
+}
+
+void TestPerformance::testGraphIncrementalTrace()
+{
+    GraphWidget graph("Trend", GraphWidget::SineWave);
+    graph.resize(800, 400);
+    QImage incremental(graph.size(), QImage::Format_ARGB32_Premultiplied);
+    graph.render(&incremental); // Builds the layers
+    
+    // Wrap the sweep more than once, each sample drawn into the trace layer
+    for (int i = 0; i < 100; ++i) {
+        graph.addDataPoint(graphSample(i));
+    }
+    graph.render(&incremental);
+    
+    // Same picture as drawing every layer again
+    graph.setRange(0, 100);
+    QImage full(graph.size(), QImage::Format_ARGB32_Premultiplied);
+    graph.render(&full);
+    QCOMPARE(incremental, full);
+}
+
+void TestPerformance::benchmarkGraphFullRepaint()
+{
+    GraphWidget graph("Trend", GraphWidget::SineWave);
+    graph.resize(800, 400);
+    for (int i = 0; i < 100; ++i) {
+        graph.addDataPoint(graphSample(i));
+    }
+    QImage target(graph.size(), QImage::Format_ARGB32_Premultiplied);
+    
+    // What every sample cost before: grid, hexagons, axis and trace drawn again
+    QBENCHMARK {
+        graph.setRange(0, 100);
+        graph.render(&target);
+    }
+}
+
+void TestPerformance::benchmarkGraphSampleRepaint()
+{
+    GraphWidget graph("Trend", GraphWidget::SineWave);
+    graph.resize(800, 400);
+    graph.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&graph));
+    
+    // A new sample and the repaint of the strip it dirties
+    int index = 0;
+    QBENCHMARK {
+        graph.addDataPoint(graphSample(++index));
+        QCoreApplication::processEvents();
+    }
+}
+
+QVector<double> TestPerformance::graphHistory(int count)
+{
+    // Slow wave with fast ripple, so every column has a real min/max
+    QVector<double> history(count);
+    for (int i = 0; i < count; ++i) {
+        history[i] = 50.0 + 30.0 * std::sin(i * 6.0 / count) + 10.0 * std::sin(i * 0.7);
+    }
+    return history;
+}
+
+void TestPerformance::testTraceDecimation()
+{
+    // SIMD extremes against a plain loop, any length, NaN skipped
+    QVector<double> values = graphHistory(37);
+    values[5] = std::numeric_limits<double>::quiet_NaN();
+    values[36] = std::numeric_limits<double>::quiet_NaN();
+    for (int count = 1; count <= values.size(); ++count) {
+        double minValue = std::numeric_limits<double>::infinity();
+        double maxValue = -minValue;
+        for (int i = 0; i < count; ++i) {
+            if (!std::isnan(values[i])) {
+                minValue = qMin(minValue, values[i]);
+                maxValue = qMax(maxValue, values[i]);
+            }
+        }
+        const TraceDecimator::Extremes range = TraceDecimator::extremes(values.constData(), count);
+        QCOMPARE(range.min, minValue);
+        QCOMPARE(range.max, maxValue);
+    }
+    QVERIFY(!TraceDecimator::extremes(values.constData() + 36, 1).isValid());
+    QVERIFY(!TraceDecimator::extremes(values.constData(), 0).isValid());
+    
+    // Few samples are passed through
+    QCOMPARE(TraceDecimator::decimate(values.constData(), 10, 5).size(), 10);
+    
+    // At most two vertices per column, each column's extremes kept
+    QVector<double> history = graphHistory(HISTORY_SAMPLES);
+    for (int i = 400000; i < 420000; ++i) {
+        history[i] = std::numeric_limits<double>::quiet_NaN(); // Gap of 16 columns
+    }
+    const QVector<QPointF> points = TraceDecimator::decimate(history.constData(), HISTORY_SAMPLES, GRAPH_COLUMNS);
+    QVERIFY(points.size() <= 2 * GRAPH_COLUMNS);
+    int gaps = 0;
+    for (const QPointF& point : points) {
+        gaps += std::isnan(point.y()) ? 1 : 0;
+    }
+    QCOMPARE(gaps, 16);
+    const TraceDecimator::Extremes all = TraceDecimator::extremes(history.constData(), HISTORY_SAMPLES);
+    double minShown = all.max;
+    double maxShown = all.min;
+    for (const QPointF& point : points) {
+        if (!std::isnan(point.y())) {
+            minShown = qMin(minShown, point.y());
+            maxShown = qMax(maxShown, point.y());
+        }
+    }
+    QCOMPARE(minShown, all.min);
+    QCOMPARE(maxShown, all.max);
+    
+    // LTTB: two samples per column, first and last kept, in time order
+    const QVector<QPointF> lttb = TraceDecimator::decimate(history.constData(), HISTORY_SAMPLES,
+                                                           GRAPH_COLUMNS, TraceDecimator::Lttb);
+    QCOMPARE(lttb.size(), 2 * GRAPH_COLUMNS);
+    QCOMPARE(lttb.first().x(), 0.0);
+    QCOMPARE(lttb.last().x(), double(HISTORY_SAMPLES - 1));
+    for (int i = 1; i < lttb.size(); ++i) {
+        QVERIFY(lttb[i].x() > lttb[i - 1].x());
+    }
+    
+    // LTTB never picks NaN while a bucket has a number, also next to a gap
+    QVector<double> sparse = graphHistory(1000);
+    for (int i = 0; i < 900; ++i) {
+        if (i % 2 == 1 || (i >= 500 && i < 600)) {
+            sparse[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+    for (const QPointF& point : TraceDecimator::decimate(sparse.constData(), 1000, 50, TraceDecimator::Lttb)) {
+        QVERIFY(!std::isnan(point.y()) || (point.x() >= 500 && point.x() < 600));
+    }
+}
+
+void TestPerformance::testTraceEnvelope()
+{
+    QVector<double> history = graphHistory(HISTORY_SAMPLES);
+    for (int i = 400000; i < 420000; ++i) {
+        history[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    
+    // Bounded, whatever the number of samples
+    TraceEnvelope envelope(4 * GRAPH_COLUMNS);
+    for (int i = 0; i < HISTORY_SAMPLES; ++i) {
+        envelope.append(history[i]);
+    }
+    QCOMPARE(envelope.sampleCount(), HISTORY_SAMPLES);
+    QVERIFY(envelope.size() <= 8 * GRAPH_COLUMNS);
+    QVERIFY(envelope.size() > 4 * GRAPH_COLUMNS);
+    QCOMPARE(envelope.sampleIndex(0), 0.0);
+    QCOMPARE(envelope.sampleIndex(envelope.size() - 1), double(HISTORY_SAMPLES - 1));
+    
+    // Every bucket holds the extremes of its samples, in time order
+    for (int index = 0; index < envelope.size(); index += 2) {
+        const int first = int(envelope.sampleIndex(index));
+        const int last = int(envelope.sampleIndex(index + 1));
+        QCOMPARE(last - first + 1, qMin(envelope.bucketSize(), HISTORY_SAMPLES - first));
+        const TraceDecimator::Extremes range = TraceDecimator::extremes(history.constData() + first,
+                                                                        last - first + 1);
+        if (!range.isValid()) {
+            QVERIFY(std::isnan(envelope.values()[index]) && std::isnan(envelope.values()[index + 1]));
+            continue;
+        }
+        const double a = envelope.values()[index];
+        const double b = envelope.values()[index + 1];
+        QCOMPARE(qMin(a, b), range.min);
+        QCOMPARE(qMax(a, b), range.max);
+    }
+    
+    // Decimating the envelope keeps the overall extremes and the gap
+    const QVector<QPointF> points = TraceDecimator::decimate(envelope.values(), envelope.size(), GRAPH_COLUMNS);
+    const TraceDecimator::Extremes all = TraceDecimator::extremes(history.constData(), HISTORY_SAMPLES);
+    double minShown = all.max;
+    double maxShown = all.min;
+    int gaps = 0;
+    for (const QPointF& point : points) {
+        if (std::isnan(point.y())) {
+            ++gaps;
+        } else {
+            minShown = qMin(minShown, point.y());
+            maxShown = qMax(maxShown, point.y());
+        }
+    }
+    QCOMPARE(minShown, all.min);
+    QCOMPARE(maxShown, all.max);
+    QVERIFY(gaps >= 14);
+}
+
+void TestPerformance::benchmarkDecimateMinMax()
+{
+    const QVector<double> history = graphHistory(HISTORY_SAMPLES);
+    QBENCHMARK {
+        TraceDecimator::decimate(history.constData(), HISTORY_SAMPLES, GRAPH_COLUMNS);
+    }
+}
+
+void TestPerformance::benchmarkDecimateLttb()
+{
+    const QVector<double> history = graphHistory(HISTORY_SAMPLES);
+    QBENCHMARK {
+        TraceDecimator::decimate(history.constData(), HISTORY_SAMPLES, GRAPH_COLUMNS, TraceDecimator::Lttb);
+    }
+}
+
+void TestPerformance::benchmarkGraphHistoryRepaint_data()
+{
+    QTest::addColumn<int>("samples");
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("1M") << HISTORY_SAMPLES;
+}
+
+void TestPerformance::benchmarkGraphHistoryRepaint()
+{
+    QFETCH(int, samples);
+    GraphWidget graph("Trend", GraphWidget::SineWave);
+    graph.resize(GRAPH_COLUMNS + 20, 400);
+    graph.setHistory(graphHistory(samples));
+    QImage target(graph.size(), QImage::Format_ARGB32_Premultiplied);
+    
+    // Decimation and drawing of the whole history. The first render
+    // summarises the samples into the envelope; after that both rows cost
+    // the same
+    QBENCHMARK {
+        graph.setRange(0, 100);
+        graph.render(&target);
+    }
+}
+
+void TestPerformance::benchmarkGraphHistorySample()
+{
+    GraphWidget graph("Trend", GraphWidget::SineWave);
+    graph.resize(GRAPH_COLUMNS + 20, 400);
+    graph.setHistory(graphHistory(HISTORY_SAMPLES));
+    QImage target(graph.size(), QImage::Format_ARGB32_Premultiplied);
+    graph.render(&target); // Builds the layers and the envelope
+    
+    // A new sample redraws the trace from the envelope, not the history
+    int index = 0;
+    QBENCHMARK {
+        graph.addDataPoint(graphSample(++index));
+    }
+}
+
+QTEST_MAIN(TestPerformance)
+#include "test_performance.moc"
@@ -0,0 +1,178 @@
+#include "mockhttpcontroller.h"
+#include <QHostAddress>
+#include <QLocale>
+#include <QDebug>
+
+MockHttpController::MockHttpController(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_compressionEnabled(true)
+    , m_documentVersion(0)
+    , m_requestCount(0)
+    , m_notModifiedCount(0)
+    , m_connectionCount(0)
+    , m_bytesSent(0)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MockHttpController::onNewConnection);
+}
+
+MockHttpController::~MockHttpController()
+{
+    // Server and sockets automatically deleted by parent QObject
+}
+
+bool MockHttpController::listen()
+{
+    return m_server->listen(QHostAddress::LocalHost, 0);
+}
+
+QString MockHttpController::baseUrl() const
+{
+    return QString("http://127.0.0.1:%1/").arg(m_server->serverPort());
+}
+
+void MockHttpController::setDocument(const QString &path, const QByteArray &body)
+{
+    Document document;
+    document.body = body;
+    document.etag = "\"v" + QByteArray::number(++m_documentVersion) + "\"";
+    // HTTP dates have one second resolution; keep every version distinct
+    document.lastModified = QDateTime::currentDateTimeUtc().addSecs(m_documentVersion);
+    m_documents.insert(path.startsWith('/') ? path : '/' + path, document);
+}
+
+void MockHttpController::setCompressionEnabled(bool enabled)
+{
+    m_compressionEnabled = enabled;
+}
+
+int MockHttpController::getRequestCount() const
+{
+    return m_requestCount;
+}
+
+int MockHttpController::getNotModifiedCount() const
+{
+    return m_notModifiedCount;
+}
+
+int MockHttpController::getConnectionCount() const
+{
+    return m_connectionCount;
+}
+
+qint64 MockHttpController::getBytesSent() const
+{
+    return m_bytesSent;
+}
+
+QByteArray MockHttpController::getLastRequestHeader(const QByteArray &name) const
+{
+    return m_lastRequestHeaders.value(name.toLower());
+}
+
+void MockHttpController::resetMock()
+{
+    m_requestCount = 0;
+    m_notModifiedCount = 0;
+    m_connectionCount = 0;
+    m_bytesSent = 0;
+    m_lastRequestHeaders.clear();
+}
+
+void MockHttpController::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        m_connectionCount++;
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &MockHttpController::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockHttpController::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+    
+    QByteArray &buffer = m_buffers[socket];
+    buffer += socket->readAll();
+    
+    // Serve every complete request; pipelined clients send several at once
+    int end;
+    while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+        const QByteArray head = buffer.left(end);
+        buffer.remove(0, end + 4);
+        handleRequest(socket, head);
+    }
+}
+
+void MockHttpController::handleRequest(QTcpSocket *socket, const QByteArray &head)
+{
+    m_requestCount++;
+    
+    const QList<QByteArray> lines = head.split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    const QString path = QString::fromLatin1(requestLine.value(1));
+    
+    m_lastRequestHeaders.clear();
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines[i].indexOf(':');
+        if (colon > 0) {
+            m_lastRequestHeaders.insert(lines[i].left(colon).trimmed().toLower(),
+                                        lines[i].mid(colon + 1).trimmed());
+        }
+    }
+    
+    if (requestLine.value(0) != "GET" || !m_documents.contains(path)) {
+        writeResponse(socket, 404, QByteArray(), QByteArray());
+        emit requestServed(path, 404);
+        return;
+    }
+    
+    const Document &document = m_documents[path];
+    const QByteArray lastModified = QLocale::c().toString(document.lastModified,
+        "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+    QByteArray headers = "ETag: " + document.etag + "\r\n"
+                       + "Last-Modified: " + lastModified + "\r\n";
+    
+    // If-None-Match takes precedence over If-Modified-Since (RFC 7232)
+    const QByteArray ifNoneMatch = getLastRequestHeader("If-None-Match");
+    const bool notModified = !ifNoneMatch.isEmpty()
+        ? ifNoneMatch == document.etag
+        : getLastRequestHeader("If-Modified-Since") == lastModified;
+    if (notModified) {
+        m_notModifiedCount++;
+        writeResponse(socket, 304, headers, QByteArray());
+        emit requestServed(path, 304);
+        return;
+    }
+    
+    QByteArray body = document.body;
+    if (m_compressionEnabled && getLastRequestHeader("Accept-Encoding").contains("deflate")) {
+        body = qCompress(body).mid(4); // Strip Qt's length prefix, leaving a zlib stream
+        headers += "Content-Encoding: deflate\r\n";
+    }
+    headers += "Content-Type: text/xml\r\n";
+    writeResponse(socket, 200, headers, body);
+    emit requestServed(path, 200);
+}
+
+void MockHttpController::writeResponse(QTcpSocket *socket, int statusCode, const QByteArray &headers, const QByteArray &body)
+{
+    QByteArray reason = "OK";
+    if (statusCode == 304) reason = "Not Modified";
+    else if (statusCode == 404) reason = "Not Found";
+    
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(statusCode) + ' ' + reason + "\r\n"
+                        + headers
+                        + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                        + "Connection: keep-alive\r\n"
+                        + "\r\n"
+                        + body;
+    m_bytesSent += response.size();
+    socket->write(response);
+}
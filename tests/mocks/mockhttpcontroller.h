@@ -0,0 +1,75 @@
+#ifndef MOCKHTTPCONTROLLER_H
+#define MOCKHTTPCONTROLLER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QMap>
+#include <QDateTime>
+
+/**
+ * @brief Mock controller web server for testing XML fetching
+ * 
+ * Minimal HTTP/1.1 server on localhost that serves in-memory documents the
+ * way a controller's web interface does: ETag and Last-Modified validators,
+ * 304 responses to conditional requests, deflate compression and
+ * persistent, pipelined connections. Counts requests, connections and
+ * bytes on the wire so tests can verify what a client actually sent.
+ */
+class MockHttpController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MockHttpController(QObject *parent = nullptr);
+    virtual ~MockHttpController();
+    
+    // Mock Configuration
+    bool listen();
+    QString baseUrl() const;
+    void setDocument(const QString &path, const QByteArray &body);
+    void setCompressionEnabled(bool enabled);
+    
+    // Test State Access
+    int getRequestCount() const;
+    int getNotModifiedCount() const;
+    int getConnectionCount() const;
+    qint64 getBytesSent() const;
+    QByteArray getLastRequestHeader(const QByteArray &name) const;
+    
+    // Reset for clean test state
+    void resetMock();
+
+signals:
+    void requestServed(const QString &path, int statusCode);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    struct Document {
+        QByteArray body;
+        QByteArray etag;
+        QDateTime lastModified;
+    };
+    
+    void handleRequest(QTcpSocket *socket, const QByteArray &head);
+    void writeResponse(QTcpSocket *socket, int statusCode, const QByteArray &headers, const QByteArray &body);
+    
+    QTcpServer *m_server;
+    QMap<QString, Document> m_documents;
+    QHash<QTcpSocket*, QByteArray> m_buffers;  // Unparsed request bytes per connection
+    bool m_compressionEnabled;
+    int m_documentVersion;
+    
+    // Mock State
+    int m_requestCount;
+    int m_notModifiedCount;
+    int m_connectionCount;
+    qint64 m_bytesSent;
+    QHash<QByteArray, QByteArray> m_lastRequestHeaders;
+};
+
+#endif // MOCKHTTPCONTROLLER_H
@@ -0,0 +1,209 @@
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include "../src/models/controllerpagemodel.h"
+
+/**
+ * @brief Unit tests for the controller page list model
+ * 
+ * Tests how forms, columns and fields of a parsed page are flattened into
+ * rows, how values are shown, and that refreshes only report the rows
+ * whose value changed.
+ */
+class TestControllerPageModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRows();
+    void testValueText();
+    void testUpdateValues();
+    void testEditing();
+
+private:
+    static ControllerXmlService::XmlField makeField(const QString &id, const QVariant &value);
+    static ControllerXmlService::XmlPage makePage(int fieldCount);
+};
+
+ControllerXmlService::XmlField TestControllerPageModel::makeField(const QString &id, const QVariant &value)
+{
+    ControllerXmlService::XmlField field;
+    field.id = id;
+    field.label = "Field " + id;
+    field.unit = "bar";
+    field.value = value;
+    return field;
+}
+
+ControllerXmlService::XmlPage TestControllerPageModel::makePage(int fieldCount)
+{
+    ControllerXmlService::XmlColumn column;
+    column.title = "Process";
+    for (int i = 0; i < fieldCount; ++i) {
+        column.fields.append(makeField(QString("f%1").arg(i), double(i)));
+    }
+    
+    ControllerXmlService::XmlForm form;
+    form.type = "cnt";
+    form.columns.append(column);
+    
+    ControllerXmlService::XmlPage page;
+    page.title = "unit";
+    page.forms.append(form);
+    page.fieldCount = fieldCount;
+    return page;
+}
+
+void TestControllerPageModel::testRows()
+{
+    ControllerXmlService::XmlForm sub;
+    sub.type = "sub";
+    sub.title = "Operation";
+    
+    ControllerXmlService::XmlColumn first;
+    first.title = "Pressure";
+    first.fields.append(makeField("p1", 1.5));
+    ControllerXmlService::XmlField hidden = makeField("p2", 2.0);
+    hidden.hidden = true;
+    first.fields.append(hidden);
+    first.fields.append(makeField("", 3.0));        // No ID: not shown
+    
+    ControllerXmlService::XmlColumn untitled;
+    untitled.fields.append(makeField("g1", 4.0));
+    
+    ControllerXmlService::XmlColumn empty;
+    empty.title = "Empty";                          // No visible fields: no header
+    
+    ControllerXmlService::XmlForm cnt;
+    cnt.type = "cnt";
+    cnt.columns << first << untitled << empty;
+    
+    ControllerXmlService::XmlPage page;
+    page.forms << sub << cnt;
+    
+    ControllerPageModel model;
+    model.setPage(page);
+    QCOMPARE(model.rowCount(), 5);
+    
+    QCOMPARE(model.index(0).data(ControllerPageModel::RowKindRole).toInt(), int(ControllerPageModel::SubHeaderRow));
+    QCOMPARE(model.index(0).data().toString(), QString("OPERATION"));
+    QCOMPARE(model.index(1).data(ControllerPageModel::RowKindRole).toInt(), int(ControllerPageModel::GroupHeaderRow));
+    QCOMPARE(model.index(1).data().toString(), QString("PRESSURE"));
+    QVERIFY(!model.index(1).data(ControllerPageModel::GroupGapRole).toBool());
+    QCOMPARE(model.index(2).data(ControllerPageModel::FieldIdRole).toString(), QString("p1"));
+    QCOMPARE(model.index(3).data().toString(), QString("GENERAL"));
+    QVERIFY(model.index(3).data(ControllerPageModel::GroupGapRole).toBool());
+    QCOMPARE(model.index(4).data(ControllerPageModel::FieldIdRole).toString(), QString("g1"));
+    
+    QCOMPARE(model.rowForField("p1"), 2);
+    QCOMPARE(model.rowForField("p2"), -1);
+    QVERIFY(!(model.index(1).flags() & Qt::ItemIsEditable));
+    QVERIFY(!(model.index(2).flags() & Qt::ItemIsEditable));
+    
+    model.clear();
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(model.rowForField("p1"), -1);
+}
+
+void TestControllerPageModel::testValueText()
+{
+    ControllerXmlService::XmlField display = makeField("d", QVariant());
+    ControllerXmlService::XmlField input = makeField("i", QVariant());
+    input.var = "setpoint";
+    ControllerXmlService::XmlField number = makeField("n", 171.0);
+    ControllerXmlService::XmlField mode = makeField("m", QString("20"));
+    mode.type = "drp";
+    mode.optds = "Off,Auto,Manual";
+    mode.optdv = "0,10,20";
+    ControllerXmlService::XmlField level = makeField("l", 1);
+    level.type = "drp";
+    level.optds = "Low,High";
+    
+    ControllerXmlService::XmlColumn column;
+    column.fields << display << input << number << mode << level;
+    ControllerXmlService::XmlForm form;
+    form.type = "cnt";
+    form.columns.append(column);
+    ControllerXmlService::XmlPage page;
+    page.forms.append(form);
+    
+    ControllerPageModel model;
+    model.setPage(page);
+    auto text = [&model](const QString &id) {
+        return model.index(model.rowForField(id)).data(ControllerPageModel::ValueTextRole).toString();
+    };
+    
+    QCOMPARE(text("d"), QString("--"));
+    QCOMPARE(text("i"), QString("0"));
+    QCOMPARE(text("n"), QString("171"));
+    QCOMPARE(text("m"), QString("Manual"));
+    QCOMPARE(text("l"), QString("High"));
+    
+    QVERIFY(model.index(model.rowForField("i")).flags() & Qt::ItemIsEditable);
+    QVERIFY(model.index(model.rowForField("m")).flags() & Qt::ItemIsEditable);
+    QCOMPARE(model.index(model.rowForField("m")).data(ControllerPageModel::OptionsRole).toStringList(),
+             QStringList({"Off", "Auto", "Manual"}));
+    
+    // A value that selects no option keeps the current one
+    model.updateValues({{"m", QString("99")}, {"l", 0}});
+    QCOMPARE(text("m"), QString("Manual"));
+    QCOMPARE(text("l"), QString("Low"));
+}
+
+void TestControllerPageModel::testUpdateValues()
+{
+    ControllerPageModel model;
+    model.setPage(makePage(100));
+    QCOMPARE(model.rowCount(), 101);
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+    QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+    
+    // Unchanged values and unknown fields report nothing
+    model.updateValues({{"f3", 3.0}, {"missing", 1.0}});
+    QCOMPARE(changedSpy.count(), 0);
+    
+    // Scattered changes are reported row by row, adjacent ones as one range
+    model.updateValues({{"f50", 500.0}, {"f10", 100.0}, {"f11", 110.0}, {"f12", 120.0}});
+    QCOMPARE(changedSpy.count(), 2);
+    const int row10 = model.rowForField("f10");
+    QCOMPARE(changedSpy.at(0).at(0).toModelIndex().row(), row10);
+    QCOMPARE(changedSpy.at(0).at(1).toModelIndex().row(), row10 + 2);
+    QCOMPARE(changedSpy.at(1).at(0).toModelIndex().row(), model.rowForField("f50"));
+    QCOMPARE(changedSpy.at(1).at(1).toModelIndex().row(), model.rowForField("f50"));
+    QVERIFY(changedSpy.at(0).at(2).value<QVector<int>>().contains(ControllerPageModel::ValueTextRole));
+    QCOMPARE(resetSpy.count(), 0);
+    
+    QCOMPARE(model.index(row10 + 1).data(ControllerPageModel::ValueTextRole).toString(), QString("110"));
+    QCOMPARE(model.index(row10 + 1).data(ControllerPageModel::ValueRole).toDouble(), 110.0);
+}
+
+void TestControllerPageModel::testEditing()
+{
+    ControllerXmlService::XmlField input = makeField("i", 5.0);
+    input.var = "setpoint";
+    ControllerXmlService::XmlColumn column;
+    column.fields << input;
+    ControllerXmlService::XmlForm form;
+    form.type = "cnt";
+    form.columns.append(column);
+    ControllerXmlService::XmlPage page;
+    page.forms.append(form);
+    
+    ControllerPageModel model;
+    model.setPage(page);
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+    
+    const QModelIndex index = model.index(model.rowForField("i"));
+    QVERIFY(model.setData(index, QString("7.5")));
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(index.data(ControllerPageModel::ValueTextRole).toString(), QString("7.5"));
+    
+    // Headers can't be edited
+    QVERIFY(!model.setData(model.index(0), QString("x")));
+    
+    // A refresh replaces the entered value
+    model.updateValues({{"i", 6.0}});
+    QCOMPARE(index.data(ControllerPageModel::ValueTextRole).toString(), QString("6"));
+}
+
+QTEST_MAIN(TestControllerPageModel)
+#include "test_controllerpagemodel.moc"
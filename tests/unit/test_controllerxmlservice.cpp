@@ -0,0 +1,462 @@
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <limits>
+#include "../src/services/controllerxmlservice.h"
+#include "../src/services/controllerxmlparser.h"
+#include "../src/utils/calcexpression.h"
+#include "../mocks/mockhttpcontroller.h"
+
+/**
+ * @brief Unit tests for the controller XML page diff
+ * 
+ * Tests that refreshes with an unchanged layout report only the changed
+ * values, that any layout change asks for a rebuild, what refreshes cost
+ * on the wire against a local controller web server, that known layouts
+ * are taken from the layout cache instead of being parsed, and the calc
+ * expressions applied to field values.
+ */
+class TestControllerXmlService : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void testUnchangedPage();
+    void testChangedValues();
+    void testLayoutChanged();
+    void testFieldIdMismatch();
+
+    void testConditionalRefresh();
+    void testCompressedTransfer();
+    void testCoalescedFetch();
+    
+    void testValueOnlyRefresh();
+    void testLayoutCacheOnDisk();
+    void testLayoutKeyIgnoresText();
+    void testUnscannableDocument();
+    
+    void testCalcExpression_data();
+    void testCalcExpression();
+    void testCalcExpressionErrors();
+    void testCalculatedValues();
+
+private:
+    static ControllerXmlService::XmlPage makePage(int fieldCount);
+    static QByteArray makeDocument(int fieldCount, int valueOffset);
+};
+
+ControllerXmlService::XmlPage TestControllerXmlService::makePage(int fieldCount)
+{
+    ControllerXmlService::XmlColumn column;
+    column.title = "Process";
+    for (int i = 0; i < fieldCount; ++i) {
+        ControllerXmlService::XmlField field;
+        field.id = QString("f%1").arg(i);
+        field.label = QString("Field %1").arg(i);
+        field.value = double(i);
+        column.fields.append(field);
+    }
+    
+    ControllerXmlService::XmlForm form;
+    form.type = "cnt";
+    form.columns.append(column);
+    
+    ControllerXmlService::XmlPage page;
+    page.title = "unit";
+    page.forms.append(form);
+    page.fieldCount = fieldCount;
+    page.layoutHash = 0x1234;
+    return page;
+}
+
+QByteArray TestControllerXmlService::makeDocument(int fieldCount, int valueOffset)
+{
+    QByteArray xml = "<unit_page version=\"1\"><hdr title=\"unit\"/>"
+                     "<frm type=\"cnt\"><col title=\"Process\">";
+    for (int i = 0; i < fieldCount; ++i) {
+        xml += QString("<val id=\"f%1\" label=\"Field %1\" unit=\"bar\">%2</val>")
+                   .arg(i).arg(i + valueOffset).toUtf8();
+    }
+    xml += "</col></frm></unit_page>";
+    return xml;
+}
+
+void TestControllerXmlService::initTestCase()
+{
+    qRegisterMetaType<ControllerXmlService::XmlPage>();
+    qRegisterMetaType<QVector<ControllerXmlService::XmlValueChange>>();
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestControllerXmlService::testUnchangedPage()
+{
+    const auto previous = makePage(500);
+    const auto current = makePage(500);
+    
+    const auto diff = ControllerXmlService::diffPages(previous, current);
+    QVERIFY(!diff.layoutChanged);
+    QVERIFY(diff.changes.isEmpty());
+}
+
+void TestControllerXmlService::testChangedValues()
+{
+    const auto previous = makePage(500);
+    auto current = makePage(500);
+    auto &fields = current.forms[0].columns[0].fields;
+    fields[7].value = 70.5;
+    fields[499].value = QString("FAULT");
+    
+    const auto diff = ControllerXmlService::diffPages(previous, current);
+    QVERIFY(!diff.layoutChanged);
+    QCOMPARE(diff.changes.size(), 2);
+    QCOMPARE(diff.changes[0].id, QString("f7"));
+    QCOMPARE(diff.changes[0].value.toDouble(), 70.5);
+    QCOMPARE(diff.changes[1].id, QString("f499"));
+    QCOMPARE(diff.changes[1].value.toString(), QString("FAULT"));
+}
+
+void TestControllerXmlService::testLayoutChanged()
+{
+    const auto previous = makePage(10);
+    
+    auto rehashed = makePage(10);
+    rehashed.layoutHash = 0x4321;
+    QVERIFY(ControllerXmlService::diffPages(previous, rehashed).layoutChanged);
+    
+    auto grown = makePage(11);
+    QVERIFY(ControllerXmlService::diffPages(previous, grown).layoutChanged);
+    
+    // Nothing to diff against
+    QVERIFY(ControllerXmlService::diffPages(ControllerXmlService::XmlPage(), previous).layoutChanged);
+}
+
+void TestControllerXmlService::testFieldIdMismatch()
+{
+    // Equal hashes must not patch values into the wrong fields
+    const auto previous = makePage(10);
+    auto current = makePage(10);
+    current.forms[0].columns[0].fields[3].id = "renamed";
+    current.forms[0].columns[0].fields[5].value = 1.0;
+    
+    const auto diff = ControllerXmlService::diffPages(previous, current);
+    QVERIFY(diff.layoutChanged);
+    QVERIFY(diff.changes.isEmpty());
+}
+
+void TestControllerXmlService::testConditionalRefresh()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    controller.setDocument("unit/p_operation.xml", makeDocument(500, 0));
+    
+    ControllerXmlService service;
+    service.setBaseUrl(controller.baseUrl());
+    QSignalSpy receivedSpy(&service, &ControllerXmlService::xmlDataReceived);
+    QSignalSpy updatedSpy(&service, &ControllerXmlService::xmlDataUpdated);
+    QSignalSpy valuesSpy(&service, &ControllerXmlService::xmlValuesChanged);
+    
+    service.fetchXmlFile("unit/p_operation.xml");
+    QVERIFY(receivedSpy.wait());
+    QCOMPARE(service.getCurrentPage().fieldCount, 500);
+    const qint64 fullBytes = controller.getBytesSent();
+    
+    // Unchanged document: 304 without a body, no parsing, no value changes
+    for (int i = 0; i < 3; ++i) {
+        service.fetchXmlFile("unit/p_operation.xml");
+        QVERIFY(updatedSpy.wait());
+    }
+    QCOMPARE(controller.getRequestCount(), 4);
+    QCOMPARE(controller.getNotModifiedCount(), 3);
+    QCOMPARE(service.getStatistics().notModified, 3);
+    QVERIFY(!controller.getLastRequestHeader("If-None-Match").isEmpty());
+    QVERIFY(controller.getBytesSent() - fullBytes < fullBytes);
+    QCOMPARE(valuesSpy.count(), 0);
+    QCOMPARE(receivedSpy.count(), 1);
+    
+    // Keep-alive: every request went over the first connection
+    QCOMPARE(controller.getConnectionCount(), 1);
+    
+    // A new version is fetched in full and only its values are reported
+    controller.setDocument("unit/p_operation.xml", makeDocument(500, 1));
+    service.fetchXmlFile("unit/p_operation.xml");
+    QVERIFY(valuesSpy.wait());
+    QCOMPARE(valuesSpy.takeFirst().at(0).value<QVector<ControllerXmlService::XmlValueChange>>().size(), 500);
+    QCOMPARE(receivedSpy.count(), 1);
+    QCOMPARE(controller.getNotModifiedCount(), 3);
+}
+
+void TestControllerXmlService::testCompressedTransfer()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    const QByteArray document = makeDocument(500, 0);
+    controller.setDocument("unit/p_operation.xml", document);
+    
+    ControllerXmlService service;
+    service.setBaseUrl(controller.baseUrl());
+    QSignalSpy receivedSpy(&service, &ControllerXmlService::xmlDataReceived);
+    
+    service.fetchXmlFile("unit/p_operation.xml");
+    QVERIFY(receivedSpy.wait());
+    
+    QVERIFY(controller.getLastRequestHeader("Accept-Encoding").contains("deflate"));
+    QVERIFY(controller.getBytesSent() < document.size() / 2);
+    QCOMPARE(service.getStatistics().bytesReceived, qint64(document.size()));
+    QCOMPARE(service.getCurrentPage().fieldCount, 500);
+}
+
+void TestControllerXmlService::testCoalescedFetch()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    controller.setDocument("unit/p_operation.xml", makeDocument(10, 0));
+    
+    ControllerXmlService service;
+    service.setBaseUrl(controller.baseUrl());
+    QSignalSpy receivedSpy(&service, &ControllerXmlService::xmlDataReceived);
+    
+    // The second and third fetch arrive while the first is still in flight
+    service.fetchXmlFile("unit/p_operation.xml");
+    service.fetchXmlFile("unit/p_operation.xml");
+    service.fetchXmlFile("unit/p_operation.xml");
+    QVERIFY(receivedSpy.wait());
+    QTest::qWait(50);
+    
+    QCOMPARE(controller.getRequestCount(), 1);
+    QCOMPARE(service.getStatistics().requests, 1);
+    QCOMPARE(service.getStatistics().coalesced, 2);
+    QCOMPARE(receivedSpy.count(), 1);
+}
+
+void TestControllerXmlService::testValueOnlyRefresh()
+{
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    QSignalSpy receivedSpy(&service, &ControllerXmlService::xmlDataReceived);
+    QSignalSpy valuesSpy(&service, &ControllerXmlService::xmlValuesChanged);
+    
+    service.processXmlData(makeDocument(500, 0));
+    QCOMPARE(receivedSpy.count(), 1);
+    QCOMPARE(service.getStatistics().fullParses, 1);
+    
+    // Same layout, new values: scanned, not parsed
+    service.processXmlData(makeDocument(500, 0));
+    service.processXmlData(makeDocument(500, 7));
+    QCOMPARE(service.getStatistics().fullParses, 1);
+    QCOMPARE(service.getStatistics().valueRefreshes, 2);
+    QCOMPARE(receivedSpy.count(), 1);
+    QCOMPARE(valuesSpy.count(), 1);
+    
+    const auto changes = valuesSpy.takeFirst().at(0).value<QVector<ControllerXmlService::XmlValueChange>>();
+    QCOMPARE(changes.size(), 500);
+    QCOMPARE(changes.at(3).id, QString("f3"));
+    QCOMPARE(changes.at(3).value.toString(), QString("10"));
+    QCOMPARE(service.getCurrentPage().forms[0].columns[0].fields[499].value.toString(), QString("506"));
+    
+    // A new layout is parsed again and reported as such
+    service.processXmlData(makeDocument(501, 0));
+    QCOMPARE(service.getStatistics().fullParses, 2);
+    QCOMPARE(receivedSpy.count(), 2);
+    QCOMPARE(service.getCurrentPage().fieldCount, 501);
+}
+
+void TestControllerXmlService::testLayoutCacheOnDisk()
+{
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    
+    {
+        ControllerXmlService service;
+        service.setLayoutCacheDirectory(cacheDir.path());
+        service.processXmlData(makeDocument(500, 0));
+        QCOMPARE(service.getStatistics().fullParses, 1);
+    }
+    QCOMPARE(QDir(cacheDir.path()).entryList(QStringList() << "*.layout").size(), 1);
+    
+    // A fresh service (e.g. after a restart) starts from the cached layout
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(cacheDir.path());
+    QSignalSpy receivedSpy(&service, &ControllerXmlService::xmlDataReceived);
+    service.processXmlData(makeDocument(500, 3));
+    QCOMPARE(service.getStatistics().fullParses, 0);
+    QCOMPARE(service.getStatistics().cachedLayouts, 1);
+    QCOMPARE(receivedSpy.count(), 1);
+    
+    const auto &page = service.getCurrentPage();
+    QCOMPARE(page.title, QString("unit"));
+    QCOMPARE(page.fieldCount, 500);
+    const auto &field = page.forms[0].columns[0].fields[42];
+    QCOMPARE(field.id, QString("f42"));
+    QCOMPARE(field.label, QString("Field 42"));
+    QCOMPARE(field.unit, QString("bar"));
+    QCOMPARE(field.value.toString(), QString("45"));
+    
+    // Identical to what a full parse produces
+    ControllerXmlService parser;
+    parser.setLayoutCacheDirectory(QString());
+    parser.processXmlData(makeDocument(500, 3));
+    const auto diff = ControllerXmlService::diffPages(parser.getCurrentPage(), page);
+    QVERIFY(!diff.layoutChanged);
+    QVERIFY(diff.changes.isEmpty());
+    
+    // Only the most recently used layouts stay on disk
+    for (int fields = 1; fields <= ControllerXmlParser::MAX_LAYOUT_FILES + 5; ++fields) {
+        service.processXmlData(makeDocument(fields, 0));
+    }
+    QCOMPARE(QDir(cacheDir.path()).entryList(QStringList() << "*.layout").size(),
+             ControllerXmlParser::MAX_LAYOUT_FILES);
+}
+
+void TestControllerXmlService::testLayoutKeyIgnoresText()
+{
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(makeDocument(20, 0));
+    
+    // Reformatted text between the elements and a comment keep the layout
+    QByteArray document = makeDocument(20, 4);
+    document.replace("</val>", "</val>\n  ");
+    document.replace("<frm ", "<!-- generated -->\n<frm ");
+    service.processXmlData(document);
+    QCOMPARE(service.getStatistics().fullParses, 1);
+    QCOMPARE(service.getStatistics().valueRefreshes, 1);
+    QCOMPARE(service.getCurrentPage().forms[0].columns[0].fields[19].value.toString(), QString("23"));
+    
+    // A changed attribute does not
+    document.replace("label=\"Field 7\"", "label=\"Pump 7\"");
+    service.processXmlData(document);
+    QCOMPARE(service.getStatistics().fullParses, 2);
+    QCOMPARE(service.getCurrentPage().forms[0].columns[0].fields[7].label, QString("Pump 7"));
+}
+
+void TestControllerXmlService::testUnscannableDocument()
+{
+    // Entities in values need the real parser every time
+    QByteArray document = makeDocument(10, 0);
+    document.replace(">5</val>", ">A &amp; B</val>");
+    
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(document);
+    service.processXmlData(document);
+    QCOMPARE(service.getStatistics().fullParses, 2);
+    QCOMPARE(service.getStatistics().valueRefreshes, 0);
+    QCOMPARE(service.getCurrentPage().forms[0].columns[0].fields[5].value.toString(), QString("A & B"));
+}
+
+void TestControllerXmlService::testCalcExpression_data()
+{
+    QTest::addColumn<QString>("calc");
+    QTest::addColumn<double>("val");
+    QTest::addColumn<double>("expected");
+    
+    QTest::newRow("identity") << "val" << 42.0 << 42.0;
+    QTest::newRow("divide") << "val/10" << 235.0 << 23.5;
+    QTest::newRow("precedence") << "1+val*2-6/3" << 4.0 << 7.0;
+    QTest::newRow("parentheses") << "(val+1)/100" << 249.0 << 2.5;
+    QTest::newRow("unary") << "-val + +2 - -1" << 5.0 << -2.0;
+    QTest::newRow("modulo") << "val % 256" << 513.0 << 1.0;
+    QTest::newRow("ternary zero") << "val==0?val:(val+1)/100" << 0.0 << 0.0;
+    QTest::newRow("ternary nonzero") << "val==0?val:(val+1)/100" << 99.0 << 1.0;
+    QTest::newRow("nested ternary") << "val<0 ? -1 : val>0 ? 1 : 0" << 7.0 << 1.0;
+    QTest::newRow("comparison") << "(val>=10) + (val<=10) + (val!=10)" << 10.0 << 2.0;
+    QTest::newRow("logical") << "val>0 && val<5 || val==9" << 9.0 << 1.0;
+    QTest::newRow("logical short-circuit") << "val && 1/val > 0.5" << 0.0 << 0.0;
+    QTest::newRow("not") << "!val + !!val" << 3.0 << 1.0;
+    QTest::newRow("bit and shift") << "(val >> 4) & 0x0F" << 171.0 << 10.0;
+    QTest::newRow("bit or xor not") << "(val | 1) ^ ~0" << 4.0 << -6.0;
+    QTest::newRow("bit vs logical") << "val & 2 && val | 0" << 6.0 << 1.0;
+    QTest::newRow("shift left") << "1 << val" << 40.0 << 1099511627776.0;
+    QTest::newRow("negative shift left") << "val << 1" << -1.0 << -2.0;
+    QTest::newRow("negative shift right") << "val >> 2" << -8.0 << -2.0;
+    QTest::newRow("shift into sign bit") << "1 << val" << 63.0 << -9223372036854775808.0;
+    QTest::newRow("shift count masked") << "val << 64" << 3.0 << 3.0;
+    QTest::newRow("shift vs additive") << "1 << val + 1" << 2.0 << 8.0;
+    QTest::newRow("shift vs relational") << "1 << 2 < val" << 5.0 << 1.0;
+    QTest::newRow("bit and vs equality") << "val & 6 == 6" << 6.0 << 0.0;
+    QTest::newRow("unary vs multiply") << "-val * -2 % 5" << 4.0 << 3.0;
+    QTest::newRow("ternary right-associative") << "val ? 2 : 3 ? 4 : 5" << 0.0 << 4.0;
+    QTest::newRow("ternary lowest precedence") << "val > 1 ? val + 1 : val - 1" << 5.0 << 6.0;
+    QTest::newRow("ternary in parentheses") << "(val ? 10 : 20) + 1" << 0.0 << 21.0;
+    QTest::newRow("ternary in condition") << "(val ? 0 : 1) ? 7 : 8" << 2.0 << 8.0;
+    QTest::newRow("exponent") << "val * 1e-3 + .5" << 1500.0 << 2.0;
+}
+
+void TestControllerXmlService::testCalcExpression()
+{
+    QFETCH(QString, calc);
+    QFETCH(double, val);
+    QFETCH(double, expected);
+    
+    const auto program = CalcExpression::compile(calc);
+    QVERIFY2(program.isSuccess(), qPrintable(program.isFailure() ? program.error() : QString()));
+    QCOMPARE(program.value().evaluate(val), expected);
+    
+    // Batch evaluation gives the same results
+    double values[3] = { val, val, val };
+    program.value().evaluate(values, values, 3);
+    QCOMPARE(values[2], expected);
+}
+
+void TestControllerXmlService::testCalcExpressionErrors()
+{
+    QVERIFY(CalcExpression::compile("").isFailure());
+    QVERIFY(CalcExpression::compile("val +").isFailure());
+    QVERIFY(CalcExpression::compile("(val").isFailure());
+    QVERIFY(CalcExpression::compile("val ? 1").isFailure());
+    QVERIFY(CalcExpression::compile("value/10").isFailure());
+    QVERIFY(CalcExpression::compile("val 10").isFailure());
+    QVERIFY(CalcExpression::compile("val = 1").isFailure());
+    QVERIFY(CalcExpression::compile(QString(40, '(') + "val" + QString(40, ')')).isSuccess());
+    
+    // Deep right-leaning chains need one stack slot per pending operand
+    QString deep = "val";
+    for (int i = 0; i < CalcExpression::MAX_STACK_DEPTH; ++i) {
+        deep = "val+(" + deep + ")";
+    }
+    QVERIFY(CalcExpression::compile(deep).isFailure());
+    QVERIFY(CalcExpression::compile(deep.mid(5, deep.size() - 6)).isSuccess());
+    
+    // Recursion limit: the outer expression and each unary operator or
+    // parenthesis level count, up to 128 levels
+    QVERIFY(CalcExpression::compile(QString(126, '-') + "val").isSuccess());
+    QCOMPARE(CalcExpression::compile(QString(126, '-') + "val").value().evaluate(2.0), 2.0);
+    QVERIFY(CalcExpression::compile(QString(127, '-') + "val").isFailure());
+    QVERIFY(CalcExpression::compile(QString(63, '(') + "val" + QString(63, ')')).isSuccess());
+    QVERIFY(CalcExpression::compile(QString(64, '(') + "val" + QString(64, ')')).isFailure());
+    
+    // Nesting that needs no stack slots is bounded by the parser's recursion
+    QVERIFY(CalcExpression::compile(QString(100000, '(') + "val" + QString(100000, ')')).isFailure());
+    QVERIFY(CalcExpression::compile(QString(100000, '-') + "val").isFailure());
+    QVERIFY(CalcExpression::compile(QString("val?1:").repeated(100000) + "0").isFailure());
+    
+    QVERIFY(CalcExpression().isIdentity());
+    QCOMPARE(CalcExpression().evaluate(1.5), 1.5);
+    QCOMPARE(CalcExpression::compile("val/0").value().evaluate(1.0), std::numeric_limits<double>::infinity());
+}
+
+void TestControllerXmlService::testCalculatedValues()
+{
+    const QByteArray document =
+        "<unit_page version=\"1\"><frm type=\"cnt\"><col>"
+        "<val id=\"temp\" calc=\"val/10\">235</val>"
+        "<val id=\"level\" calc=\"val==0?val:(val+1)/100\">249</val>"
+        "<val id=\"bad\" calc=\"val//\">7</val>"
+        "<val id=\"text\" calc=\"val/10\">Auto</val>"
+        "</col></frm></unit_page>";
+    
+    ControllerXmlService service;
+    service.setLayoutCacheDirectory(QString());
+    service.processXmlData(document);
+    
+    const auto &fields = service.getCurrentPage().forms[0].columns[0].fields;
+    QCOMPARE(fields[0].value.toDouble(), 23.5);
+    QCOMPARE(fields[1].value.toDouble(), 2.5);
+    QCOMPARE(fields[2].value.toDouble(), 7.0);          // Invalid calc: shown raw
+    QCOMPARE(fields[3].value.toString(), QString("Auto")); // Not a number: not calculated
+}
+
+QTEST_MAIN(TestControllerXmlService)
+#include "test_controllerxmlservice.moc"
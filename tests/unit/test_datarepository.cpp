@@ -0,0 +1,154 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include "../src/data/datarepository.h"
+
+/**
+ * @brief Unit tests for the batched DataRepository and CircularDataBuffer
+ * 
+ * Tests multi-row batch inserts, the write-behind queue, background
+ * incremental vacuum and ring buffer ordering.
+ */
+class TestDataRepository : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testBatchInsert();
+    void testWriteBehindQueue();
+    void testIncrementalVacuum();
+    void testControllerConfig();
+    void testCircularDataBuffer();
+
+private:
+    QTemporaryDir *m_tempDir;
+};
+
+void TestDataRepository::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestDataRepository::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+void TestDataRepository::testBatchInsert()
+{
+    DataRepository repo(m_tempDir->filePath("data.db"));
+    QVERIFY(repo.initialize());
+    
+    // Spans several full statements plus a partial one
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    const int samples = DataRepository::ROWS_PER_STATEMENT * 3 + 17;
+    QList<DataPoint> points;
+    for (int i = 0; i < samples; ++i) {
+        points.append(DataPoint("Flow", i * 0.5, base.addMSecs(i * 100),
+                                i % 2 ? DataPoint::Quality::Good : DataPoint::Quality::Uncertain));
+    }
+    QVERIFY(repo.insertDataPoints("192.168.1.10", points));
+    
+    auto history = repo.getHistoricalData("192.168.1.10", "Flow", base, base.addMSecs((samples - 1) * 100));
+    QCOMPARE(history.size(), samples);
+    QCOMPARE(history.first().toDouble(), 0.0);
+    QCOMPARE(history.last().toDouble(), (samples - 1) * 0.5);
+    QCOMPARE(history.first().quality(), DataPoint::Quality::Uncertain);
+    
+    QVERIFY(repo.getHistoricalData("192.168.1.11", "Flow", base, base.addSecs(3600)).isEmpty());
+    
+    auto latest = repo.getLatestData("192.168.1.10", 5);
+    QCOMPARE(latest.size(), 5);
+    QCOMPARE(latest.first().timestamp(), base.addMSecs((samples - 1) * 100));
+}
+
+void TestDataRepository::testWriteBehindQueue()
+{
+    DataRepository repo(m_tempDir->filePath("data.db"));
+    QVERIFY(repo.initialize());
+    repo.setFlushInterval(50);
+    repo.setMaxQueueSize(100);
+    
+    for (int i = 0; i < 150; ++i) {
+        repo.onDataReceived("10.0.0.5", "Speed", i);
+    }
+    
+    // The first 100 were written when the queue filled up
+    QCOMPARE(repo.queuedCount(), 50);
+    
+    // Queued samples are visible to queries before they are flushed
+    QCOMPARE(repo.getLatestData("10.0.0.5", 200).size(), 150);
+    
+    QTRY_COMPARE(repo.queuedCount(), 0);
+    QCOMPARE(repo.getLatestData("10.0.0.5", 200).size(), 150);
+}
+
+void TestDataRepository::testIncrementalVacuum()
+{
+    const QString path = m_tempDir->filePath("data.db");
+    DataRepository repo(path);
+    QVERIFY(repo.initialize());
+    
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    QList<DataPoint> points;
+    for (int i = 0; i < 20000; ++i) {
+        points.append(DataPoint("Text", QString(200, QChar('a' + i % 26)), base.addMSecs(i)));
+    }
+    QVERIFY(repo.insertDataPoints("plc", points));
+    QVERIFY(repo.flush());
+    
+    QSignalSpy finished(&repo, &DataRepository::vacuumFinished);
+    QVERIFY(repo.cleanupOldData(base.addSecs(3600)));
+    
+    // Returns immediately; space comes back step by step
+    QVERIFY(repo.isVacuuming());
+    QVERIFY(finished.wait(10000));
+    QVERIFY(!repo.isVacuuming());
+    QVERIFY(repo.getHistoricalData("plc", "Text", base, base.addSecs(3600)).isEmpty());
+}
+
+void TestDataRepository::testControllerConfig()
+{
+    DataRepository repo(m_tempDir->filePath("data.db"));
+    QVERIFY(repo.initialize());
+    
+    QVariantMap config;
+    config["port"] = 502;
+    config["name"] = "Boiler";
+    QVERIFY(repo.saveControllerConfig("192.168.1.20", config));
+    
+    QCOMPARE(repo.loadControllerConfig("192.168.1.20").value("name").toString(), QString("Boiler"));
+    QCOMPARE(repo.getConfiguredControllers(), QStringList() << "192.168.1.20");
+}
+
+void TestDataRepository::testCircularDataBuffer()
+{
+    CircularDataBuffer buffer(4);
+    QSignalSpy full(&buffer, &CircularDataBuffer::bufferFull);
+    
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    for (int i = 0; i < 6; ++i) {
+        buffer.addDataPoint(DataPoint("Level", i, base.addSecs(i)));
+    }
+    QCOMPARE(full.count(), 1);
+    QCOMPARE(buffer.size(), 4);
+    
+    auto data = buffer.getData();
+    QCOMPARE(data.first().value().toInt(), 2);
+    QCOMPARE(data.last().value().toInt(), 5);
+    QCOMPARE(buffer.getData(2).first().value().toInt(), 4);
+    QCOMPARE(buffer.getDataRange(base.addSecs(3), base.addSecs(4)).size(), 2);
+    
+    buffer.setMaxSize(2);
+    QCOMPARE(buffer.getData().first().value().toInt(), 4);
+    buffer.addDataPoint(DataPoint("Level", 6, base.addSecs(6)));
+    QCOMPARE(buffer.getData().last().value().toInt(), 6);
+}
+
+QTEST_MAIN(TestDataRepository)
+#include "test_datarepository.moc"
@@ -0,0 +1,178 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QFile>
+#include <QDir>
+#include "../src/services/historianbackup.h"
+#include "../src/repositories/sqliterepository.h"
+
+/**
+ * @brief Unit tests for the online historian backup
+ * 
+ * Tests that a backup taken while samples are being written is complete
+ * and restorable, that checksum verification catches corruption and that
+ * only the configured number of backups is kept.
+ */
+class TestHistorianBackup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testBackupWhileWriting();
+    void testVerifyDetectsCorruption();
+    void testRetention();
+    void testCancel();
+
+private:
+    QString databasePath() const;
+    QString backupDirectory() const;
+    void fillHistorian(SqliteRepository& repo, int days, int samplesPerDay);
+    
+    QTemporaryDir *m_tempDir;
+};
+
+void TestHistorianBackup::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestHistorianBackup::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestHistorianBackup::databasePath() const
+{
+    return m_tempDir->filePath("datapoints.db");
+}
+
+QString TestHistorianBackup::backupDirectory() const
+{
+    return m_tempDir->filePath("backups");
+}
+
+void TestHistorianBackup::fillHistorian(SqliteRepository& repo, int days, int samplesPerDay)
+{
+    const QDateTime base = QDateTime::currentDateTime().addDays(-days);
+    QList<DataPoint> points;
+    for (int day = 0; day < days; ++day) {
+        for (int i = 0; i < samplesPerDay; ++i) {
+            points.append(DataPoint("Flow", day * 1000 + i, base.addDays(day).addSecs(i)));
+        }
+    }
+    QVERIFY(repo.saveAll(points).isSuccess());
+}
+
+void TestHistorianBackup::testBackupWhileWriting()
+{
+    SqliteRepository repo(databasePath());
+    fillHistorian(repo, 3, 5000);
+    const int countAtStart = repo.count();
+    
+    HistorianBackup backup(databasePath(), backupDirectory());
+    backup.setPagesPerStep(8);
+    backup.setStepPause(1);
+    QSignalSpy finished(&backup, &HistorianBackup::finished);
+    QSignalSpy progress(&backup, &HistorianBackup::progress);
+    QVERIFY(backup.start().isSuccess());
+    QVERIFY(backup.start().isFailure());
+    
+    // Ingestion continues at full rate while the backup runs
+    const QDateTime now = QDateTime::currentDateTime();
+    int written = 0;
+    while (backup.isRunning()) {
+        QVERIFY(repo.save(DataPoint("Live", written, now.addMSecs(written))).isSuccess());
+        ++written;
+    }
+    QVERIFY(written > 0);
+    
+    QTRY_COMPARE(finished.count(), 1);
+    QVERIFY(progress.count() > 0);
+    QCOMPARE(progress.last().at(0).toLongLong(), progress.last().at(1).toLongLong());
+    
+    const QString backupPath = finished.first().at(0).toString();
+    QCOMPARE(backup.backups(), QStringList() << backupPath);
+    QVERIFY(HistorianBackup::verify(backupPath).isSuccess());
+    
+    // The backup is a consistent, usable historian
+    SqliteRepository restored(QDir(backupPath).filePath("datapoints.db"));
+    QVERIFY(restored.count() >= countAtStart);
+    QVERIFY(restored.count() <= countAtStart + written);
+    QCOMPARE(restored.findByTag("Flow").value().size(), countAtStart);
+}
+
+void TestHistorianBackup::testVerifyDetectsCorruption()
+{
+    {
+        SqliteRepository repo(databasePath());
+        fillHistorian(repo, 2, 1000);
+    }
+    
+    HistorianBackup backup(databasePath(), backupDirectory());
+    QSignalSpy finished(&backup, &HistorianBackup::finished);
+    QVERIFY(backup.start().isSuccess());
+    QVERIFY(backup.waitForFinished(30000));
+    QTRY_COMPARE(finished.count(), 1);
+    
+    const QString backupPath = finished.first().at(0).toString();
+    QFile copy(QDir(backupPath).filePath("datapoints.db"));
+    QVERIFY(copy.open(QIODevice::ReadWrite));
+    copy.seek(copy.size() / 2);
+    const char byte = copy.peek(1).at(0);
+    copy.write(QByteArray(1, char(byte ^ 0xFF)));
+    copy.close();
+    
+    QVERIFY(HistorianBackup::verify(backupPath).isFailure());
+}
+
+void TestHistorianBackup::testRetention()
+{
+    {
+        SqliteRepository repo(databasePath());
+        fillHistorian(repo, 1, 100);
+    }
+    
+    HistorianBackup backup(databasePath(), backupDirectory());
+    backup.setRetainedBackups(2);
+    QSignalSpy finished(&backup, &HistorianBackup::finished);
+    
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(backup.start().isSuccess());
+        QVERIFY(backup.waitForFinished(30000));
+    }
+    QTRY_COMPARE(finished.count(), 3);
+    
+    const QStringList kept = backup.backups();
+    QCOMPARE(kept.size(), 2);
+    QCOMPARE(kept.last(), finished.last().at(0).toString());
+    QVERIFY(!QDir(finished.first().at(0).toString()).exists());
+}
+
+void TestHistorianBackup::testCancel()
+{
+    {
+        SqliteRepository repo(databasePath());
+        fillHistorian(repo, 2, 5000);
+    }
+    
+    HistorianBackup backup(databasePath(), backupDirectory());
+    backup.setPagesPerStep(1);
+    backup.setStepPause(5);
+    QSignalSpy failed(&backup, &HistorianBackup::failed);
+    
+    QVERIFY(backup.start().isSuccess());
+    backup.cancel();
+    QVERIFY(backup.waitForFinished(30000));
+    
+    QTRY_COMPARE(failed.count(), 1);
+    QVERIFY(backup.backups().isEmpty());
+    QVERIFY(QDir(backupDirectory()).entryList(QDir::Dirs | QDir::NoDotAndDotDot).isEmpty());
+}
+
+QTEST_MAIN(TestHistorianBackup)
+#include "test_historianbackup.moc"
@@ -0,0 +1,219 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <algorithm>
+#include <cmath>
+#include "../src/services/historianexporter.h"
+#include "../src/repositories/sqliterepository.h"
+
+/**
+ * @brief Unit tests for the bulk historian export
+ * 
+ * Tests that a columnar export reads back exactly what the historian
+ * holds, that chunks and the index respect the chunk size and time order,
+ * the CSV output and cancellation.
+ */
+class TestHistorianExporter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testColumnarRoundTrip();
+    void testCorruptChunkDetected();
+    void testCsvExport();
+    void testCancel();
+
+private:
+    QString databasePath() const;
+    void fillHistorian(SqliteRepository& repo);
+    QString exportColumnar(SqliteRepository& repo, const QStringList& tags, int chunkRows);
+    
+    QTemporaryDir *m_tempDir;
+    QDateTime m_base;
+};
+
+void TestHistorianExporter::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+    m_base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+}
+
+void TestHistorianExporter::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestHistorianExporter::databasePath() const
+{
+    return m_tempDir->filePath("datapoints.db");
+}
+
+void TestHistorianExporter::fillHistorian(SqliteRepository& repo)
+{
+    // Three days of Flow every 30 s, a few Pressure samples and a text tag
+    QList<DataPoint> points;
+    for (int i = 0; i < 3 * 2880; ++i) {
+        points.append(DataPoint("Flow", 50.0 + std::sin(i / 100.0), m_base.addSecs(i * 30),
+                                i % 500 == 0 ? DataPoint::Quality::Uncertain : DataPoint::Quality::Good));
+    }
+    for (int i = 0; i < 10; ++i) {
+        points.append(DataPoint("Pressure", qint64(1000 + i), m_base.addSecs(i * 3600)));
+    }
+    points.append(DataPoint("Mode", QString("Auto, \"fast\""), m_base));
+    points.append(DataPoint("Mode", 2, m_base.addSecs(60)));
+    QVERIFY(repo.saveAll(points).isSuccess());
+}
+
+QString TestHistorianExporter::exportColumnar(SqliteRepository& repo, const QStringList& tags, int chunkRows)
+{
+    const QString path = m_tempDir->filePath("export.hcol");
+    HistorianExporter exporter(repo);
+    exporter.setChunkRows(chunkRows);
+    QSignalSpy finished(&exporter, &HistorianExporter::finished);
+    
+    if (exporter.start(path, tags).isFailure() || !exporter.waitForFinished(30000)) {
+        return QString();
+    }
+    QCoreApplication::processEvents();
+    return finished.count() == 1 ? path : QString();
+}
+
+void TestHistorianExporter::testColumnarRoundTrip()
+{
+    SqliteRepository repo(databasePath());
+    fillHistorian(repo);
+    
+    const QStringList tags = {"Flow", "Pressure", "Mode", "Missing"};
+    const QString path = m_tempDir->filePath("export.hcol");
+    HistorianExporter exporter(repo);
+    exporter.setChunkRows(1000);
+    QSignalSpy finished(&exporter, &HistorianExporter::finished);
+    QSignalSpy progress(&exporter, &HistorianExporter::progress);
+    
+    QVERIFY(exporter.start(path, QStringList()).isFailure());
+    QVERIFY(exporter.start(path, tags).isSuccess());
+    QVERIFY(exporter.waitForFinished(30000));
+    QTRY_COMPARE(finished.count(), 1);
+    QCOMPARE(finished.first().at(1).toLongLong(), qint64(3 * 2880 + 10 + 2));
+    QCOMPARE(progress.last().at(1).toInt(), tags.size());
+    
+    HistorianExportReader reader;
+    QVERIFY(reader.open(path).isSuccess());
+    QCOMPARE(reader.tags(), tags);
+    QCOMPARE(reader.schema().value("version").toInt(), 1);
+    QCOMPARE(reader.schema().value("columns").toArray().size(), 4);
+    
+    // Reassemble every tag from its chunks and compare with the historian
+    QHash<QString, QList<DataPoint>> exported;
+    for (int i = 0; i < reader.chunks().size(); ++i) {
+        const HistorianExportReader::Chunk chunk = reader.chunks().at(i);
+        QVERIFY(chunk.rowCount >= 1 && chunk.rowCount <= 1000);
+        
+        auto samples = reader.readChunk(i);
+        QVERIFY(samples.isSuccess());
+        const QList<DataPoint> rows = samples.value();
+        QCOMPARE(rows.size(), chunk.rowCount);
+        QCOMPARE(rows.first().timestamp().toMSecsSinceEpoch(), chunk.firstMs);
+        QCOMPARE(rows.last().timestamp().toMSecsSinceEpoch(), chunk.lastMs);
+        exported[reader.tags().at(chunk.tagIndex)].append(rows);
+    }
+    QVERIFY(!exported.contains("Missing"));
+    
+    for (const QString& tag : {QString("Flow"), QString("Pressure"), QString("Mode")}) {
+        QList<DataPoint> stored = repo.findByTag(tag).value();
+        std::reverse(stored.begin(), stored.end());
+        const QList<DataPoint> rows = exported.value(tag);
+        QCOMPARE(rows.size(), stored.size());
+        for (int i = 0; i < rows.size(); ++i) {
+            QCOMPARE(rows.at(i).timestamp(), stored.at(i).timestamp());
+            QCOMPARE(rows.at(i).quality(), stored.at(i).quality());
+            if (stored.at(i).value().userType() == QMetaType::QString) {
+                QCOMPARE(rows.at(i).value().toString(), stored.at(i).value().toString());
+            } else {
+                QCOMPARE(rows.at(i).value().toDouble(), stored.at(i).value().toDouble());
+            }
+        }
+    }
+    
+    // Columnar encoding beats the raw 17 bytes per sample by a wide margin
+    QVERIFY(QFileInfo(path).size() < exported.value("Flow").size() * 8);
+}
+
+void TestHistorianExporter::testCorruptChunkDetected()
+{
+    SqliteRepository repo(databasePath());
+    fillHistorian(repo);
+    const QString path = exportColumnar(repo, {"Flow"}, 2000);
+    QVERIFY(!path.isEmpty());
+    
+    HistorianExportReader reader;
+    QVERIFY(reader.open(path).isSuccess());
+    const qint64 offset = reader.chunks().at(1).offset + 64;
+    
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(offset);
+    const char byte = file.peek(1).at(0);
+    file.write(QByteArray(1, char(byte ^ 0xFF)));
+    file.close();
+    
+    QVERIFY(reader.open(path).isSuccess());
+    QVERIFY(reader.readChunk(0).isSuccess());
+    QVERIFY(reader.readChunk(1).isFailure());
+    
+    // A truncated file has no trailer
+    QVERIFY(file.resize(file.size() - 1));
+    QVERIFY(reader.open(path).isFailure());
+}
+
+void TestHistorianExporter::testCsvExport()
+{
+    SqliteRepository repo(databasePath());
+    fillHistorian(repo);
+    
+    const QString path = m_tempDir->filePath("export.csv");
+    HistorianExporter exporter(repo);
+    QSignalSpy finished(&exporter, &HistorianExporter::finished);
+    QVERIFY(exporter.start(path, {"Mode", "Pressure"}, m_base, m_base.addSecs(3600),
+                           HistorianExporter::Format::Csv).isSuccess());
+    QVERIFY(exporter.waitForFinished(30000));
+    QTRY_COMPARE(finished.count(), 1);
+    
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QList<QByteArray> lines = file.readAll().trimmed().split('\n');
+    QCOMPARE(lines.size(), 5);
+    QCOMPARE(lines.at(0), QByteArray("tag,timestamp,value,quality"));
+    QCOMPARE(lines.at(1), QByteArray("Mode,2023-11-14T22:13:20.000Z,\"Auto, \"\"fast\"\"\",Good"));
+    QCOMPARE(lines.at(2), QByteArray("Mode,2023-11-14T22:14:20.000Z,2,Good"));
+    QCOMPARE(lines.at(4), QByteArray("Pressure,2023-11-14T23:13:20.000Z,1001,Good"));
+}
+
+void TestHistorianExporter::testCancel()
+{
+    SqliteRepository repo(databasePath());
+    fillHistorian(repo);
+    
+    const QString path = m_tempDir->filePath("export.hcol");
+    HistorianExporter exporter(repo);
+    exporter.setChunkRows(1);
+    QSignalSpy failed(&exporter, &HistorianExporter::failed);
+    
+    QVERIFY(exporter.start(path, {"Flow"}).isSuccess());
+    exporter.cancel();
+    QVERIFY(exporter.waitForFinished(30000));
+    
+    QTRY_COMPARE(failed.count(), 1);
+    QVERIFY(!QFile::exists(path));
+}
+
+QTEST_MAIN(TestHistorianExporter)
+#include "test_historianexporter.moc"
@@ -0,0 +1,238 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QFile>
+#include "../src/services/historianimporter.h"
+#include "../src/services/historianexporter.h"
+#include "../src/repositories/sqliterepository.h"
+
+/**
+ * @brief Unit tests for the bulk historian import
+ * 
+ * Tests CSV parsing and rejection of bad rows, the round trip of a
+ * columnar export into another historian, resuming after cancellation
+ * and that rollups are rebuilt once the load is done.
+ */
+class TestHistorianImporter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testCsvImport();
+    void testColumnarImport();
+    void testResumeAfterCancel();
+    void testRollupsRebuilt();
+
+private:
+    QString writeFile(const QString& name, const QByteArray& content);
+    QByteArray flowCsv(int rows) const;
+    bool runImport(HistorianImporter& importer, const QString& path);
+    
+    QTemporaryDir *m_tempDir;
+    QDateTime m_base;
+};
+
+void TestHistorianImporter::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+    m_base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+}
+
+void TestHistorianImporter::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestHistorianImporter::writeFile(const QString& name, const QByteArray& content)
+{
+    const QString path = m_tempDir->filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size()) {
+        return QString();
+    }
+    return path;
+}
+
+QByteArray TestHistorianImporter::flowCsv(int rows) const
+{
+    // One sample per second, 0..5 repeating
+    QByteArray csv("timestamp,tag,value\n");
+    for (int i = 0; i < rows; ++i) {
+        csv += QByteArray::number(m_base.toMSecsSinceEpoch() + i * 1000LL) + ",Flow," + QByteArray::number(i % 6) + "\n";
+    }
+    return csv;
+}
+
+bool TestHistorianImporter::runImport(HistorianImporter& importer, const QString& path)
+{
+    return importer.start(path).isSuccess() && importer.waitForFinished(30000);
+}
+
+void TestHistorianImporter::testCsvImport()
+{
+    const QString path = writeFile("legacy.csv",
+        "tag,timestamp,value,quality,unit\r\n"
+        "Flow,1700000000000,12.5,Good,m3/h\r\n"
+        "Flow,2023-11-14T22:13:21.000Z,13,1,m3/h\r\n"
+        "\"Mode, main\",1700000000000,\"Auto\n\"\"fast\"\"\",Bad,\r\n"
+        "Flow,yesterday,14,Good,m3/h\r\n"
+        "Flow,1700000002000,15,Excellent,m3/h\r\n"
+        "Flow,1700000003000\r\n");
+    QVERIFY(!path.isEmpty());
+    
+    SqliteRepository repo(m_tempDir->filePath("datapoints.db"));
+    HistorianImporter importer(repo);
+    QSignalSpy finished(&importer, &HistorianImporter::finished);
+    
+    QVERIFY(importer.start(m_tempDir->filePath("missing.csv")).isFailure());
+    QVERIFY(runImport(importer, path));
+    QTRY_COMPARE(finished.count(), 1);
+    QCOMPARE(finished.first().at(0).toLongLong(), qint64(3));
+    QCOMPARE(finished.first().at(1).toLongLong(), qint64(3));
+    QVERIFY(!QFile::exists(importer.checkpointPath()));
+    
+    const QList<DataPoint> flow = repo.findByTag("Flow").value();
+    QCOMPARE(flow.size(), 2);
+    QCOMPARE(flow.at(0).value().toLongLong(), qint64(13));
+    QCOMPARE(flow.at(0).quality(), DataPoint::Quality::Uncertain);
+    QCOMPARE(flow.at(0).timestamp(), m_base.addSecs(1));
+    QCOMPARE(flow.at(1).value().toDouble(), 12.5);
+    
+    const QList<DataPoint> mode = repo.findByTag("Mode, main").value();
+    QCOMPARE(mode.size(), 1);
+    QCOMPARE(mode.first().value().toString(), QString("Auto\n\"fast\""));
+    QCOMPARE(mode.first().quality(), DataPoint::Quality::Bad);
+    
+    // A file without the required columns is refused
+    QSignalSpy failed(&importer, &HistorianImporter::failed);
+    QVERIFY(runImport(importer, writeFile("other.csv", "time,value\n1,2\n")));
+    QTRY_COMPARE(failed.count(), 1);
+}
+
+void TestHistorianImporter::testColumnarImport()
+{
+    SqliteRepository source(m_tempDir->filePath("source.db"));
+    QList<DataPoint> points;
+    for (int i = 0; i < 3 * 2880; ++i) {
+        points.append(DataPoint("Flow", 50.0 + i * 0.25, m_base.addSecs(i * 30)));
+    }
+    points.append(DataPoint("Mode", QString("Auto"), m_base, DataPoint::Quality::Stale));
+    QVERIFY(source.saveAll(points).isSuccess());
+    
+    const QString path = m_tempDir->filePath("export.hcol");
+    HistorianExporter exporter(source);
+    exporter.setChunkRows(1000);
+    QVERIFY(exporter.start(path, {"Flow", "Mode"}).isSuccess());
+    QVERIFY(exporter.waitForFinished(30000));
+    QVERIFY(QFile::exists(path));
+    
+    SqliteRepository target(m_tempDir->filePath("target.db"));
+    HistorianImporter importer(target);
+    importer.setBatchRows(2500);
+    QSignalSpy finished(&importer, &HistorianImporter::finished);
+    QSignalSpy progress(&importer, &HistorianImporter::progress);
+    QVERIFY(runImport(importer, path));
+    QTRY_COMPARE(finished.count(), 1);
+    QCOMPARE(finished.first().at(0).toLongLong(), qint64(points.size()));
+    QVERIFY(progress.count() >= 3);
+    QCOMPARE(progress.last().at(1).toLongLong(), progress.last().at(2).toLongLong());
+    
+    QCOMPARE(target.count(), source.count());
+    const QList<DataPoint> imported = target.findByTag("Flow").value();
+    const QList<DataPoint> original = source.findByTag("Flow").value();
+    QCOMPARE(imported.size(), original.size());
+    for (int i = 0; i < imported.size(); ++i) {
+        QCOMPARE(imported.at(i).timestamp(), original.at(i).timestamp());
+        QCOMPARE(imported.at(i).value().toDouble(), original.at(i).value().toDouble());
+    }
+    
+    const DataPoint mode = target.findLatestByTag("Mode").value();
+    QCOMPARE(mode.value().toString(), QString("Auto"));
+    QCOMPARE(mode.quality(), DataPoint::Quality::Stale);
+}
+
+void TestHistorianImporter::testResumeAfterCancel()
+{
+    const QString path = writeFile("flow.csv", flowCsv(10000));
+    SqliteRepository repo(m_tempDir->filePath("datapoints.db"));
+    
+    {
+        HistorianImporter importer(repo);
+        importer.setBatchRows(1000);
+        QSignalSpy failed(&importer, &HistorianImporter::failed);
+        
+        // Stop right after the third batch is committed
+        connect(&importer, &HistorianImporter::progress, &importer,
+                [&importer](qint64 rowsImported) {
+                    if (rowsImported >= 3000) {
+                        importer.cancel();
+                    }
+                }, Qt::DirectConnection);
+        
+        QVERIFY(runImport(importer, path));
+        QTRY_COMPARE(failed.count(), 1);
+        QVERIFY(QFile::exists(importer.checkpointPath()));
+        QCOMPARE(repo.count(), 3000);
+    }
+    
+    HistorianImporter importer(repo);
+    importer.setBatchRows(1000);
+    QSignalSpy finished(&importer, &HistorianImporter::finished);
+    QSignalSpy progress(&importer, &HistorianImporter::progress);
+    QVERIFY(runImport(importer, path));
+    QTRY_COMPARE(finished.count(), 1);
+    
+    // Only the remaining batches were read again
+    QCOMPARE(progress.count(), 7);
+    QCOMPARE(finished.first().at(0).toLongLong(), qint64(10000));
+    QCOMPARE(repo.count(), 10000);
+    QVERIFY(!QFile::exists(importer.checkpointPath()));
+    
+    // A changed file starts over instead of resuming
+    QVERIFY(!writeFile("flow.csv", flowCsv(500)).isEmpty());
+    QVERIFY(runImport(importer, path));
+    QTRY_COMPARE(finished.count(), 2);
+    QCOMPARE(finished.last().at(0).toLongLong(), qint64(500));
+}
+
+void TestHistorianImporter::testRollupsRebuilt()
+{
+    m_base = QDateTime::fromMSecsSinceEpoch(1700002800000);  // Hour aligned, crosses midnight
+    const QString path = writeFile("flow.csv", flowCsv(7200));
+    SqliteRepository repo(m_tempDir->filePath("datapoints.db"));
+    
+    HistorianImporter importer(repo);
+    importer.setBatchRows(500);
+    QSignalSpy finished(&importer, &HistorianImporter::finished);
+    QVERIFY(runImport(importer, path));
+    QTRY_COMPARE(finished.count(), 1);
+    
+    // Minute rollups cover every imported sample exactly once
+    auto trend = repo.findTrend("Flow", m_base, m_base.addSecs(7199), 100);
+    QVERIFY(trend.isSuccess());
+    const QList<TrendBucket> buckets = trend.value();
+    QCOMPARE(buckets.size(), 120);
+    
+    int total = 0;
+    for (const TrendBucket& bucket : buckets) {
+        total += bucket.count;
+        QCOMPARE(bucket.widthMs, qint64(60000));
+        QCOMPARE(bucket.min, 0.0);
+        QCOMPARE(bucket.max, 5.0);
+    }
+    QCOMPARE(total, 7200);
+    
+    // Regular writes maintain rollups again
+    QVERIFY(repo.save(DataPoint("Flow", 9, m_base.addSecs(7200))).isSuccess());
+    trend = repo.findTrend("Flow", m_base, m_base.addSecs(7259), 100);
+    QVERIFY(trend.isSuccess());
+    QCOMPARE(trend.value().last().max, 9.0);
+}
+
+QTEST_MAIN(TestHistorianImporter)
+#include "test_historianimporter.moc"
@@ -0,0 +1,185 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include "../src/repositories/historianspool.h"
+
+/**
+ * @brief Unit tests for the store-and-forward spool
+ * 
+ * Tests ordering, persistence across reopen, wrap-around, the size bound
+ * and recovery from a torn append.
+ */
+class TestHistorianSpool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testAppendPeekConsume();
+    void testReopen();
+    void testWrapAround();
+    void testFull();
+    void testTornRecord();
+
+private:
+    QString spoolPath() const;
+    static QList<DataPoint> makeSamples(int first, int count);
+    
+    QTemporaryDir *m_tempDir;
+};
+
+void TestHistorianSpool::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestHistorianSpool::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestHistorianSpool::spoolPath() const
+{
+    return m_tempDir->filePath("datapoints.db.spool");
+}
+
+QList<DataPoint> TestHistorianSpool::makeSamples(int first, int count)
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000LL);
+    QList<DataPoint> samples;
+    for (int i = first; i < first + count; ++i) {
+        samples.append(DataPoint("Pressure", i, base.addMSecs(i), DataPoint::Quality::Uncertain));
+    }
+    return samples;
+}
+
+void TestHistorianSpool::testAppendPeekConsume()
+{
+    HistorianSpool spool(spoolPath(), 64 * 1024);
+    QVERIFY(spool.isOpen());
+    QCOMPARE(spool.depth(), 0);
+    QCOMPARE(spool.usedBytes(), qint64(0));
+    
+    QVERIFY(spool.append(makeSamples(0, 10)).isSuccess());
+    QCOMPARE(spool.depth(), 10);
+    QVERIFY(spool.usedBytes() > 0);
+    
+    // Peeking does not remove anything
+    QList<DataPoint> head = spool.peek(3);
+    QCOMPARE(head.size(), 3);
+    QCOMPARE(head.at(0).value().toInt(), 0);
+    QCOMPARE(head.at(2).value().toInt(), 2);
+    QCOMPARE(head.at(2).tag(), QString("Pressure"));
+    QCOMPARE(head.at(2).timestamp(), makeSamples(2, 1).first().timestamp());
+    QCOMPARE(head.at(2).quality(), DataPoint::Quality::Uncertain);
+    QCOMPARE(spool.depth(), 10);
+    
+    spool.consume(3);
+    QCOMPARE(spool.depth(), 7);
+    QCOMPARE(spool.peek(1).first().value().toInt(), 3);
+    
+    spool.consume(100);
+    QCOMPARE(spool.depth(), 0);
+    QCOMPARE(spool.usedBytes(), qint64(0));
+    QVERIFY(spool.peek(10).isEmpty());
+}
+
+void TestHistorianSpool::testReopen()
+{
+    {
+        HistorianSpool spool(spoolPath(), 64 * 1024);
+        QVERIFY(spool.append(makeSamples(0, 50)).isSuccess());
+        spool.consume(20);
+    }
+    
+    // Existing journals keep their size and content
+    HistorianSpool spool(spoolPath(), 1024 * 1024);
+    QCOMPARE(spool.capacityBytes(), qint64(64 * 1024));
+    QCOMPARE(spool.depth(), 30);
+    
+    QList<DataPoint> samples = spool.peek(100);
+    QCOMPARE(samples.size(), 30);
+    for (int i = 0; i < samples.size(); ++i) {
+        QCOMPARE(samples.at(i).value().toInt(), 20 + i);
+    }
+}
+
+void TestHistorianSpool::testWrapAround()
+{
+    // Push several times the journal size through it, reopening in between
+    int nextIn = 0;
+    int nextOut = 0;
+    for (int round = 0; round < 20; ++round) {
+        HistorianSpool spool(spoolPath(), 8 * 1024);
+        QCOMPARE(spool.depth(), nextIn - nextOut);
+        
+        while (spool.append(makeSamples(nextIn, 7)).isSuccess()) {
+            nextIn += 7;
+        }
+        
+        const QList<DataPoint> samples = spool.peek(spool.depth() / 2 + 1);
+        for (const DataPoint& sample : samples) {
+            QCOMPARE(sample.value().toInt(), nextOut++);
+        }
+        spool.consume(samples.size());
+    }
+    
+    HistorianSpool spool(spoolPath());
+    const QList<DataPoint> rest = spool.peek(spool.depth());
+    QCOMPARE(rest.size(), nextIn - nextOut);
+    for (const DataPoint& sample : rest) {
+        QCOMPARE(sample.value().toInt(), nextOut++);
+    }
+}
+
+void TestHistorianSpool::testFull()
+{
+    HistorianSpool spool(spoolPath(), 8 * 1024);
+    
+    int appended = 0;
+    while (spool.append(makeSamples(appended, 10)).isSuccess()) {
+        appended += 10;
+    }
+    QVERIFY(appended > 0);
+    QCOMPARE(spool.depth(), appended);
+    QVERIFY(spool.usedBytes() <= spool.capacityBytes());
+    
+    // A rejected batch leaves nothing behind, and consuming makes room again
+    spool.consume(10);
+    QVERIFY(spool.append(makeSamples(appended, 5)).isSuccess());
+    QCOMPARE(spool.depth(), appended - 5);
+    QCOMPARE(spool.peek(spool.depth()).last().value().toInt(), appended + 4);
+}
+
+void TestHistorianSpool::testTornRecord()
+{
+    {
+        HistorianSpool spool(spoolPath(), 64 * 1024);
+        QVERIFY(spool.append(makeSamples(0, 5)).isSuccess());
+    }
+    
+    // Damage the last record's payload, as if the process died mid-append
+    QFile file(spoolPath());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    HistorianSpool reference(m_tempDir->filePath("reference.spool"), 64 * 1024);
+    QVERIFY(reference.append(makeSamples(0, 5)).isSuccess());
+    const qint64 lastRecordEnd = 64 + reference.usedBytes();
+    QVERIFY(file.seek(lastRecordEnd - 1));
+    QVERIFY(file.putChar('\x7f'));
+    file.close();
+    
+    HistorianSpool spool(spoolPath(), 64 * 1024);
+    QCOMPARE(spool.depth(), 4);
+    QCOMPARE(spool.peek(4).last().value().toInt(), 3);
+    
+    // Appends continue after the last intact record
+    QVERIFY(spool.append(makeSamples(100, 1)).isSuccess());
+    QCOMPARE(spool.peek(5).last().value().toInt(), 100);
+}
+
+QTEST_MAIN(TestHistorianSpool)
+#include "test_historianspool.moc"
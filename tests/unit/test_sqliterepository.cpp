@@ -0,0 +1,639 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "../src/repositories/sqliterepository.h"
+
+/**
+ * @brief Unit tests for the SQLite historian repository
+ * 
+ * Tests the typed schema, tag dictionary, time-range queries, paged
+ * cursors, per-thread reader connections, the store-and-forward spool and
+ * the in-place migration of legacy databases.
+ */
+class TestSqliteRepository : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    // Schema Tests
+    void testSaveAndFindById();
+    void testTypedValuesRoundTrip();
+    void testMillisecondTimestamps();
+    void testTagAndTimeRangeQueries();
+    void testDeleteOlderThan();
+    void testPartitionRetention();
+    void testClearWithAttachedReader();
+    void testTrendRollups();
+    void testTrendDuringBulkLoad();
+    void testCursorPaging();
+    void testConcurrentReaders();
+    void testWritesFromWorkerThreads();
+    void testLatestValueCache();
+    void testResample();
+    void testStoreAndForward();
+    
+    // Migration Tests
+    void testMigrationFromV1();
+
+private:
+    QString databasePath() const;
+    
+    QTemporaryDir *m_tempDir;
+};
+
+void TestSqliteRepository::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestSqliteRepository::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestSqliteRepository::databasePath() const
+{
+    return m_tempDir->filePath("historian.db");
+}
+
+void TestSqliteRepository::testSaveAndFindById()
+{
+    SqliteRepository repo(databasePath());
+    QVERIFY(repo.isConnected());
+    
+    const QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(1700000000123);
+    QVERIFY(repo.save(DataPoint("Temperature", 42.5, timestamp)).isSuccess());
+    QCOMPARE(repo.count(), 1);
+    
+    auto found = repo.findById(SqliteRepository::makeId("Temperature", timestamp));
+    QVERIFY(found.isSuccess());
+    QCOMPARE(found.value().tag(), QString("Temperature"));
+    QCOMPARE(found.value().toDouble(), 42.5);
+    
+    QVERIFY(repo.deleteById(SqliteRepository::makeId("Temperature", timestamp)).isSuccess());
+    QCOMPARE(repo.count(), 0);
+    QVERIFY(repo.findById("Temperature@not-a-timestamp").isFailure());
+}
+
+void TestSqliteRepository::testTypedValuesRoundTrip()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    QVERIFY(repo.save(DataPoint("Int", 65535, base)).isSuccess());
+    QVERIFY(repo.save(DataPoint("Real", 0.1, base)).isSuccess());
+    QVERIFY(repo.save(DataPoint("Text", QString("RUNNING"), base)).isSuccess());
+    
+    QCOMPARE(repo.findLatestByTag("Int").value().value().toLongLong(), 65535LL);
+    QCOMPARE(repo.findLatestByTag("Real").value().value().toDouble(), 0.1);
+    QCOMPARE(repo.findLatestByTag("Text").value().value().toString(), QString("RUNNING"));
+}
+
+void TestSqliteRepository::testMillisecondTimestamps()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    // Samples within the same second must stay distinct
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(repo.save(DataPoint("EEG", i, base.addMSecs(i * 100))).isSuccess());
+    }
+    
+    auto points = repo.findByTag("EEG");
+    QVERIFY(points.isSuccess());
+    QCOMPARE(points.value().size(), 10);
+    QCOMPARE(points.value().first().timestamp(), base.addMSecs(900));
+}
+
+void TestSqliteRepository::testTagAndTimeRangeQueries()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    for (int i = 0; i < 20; ++i) {
+        repo.save(DataPoint("A", i, base.addSecs(i)));
+        repo.save(DataPoint("B", i * 2, base.addSecs(i)));
+    }
+    
+    auto range = repo.findByTimeRange(base.addSecs(5), base.addSecs(9));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 10);
+    
+    auto tagRange = repo.findByTagAndTimeRange("B", base.addSecs(5), base.addSecs(9));
+    QVERIFY(tagRange.isSuccess());
+    QCOMPARE(tagRange.value().size(), 5);
+    QCOMPARE(tagRange.value().first().value().toInt(), 18);
+    
+    auto unknown = repo.findByTag("Unknown");
+    QVERIFY(unknown.isSuccess());
+    QVERIFY(unknown.value().isEmpty());
+}
+
+void TestSqliteRepository::testDeleteOlderThan()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime now = QDateTime::currentDateTime();
+    
+    repo.save(DataPoint("A", 1, now.addDays(-10)));
+    repo.save(DataPoint("A", 2, now.addDays(-1)));
+    repo.save(DataPoint("B", 3, now));
+    
+    // Samples around the cutoff, every 10 minutes
+    const QDateTime cutoff = now.addDays(-5);
+    for (int i = -12; i < 12; ++i) {
+        repo.save(DataPoint("C", i, cutoff.addSecs(i * 600 + 30)));
+    }
+    
+    QVERIFY(repo.deleteOlderThan(5).isSuccess());
+    auto remaining = repo.findByTag("C");
+    QVERIFY(remaining.isSuccess());
+    QVERIFY(remaining.value().size() >= 12 && remaining.value().size() < 24);
+    QCOMPARE(repo.count(), 2 + remaining.value().size());
+    
+    // Rollup buckets no longer count the trimmed samples
+    auto trend = repo.findTrend("C", cutoff.addSecs(-3 * 3600), cutoff.addSecs(3 * 3600), 2);
+    QVERIFY(trend.isSuccess());
+    int total = 0;
+    for (const TrendBucket& bucket : trend.value()) {
+        QVERIFY(bucket.widthMs > 0);
+        total += bucket.count;
+    }
+    QCOMPARE(total, remaining.value().size());
+}
+
+void TestSqliteRepository::testPartitionRetention()
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QDir partitionDir(databasePath() + ".partitions");
+    
+    {
+        SqliteRepository repo(databasePath());
+        for (int day = 0; day < 12; ++day) {
+            QVERIFY(repo.save(DataPoint("A", day, now.addDays(-day).addSecs(3600))).isSuccess());
+        }
+        QCOMPARE(partitionDir.entryList({"*.db"}, QDir::Files).size(), 12);
+    }
+    
+    // Reopen: the manifest is loaded without attaching every partition
+    SqliteRepository repo(databasePath());
+    QCOMPARE(repo.count(), 12);
+    
+    auto range = repo.findByTagAndTimeRange("A", now.addDays(-3), now.addSecs(7200));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 4);
+    QCOMPARE(range.value().first().value().toInt(), 0);
+    
+    QVERIFY(repo.deleteOlderThan(5).isSuccess());
+    QCOMPARE(repo.count(), 6);
+    QVERIFY(partitionDir.entryList({"*.db"}, QDir::Files).size() < 12);
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 0);
+}
+
+void TestSqliteRepository::testClearWithAttachedReader()
+{
+    SqliteRepository repo(databasePath());
+    const QDir partitionDir(databasePath() + ".partitions");
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    
+    // This thread's reader has today's partition attached
+    QVERIFY(repo.save(DataPoint("A", 1, now)).isSuccess());
+    QCOMPARE(repo.findByTagAndTimeRange("A", now.addSecs(-60), now.addSecs(60)).value().size(), 1);
+    
+    // The file stays until the reader lets go; today gets a new file
+    QVERIFY(repo.clear().isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 2, now.addMSecs(1))).isSuccess());
+    QCOMPARE(partitionDir.entryList({"*.db"}, QDir::Files).size(), 2);
+    
+    const auto range = repo.findByTagAndTimeRange("A", now.addSecs(-60), now.addSecs(60));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 1);
+    QCOMPARE(range.value().first().value().toInt(), 2);
+    QCOMPARE(partitionDir.entryList({"*.db"}, QDir::Files).size(), 1);
+    
+    // Partition files the manifest does not list are removed on startup
+    QFile orphan(partitionDir.filePath("2000-01-01.db"));
+    QVERIFY(orphan.open(QIODevice::WriteOnly));
+    orphan.close();
+    SqliteRepository reopened(databasePath());
+    QVERIFY(!orphan.exists());
+    QCOMPARE(reopened.count(), 1);
+}
+
+void TestSqliteRepository::testTrendRollups()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700002800000);  // Hour aligned
+    
+    // Two hours of samples every 10 seconds
+    for (int i = 0; i < 720; ++i) {
+        QVERIFY(repo.save(DataPoint("Flow", i % 6, base.addSecs(i * 10))).isSuccess());
+    }
+    
+    QCOMPARE(SqliteRepository::rollupTierFor(7200000, 100), qint64(60000));
+    QCOMPARE(SqliteRepository::rollupTierFor(7200000, 2), qint64(3600000));
+    QCOMPARE(SqliteRepository::rollupTierFor(60000, 100), qint64(0));
+    
+    auto trend = repo.findTrend("Flow", base, base.addSecs(7199), 100);
+    QVERIFY(trend.isSuccess());
+    QCOMPARE(trend.value().size(), 120);
+    
+    int total = 0;
+    for (const TrendBucket& bucket : trend.value()) {
+        total += bucket.count;
+        QCOMPARE(bucket.widthMs, qint64(60000));
+        QCOMPARE(bucket.min, 0.0);
+        QCOMPARE(bucket.max, 5.0);
+        QCOMPARE(bucket.first, 0.0);
+        QCOMPARE(bucket.last, 5.0);
+    }
+    QCOMPARE(total, 720);
+    QCOMPARE(trend.value().first().average(), 2.5);
+    
+    // A replaced sample is counted once with its new value
+    QVERIFY(repo.save(DataPoint("Flow", 10, base)).isSuccess());
+    trend = repo.findTrend("Flow", base, base.addSecs(7199), 100);
+    QVERIFY(trend.isSuccess());
+    QCOMPARE(trend.value().first().count, 6);
+    QCOMPARE(trend.value().first().max, 10.0);
+    QCOMPARE(trend.value().first().first, 10.0);
+    QCOMPARE(trend.value().first().min, 1.0);
+    
+    // A deleted sample leaves its bucket
+    QVERIFY(repo.deleteById(SqliteRepository::makeId("Flow", base.addSecs(10))).isSuccess());
+    trend = repo.findTrend("Flow", base, base.addSecs(7199), 100);
+    QVERIFY(trend.isSuccess());
+    QCOMPARE(trend.value().first().count, 5);
+    QCOMPARE(trend.value().first().min, 2.0);
+    
+    // Short ranges fall back to raw samples
+    auto raw = repo.findTrend("Flow", base, base.addSecs(99), 100);
+    QVERIFY(raw.isSuccess());
+    QCOMPARE(raw.value().size(), 10);
+    QCOMPARE(raw.value().first().widthMs, qint64(0));
+}
+
+void TestSqliteRepository::testTrendDuringBulkLoad()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700002800000);  // Hour aligned
+    
+    // Ten minutes of samples every second, loaded without rollups
+    QList<DataPoint> batch;
+    for (int i = 0; i < 600; ++i) {
+        batch.append(DataPoint("Flow", i % 6, base.addSecs(i)));
+    }
+    repo.beginBulkLoad();
+    QVERIFY(repo.importSamples(batch).isSuccess());
+    QVERIFY(repo.deleteById(SqliteRepository::makeId("Flow", base)).isSuccess());
+    
+    // Answered from the raw samples until the rollups are rebuilt
+    for (int pass = 0; pass < 2; ++pass) {
+        auto trend = repo.findTrend("Flow", base, base.addSecs(600), 10);
+        QVERIFY(trend.isSuccess());
+        QCOMPARE(trend.value().size(), 10);
+        QCOMPARE(trend.value().first().widthMs, qint64(60000));
+        QCOMPARE(trend.value().first().count, 59);
+        QCOMPARE(trend.value().first().first, 1.0);
+        QCOMPARE(trend.value().last().count, 60);
+        QCOMPARE(trend.value().last().min, 0.0);
+        QCOMPARE(trend.value().last().max, 5.0);
+        QCOMPARE(trend.value().last().lastMs, base.addSecs(599).toMSecsSinceEpoch());
+        
+        if (pass == 0) {
+            QVERIFY(repo.endBulkLoad().isSuccess());
+        }
+    }
+}
+
+void TestSqliteRepository::testCursorPaging()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    for (int i = 0; i < 25; ++i) {
+        repo.save(DataPoint("A", i, base.addSecs(i)));
+        repo.save(DataPoint("B", i, base.addSecs(i)));
+    }
+    
+    auto cursor = repo.openCursor("A", base, base.addSecs(24), 10);
+    QList<int> pageSizes;
+    while (!cursor->atEnd()) {
+        auto page = cursor->fetchNext();
+        QVERIFY(page.isSuccess());
+        pageSizes.append(page.value().size());
+        if (pageSizes.size() == 1) {
+            QCOMPARE(page.value().first().value().toInt(), 24);
+        }
+    }
+    QCOMPARE(pageSizes, QList<int>({10, 10, 5}));
+    QCOMPARE(cursor->rowsFetched(), qint64(25));
+    
+    // Ascending order across pages
+    auto ascending = repo.openCursor("B", base.addSecs(5), QDateTime(), 4, true);
+    QList<int> values;
+    while (!ascending->atEnd()) {
+        for (const DataPoint& point : ascending->fetchNext().value()) {
+            values.append(point.value().toInt());
+        }
+    }
+    QCOMPARE(values.size(), 20);
+    QCOMPARE(values.first(), 5);
+    QCOMPARE(values.last(), 24);
+    QVERIFY(std::is_sorted(values.begin(), values.end()));
+    
+    // Writes are not blocked by an open cursor
+    auto all = repo.openCursor(QString(), QDateTime(), QDateTime(), 10);
+    QCOMPARE(all->fetchNext().value().size(), 10);
+    QVERIFY(repo.save(DataPoint("A", 99, base.addSecs(30))).isSuccess());
+    
+    all->cancel();
+    QVERIFY(all->atEnd());
+    QVERIFY(all->fetchNext().isFailure());
+    
+    QVERIFY(repo.openCursor("Unknown")->fetchNext().value().isEmpty());
+}
+
+void TestSqliteRepository::testConcurrentReaders()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    repo.save(DataPoint("A", 0, base));
+    
+    const auto readerConnections = []() {
+        return QSqlDatabase::connectionNames().filter("-reader-").size();
+    };
+    const int connectionsBefore = readerConnections();
+    
+    std::atomic<int> failedReads(0);
+    std::atomic<int> readerConnectionsSeen(0);
+    QThread* readerThread = QThread::create([&]() {
+        for (int i = 0; i < 50; ++i) {
+            if (repo.findLatestByTag("A").isFailure() || repo.findTrend("A", base, base.addSecs(100), 10).isFailure()) {
+                ++failedReads;
+            }
+        }
+        readerConnectionsSeen = readerConnections();
+    });
+    readerThread->start();
+    
+    // Writes proceed while the other thread reads on its own connection
+    for (int i = 1; i <= 50; ++i) {
+        QVERIFY(repo.save(DataPoint("A", i, base.addSecs(i))).isSuccess());
+    }
+    
+    QVERIFY(readerThread->wait(10000));
+    delete readerThread;
+    
+    QCOMPARE(failedReads.load(), 0);
+    QCOMPARE(readerConnectionsSeen.load(), connectionsBefore + 1);
+    QCOMPARE(readerConnections(), connectionsBefore);   // Released when the thread finished
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 50);
+}
+
+void TestSqliteRepository::testWritesFromWorkerThreads()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    // Each call is handed to the repository's writer thread
+    std::atomic<int> failedWrites(0);
+    QList<QThread*> writers;
+    for (int t = 0; t < 2; ++t) {
+        writers.append(QThread::create([&repo, &failedWrites, base, t]() {
+            const QString tag = QString("W%1").arg(t);
+            for (int i = 0; i < 50; ++i) {
+                if (repo.save(DataPoint(tag, i, base.addSecs(i))).isFailure()) {
+                    ++failedWrites;
+                }
+            }
+            if (repo.deleteById(SqliteRepository::makeId(tag, base)).isFailure()) {
+                ++failedWrites;
+            }
+        }));
+        writers.last()->start();
+    }
+    
+    for (QThread* writer : qAsConst(writers)) {
+        QVERIFY(writer->wait(10000));
+        delete writer;
+    }
+    
+    QCOMPARE(failedWrites.load(), 0);
+    QCOMPARE(repo.count(), 98);
+    QCOMPARE(repo.findLatestByTag("W1").value().value().toInt(), 49);
+}
+
+void TestSqliteRepository::testLatestValueCache()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    {
+        SqliteRepository repo(databasePath());
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(repo.save(DataPoint("A", i, base.addSecs(i * 3600))).isSuccess());
+        }
+        QVERIFY(repo.save(DataPoint("B", 1.5, base.addDays(-3))).isSuccess());
+        
+        // An out-of-order sample does not replace the newer one
+        QVERIFY(repo.save(DataPoint("A", -1, base.addSecs(-60))).isSuccess());
+        QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 9);
+    }
+    
+    // Rebuilt at startup, including tags that only exist in older partitions
+    SqliteRepository repo(databasePath());
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 9);
+    QCOMPARE(repo.findLatestByTag("B").value().value().toDouble(), 1.5);
+    QVERIFY(repo.findLatestByTag("Missing").isFailure());
+    
+    // Deleting the cached sample falls back to the previous one on disk
+    QVERIFY(repo.deleteById(SqliteRepository::makeId("A", base.addSecs(9 * 3600))).isSuccess());
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 8);
+    
+    QVERIFY(repo.saveAll({DataPoint("A", 10, base.addSecs(10 * 3600)), DataPoint("B", 2.5, base)}).isSuccess());
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 10);
+    QCOMPARE(repo.findLatestByTag("B").value().value().toDouble(), 2.5);
+    
+    QVERIFY(repo.clear().isSuccess());
+    QVERIFY(repo.findLatestByTag("A").isFailure());
+}
+
+void TestSqliteRepository::testResample()
+{
+    SqliteRepository repo(databasePath());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700002800000);
+    
+    // A: step signal sampled irregularly, with a sample before the grid
+    QVERIFY(repo.save(DataPoint("A", 0, base.addSecs(-5))).isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 10, base.addSecs(10))).isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 40.0, base.addSecs(25))).isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 99, base.addSecs(30), DataPoint::Quality::Bad)).isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 10, base.addSecs(40))).isSuccess());
+    QVERIFY(repo.save(DataPoint("A", 30, base.addSecs(60))).isSuccess());
+    // B: starts inside the grid
+    QVERIFY(repo.save(DataPoint("B", 5, base.addSecs(20))).isSuccess());
+    
+    const QStringList tags = {"A", "B", "Missing"};
+    const QDateTime end = base.addSecs(40);
+    
+    auto previous = repo.resample(tags, base, end, 10000, ResampleMode::Previous);
+    QVERIFY(previous.isSuccess());
+    QCOMPARE(previous.value().slotCount(), 5);
+    QCOMPARE(previous.value().timestamps.last(), end.toMSecsSinceEpoch());
+    QCOMPARE(previous.value().values.size(), 3);
+    QCOMPARE(previous.value().values[0], QVector<double>({0, 10, 10, 40, 10}));
+    QVERIFY(std::isnan(previous.value().values[1][1]));
+    QCOMPARE(previous.value().values[1][2], 5.0);
+    QVERIFY(std::isnan(previous.value().values[2][0]));
+    
+    auto linear = repo.resample(tags, base, end, 10000, ResampleMode::Linear);
+    QVERIFY(linear.isSuccess());
+    QCOMPARE(linear.value().values[0][0], 10.0 / 3.0);
+    QCOMPARE(linear.value().values[0][2], 30.0);
+    QCOMPARE(linear.value().values[0][3], 30.0);
+    QCOMPARE(linear.value().values[0][4], 10.0);
+    
+    auto average = repo.resample(tags, base, end, 10000, ResampleMode::TimeWeightedAverage);
+    QVERIFY(average.isSuccess());
+    QCOMPARE(average.value().values[0], QVector<double>({0, 10, 25, 40, 10}));
+    QCOMPARE(average.value().values[1][2], 5.0);
+    
+    auto minMax = repo.resample(tags, base, end, 20000, ResampleMode::MinMax);
+    QVERIFY(minMax.isSuccess());
+    QCOMPARE(minMax.value().slotCount(), 3);
+    QCOMPARE(minMax.value().values[0][1], 40.0);
+    QCOMPARE(minMax.value().maxValues[0][1], 40.0);
+    QCOMPARE(minMax.value().values[0][2], 10.0);
+    QCOMPARE(minMax.value().maxValues[0][2], 10.0);     // Sample at 60 s is past the grid
+    
+    QVERIFY(repo.resample(tags, end, base, 10000, ResampleMode::Previous).isFailure());
+    QVERIFY(repo.resample(tags, base, end, 0, ResampleMode::Previous).isFailure());
+}
+
+void TestSqliteRepository::testStoreAndForward()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700002800000);  // Hour aligned
+    const QString partitionFile = databasePath() + ".partitions/"
+        + base.toUTC().toString("yyyy-MM-dd") + ".db";
+    
+    // A second connection holding the partition's write lock makes writes fail
+    QSqlDatabase locker = QSqlDatabase::addDatabase("QSQLITE", "spool-locker");
+    locker.setDatabaseName(partitionFile);
+    auto lockPartition = [&]() {
+        QVERIFY(locker.open());
+        QSqlQuery begin(locker);
+        QVERIFY(begin.exec("BEGIN EXCLUSIVE"));
+    };
+    auto unlockPartition = [&]() {
+        QSqlQuery rollback(locker);
+        QVERIFY(rollback.exec("ROLLBACK"));
+        locker.close();
+    };
+    
+    QList<DataPoint> firstBatch;
+    QList<DataPoint> secondBatch;
+    for (int i = 0; i < 50; ++i) {
+        firstBatch.append(DataPoint("Flow", i, base.addSecs(i)));
+        secondBatch.append(DataPoint("Flow", 100 + i, base.addSecs(100 + i)));
+    }
+    
+    {
+        SqliteRepository repo(databasePath());
+        QVERIFY(repo.save(DataPoint("Flow", -1, base.addSecs(-1))).isSuccess());
+        QVERIFY(!QFile::exists(databasePath() + ".spool"));
+        QCOMPARE(repo.spoolMetrics().capacityBytes, qint64(0));
+        
+        lockPartition();
+        QVERIFY(repo.saveAll(firstBatch).isSuccess());
+        QVERIFY(repo.save(DataPoint("Flow", 99, base.addSecs(99))).isSuccess());
+        QCOMPARE(repo.count(), 1);
+        
+        SpoolMetrics metrics = repo.spoolMetrics();
+        QCOMPARE(metrics.depth, 51);
+        QCOMPARE(metrics.spooledTotal, qint64(51));
+        QVERIFY(metrics.usedBytes > 0);
+        QVERIFY(metrics.capacityBytes > 0);
+        QVERIFY(!metrics.lastError.isEmpty());
+        
+        unlockPartition();
+        auto drained = repo.drainSpool();
+        QVERIFY(drained.isSuccess());
+        QCOMPARE(drained.value(), 51);
+        QCOMPARE(repo.count(), 52);
+        QCOMPARE(repo.findLatestByTag("Flow").value().value().toInt(), 99);
+        
+        metrics = repo.spoolMetrics();
+        QCOMPARE(metrics.depth, 0);
+        QCOMPARE(metrics.drainedTotal, qint64(51));
+        QVERIFY(metrics.drainRate > 0.0);
+        
+        // Spooled again while the repository shuts down
+        lockPartition();
+        QVERIFY(repo.saveAll(secondBatch).isSuccess());
+        QCOMPARE(repo.spoolMetrics().depth, 50);
+    }
+    unlockPartition();
+    
+    // Drained on startup
+    SqliteRepository repo(databasePath());
+    QCOMPARE(repo.spoolMetrics().depth, 0);
+    QCOMPARE(repo.count(), 102);
+    
+    // Replaying samples that are already stored does not inflate the rollups
+    QVERIFY(repo.saveAll(secondBatch).isSuccess());
+    auto trend = repo.findTrend("Flow", base, base.addSecs(3599), 1);
+    QVERIFY(trend.isSuccess());
+    QCOMPARE(trend.value().size(), 1);
+    QCOMPARE(trend.value().first().count, 101);
+    
+    locker = QSqlDatabase();
+    QSqlDatabase::removeDatabase("spool-locker");
+}
+
+void TestSqliteRepository::testMigrationFromV1()
+{
+    {
+        QSqlDatabase legacy = QSqlDatabase::addDatabase("QSQLITE", "legacy");
+        legacy.setDatabaseName(databasePath());
+        QVERIFY(legacy.open());
+        
+        QSqlQuery query(legacy);
+        QVERIFY(query.exec("CREATE TABLE datapoints (id INTEGER PRIMARY KEY AUTOINCREMENT, tag TEXT NOT NULL, "
+                           "value TEXT NOT NULL, timestamp INTEGER NOT NULL, quality INTEGER NOT NULL)"));
+        QVERIFY(query.exec("CREATE INDEX idx_tag ON datapoints(tag)"));
+        QVERIFY(query.exec("INSERT INTO datapoints (tag, value, timestamp, quality) VALUES "
+                           "('EEG', '12', 1700000000, 0), ('EEG', '13', 1700000000, 0), "
+                           "('Temperature', '21.5', 1700000001, 1), ('Mode', 'AUTO', 1700000002, 0)"));
+        legacy.close();
+    }
+    QSqlDatabase::removeDatabase("legacy");
+    
+    SqliteRepository repo(databasePath());
+    QVERIFY(repo.isConnected());
+    QCOMPARE(repo.count(), 4);
+    
+    // Two legacy rows in the same second survive as distinct milliseconds
+    auto eeg = repo.findByTag("EEG");
+    QVERIFY(eeg.isSuccess());
+    QCOMPARE(eeg.value().size(), 2);
+    QCOMPARE(eeg.value().first().value().toLongLong(), 13LL);
+    
+    auto temperature = repo.findLatestByTag("Temperature");
+    QVERIFY(temperature.isSuccess());
+    QCOMPARE(temperature.value().toDouble(), 21.5);
+    QCOMPARE(temperature.value().quality(), DataPoint::Quality::Uncertain);
+    
+    QCOMPARE(repo.findLatestByTag("Mode").value().toString(), QString("AUTO"));
+}
+
+QTEST_MAIN(TestSqliteRepository)
+#include "test_sqliterepository.moc"
@@ -0,0 +1,137 @@
+#include <QtTest/QtTest>
+#include <QThread>
+#include <memory>
+#include <vector>
+#include "../src/data/tagregistry.h"
+
+/**
+ * @brief Unit tests for the tag dictionary
+ * 
+ * Tests dense ID assignment, metadata updates, lookups by controller and
+ * concurrent interning.
+ */
+class TestTagRegistry : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testIntern();
+    void testDefine();
+    void testTagsOfController();
+    void testConcurrentIntern();
+};
+
+void TestTagRegistry::testIntern()
+{
+    TagRegistry registry;
+    QCOMPARE(registry.size(), 1);
+    
+    const quint32 flow = registry.intern("Flow");
+    const quint32 pressure = registry.intern("Pressure");
+    QCOMPARE(flow, quint32(1));
+    QCOMPARE(pressure, quint32(2));
+    QCOMPARE(registry.intern("Flow"), flow);
+    QCOMPARE(registry.size(), 3);
+    
+    QCOMPARE(registry.find("Pressure"), pressure);
+    QCOMPARE(registry.find("Level"), quint32(0));
+    QCOMPARE(registry.intern(QString()), quint32(0));
+    QCOMPARE(registry.size(), 3);
+    
+    QCOMPARE(registry.name(flow), QString("Flow"));
+    QCOMPARE(registry.name(0), QString());
+    QCOMPARE(registry.name(99), QString());
+    
+    // Interned tags carry default metadata
+    const TagInfo info = registry.info(flow);
+    QVERIFY(info.isValid());
+    QCOMPARE(info.id, flow);
+    QCOMPARE(info.address, -1);
+    QVERIFY(!registry.info(99).isValid());
+}
+
+void TestTagRegistry::testDefine()
+{
+    TagRegistry registry;
+    const quint32 flow = registry.intern("Flow");
+    
+    TagInfo info;
+    info.id = 42;       // Ignored
+    info.name = "Flow";
+    info.controller = "192.168.10.243";
+    info.address = 25;
+    info.type = TagInfo::ValueType::Int;
+    info.unit = "m3/h";
+    info.scanClass = 2;
+    info.deadband = 0.5;
+    QCOMPARE(registry.define(info), flow);
+    
+    const TagInfo stored = registry.info(flow);
+    QCOMPARE(stored.id, flow);
+    QCOMPARE(stored.controller, QString("192.168.10.243"));
+    QCOMPARE(stored.address, 25);
+    QCOMPARE(stored.type, TagInfo::ValueType::Int);
+    QCOMPARE(stored.unit, QString("m3/h"));
+    QCOMPARE(stored.scanClass, 2);
+    QCOMPARE(stored.deadband, 0.5);
+    
+    // Defining a new name registers it
+    info.name = "Level";
+    const quint32 level = registry.define(info);
+    QCOMPARE(level, quint32(2));
+    QCOMPARE(registry.find("Level"), level);
+    
+    info.name.clear();
+    QCOMPARE(registry.define(info), quint32(0));
+}
+
+void TestTagRegistry::testTagsOfController()
+{
+    TagRegistry registry;
+    
+    const QStringList names = {"A1", "B1", "A2"};
+    for (const QString& name : names) {
+        TagInfo info;
+        info.name = name;
+        info.controller = name.left(1);
+        registry.define(info);
+    }
+    registry.intern("Unassigned");
+    
+    const QVector<TagInfo> tags = registry.tagsOfController("A");
+    QCOMPARE(tags.size(), 2);
+    QCOMPARE(tags.at(0).name, QString("A1"));
+    QCOMPARE(tags.at(1).name, QString("A2"));
+    QCOMPARE(registry.tagsOfController("C").size(), 0);
+}
+
+void TestTagRegistry::testConcurrentIntern()
+{
+    TagRegistry registry;
+    const int threadCount = 4;
+    const int tagCount = 500;
+    
+    // Every thread interns the same names; each name must get one ID
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back(QThread::create([&registry, t]() {
+            for (int i = 0; i < tagCount; ++i) {
+                registry.intern(QString("Tag%1").arg((i * (t + 1)) % tagCount));
+            }
+        }));
+        threads.back()->start();
+    }
+    for (auto& thread : threads) {
+        QVERIFY(thread->wait(30000));
+    }
+    
+    QCOMPARE(registry.size(), tagCount + 1);
+    for (int i = 0; i < tagCount; ++i) {
+        const quint32 id = registry.find(QString("Tag%1").arg(i));
+        QVERIFY(id > 0 && id <= quint32(tagCount));
+        QCOMPARE(registry.name(id), QString("Tag%1").arg(i));
+    }
+}
+
+QTEST_MAIN(TestTagRegistry)
+#include "test_tagregistry.moc"
@@ -0,0 +1,247 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include "../src/repositories/tieredrepository.h"
+
+/**
+ * @brief Unit tests for the tiered RAM/SQLite historian
+ * 
+ * Tests that range queries merge both tiers without gaps or duplicates
+ * (including samples the ring never held), that recent ranges are served
+ * from RAM alone, that segments are flushed by size and by age, and that
+ * nothing is lost on shutdown.
+ */
+class TestTieredRepository : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testMergedRangeQuery();
+    void testSegmentFlushBySize();
+    void testSegmentFlushByAge();
+    void testFlushOnDestruction();
+    void testLatestFromHotTier();
+    void testNonGoodSamplesFromDisk();
+    void testRecentRangeFromRam();
+    void testOutOfOrderEviction();
+
+private:
+    QString databasePath() const;
+    
+    QTemporaryDir *m_tempDir;
+};
+
+void TestTieredRepository::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestTieredRepository::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestTieredRepository::databasePath() const
+{
+    return m_tempDir->filePath("historian.db");
+}
+
+void TestTieredRepository::testMergedRangeQuery()
+{
+    TieredRepository repo(databasePath(), 100);
+    repo.setSegmentSize(64);
+    
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    for (int i = 0; i < 300; ++i) {
+        QVERIFY(repo.save(DataPoint("Level", i, base.addSecs(i))).isSuccess());
+    }
+    
+    // Part of the data is on disk, part only in RAM, some in both
+    QVERIFY(repo.pendingCount() > 0);
+    
+    auto all = repo.findByTag("Level");
+    QVERIFY(all.isSuccess());
+    QCOMPARE(all.value().size(), 300);
+    for (int i = 0; i < 300; ++i) {
+        QCOMPARE(all.value().at(i).value().toInt(), 299 - i);
+    }
+    
+    // Range straddling the ring boundary
+    auto range = repo.findByTagAndTimeRange("Level", base.addSecs(150), base.addSecs(249));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 100);
+    QCOMPARE(range.value().first().value().toInt(), 249);
+    QCOMPARE(range.value().last().value().toInt(), 150);
+    
+    QVERIFY(repo.flush().isSuccess());
+    QCOMPARE(repo.pendingCount(), 0);
+    QCOMPARE(repo.count(), 300);
+    QCOMPARE(repo.findByTimeRange(base, base.addSecs(299)).value().size(), 300);
+}
+
+void TestTieredRepository::testSegmentFlushBySize()
+{
+    TieredRepository repo(databasePath(), 1000);
+    repo.setSegmentSize(10);
+    QSignalSpy flushed(&repo, &TieredRepository::segmentFlushed);
+    
+    const QDateTime base = QDateTime::currentDateTime();
+    for (int i = 0; i < 25; ++i) {
+        QVERIFY(repo.save(DataPoint("Speed", i, base.addMSecs(i))).isSuccess());
+    }
+    
+    QTRY_COMPARE(flushed.count(), 2);
+    QCOMPARE(repo.pendingCount(), 5);
+    QCOMPARE(repo.coldTier()->count(), 20);
+    QCOMPARE(repo.count(), 25);
+}
+
+void TestTieredRepository::testSegmentFlushByAge()
+{
+    TieredRepository repo(databasePath(), 1000);
+    repo.setMaxSegmentAge(100);
+    
+    QVERIFY(repo.save(DataPoint("Pressure", 1.5, QDateTime::currentDateTime())).isSuccess());
+    QCOMPARE(repo.pendingCount(), 1);
+    
+    QTRY_COMPARE_WITH_TIMEOUT(repo.pendingCount(), 0, 2000);
+    QCOMPARE(repo.coldTier()->count(), 1);
+}
+
+void TestTieredRepository::testFlushOnDestruction()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    {
+        TieredRepository repo(databasePath(), 1000);
+        for (int i = 0; i < 50; ++i) {
+            QVERIFY(repo.save(DataPoint("Flow", i * 0.5, base.addSecs(i))).isSuccess());
+        }
+    }
+    
+    {
+        SqliteRepository reopened(databasePath());
+        QCOMPARE(reopened.count(), 50);
+    }
+    
+    // The history of a previous run is on disk only
+    TieredRepository repo(databasePath(), 1000);
+    QVERIFY(repo.save(DataPoint("Flow", 99.0, base.addSecs(100))).isSuccess());
+    QCOMPARE(repo.findByTag("Flow").value().size(), 51);
+    QCOMPARE(repo.findByTimeRange(base.addSecs(40), base.addSecs(100)).value().size(), 11);
+}
+
+void TestTieredRepository::testLatestFromHotTier()
+{
+    TieredRepository repo(databasePath(), 10);
+    const QDateTime base = QDateTime::currentDateTime();
+    
+    QVERIFY(repo.save(DataPoint("Temp", 20.0, base)).isSuccess());
+    QVERIFY(repo.save(DataPoint("Temp", 21.0, base.addSecs(1), DataPoint::Quality::Bad)).isSuccess());
+    
+    // Non-Good samples skip the ring but are still the latest value
+    auto latest = repo.findLatestByTag("Temp");
+    QVERIFY(latest.isSuccess());
+    QCOMPARE(latest.value().toDouble(), 21.0);
+    
+    QVERIFY(repo.findLatestByTag("Missing").isFailure());
+}
+
+void TestTieredRepository::testNonGoodSamplesFromDisk()
+{
+    TieredRepository repo(databasePath(), 100);
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(repo.save(DataPoint("Flow", i, base.addSecs(i))).isSuccess());
+    }
+    
+    // Newer than the oldest sample in the ring, but never held by it
+    QVERIFY(repo.save(DataPoint("Flow", 99, base.addSecs(20), DataPoint::Quality::Bad)).isSuccess());
+    QVERIFY(repo.save(DataPoint("Flow", 42, base.addMSecs(5500), DataPoint::Quality::Uncertain)).isSuccess());
+    QVERIFY(repo.flush().isSuccess());
+    QCOMPARE(repo.pendingCount(), 0);
+    
+    auto range = repo.findByTagAndTimeRange("Flow", base.addSecs(5), base.addSecs(30));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 7);     // Good 5..9, Uncertain, Bad
+    QCOMPARE(range.value().first().quality(), DataPoint::Quality::Bad);
+    QCOMPARE(repo.findByTag("Flow").value().size(), 12);
+    
+    auto latest = repo.findLatestByTag("Flow");
+    QVERIFY(latest.isSuccess());
+    QCOMPARE(latest.value().toDouble(), 99.0);
+}
+
+void TestTieredRepository::testRecentRangeFromRam()
+{
+    TieredRepository repo(databasePath(), 100);
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(repo.save(DataPoint("Flow", i, base.addSecs(i))).isSuccess());
+    }
+    QVERIFY(repo.flush().isSuccess());
+    
+    // Written behind the repository's back: only a disk read can find it
+    QVERIFY(repo.coldTier()->save(DataPoint("Flow", -1, base.addMSecs(7500))).isSuccess());
+    
+    auto recent = repo.findByTagAndTimeRange("Flow", base.addSecs(5), base.addSecs(30));
+    QVERIFY(recent.isSuccess());
+    QCOMPARE(recent.value().size(), 5);
+    QCOMPARE(recent.value().first().value().toInt(), 9);
+    QCOMPARE(repo.findByTimeRange(base.addSecs(5), base.addSecs(30)).value().size(), 5);
+    
+    // A Bad sample is on disk only, so the range up to it is read from disk
+    QVERIFY(repo.save(DataPoint("Flow", 99, base.addSecs(20), DataPoint::Quality::Bad)).isSuccess());
+    QVERIFY(repo.flush().isSuccess());
+    
+    auto mixed = repo.findByTagAndTimeRange("Flow", base.addSecs(5), base.addSecs(30));
+    QVERIFY(mixed.isSuccess());
+    QCOMPARE(mixed.value().size(), 7);     // Good 5..9, the disk-only sample, Bad
+    QCOMPARE(mixed.value().first().quality(), DataPoint::Quality::Bad);
+    
+    // ... but not past it
+    QVERIFY(repo.save(DataPoint("Flow", 25, base.addSecs(25))).isSuccess());
+    QVERIFY(repo.flush().isSuccess());
+    QVERIFY(repo.coldTier()->save(DataPoint("Flow", -2, base.addSecs(26))).isSuccess());
+    
+    auto after = repo.findByTagAndTimeRange("Flow", base.addSecs(21), base.addSecs(30));
+    QVERIFY(after.isSuccess());
+    QCOMPARE(after.value().size(), 1);
+    QCOMPARE(after.value().first().value().toInt(), 25);
+}
+
+void TestTieredRepository::testOutOfOrderEviction()
+{
+    TieredRepository repo(databasePath(), 5);
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    for (int i = 10; i < 15; ++i) {
+        QVERIFY(repo.save(DataPoint("Level", i, base.addSecs(i))).isSuccess());
+    }
+    QVERIFY(repo.flush().isSuccess());
+    
+    // Late samples evict the oldest saved ones, which are newer than them
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(repo.save(DataPoint("Level", i, base.addSecs(i))).isSuccess());
+    }
+    QVERIFY(repo.flush().isSuccess());
+    
+    auto all = repo.findByTagAndTimeRange("Level", base, base.addSecs(20));
+    QVERIFY(all.isSuccess());
+    QCOMPARE(all.value().size(), 8);
+    QCOMPARE(all.value().first().value().toInt(), 14);
+    QCOMPARE(all.value().last().value().toInt(), 0);
+    
+    auto recent = repo.findByTagAndTimeRange("Level", base.addSecs(11), base.addSecs(20));
+    QVERIFY(recent.isSuccess());
+    QCOMPARE(recent.value().size(), 4);
+}
+
+QTEST_MAIN(TestTieredRepository)
+#include "test_tieredrepository.moc"
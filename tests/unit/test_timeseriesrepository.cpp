@@ -0,0 +1,220 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <cmath>
+#include "../src/repositories/timeseriesrepository.h"
+
+/**
+ * @brief Unit tests for the compressed append-only time-series engine
+ * 
+ * Tests round trips through open and sealed chunks, compression ratio,
+ * persistence across reopen, recovery of open chunks from the journal
+ * after a crash and recovery from torn writes.
+ */
+class TestTimeSeriesRepository : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    
+    void testRoundTrip();
+    void testCompressionRatio();
+    void testReopen();
+    void testCrashRecovery();
+    void testTornWriteRecovery();
+    void testFindSamples();
+    void testRejectsNonNumeric();
+
+private:
+    QString directory() const;
+    
+    QTemporaryDir *m_tempDir;
+};
+
+void TestTimeSeriesRepository::init()
+{
+    m_tempDir = new QTemporaryDir();
+    QVERIFY(m_tempDir->isValid());
+}
+
+void TestTimeSeriesRepository::cleanup()
+{
+    delete m_tempDir;
+    m_tempDir = nullptr;
+}
+
+QString TestTimeSeriesRepository::directory() const
+{
+    return m_tempDir->filePath("timeseries");
+}
+
+void TestTimeSeriesRepository::testRoundTrip()
+{
+    TimeSeriesRepository repo(directory());
+    QVERIFY(repo.isOpen());
+    
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    const int samples = TimeSeriesRepository::SAMPLES_PER_CHUNK + 100;  // One sealed, one open chunk
+    
+    for (int i = 0; i < samples; ++i) {
+        QVERIFY(repo.save(DataPoint("Flow", 0.1 * i, base.addMSecs(i * 250))).isSuccess());
+        QVERIFY(repo.save(DataPoint("Count", i, base.addMSecs(i * 250),
+                                    i % 10 ? DataPoint::Quality::Good : DataPoint::Quality::Stale)).isSuccess());
+    }
+    QCOMPARE(repo.count(), samples * 2);
+    
+    auto flow = repo.findByTag("Flow");
+    QVERIFY(flow.isSuccess());
+    QCOMPARE(flow.value().size(), samples);
+    QCOMPARE(flow.value().first().toDouble(), 0.1 * (samples - 1));
+    QCOMPARE(flow.value().last().timestamp(), base);
+    
+    auto range = repo.findByTagAndTimeRange("Count", base.addMSecs(1000 * 250), base.addMSecs(1049 * 250));
+    QVERIFY(range.isSuccess());
+    QCOMPARE(range.value().size(), 50);
+    QCOMPARE(range.value().first().value().type(), QVariant::LongLong);
+    QCOMPARE(range.value().last().value().toInt(), 1000);
+    QCOMPARE(range.value().last().quality(), DataPoint::Quality::Stale);
+    
+    QCOMPARE(repo.findByTimeRange(base, base.addMSecs(999)).value().size(), 8);
+    QCOMPARE(repo.findLatestByTag("Count").value().value().toInt(), samples - 1);
+    QCOMPARE(repo.findById("Flow@" + QString::number(base.toMSecsSinceEpoch() + 500)).value().toDouble(), 0.2);
+    QVERIFY(repo.deleteById("Flow@0").isFailure());
+}
+
+void TestTimeSeriesRepository::testCompressionRatio()
+{
+    TimeSeriesRepository repo(directory());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    const int samples = 20 * TimeSeriesRepository::SAMPLES_PER_CHUNK;
+    
+    // Slowly changing process value polled once per second
+    for (int i = 0; i < samples; ++i) {
+        const double temperature = std::round((20.0 + 5.0 * std::sin(i / 3600.0)) * 10.0) / 10.0;
+        repo.save(DataPoint("Temperature", temperature, base.addSecs(i)));
+    }
+    QVERIFY(repo.flush().isSuccess());
+    
+    const double bytesPerSample = double(repo.storageSize()) / samples;
+    QVERIFY2(bytesPerSample < 2.0, qPrintable(QString("%1 bytes per sample").arg(bytesPerSample)));
+}
+
+void TestTimeSeriesRepository::testReopen()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    {
+        TimeSeriesRepository repo(directory());
+        for (int i = 0; i < 10; ++i) {
+            repo.save(DataPoint("A", i, base.addSecs(i)));
+        }
+        // Destructor seals the open chunk
+    }
+    
+    TimeSeriesRepository repo(directory());
+    QCOMPARE(repo.count(), 10);
+    repo.save(DataPoint("A", 10, base.addSecs(10)));
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), 10);
+    
+    QVERIFY(repo.clear().isSuccess());
+    QCOMPARE(repo.count(), 0);
+}
+
+void TestTimeSeriesRepository::testCrashRecovery()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    const int samples = TimeSeriesRepository::SAMPLES_PER_CHUNK + 10;  // One sealed, one open chunk
+    
+    // Never destroyed, so nothing is flushed on the way out - like a crash
+    TimeSeriesRepository* crashed = new TimeSeriesRepository(directory());
+    for (int i = 0; i < samples; ++i) {
+        QVERIFY(crashed->save(DataPoint("A", i, base.addSecs(i))).isSuccess());
+    }
+    QVERIFY(crashed->save(DataPoint("B", 0.5, base, DataPoint::Quality::Uncertain)).isSuccess());
+    
+    TimeSeriesRepository repo(directory());
+    QCOMPARE(repo.count(), samples + 1);
+    QCOMPARE(repo.findLatestByTag("A").value().value().toInt(), samples - 1);
+    QCOMPARE(repo.findLatestByTag("A").value().value().type(), QVariant::LongLong);
+    QCOMPARE(repo.findLatestByTag("B").value().quality(), DataPoint::Quality::Uncertain);
+    
+    // The journal keeps working after recovery
+    QVERIFY(repo.save(DataPoint("B", 1.5, base.addSecs(1))).isSuccess());
+    QVERIFY(repo.flush().isSuccess());
+    QCOMPARE(QFileInfo(QDir(directory()).filePath("open-chunks.journal")).size(), qint64(0));
+    QCOMPARE(repo.findByTag("B").value().size(), 2);
+}
+
+void TestTimeSeriesRepository::testTornWriteRecovery()
+{
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    
+    {
+        TimeSeriesRepository repo(directory());
+        for (int i = 0; i < 10; ++i) {
+            repo.save(DataPoint("A", i, base.addSecs(i)));
+        }
+        QVERIFY(repo.flush().isSuccess());
+        for (int i = 0; i < 10; ++i) {
+            repo.save(DataPoint("B", i, base.addSecs(i)));
+        }
+    }
+    
+    // Simulate a crash in the middle of writing the second chunk
+    const QString segment = QDir(directory()).filePath("segment-00000001.tss");
+    QFile file(segment);
+    const qint64 fullSize = file.size();
+    QVERIFY(file.resize(fullSize - 5));
+    
+    TimeSeriesRepository repo(directory());
+    QCOMPARE(repo.count(), 10);
+    QVERIFY(repo.findByTag("B").value().isEmpty());
+    QVERIFY(QFile(segment).size() < fullSize - 5);
+    
+    // Appending continues after the last valid chunk
+    repo.save(DataPoint("B", 42, base));
+    QVERIFY(repo.flush().isSuccess());
+    QCOMPARE(repo.findLatestByTag("B").value().value().toInt(), 42);
+}
+
+void TestTimeSeriesRepository::testFindSamples()
+{
+    TimeSeriesRepository repo(directory());
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(1700000000000);
+    const int samples = TimeSeriesRepository::SAMPLES_PER_CHUNK + 100;
+    
+    for (int i = 0; i < samples; ++i) {
+        repo.save(DataPoint("Flow", 0.5 * i, base.addMSecs(i * 250)));
+        repo.save(DataPoint("Count", i, base.addMSecs(i * 250)));
+    }
+    
+    auto flow = repo.findSamples("Flow");
+    QVERIFY(flow.isSuccess());
+    QCOMPARE(flow.value().size(), samples);
+    QCOMPARE(flow.value().first().timestampMs(), base.toMSecsSinceEpoch());
+    QCOMPARE(flow.value().last().real, 0.5 * (samples - 1));
+    QCOMPARE(flow.value().last().tag(), QString("Flow"));
+    
+    auto count = repo.findSamples("Count", base.addMSecs(1000 * 250), base.addMSecs(1049 * 250));
+    QVERIFY(count.isSuccess());
+    QCOMPARE(count.value().size(), 50);
+    QCOMPARE(count.value().first().type, Sample::Type::Int);
+    QCOMPARE(count.value().first().integer, qint64(1000));
+    
+    QVERIFY(repo.findSamples("Unknown").value().isEmpty());
+}
+
+void TestTimeSeriesRepository::testRejectsNonNumeric()
+{
+    TimeSeriesRepository repo(directory());
+    QVERIFY(repo.save(DataPoint("Mode", QString("AUTO"))).isFailure());
+    QVERIFY(repo.save(DataPoint("Running", true)).isSuccess());
+    QCOMPARE(repo.count(), 1);
+}
+
+QTEST_MAIN(TestTimeSeriesRepository)
+#include "test_timeseriesrepository.moc"
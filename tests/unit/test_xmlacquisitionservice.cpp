@@ -0,0 +1,204 @@
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "../src/services/xmlacquisitionservice.h"
+#include "../mocks/mockhttpcontroller.h"
+
+/**
+ * @brief Unit tests for pooled XML acquisition
+ * 
+ * Tests against a local controller web server that fetches stay within
+ * the global request limit, that the visible page is fetched first, and
+ * that published snapshots never change after delivery.
+ */
+class TestXmlAcquisitionService : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    
+    void testConcurrencyLimit();
+    void testVisibleSourceFirst();
+    void testImmutableSnapshots();
+    void testRemoveSource();
+
+private:
+    static QByteArray makeDocument(int fieldCount, int valueOffset);
+    
+    QTemporaryDir m_cacheDir;
+};
+
+QByteArray TestXmlAcquisitionService::makeDocument(int fieldCount, int valueOffset)
+{
+    QByteArray xml = "<unit_page version=\"1\"><hdr title=\"unit\"/>"
+                     "<frm type=\"cnt\"><col title=\"Process\">";
+    for (int i = 0; i < fieldCount; ++i) {
+        xml += QString("<val id=\"f%1\" label=\"Field %1\" unit=\"bar\">%2</val>")
+                   .arg(i).arg(i + valueOffset).toUtf8();
+    }
+    xml += "</col></frm></unit_page>";
+    return xml;
+}
+
+void TestXmlAcquisitionService::initTestCase()
+{
+    QVERIFY(m_cacheDir.isValid());
+}
+
+void TestXmlAcquisitionService::testConcurrencyLimit()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    const int pageCount = 12;
+    for (int i = 0; i < pageCount; ++i) {
+        controller.setDocument(QString("unit/p_%1.xml").arg(i), makeDocument(50 + i, 0));
+    }
+    
+    XmlAcquisitionService acquisition;
+    acquisition.setLayoutCacheDirectory(m_cacheDir.path());
+    acquisition.setMaxConcurrentRequests(3);
+    QSignalSpy updatedSpy(&acquisition, &XmlAcquisitionService::pageUpdated);
+    
+    QList<int> ids;
+    for (int i = 0; i < pageCount; ++i) {
+        ids.append(acquisition.addSource(controller.baseUrl(), QString("unit/p_%1.xml").arg(i), 60000));
+    }
+    QCOMPARE(acquisition.addSource(controller.baseUrl(), "unit/p_0.xml", 60000), ids.first());
+    QCOMPARE(acquisition.sourceCount(), pageCount);
+    
+    acquisition.start();
+    QCOMPARE(acquisition.requestsInFlight(), 3);
+    QTRY_COMPARE_WITH_TIMEOUT(updatedSpy.count(), pageCount, 10000);
+    
+    QCOMPARE(acquisition.getStatistics().requests, pageCount);
+    QCOMPARE(acquisition.getStatistics().parses, pageCount);
+    QCOMPARE(acquisition.getStatistics().peakConcurrentRequests, 3);
+    QCOMPARE(acquisition.getStatistics().errors, 0);
+    for (int i = 0; i < pageCount; ++i) {
+        const auto snapshot = acquisition.snapshot(ids.at(i));
+        QVERIFY(snapshot);
+        QCOMPARE(snapshot->sourceId, ids.at(i));
+        QCOMPARE(snapshot->page.fieldCount, 50 + i);
+        QVERIFY(snapshot->layoutChanged);
+        QCOMPARE(snapshot->sequence, quint64(1));
+    }
+    
+    // Nothing is due again for a minute
+    QTest::qWait(100);
+    QCOMPARE(controller.getRequestCount(), pageCount);
+}
+
+void TestXmlAcquisitionService::testVisibleSourceFirst()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    for (int i = 0; i < 6; ++i) {
+        controller.setDocument(QString("unit/p_%1.xml").arg(i), makeDocument(20, i));
+    }
+    
+    XmlAcquisitionService acquisition;
+    acquisition.setLayoutCacheDirectory(m_cacheDir.path());
+    acquisition.setMaxConcurrentRequests(1);
+    QSignalSpy updatedSpy(&acquisition, &XmlAcquisitionService::pageUpdated);
+    QSignalSpy servedSpy(&controller, &MockHttpController::requestServed);
+    
+    QList<int> ids;
+    for (int i = 0; i < 6; ++i) {
+        ids.append(acquisition.addSource(controller.baseUrl(), QString("unit/p_%1.xml").arg(i), 60000));
+    }
+    acquisition.setVisibleSource(ids.last());
+    acquisition.start();
+    
+    QTRY_COMPARE_WITH_TIMEOUT(updatedSpy.count(), 6, 10000);
+    QCOMPARE(servedSpy.count(), 6);
+    QCOMPARE(servedSpy.at(0).at(0).toString(), QString("/unit/p_5.xml"));
+    // The rest in the order they were added
+    for (int i = 1; i < 6; ++i) {
+        QCOMPARE(servedSpy.at(i).at(0).toString(), QString("/unit/p_%1.xml").arg(i - 1));
+    }
+    
+    // Switching pages refreshes the new one immediately (the document is
+    // unchanged, so the refresh ends in a 304 and publishes nothing)
+    updatedSpy.clear();
+    const int requests = controller.getRequestCount();
+    acquisition.setVisibleSource(ids.at(2));
+    QTRY_COMPARE_WITH_TIMEOUT(acquisition.getStatistics().notModified, 1, 5000);
+    QCOMPARE(controller.getRequestCount(), requests + 1);
+    QCOMPARE(updatedSpy.count(), 0);
+    
+    // A changed document is published for the visible page
+    controller.setDocument("unit/p_2.xml", makeDocument(20, 100));
+    acquisition.setVisibleSource(ids.at(2));
+    QVERIFY(updatedSpy.wait());
+    QCOMPARE(updatedSpy.at(0).at(0).toInt(), ids.at(2));
+}
+
+void TestXmlAcquisitionService::testImmutableSnapshots()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    controller.setDocument("unit/p_operation.xml", makeDocument(200, 0));
+    
+    XmlAcquisitionService acquisition;
+    acquisition.setLayoutCacheDirectory(m_cacheDir.path());
+    QSignalSpy updatedSpy(&acquisition, &XmlAcquisitionService::pageUpdated);
+    const int id = acquisition.addSource(controller.baseUrl(), "unit/p_operation.xml", 20);
+    acquisition.start();
+    
+    QVERIFY(updatedSpy.wait());
+    const XmlAcquisitionService::SnapshotPtr first = acquisition.snapshot(id);
+    QVERIFY(first);
+    QCOMPARE(updatedSpy.at(0).at(1).value<XmlAcquisitionService::SnapshotPtr>(), first);
+    QCOMPARE(first->page.forms.at(0).columns.at(0).fields.at(5).value.toDouble(), 5.0);
+    
+    // Unchanged documents are answered with a 304 and publish nothing
+    QTRY_VERIFY_WITH_TIMEOUT(acquisition.getStatistics().notModified >= 2, 5000);
+    QCOMPARE(updatedSpy.count(), 1);
+    QCOMPARE(acquisition.snapshot(id), first);
+    
+    // A new version is published as a new snapshot listing its changes
+    controller.setDocument("unit/p_operation.xml", makeDocument(200, 1000));
+    QVERIFY(updatedSpy.wait());
+    const XmlAcquisitionService::SnapshotPtr second = acquisition.snapshot(id);
+    QVERIFY(second != first);
+    QVERIFY(!second->layoutChanged);
+    QCOMPARE(second->changes.size(), 200);
+    QCOMPARE(second->sequence, first->sequence + 1);
+    QCOMPARE(second->page.forms.at(0).columns.at(0).fields.at(5).value.toDouble(), 1005.0);
+    
+    // The earlier snapshot still shows the values it was published with
+    QCOMPARE(first->page.forms.at(0).columns.at(0).fields.at(5).value.toDouble(), 5.0);
+    QVERIFY(first->layoutChanged);
+    QVERIFY(first->changes.isEmpty());
+    QCOMPARE(acquisition.getStatistics().parses, 2);
+}
+
+void TestXmlAcquisitionService::testRemoveSource()
+{
+    MockHttpController controller;
+    QVERIFY(controller.listen());
+    controller.setDocument("unit/p_operation.xml", makeDocument(20, 0));
+    
+    XmlAcquisitionService acquisition;
+    acquisition.setLayoutCacheDirectory(m_cacheDir.path());
+    QSignalSpy updatedSpy(&acquisition, &XmlAcquisitionService::pageUpdated);
+    const int id = acquisition.addSource(controller.baseUrl(), "unit/p_operation.xml", 20);
+    acquisition.setVisibleSource(id);
+    acquisition.start();
+    QCOMPARE(acquisition.requestsInFlight(), 1);
+    
+    // Removing a source aborts its request and frees the slot
+    acquisition.removeSource(id);
+    QCOMPARE(acquisition.requestsInFlight(), 0);
+    QCOMPARE(acquisition.sourceCount(), 0);
+    QCOMPARE(acquisition.visibleSource(), -1);
+    QVERIFY(!acquisition.snapshot(id));
+    
+    QTest::qWait(200);
+    QCOMPARE(updatedSpy.count(), 0);
+    QCOMPARE(acquisition.getStatistics().requests, 1);
+}
+
+QTEST_MAIN(TestXmlAcquisitionService)
+#include "test_xmlacquisitionservice.moc"